@@ -12,6 +12,9 @@
 #include <stb_image.h>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include "texture_cooker/cooked_texture.h"
+#include "suballocators.h"
+#include "mesh_processing.h"
 
 #include <iostream>
 #include <cassert>
@@ -28,14 +31,39 @@
 #include <optional>
 #include <vector>
 #include <set>
+#include <map>
 #include <array>
+#include <tuple>
 #include <chrono>
 #include <unordered_map>
+#include <queue>
+#include <deque>
+#include <memory>
+#include <type_traits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 #define VIEWPORT_WIDTH 1080;
 #define VIEWPORT_HEIGHT 720;
-#define PBR_SAMPLER_NUMBER 7 // BC + M + R + N + AO + Emissive + Mask
+#define PBR_SAMPLER_NUMBER 4 // BC + ORM(AO + R + M + Mask) + N + Emissive
 #define POINT_LIGHTS_NUM 16
 #define SHADOWMAP_DIM 1024
 #define VERTEX_BUFFER_BIND_ID 0
@@ -45,6 +73,27 @@
 #define SCENE_SHOW_SKYDOME true
 #define ENABLE_INDIRECT_DRAW false
 #define ENABLE_DEFEERED_RENDERING true
+#define ENABLE_PARALLEL_ASSET_LOADING true
+#define ENABLE_STREAMING_UPLOAD true
+#define STREAMING_STAGING_SIZE (64 * 1024 * 1024)
+#define ENABLE_TRANSFER_QUEUE_UPLOAD false // 流式上传使用独立的传输队列族并做所有权转移，还没有在同步验证下验证过，默认关闭，上传走图形队列
+#define ENABLE_SYNC_VALIDATION true // 开启验证层时同时开启同步验证，检查传输队列和图形队列之间的所有权转移和屏障
+#define DEVICE_MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
+#define ENABLE_MESH_IMPORT_BENCHMARK false
+#define ENABLE_COMPACT_VERTEX true
+#define MAX_MESH_LODS 4 // 烘焙模型最多的LOD数量，包括原始模型
+#define ENABLE_INSTANCE_LOD true
+#define LOD_ERROR_PIXELS 1.0f // LOD的简化误差投影到屏幕上不超过这个像素数时才使用这个LOD
+#define GEOMETRY_POOL_MIN_VERTICES (256 * 1024) // 几何缓存池的初始容量，放不下时按两倍扩容
+#define GEOMETRY_POOL_MIN_INDICES (1024 * 1024)
+#define ENABLE_SCENE_MULTI_DRAW_INDIRECT true // 场景物体默认通过 Multi-Draw-Indirect 提交，运行时按 I 键和逐物体提交切换
+#define MAX_SCENE_DRAW_DATA 1024 // 场景 DrawData 存储缓存的容量，每个物体一条
+#define MAX_SCENE_DRAWS 4096 // 每个Pass每帧 indirect draw 命令缓存的初始容量，放不下时按两倍扩容
+#define SCENE_DRAW_STATS_INTERVAL 5.0f // 每隔多少秒打印一次场景提交的录制耗时
+#define ENABLE_PARALLEL_COMMAND_RECORDING true // 各个Pass在录制线程中写入 Secondary CommandBuffer，运行时按 P 键和单线程录制切换
+#define RECORD_OBJECTS_PER_TASK 64 // 逐物体提交时每个录制任务负责的物体数量
+#define ENABLE_COMMAND_BUFFER_CACHE true // 录制依赖的状态没有变化时重复提交缓存的 CommandBuffer，运行时按 C 键切换
+#define UNIFORM_RING_SIZE (256 * 1024) // 每帧统一缓存环的容量
 
 /** 同时渲染多帧的最大帧数*/
 const int MAX_FRAMES_IN_FLIGHT = 2;
@@ -55,6 +104,7 @@ struct FInstanceData {
 	glm::vec3 InstanceRotation;
 	glm::float32 InstancePScale;
 	glm::uint8 InstanceTexIndex;
+	glm::uint16 InstanceDrawIndex;		// 所属物体在 DrawData 存储缓存中的序号，占用原来的对齐空间
 };
 
 
@@ -91,6 +141,96 @@ struct FLight
 	}
 };
 
+
+enum class ELightType : uint8_t
+{
+	Directional = 0,
+	Point,
+	Spot,
+	Count
+};
+
+
+/** 场景中所有的灯光，按 方向光、点光源、聚光灯 的顺序连续存放，和着色器中的灯光存储缓存一一对应
+ * 每个灯光记录还有哪些帧没有上传它的修改，每帧只上传这一帧的脏灯光*/
+struct FSceneLights
+{
+	std::vector<FLight> Lights;
+	std::vector<uint32_t> DirtyFrames;		// 按位记录每个灯光还需要上传到哪些帧
+	uint32_t Counts[static_cast<size_t>(ELightType::Count)] = {};
+
+	static constexpr uint32_t ALL_FRAMES_DIRTY = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+
+	uint32_t Num(ELightType inType) const
+	{
+		return Counts[static_cast<size_t>(inType)];
+	}
+
+	/** 灯光在整个灯光数组中的序号*/
+	uint32_t GetIndex(ELightType inType, uint32_t inIndex) const
+	{
+		uint32_t first = 0;
+		for (size_t type = 0; type < static_cast<size_t>(inType); type++) {
+			first += Counts[type];
+		}
+		return first + inIndex;
+	}
+
+	const FLight& Get(ELightType inType, uint32_t inIndex) const
+	{
+		return Lights[GetIndex(inType, inIndex)];
+	}
+
+	/** 修改灯光，所有帧都需要重新上传这个灯光*/
+	FLight& Edit(ELightType inType, uint32_t inIndex)
+	{
+		uint32_t index = GetIndex(inType, inIndex);
+		DirtyFrames[index] = ALL_FRAMES_DIRTY;
+		return Lights[index];
+	}
+
+	/** 添加灯光，插入到同类灯光的末尾，后面的灯光序号都变了，需要全部重新上传*/
+	void Add(ELightType inType, const FLight& inLight)
+	{
+		uint32_t index = GetIndex(inType, Num(inType));
+		Lights.insert(Lights.begin() + index, inLight);
+		DirtyFrames.insert(DirtyFrames.begin() + index, ALL_FRAMES_DIRTY);
+		std::fill(DirtyFrames.begin() + index, DirtyFrames.end(), ALL_FRAMES_DIRTY);
+		Counts[static_cast<size_t>(inType)]++;
+	}
+
+	void MarkAllDirty()
+	{
+		std::fill(DirtyFrames.begin(), DirtyFrames.end(), ALL_FRAMES_DIRTY);
+	}
+};
+
+
+/** 场景物体参与的Pass，注册时按位组合成 PassFlags*/
+enum class EScenePass : uint8_t
+{
+	Shadow = 0,
+	Forward,
+	Deferred,
+	Indirect,
+	Count
+};
+
+constexpr size_t SCENE_PASS_COUNT = static_cast<size_t>(EScenePass::Count);
+
+constexpr uint32_t ScenePassBit(EScenePass inPass)
+{
+	return 1u << static_cast<uint32_t>(inPass);
+}
+
+
+/** 场景注册表中物体的句柄，槽位和代数；物体移除后槽位会被复用，代数不同的旧句柄失效*/
+struct FSceneHandle
+{
+	uint32_t Slot = UINT32_MAX;
+	uint32_t Generation = 0;
+};
+
 /** 物体的MVP矩阵信息*/
 struct FUniformBufferBase {
 	glm::mat4 Model;
@@ -104,6 +244,7 @@ struct FVertex {
 	glm::vec3 Normal;
 	glm::vec3 Color;
 	glm::vec2 TexCoord;
+	glm::vec4 Tangent;		// 导入时生成的切线（MikkTSpace），w为手性：B = cross(N, T) * w
 
 	// 顶点描述
 	static VkVertexInputBindingDescription GetBindingDescription() {
@@ -115,8 +256,9 @@ struct FVertex {
 		return bindingDescription;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions() {
-		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+	/** 切线使用 location 8，location 4~7 留给 Instance 数据*/
+	static std::array<VkVertexInputAttributeDescription, 5> GetAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
 
 		attributeDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
 		attributeDescriptions[0].location = 0;
@@ -138,6 +280,11 @@ struct FVertex {
 		attributeDescriptions[3].format = VK_FORMAT_R32G32_SFLOAT;
 		attributeDescriptions[3].offset = offsetof(FVertex, TexCoord);
 
+		attributeDescriptions[4].binding = VERTEX_BUFFER_BIND_ID;
+		attributeDescriptions[4].location = 8;
+		attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[4].offset = offsetof(FVertex, Tangent);
+
 		return attributeDescriptions;
 	}
 
@@ -156,8 +303,8 @@ struct FVertex {
 		return { bindingDescription0, bindingDescription1 };
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 8> GetAttributeInstancedDescriptions() {
-		std::array<VkVertexInputAttributeDescription, 8> attributeDescriptions{};
+	static std::array<VkVertexInputAttributeDescription, 10> GetAttributeInstancedDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 10> attributeDescriptions{};
 
 		attributeDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
 		attributeDescriptions[0].location = 0;
@@ -179,1382 +326,3050 @@ struct FVertex {
 		attributeDescriptions[3].format = VK_FORMAT_R32G32_SFLOAT;
 		attributeDescriptions[3].offset = offsetof(FVertex, TexCoord);
 
-		attributeDescriptions[4].binding = INSTANCE_BUFFER_BIND_ID;
-		attributeDescriptions[4].location = 4;
-		attributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[4].offset = offsetof(FInstanceData, InstancePosition);
+		attributeDescriptions[4].binding = VERTEX_BUFFER_BIND_ID;
+		attributeDescriptions[4].location = 8;
+		attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[4].offset = offsetof(FVertex, Tangent);
 
 		attributeDescriptions[5].binding = INSTANCE_BUFFER_BIND_ID;
-		attributeDescriptions[5].location = 5;
+		attributeDescriptions[5].location = 4;
 		attributeDescriptions[5].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[5].offset = offsetof(FInstanceData, InstanceRotation);
+		attributeDescriptions[5].offset = offsetof(FInstanceData, InstancePosition);
 
 		attributeDescriptions[6].binding = INSTANCE_BUFFER_BIND_ID;
-		attributeDescriptions[6].location = 6;
-		attributeDescriptions[6].format = VK_FORMAT_R32_SFLOAT;
-		attributeDescriptions[6].offset = offsetof(FInstanceData, InstancePScale);
+		attributeDescriptions[6].location = 5;
+		attributeDescriptions[6].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[6].offset = offsetof(FInstanceData, InstanceRotation);
 
 		attributeDescriptions[7].binding = INSTANCE_BUFFER_BIND_ID;
-		attributeDescriptions[7].location = 7;
-		attributeDescriptions[7].format = VK_FORMAT_R8_UINT;
-		attributeDescriptions[7].offset = offsetof(FInstanceData, InstanceTexIndex);
+		attributeDescriptions[7].location = 6;
+		attributeDescriptions[7].format = VK_FORMAT_R32_SFLOAT;
+		attributeDescriptions[7].offset = offsetof(FInstanceData, InstancePScale);
+
+		attributeDescriptions[8].binding = INSTANCE_BUFFER_BIND_ID;
+		attributeDescriptions[8].location = 7;
+		attributeDescriptions[8].format = VK_FORMAT_R8_UINT;
+		attributeDescriptions[8].offset = offsetof(FInstanceData, InstanceTexIndex);
+
+		attributeDescriptions[9].binding = INSTANCE_BUFFER_BIND_ID;
+		attributeDescriptions[9].location = 9;
+		attributeDescriptions[9].format = VK_FORMAT_R16_UINT;
+		attributeDescriptions[9].offset = offsetof(FInstanceData, InstanceDrawIndex);
 
 		return attributeDescriptions;
 	}
 
 	bool operator==(const FVertex& other) const {
-		return Position == other.Position && Normal == other.Normal && Color == other.Color && TexCoord == other.TexCoord;
+		return Position == other.Position && Normal == other.Normal && Color == other.Color && TexCoord == other.TexCoord && Tangent == other.Tangent;
 	}
 };
 
 namespace std {
 	template<> struct hash<FVertex> {
 		size_t operator()(FVertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.Position) ^ (hash<glm::vec3>()(vertex.Color) << 1)) >> 1) ^ (hash<glm::vec2>()(vertex.TexCoord) << 1);
+			size_t seed = 0;
+			glm::detail::hash_combine(seed, hash<glm::vec3>()(vertex.Position));
+			glm::detail::hash_combine(seed, hash<glm::vec3>()(vertex.Normal));
+			glm::detail::hash_combine(seed, hash<glm::vec3>()(vertex.Color));
+			glm::detail::hash_combine(seed, hash<glm::vec2>()(vertex.TexCoord));
+			glm::detail::hash_combine(seed, hash<glm::vec4>()(vertex.Tangent));
+			return seed;
 		}
 	};
 }
 
+/** 顶点格式，每个模型可以单独选择*/
+enum class EVertexFormat : uint8_t
+{
+	Full,		// FVertex，60字节
+	Compact,	// FCompactVertex，20字节
+};
 
-const std::vector<const char*> ValidationLayers = { "VK_LAYER_KHRONOS_validation" }; // VK_LAYER_KHRONOS_validation这个是固定的，不能重命名
-const std::vector<const char*> DeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+/** 紧凑顶点的反量化参数，也是场景 DrawData 存储缓存中每个物体的数据，顶点着色器按物体序号读取
+ * position = snorm16 * PositionScale + PositionOffset
+ * uv = unorm16 * TexCoordScaleOffset.xy + TexCoordScaleOffset.zw*/
+struct FMeshConstants {
+	glm::vec4 PositionScale = glm::vec4(1.0f);
+	glm::vec4 PositionOffset = glm::vec4(0.0f);
+	glm::vec4 TexCoordScaleOffset = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
 
+/** 紧凑顶点：16位量化的位置，八面体编码的法线和切线，16位量化的UV，不保存顶点颜色
+ * 位置的w分量保存切线的手性（副切线方向）
+ * UV按物体的UV包围盒量化，精度是包围盒大小的1/65535，不随UV离原点的距离变差（半精度在UV大于2048时步长已经超过1）*/
+struct FCompactVertex {
+	int16_t Position[4];		// snorm16，模型包围盒内量化
+	int16_t NormalTangent[4];	// snorm16，xy为法线，zw为切线
+	uint16_t TexCoord[2];		// unorm16，模型UV包围盒内量化
 
-#ifdef NDEBUG
-const bool bEnableValidationLayers = false;  // Build Configuration: Release
-#else
-const bool bEnableValidationLayers = true;   // Build Configuration: Debug
-#endif
+	static VkVertexInputBindingDescription GetBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = VERTEX_BUFFER_BIND_ID;
+		bindingDescription.stride = sizeof(FCompactVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
 
+	/** 和 FVertex 使用相同的 location，没有颜色所以不使用 location 2*/
+	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
 
-static VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
-	auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-	if (func != nullptr)
-	{
-		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+		attributeDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+		attributeDescriptions[0].offset = offsetof(FCompactVertex, Position);
+
+		attributeDescriptions[1].binding = VERTEX_BUFFER_BIND_ID;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R16G16B16A16_SNORM;
+		attributeDescriptions[1].offset = offsetof(FCompactVertex, NormalTangent);
+
+		attributeDescriptions[2].binding = VERTEX_BUFFER_BIND_ID;
+		attributeDescriptions[2].location = 3;
+		attributeDescriptions[2].format = VK_FORMAT_R16G16_UNORM;
+		attributeDescriptions[2].offset = offsetof(FCompactVertex, TexCoord);
+
+		return attributeDescriptions;
 	}
-	else
-	{
-		return VK_ERROR_EXTENSION_NOT_PRESENT;
+
+	// 顶点描述，带Instance
+	static std::array<VkVertexInputBindingDescription, 2> GetBindingInstancedDescriptions() {
+		std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = FVertex::GetBindingInstancedDescriptions();
+		bindingDescriptions[0].stride = sizeof(FCompactVertex);
+		return bindingDescriptions;
 	}
-}
 
+	/** 顶点部分和 GetAttributeDescriptions 相同，Instance 部分和 FVertex 相同*/
+	static std::array<VkVertexInputAttributeDescription, 8> GetAttributeInstancedDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 8> attributeDescriptions{};
+		std::array<VkVertexInputAttributeDescription, 3> vertexAttributes = GetAttributeDescriptions();
+		std::array<VkVertexInputAttributeDescription, 10> instancedAttributes = FVertex::GetAttributeInstancedDescriptions();
+		std::copy(vertexAttributes.begin(), vertexAttributes.end(), attributeDescriptions.begin());
+		std::copy(instancedAttributes.begin() + 5, instancedAttributes.end(), attributeDescriptions.begin() + 3);
+		return attributeDescriptions;
+	}
 
-static void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
-{
-	auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-	if (func != nullptr)
+	/** 把 FVertex 量化为紧凑顶点，法线和导入时生成的切线做八面体编码
+	 * 位置按包围盒中心和半长量化到[-1, 1]，UV按UV包围盒量化到[0, 1]，反量化参数写入 outConstants*/
+	static void Quantize(const FVertex* inVertices, uint32_t inVertexCount, std::vector<FCompactVertex>& outVertices, FMeshConstants& outConstants)
 	{
-		func(instance, debugMessenger, pAllocator);
+		glm::vec3 boundsMin(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+		glm::vec2 texCoordMin(std::numeric_limits<float>::max());
+		glm::vec2 texCoordMax(-std::numeric_limits<float>::max());
+		for (uint32_t i = 0; i < inVertexCount; i++) {
+			boundsMin = glm::min(boundsMin, inVertices[i].Position);
+			boundsMax = glm::max(boundsMax, inVertices[i].Position);
+			texCoordMin = glm::min(texCoordMin, inVertices[i].TexCoord);
+			texCoordMax = glm::max(texCoordMax, inVertices[i].TexCoord);
+		}
+		glm::vec3 center = inVertexCount > 0 ? (boundsMin + boundsMax) * 0.5f : glm::vec3(0.0f);
+		glm::vec3 extent = inVertexCount > 0 ? glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(1e-6f)) : glm::vec3(1.0f);
+		glm::vec2 texCoordOffset = inVertexCount > 0 ? texCoordMin : glm::vec2(0.0f);
+		glm::vec2 texCoordScale = inVertexCount > 0 ? glm::max(texCoordMax - texCoordMin, glm::vec2(1e-6f)) : glm::vec2(1.0f);
+		outConstants.PositionScale = glm::vec4(extent, 0.0f);
+		outConstants.PositionOffset = glm::vec4(center, 0.0f);
+		outConstants.TexCoordScaleOffset = glm::vec4(texCoordScale, texCoordOffset);
+
+		outVertices.resize(inVertexCount);
+		for (uint32_t i = 0; i < inVertexCount; i++) {
+			const FVertex& vertex = inVertices[i];
+			FCompactVertex& compact = outVertices[i];
+
+			glm::vec3 normal = glm::length(vertex.Normal) > 0.0f ? glm::normalize(vertex.Normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+			glm::vec3 tangent = glm::vec3(vertex.Tangent);
+			float handedness = vertex.Tangent.w < 0.0f ? -1.0f : 1.0f;
+
+			glm::vec3 position = (vertex.Position - center) / extent;
+			glm::vec2 octNormal = OctEncode(normal);
+			glm::vec2 octTangent = OctEncode(tangent);
+			compact.Position[0] = PackSnorm16(position.x);
+			compact.Position[1] = PackSnorm16(position.y);
+			compact.Position[2] = PackSnorm16(position.z);
+			compact.Position[3] = PackSnorm16(handedness);
+			compact.NormalTangent[0] = PackSnorm16(octNormal.x);
+			compact.NormalTangent[1] = PackSnorm16(octNormal.y);
+			compact.NormalTangent[2] = PackSnorm16(octTangent.x);
+			compact.NormalTangent[3] = PackSnorm16(octTangent.y);
+			glm::vec2 texCoord = (vertex.TexCoord - texCoordOffset) / texCoordScale;
+			compact.TexCoord[0] = PackUnorm16(texCoord.x);
+			compact.TexCoord[1] = PackUnorm16(texCoord.y);
+		}
 	}
-}
 
+	/** 八面体编码，单位向量映射到[-1, 1]的正方形上，和着色器中的 OctDecode 对应*/
+	static glm::vec2 OctEncode(const glm::vec3& n)
+	{
+		glm::vec3 v = n / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+		glm::vec2 e(v.x, v.y);
+		if (v.z < 0.0f) {
+			e.x = (1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f);
+			e.y = (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return e;
+	}
 
-/** 所有的硬件信息*/
-struct FQueueFamilyIndices
-{
-	std::optional<uint32_t> GraphicsFamily;
-	std::optional<uint32_t> PresentFamily;
+	static int16_t PackSnorm16(float v)
+	{
+		return static_cast<int16_t>(std::round(glm::clamp(v, -1.0f, 1.0f) * 32767.0f));
+	}
 
-	bool IsComplete()
+	static uint16_t PackUnorm16(float v)
 	{
-		return GraphicsFamily.has_value() && PresentFamily.has_value();
+		return static_cast<uint16_t>(std::round(glm::clamp(v, 0.0f, 1.0f) * 65535.0f));
 	}
 };
 
 
-/** 支持的硬件细节信息*/
-struct FSwapChainSupportDetails
+/** 导入模型时生成切线，结果和 MikkTSpace 的约定一致：
+ * 三角形的切线先投影到顶点法线的切平面上，再按顶点处的夹角加权累加；副切线不保存，由 cross(N, T) * w 重建
+ * 镜像UV接缝处同一个顶点两侧的手性相反，这时拆分出一个新顶点，手性为负的三角形改用新顶点*/
+class FTangentGenerator
 {
-	VkSurfaceCapabilitiesKHR Capabilities;
-	std::vector<VkSurfaceFormatKHR> Formats;
-	std::vector<VkPresentModeKHR> PresentModes;
-};
+public:
+	static void Generate(std::vector<FVertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const size_t vertexCount = vertices.size();
+		// 每个顶点按手性分开累加，[2 * i] 为正手性，[2 * i + 1] 为负手性
+		std::vector<glm::vec3> tangents(vertexCount * 2, glm::vec3(0.0f));
+		std::vector<uint8_t> cornerSigns(indices.size(), 0);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const FVertex& v0 = vertices[indices[i + 0]];
+			const FVertex& v1 = vertices[indices[i + 1]];
+			const FVertex& v2 = vertices[indices[i + 2]];
+			glm::vec3 edge1 = v1.Position - v0.Position;
+			glm::vec3 edge2 = v2.Position - v0.Position;
+			glm::vec2 deltaUV1 = v1.TexCoord - v0.TexCoord;
+			glm::vec2 deltaUV2 = v2.TexCoord - v0.TexCoord;
+			float det = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+			if (std::abs(det) < 1e-12f) {
+				// UV退化的三角形不参与累加
+				continue;
+			}
+			float r = 1.0f / det;
+			glm::vec3 faceTangent = (edge1 * deltaUV2.y - edge2 * deltaUV1.y) * r;
+			glm::vec3 faceBitangent = (edge2 * deltaUV1.x - edge1 * deltaUV2.x) * r;
+
+			for (uint32_t k = 0; k < 3; k++) {
+				uint32_t index = indices[i + k];
+				const FVertex& vertex = vertices[index];
+				glm::vec3 normal = GetNormal(vertex);
+				glm::vec3 tangent = faceTangent - normal * glm::dot(normal, faceTangent);
+				if (glm::length(tangent) < 1e-12f) {
+					continue;
+				}
+				tangent = glm::normalize(tangent);
+
+				// 顶点处两条边的夹角作为权重
+				const FVertex& prev = vertices[indices[i + (k + 2) % 3]];
+				const FVertex& next = vertices[indices[i + (k + 1) % 3]];
+				glm::vec3 edgeA = next.Position - vertex.Position;
+				glm::vec3 edgeB = prev.Position - vertex.Position;
+				float lengthAB = glm::length(edgeA) * glm::length(edgeB);
+				float angle = lengthAB > 0.0f ? std::acos(glm::clamp(glm::dot(edgeA, edgeB) / lengthAB, -1.0f, 1.0f)) : 0.0f;
+
+				uint8_t sign = glm::dot(glm::cross(normal, tangent), faceBitangent) < 0.0f ? 1 : 0;
+				tangents[2 * index + sign] += tangent * angle;
+				cornerSigns[i + k] = sign;
+			}
+		}
 
+		// 两种手性都有的顶点拆分成两个
+		std::vector<uint32_t> splitVertices(vertexCount, UINT32_MAX);
+		for (size_t i = 0; i < vertexCount; i++) {
+			if (glm::length(tangents[2 * i]) > 0.0f && glm::length(tangents[2 * i + 1]) > 0.0f) {
+				splitVertices[i] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertices[i]);
+			}
+		}
+		for (size_t i = 0; i < indices.size(); i++) {
+			if (cornerSigns[i] == 1 && splitVertices[indices[i]] != UINT32_MAX) {
+				indices[i] = splitVertices[indices[i]];
+			}
+		}
 
-class FVulkanRendererApp
-{
-	struct FGlobalInput {
-		glm::vec3 CameraPos;
-		glm::vec3 CameraLookat;
-		float CameraSpeed;
-		float CameraFOV;
-		float zNear;
-		float zFar;
+		for (size_t i = 0; i < vertexCount; i++) {
+			const glm::vec3& positive = tangents[2 * i];
+			const glm::vec3& negative = tangents[2 * i + 1];
+			if (splitVertices[i] != UINT32_MAX) {
+				vertices[i].Tangent = MakeTangent(vertices[i], positive, 1.0f);
+				vertices[splitVertices[i]].Tangent = MakeTangent(vertices[i], negative, -1.0f);
+			}
+			else if (glm::length(negative) > 0.0f) {
+				vertices[i].Tangent = MakeTangent(vertices[i], negative, -1.0f);
+			}
+			else {
+				vertices[i].Tangent = MakeTangent(vertices[i], positive, 1.0f);
+			}
+		}
+	}
 
-		float CameraArm;
-		float CameraYaw;
-		float CameraPitch;
+private:
+	static glm::vec3 GetNormal(const FVertex& vertex)
+	{
+		return glm::length(vertex.Normal) > 0.0f ? glm::normalize(vertex.Normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+	}
 
-		bool bFocusCamera;
-		bool bUpdateCamera;
+	/** 累加结果再和法线正交化，UV退化时任选一个和法线垂直的方向*/
+	static glm::vec4 MakeTangent(const FVertex& vertex, const glm::vec3& tangentSum, float handedness)
+	{
+		glm::vec3 normal = GetNormal(vertex);
+		glm::vec3 tangent = tangentSum - normal * glm::dot(normal, tangentSum);
+		if (glm::length(tangent) < 1e-6f) {
+			tangent = glm::cross(normal, std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		return glm::vec4(glm::normalize(tangent), handedness);
+	}
+};
 
-		float CurrentTime;
-		float DeltaTime;
-		bool bFirstInit;
-		double LastMouseX, LastMouseY;
-		bool bPlayStageRoll;
-		float RollStage;
-		bool bPlayLightRoll;
-		float RollLight;
 
-		void ResetToFocus()
-		{
-			CameraPos = glm::vec3(2.0, 2.0, 2.0);
-			CameraLookat = glm::vec3(0.0, 0.0, 0.0);
-			CameraSpeed = 2.5;
-			CameraFOV = 45.0;
-			zNear = 0.1f;
-			zFar = 45.0f;
+/** 一级LOD在点序缓存中的范围，所有LOD共用顶点缓存*/
+struct FMeshLod {
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	float Error = 0.0f;          // 相对原始模型的最大几何误差，模型空间的距离
+};
 
-			glm::mat4 transform = glm::lookAt(CameraPos, CameraLookat, glm::vec3(0.0f, 0.0f, 1.0f));
-			glm::quat rotation(transform);
-			glm::vec3 Direction = glm::normalize(CameraLookat - CameraPos);
-			CameraYaw = 30.0; //glm::degrees(glm::atan(Direction.x, Direction.y));
-			CameraPitch = 60.0; //glm::degrees(glm::asin(Direction.z));
-			CameraArm = 10.0;
-			bUpdateCamera = false;
-			bFocusCamera = true;
 
-			CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-			CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-			CameraPos.z = sin(glm::radians(CameraPitch)) * CameraArm;
-		}
-		void ResetToTravel()
-		{
-			CameraPos = glm::vec3(2.0, 0.0, 0.0);
-			CameraLookat = glm::vec3(0.0, 0.0, 0.0);
-			CameraSpeed = 2.5;
-			CameraFOV = 45.0;
-			zNear = 0.1f;
-			zFar = 45.0f;
+/** 烘焙后的二进制模型文件头，文件布局为：Header + Vertex Blob + Index Blob + Cluster Blob*/
+struct FCookedMeshHeader {
+	uint32_t Magic;              // 'MESH'
+	uint32_t Version;            // 格式或者顶点结构改变时递增
+	uint32_t VertexStride;       // sizeof(FVertex)，用来检测顶点结构是否改变
+	uint32_t VertexCount;
+	uint32_t IndexCount;         // 所有LOD的点序总数
+	uint32_t IndexStride;        // 点序的字节数，顶点不超过65536个时为2（uint16_t），否则为4
+	uint64_t VertexOffset;       // 顶点数据相对文件头的偏移
+	uint64_t IndexOffset;        // 点序数据相对文件头的偏移
+	uint64_t SourceSize;         // 源OBJ文件大小
+	int64_t SourceTime;          // 源OBJ文件修改时间
+	uint64_t SourceHash;         // 源OBJ文件内容的FNV-1a哈希
+	glm::vec3 BoundsMin;         // 包围盒
+	glm::vec3 BoundsMax;
+	float ACMR;                  // 优化后点序的顶点缓存统计，见 FVertexCacheStats
+	float ATVR;
+	uint32_t LodCount;           // LOD数量，Lods[0] 是原始模型
+	FMeshLod Lods[MAX_MESH_LODS];
+	uint32_t ClusterCount;       // LOD0 划分的簇数量，簇按点序排列并覆盖整个 LOD0
+	uint64_t ClusterOffset;      // 簇数据相对文件头的偏移
+
+	static const uint32_t MAGIC = 0x4853454D; // 'MESH'
+	static const uint32_t VERSION = 7;
+};
 
-			CameraArm = (float)(CameraLookat - CameraPos).length();
-			glm::mat4 transform = glm::lookAt(CameraPos, CameraLookat, glm::vec3(0.0f, 0.0f, 1.0f));
-			glm::quat rotation(transform);
-			CameraYaw = -90.0f;;
-			CameraPitch = 0.0;
-			bUpdateCamera = false;
-			bFocusCamera = false;
-		}
-		void ResetAnimation()
-		{
-			bPlayStageRoll = false;
-			RollStage = 0.0;
-			bPlayLightRoll = false;
-			RollLight = 0.0;
-		}
-	} GlobalInput;
 
-	/** 全局常量*/
-	struct FGlobalConstants {
-		float Time;
-		float MetallicFactor;
-		float RoughnessFactor;
-		uint32_t SpecConstants;
-		uint32_t SpecConstantsCount;                // 特殊常数，用于优化着色器变体
-		void ResetConstants()
-		{
-			Time = 0.0f;
-			MetallicFactor = 0.0f;
-			RoughnessFactor = 1.0;
-			SpecConstants = 0;
-			SpecConstantsCount = 10;
-		}
-	} GlobalConstants;
+/** 只读的内存映射文件，用来直接读取烘焙后的二进制资源，避免额外的拷贝*/
+struct FMappedFile {
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+#ifdef _WIN32
+	HANDLE FileHandle = INVALID_HANDLE_VALUE;
+	HANDLE MappingHandle = nullptr;
+#endif
 
-	/** 场景灯光信息*/
-	struct FUniformBufferView {
-		glm::mat4 ShadowmapSpace;
-		glm::mat4 LocalToWorld;
-		glm::vec4 CameraInfo;
-		FLight DirectionalLights[16];
-		FLight PointLights[512];
-		FLight SpotLights[16];
-		// LightsCount: [0] for number of DirectionalLights, [1] for number of PointLights, [2] for number of SpotLights, [3] for number of cube map max miplevels.
-		glm::ivec4 LightsCount;
-		glm::float32 zNear;
-		glm::float32 zFar;
+	FMappedFile() = default;
+	FMappedFile(const FMappedFile&) = delete;
+	FMappedFile& operator=(const FMappedFile&) = delete;
+	~FMappedFile() { Close(); }
 
-		FUniformBufferView& FUniformBufferView::operator=(const FUniformBufferView& rhs)
-		{
-			ShadowmapSpace = rhs.ShadowmapSpace;
-			LocalToWorld = rhs.LocalToWorld;
-			CameraInfo = rhs.CameraInfo;
-			DirectionalLights[16] = rhs.DirectionalLights[16];
-			PointLights[512] = rhs.PointLights[512];
-			SpotLights[16] = rhs.SpotLights[16];
-			LightsCount = rhs.LightsCount;
-			zNear = rhs.zNear;
-			zFar = rhs.zFar;
-			return *this; 
+	bool Open(const std::string& filename)
+	{
+		Close();
+#ifdef _WIN32
+		FileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (FileHandle == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(FileHandle, &fileSize) || fileSize.QuadPart == 0) {
+			Close();
+			return false;
+		}
+		MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (MappingHandle == nullptr) {
+			Close();
+			return false;
+		}
+		Data = static_cast<const uint8_t*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+		Size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return false;
+		}
+		void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapped == MAP_FAILED) {
+			return false;
+		}
+		Data = static_cast<const uint8_t*>(mapped);
+		Size = static_cast<size_t>(st.st_size);
+#endif
+		if (Data == nullptr) {
+			Close();
+			return false;
 		}
-	} View;
-
-	struct FMesh {
-		std::vector<FVertex> Vertices;                       // 顶点
-		std::vector<uint32_t> Indices;                       // 点序
-		VkBuffer VertexBuffer;                               // 顶点缓存
-		VkDeviceMemory VertexBufferMemory;                   // 顶点缓存内存
-		VkBuffer IndexBuffer;                                // 点序缓存
-		VkDeviceMemory IndexBufferMemory;                    // 点序缓存内存
+		return true;
+	}
 
-		// only init with instanced mesh
-		VkBuffer InstancedBuffer;                            // Instanced buffer
-		VkDeviceMemory InstancedBufferMemory;                // Instanced buffer memory
-	};
+	void Close()
+	{
+#ifdef _WIN32
+		if (Data) { UnmapViewOfFile(Data); }
+		if (MappingHandle) { CloseHandle(MappingHandle); }
+		if (FileHandle != INVALID_HANDLE_VALUE) { CloseHandle(FileHandle); }
+		MappingHandle = nullptr;
+		FileHandle = INVALID_HANDLE_VALUE;
+#else
+		if (Data) { munmap(const_cast<uint8_t*>(Data), Size); }
+#endif
+		Data = nullptr;
+		Size = 0;
+	}
+};
 
-	typedef FMesh FInstancedMesh;
 
-	struct FCluster {
+/** 一次显存子分配，资源共享少量的大块VkDeviceMemory，绑定时使用Memory + Offset*/
+struct FMemoryAllocation {
+	VkDeviceMemory Memory = VK_NULL_HANDLE;	// 所在块的内存
+	VkDeviceSize Offset = 0;				// 在块中的偏移
+	VkDeviceSize Size = 0;
+	uint8_t* Mapped = nullptr;				// 主机可见内存持久映射的地址，已经加上Offset
+	uint32_t MemoryTypeIndex = 0;
+	uint32_t BlockId = 0;					// 所在块的编号，为0时没有分配
+};
 
-	};
 
-	struct FActor {
-		std::vector<FCluster> Clusters;
-	};
+/** 显存分配统计*/
+struct FMemoryStats {
+	uint32_t BlockCount = 0;				// VkDeviceMemory 的数量，即 vkAllocateMemory 的次数
+	uint32_t DedicatedBlockCount = 0;		// 单独占用一个块的大资源
+	uint32_t AllocationCount = 0;			// 子分配的数量
+	VkDeviceSize BlockBytes = 0;
+	VkDeviceSize UsedBytes = 0;
+	VkDeviceSize FreeBytes = 0;				// 可以再分配的空间
+	VkDeviceSize LargestFreeRange = 0;
 
-	struct FIndirectMesh : public FMesh
+	/** 碎片率：1 - 最大空闲区间 / 所有空闲空间，0表示空闲空间是连续的*/
+	float GetFragmentation() const
 	{
-		std::vector<FActor> Actors;
-	};
+		return FreeBytes > 0 ? 1.0f - static_cast<float>(LargestFreeRange) / static_cast<float>(FreeBytes) : 0.0f;
+	}
+};
 
-	struct FIndirectInstancedMesh : public FInstancedMesh
-	{
-		std::vector<FActor> Actors;
-	};
 
-	struct FMaterial {
-		std::vector<VkImage> TextureImages;                  // 贴图
-		std::vector<VkDeviceMemory> TextureImageMemorys;     // 贴图内存
-		std::vector<VkImageView> TextureImageViews;          // 贴图视口
-		std::vector<VkSampler> TextureSamplers;              // 贴图采样器
+/** 碎片整理的模拟结果，用来在真正移动之前估计收益*/
+struct FDefragmentationPlan {
+	uint32_t MoveCount = 0;					// 可以移动到其他块的分配数量
+	VkDeviceSize MovedBytes = 0;
+	uint32_t FreedBlockCount = 0;			// 移动之后可以回收的块数量
+};
 
-		VkDescriptorPool DescriptorPool;                     // 描述符池
-		std::vector<VkDescriptorSet> DescriptorSets;         // 描述符集合
-	};
 
-	struct FRenderBase
-	{
-		FMaterial MateData;
-	};
+/** 显存子分配器：每种内存类型按块（默认 DEVICE_MEMORY_BLOCK_SIZE）调用 vkAllocateMemory，资源从块中切分，块内的区间由 FMemoryBlockAllocator 管理
+ * 超过半个块的资源单独分配一个块，主机可见的块在创建时整体持久映射*/
+class FDeviceMemoryAllocator
+{
+public:
+	/** 碎片整理的移动回调：from 为原来的分配，to 为分配器已经在其他块中预留好的新位置
+	 * 所有者在 to 上创建新的缓存或者图片，拷贝数据，重新绑定并更新描述符后返回true，旧资源和 from 由所有者在GPU不再使用后释放
+	 * 不认识这个分配或者无法移动时返回false，to 被释放*/
+	using FMoveCallback = std::function<bool(const FMemoryAllocation& from, const FMemoryAllocation& to)>;
 
-	/** 构建 RenderObject 需要的 Vulkan 资源*/
-	struct FRenderObject : public FRenderBase
+	void Init(VkPhysicalDevice inPhysicalDevice, VkDevice inDevice, VkDeviceSize inBlockSize)
 	{
-		FMesh MeshData;
-	};
+		Device = inDevice;
+		vkGetPhysicalDeviceMemoryProperties(inPhysicalDevice, &MemoryProperties);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(inPhysicalDevice, &properties);
+		BufferImageGranularity = std::max<VkDeviceSize>(1, properties.limits.bufferImageGranularity);
+		MaxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+		BlockSize = inBlockSize;
+	}
 
-	struct FRenderInstancedObject : public FRenderBase
+	/** 释放所有的块，仍然存在的分配视为泄漏*/
+	void Destroy()
 	{
-		FInstancedMesh MeshData;
-		uint32_t InstanceCount;
-	};
+		std::lock_guard<std::mutex> lock(Mutex);
+		uint32_t leakedAllocations = 0;
+		for (auto& pair : Blocks) {
+			leakedAllocations += pair.second->Allocator.GetAllocationCount();
+			vkFreeMemory(Device, pair.second->Memory, nullptr);
+		}
+		Blocks.clear();
+		if (leakedAllocations > 0) {
+			std::cout << "[LOG]: " << leakedAllocations << " device memory allocations were not freed" << std::endl;
+		}
+	}
 
-	struct FRenderIndirectObjectBase : public FRenderBase
+	FMemoryAllocation Allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, EMemoryResourceType resourceType, EMemoryAllocationStrategy strategy)
 	{
-		VkBuffer IndirectCommandsBuffer;							// 包含 the indirect drawing commands
-		VkDeviceMemory IndirectCommandsBufferMemory;
-		std::vector<VkDrawIndexedIndirectCommand> IndirectCommands; // 存储 indirect draw commands，包含 index offsets 和 Instance count per object
-	};
+		std::lock_guard<std::mutex> lock(Mutex);
+		VkDeviceSize blockSize = GetBlockSize(memoryTypeIndex);
+		FMemoryAllocation allocation;
+		if (requirements.size > blockSize / 2)
+		{
+			FMemoryBlock& block = CreateBlock(memoryTypeIndex, requirements.size, strategy, true);
+			AllocateFromBlock(block, requirements.size, requirements.alignment, resourceType, allocation);
+			return allocation;
+		}
+		for (auto& pair : Blocks)
+		{
+			FMemoryBlock& block = *pair.second;
+			if (!block.bDedicated && block.MemoryTypeIndex == memoryTypeIndex && block.Allocator.GetStrategy() == strategy &&
+				AllocateFromBlock(block, requirements.size, requirements.alignment, resourceType, allocation)) {
+				return allocation;
+			}
+		}
+		FMemoryBlock& block = CreateBlock(memoryTypeIndex, blockSize, strategy, false);
+		if (!AllocateFromBlock(block, requirements.size, requirements.alignment, resourceType, allocation)) {
+			throw std::runtime_error("failed to sub-allocate device memory!");
+		}
+		return allocation;
+	}
 
-	struct FRenderIndirectObject : public FRenderIndirectObjectBase
+	/** 释放分配，单独分配的块和多余的空块直接归还给驱动*/
+	void Free(FMemoryAllocation& allocation)
 	{
-		FIndirectMesh MeshData;
-	};
+		if (allocation.BlockId == 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(Mutex);
+		auto found = Blocks.find(allocation.BlockId);
+		if (found == Blocks.end()) {
+			throw std::runtime_error("failed to free device memory, block not found!");
+		}
+		FMemoryBlock& block = *found->second;
+		block.Allocator.Free(allocation.Offset);
+		allocation = FMemoryAllocation{};
 
-	struct FRenderIndirectInstancedObject : public FRenderIndirectObjectBase
-	{
-		FIndirectInstancedMesh MeshData;
-		uint32_t InstanceCount;
-	};
+		if (block.Allocator.GetAllocationCount() == 0 && (block.bDedicated || HasOtherEmptyBlock(block))) {
+			vkFreeMemory(Device, block.Memory, nullptr);
+			Blocks.erase(found);
+		}
+	}
 
-	/** 延迟管线 GBuffer*/
-	struct FGeometryBuffer {
-		// Depth Stencil RGBAFloat
-		VkFormat DepthStencilFormat;
-		VkImage DepthStencilImage;
-		VkDeviceMemory DepthStencilMemory;
-		VkImageView DepthStencilImageView;
-		VkSampler DepthStencilSampler;
-		// SceneColorDeferred RGBAHalf
-		VkFormat SceneColorFormat;
-		VkImage SceneColorImage;
-		VkDeviceMemory SceneColorMemory;
-		VkImageView SceneColorImageView;
-		VkSampler SceneColorSampler;
-		// Normal+CastShadow R10G10B10A2
-		VkFormat GBufferAFormat;
-		VkImage GBufferAImage;
-		VkDeviceMemory GBufferAMemory;
-		VkImageView GBufferAImageView;
-		VkSampler GBufferASampler;
-		// M+S+R+(ShadingModelID+SelectiveOutputMask) RGBA8888
-		VkFormat GBufferBFormat;
-		VkImage GBufferBImage;
-		VkDeviceMemory GBufferBMemory;
-		VkImageView GBufferBImageView;
-		VkSampler GBufferBSampler;
-		// BaseColor+AO
-		VkFormat GBufferCFormat;
-		VkImage GBufferCImage;
-		VkDeviceMemory GBufferCMemory;
-		VkImageView GBufferCImageView;
-		VkSampler GBufferCSampler;
-		// Position+ID
-		VkFormat GBufferDFormat;
-		VkImage GBufferDImage;
-		VkDeviceMemory GBufferDMemory;
-		VkImageView GBufferDImageView;
-		VkSampler GBufferDSampler;
-		// MotionVector+Velocity(Currently not implemented)
-		//VkImage GBufferVelocityImage;
-		//VkDeviceMemory GBufferVelocityMemory;
-		//VkImageView GBufferVelocityImageView;
-		
-		VkSampler Sampler;
-	} GBuffer;
+	/** 碎片整理：从使用率最低的FreeList块开始，在同一内存类型中使用率更高的块里为每个分配预留新位置，再调用onMove让所有者移动资源
+	 * 回调中会创建资源，调用时不持有锁；所有者释放 from 之后清空的块被回收，返回移动的次数*/
+	uint32_t Defragment(uint32_t maxMoves, const FMoveCallback& onMove)
+	{
+		struct FCandidate { uint32_t BlockId; VkDeviceSize Offset, Size, Alignment; EMemoryResourceType Type; };
+		std::vector<FCandidate> candidates;
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			std::vector<const FMemoryBlock*> sources;
+			for (auto& pair : Blocks) {
+				if (!pair.second->bDedicated && pair.second->Allocator.GetStrategy() == EMemoryAllocationStrategy::FreeList && pair.second->Allocator.GetAllocationCount() > 0) {
+					sources.push_back(pair.second.get());
+				}
+			}
+			std::sort(sources.begin(), sources.end(), [](const FMemoryBlock* a, const FMemoryBlock* b) {
+				return a->Allocator.GetUsedBytes() < b->Allocator.GetUsedBytes();
+			});
+			for (const FMemoryBlock* source : sources) {
+				source->Allocator.ForEachAllocation([&candidates, source, maxMoves](uint64_t offset, uint64_t size, uint64_t alignment, EMemoryResourceType type) {
+					if (candidates.size() < maxMoves) {
+						candidates.push_back({ source->Id, offset, size, alignment, type });
+					}
+				});
+			}
+		}
 
-	/** 构建 ShadowmapPass 需要的 Vulkan 资源*/
-	struct FShadowmapPass {
-		std::vector<FRenderObject*> RenderObjects;
-		std::vector<FRenderInstancedObject*> RenderInstancedObjects;
-		std::vector<FRenderIndirectObject*> RenderIndirectObject;
-		std::vector<FRenderIndirectInstancedObject*> RenderIndirectInstancedObject;
-		float zNear, zFar;
-		int32_t Width, Height;
-		VkFormat Format;
-		VkFramebuffer FrameBuffer;
-		VkRenderPass RenderPass;
-		VkImage Image;
-		VkDeviceMemory Memory;
-		VkImageView ImageView;
-		VkSampler Sampler;
-		VkDescriptorSetLayout DescriptorSetLayout;
-		VkDescriptorPool DescriptorPool;
-		std::vector<VkDescriptorSet> DescriptorSets;
-		VkPipelineLayout PipelineLayout;
-		VkPipeline Pipeline;
-		VkPipeline PipelineInstanced;
-		std::vector<VkBuffer> UniformBuffers;
-		std::vector<VkDeviceMemory> UniformBuffersMemory;
-	} ShadowmapPass;
+		uint32_t moveCount = 0;
+		for (const FCandidate& candidate : candidates)
+		{
+			FMemoryAllocation from;
+			FMemoryAllocation to;
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				auto found = Blocks.find(candidate.BlockId);
+				if (found == Blocks.end()) {
+					continue;
+				}
+				FMemoryBlock& source = *found->second;
+				from = MakeAllocation(source, candidate.Offset, candidate.Size);
+				// 优先移动到使用率最高的块，让使用率低的块尽快清空
+				std::vector<FMemoryBlock*> targets;
+				for (auto& pair : Blocks) {
+					FMemoryBlock* target = pair.second.get();
+					if (target != &source && !target->bDedicated && target->Allocator.GetStrategy() == EMemoryAllocationStrategy::FreeList &&
+						target->MemoryTypeIndex == source.MemoryTypeIndex && target->Allocator.GetUsedBytes() >= source.Allocator.GetUsedBytes()) {
+						targets.push_back(target);
+					}
+				}
+				std::sort(targets.begin(), targets.end(), [](const FMemoryBlock* a, const FMemoryBlock* b) {
+					return a->Allocator.GetUsedBytes() > b->Allocator.GetUsedBytes();
+				});
+				for (FMemoryBlock* target : targets) {
+					if (AllocateFromBlock(*target, candidate.Size, candidate.Alignment, candidate.Type, to)) {
+						break;
+					}
+				}
+			}
+			if (to.BlockId == 0) {
+				continue;
+			}
+			if (onMove(from, to)) {
+				moveCount++;
+			}
+			else {
+				Free(to);
+			}
+		}
+		return moveCount;
+	}
 
-	/** 构建 BackgroundPass 需要的 Vulkan 资源*/
-	struct FBackgroundPass {
-		VkImage Image;
-		VkDeviceMemory Memory;
-		VkImageView ImageView;
-		VkSampler Sampler;
-		VkRenderPass RenderPass;
-		VkDescriptorSetLayout DescriptorSetLayout;
-		VkDescriptorPool DescriptorPool;
-		std::vector<VkDescriptorSet> DescriptorSets;
-		VkPipelineLayout PipelineLayout;
-		std::vector<VkPipeline> Pipelines;
-	} BackgroundPass;
+	/** 不移动任何资源：在块的副本上模拟碎片整理，估计能移动多少分配、回收多少块，顺序和 Defragment 相同*/
+	FDefragmentationPlan PlanDefragmentation(uint32_t maxMoves)
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		struct FSimulatedBlock {
+			const FMemoryBlock* Block;
+			FMemoryBlockAllocator Allocator;
+		};
+		std::vector<FSimulatedBlock> blocks;
+		for (auto& pair : Blocks) {
+			if (!pair.second->bDedicated && pair.second->Allocator.GetStrategy() == EMemoryAllocationStrategy::FreeList) {
+				blocks.push_back({ pair.second.get(), pair.second->Allocator });
+			}
+		}
+		std::sort(blocks.begin(), blocks.end(), [](const FSimulatedBlock& a, const FSimulatedBlock& b) {
+			return a.Allocator.GetUsedBytes() < b.Allocator.GetUsedBytes();
+		});
 
+		FDefragmentationPlan plan;
+		for (size_t source = 0; source < blocks.size() && plan.MoveCount < maxMoves; source++)
+		{
+			if (blocks[source].Allocator.GetAllocationCount() == 0) {
+				continue;
+			}
+			struct FMove { VkDeviceSize Offset, Size, Alignment; EMemoryResourceType Type; };
+			std::vector<FMove> moves;
+			blocks[source].Allocator.ForEachAllocation([&moves](uint64_t offset, uint64_t size, uint64_t alignment, EMemoryResourceType type) {
+				moves.push_back({ offset, size, alignment, type });
+			});
+			for (const FMove& move : moves)
+			{
+				if (plan.MoveCount >= maxMoves) {
+					break;
+				}
+				// 优先移动到使用率最高的块，让使用率低的块尽快清空
+				for (size_t target = blocks.size(); target-- > source + 1; )
+				{
+					uint64_t offset;
+					if (blocks[target].Block->MemoryTypeIndex == blocks[source].Block->MemoryTypeIndex &&
+						blocks[target].Allocator.Allocate(move.Size, move.Alignment, move.Type, offset)) {
+						blocks[source].Allocator.Free(move.Offset);
+						plan.MoveCount++;
+						plan.MovedBytes += move.Size;
+						break;
+					}
+				}
+			}
+			plan.FreedBlockCount += blocks[source].Allocator.GetAllocationCount() == 0 ? 1 : 0;
+		}
+		return plan;
+	}
 
-	/** 构建 SkydomePass 需要的 Vulkan 资源*/
-	struct FSkydomePass {
-		FMesh SkydomeMesh;
-		VkImage Image;
-		VkDeviceMemory Memory;
-		VkImageView ImageView;
-		VkSampler Sampler;
-		VkRenderPass RenderPass;
-		VkDescriptorSetLayout DescriptorSetLayout;
-		VkDescriptorPool DescriptorPool;
-		std::vector<VkDescriptorSet> DescriptorSets;
-		VkPipelineLayout PipelineLayout;
-		std::vector<VkPipeline> Pipelines;
-	} SkydomePass;
+	FMemoryStats GetStats()
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		FMemoryStats stats;
+		for (auto& pair : Blocks)
+		{
+			const FMemoryBlock& block = *pair.second;
+			stats.BlockCount++;
+			stats.DedicatedBlockCount += block.bDedicated ? 1 : 0;
+			stats.AllocationCount += block.Allocator.GetAllocationCount();
+			stats.BlockBytes += block.Allocator.GetSize();
+			stats.UsedBytes += block.Allocator.GetUsedBytes();
+			if (block.bDedicated) {
+				continue;
+			}
+			stats.FreeBytes += block.Allocator.GetFreeBytes();
+			stats.LargestFreeRange = std::max<VkDeviceSize>(stats.LargestFreeRange, block.Allocator.GetLargestFreeRange());
+		}
+		return stats;
+	}
 
-	/** 构建 BaseScenePass 需要的 Vulkan 资源*/
-	struct FBaseScenePass {
-		std::vector<FRenderObject> RenderObjects;					// 待渲染的物体
-		std::vector<FRenderInstancedObject> RenderInstancedObjects;	// 待渲染的物体
-		VkDescriptorSetLayout DescriptorSetLayout;					// 描述符集合布局
-		VkPipelineLayout PipelineLayout;							// 渲染管线布局
-		std::vector<VkPipeline> Pipelines;							// 渲染管线
-		std::vector<VkPipeline> PipelinesInstanced;					// 渲染管线
-	} BaseScenePass;
+private:
+	struct FMemoryBlock {
+		uint32_t Id = 0;
+		VkDeviceMemory Memory = VK_NULL_HANDLE;
+		uint8_t* Mapped = nullptr;
+		uint32_t MemoryTypeIndex = 0;
+		bool bDedicated = false;
+		FMemoryBlockAllocator Allocator;
+	};
 
-	struct FBaseSceneIndirectPass {
-		std::vector<FRenderIndirectObject> RenderIndirectObject;					// 待渲染的物体
-		std::vector<FRenderIndirectInstancedObject> RenderIndirectInstancedObject;	// 待渲染的物体
-		VkDescriptorSetLayout DescriptorSetLayout;									// 描述符集合布局
-		VkPipelineLayout PipelineLayout;											// 渲染管线布局
-		std::vector<VkPipeline> Pipelines;											// 渲染管线
-		std::vector<VkPipeline> PipelinesInstanced;									// 渲染管线
-	} BaseSceneIndirectPass;
+	/** 小显存堆上使用更小的块，避免一个块占掉整个堆*/
+	VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex) const
+	{
+		VkDeviceSize heapSize = MemoryProperties.memoryHeaps[MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		return std::min(BlockSize, std::max<VkDeviceSize>(heapSize / 8, 1024 * 1024));
+	}
 
-	struct FBaseSceneDeferredRenderingPass {
-		std::vector<FRenderObject> RenderObjects;					// 待渲染的物体
-		std::vector<FRenderInstancedObject> RenderInstancedObjects;	// 待渲染的物体
-		VkDescriptorSetLayout SceneDescriptorSetLayout;				// 描述符集合布局
-		VkPipelineLayout ScenePipelineLayout;						// 渲染管线布局
-		std::vector<VkPipeline> ScenePipelines;						// 渲染管线
-		std::vector<VkPipeline> ScenePipelinesInstanced;			// 渲染管线
-		VkFramebuffer SceneFrameBuffer;
-		VkRenderPass SceneRenderPass;
-		VkDescriptorSetLayout LightingDescriptorSetLayout;
-		VkDescriptorPool LightingDescriptorPool;
-		std::vector<VkDescriptorSet> LightingDescriptorSets;
-		VkPipelineLayout LightingPipelineLayout;
-		std::vector<VkPipeline> LightingPipelines;
-	} BaseSceneDeferredPass;
+	FMemoryBlock& CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, EMemoryAllocationStrategy strategy, bool bDedicated)
+	{
+		if (Blocks.size() >= MaxMemoryAllocationCount) {
+			throw std::runtime_error("failed to allocate device memory block, maxMemoryAllocationCount reached!");
+		}
+		auto block = std::make_unique<FMemoryBlock>();
+		block->Id = NextBlockId++;
+		block->MemoryTypeIndex = memoryTypeIndex;
+		block->bDedicated = bDedicated;
+		block->Allocator.Init(size, strategy, BufferImageGranularity);
 
-	GLFWwindow* Window;										// Window 渲染桌面
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+		if (vkAllocateMemory(Device, &allocInfo, nullptr, &block->Memory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate device memory block!");
+		}
+		// 同一个VkDeviceMemory只能映射一次，主机可见的块整体持久映射，分配直接使用偏移后的地址
+		if (MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			void* data;
+			vkMapMemory(Device, block->Memory, 0, VK_WHOLE_SIZE, 0, &data);
+			block->Mapped = static_cast<uint8_t*>(data);
+		}
 
-	VkInstance Instance;									// 链接程序的Vulkan实例
-	VkDebugUtilsMessengerEXT DebugMessenger;
-	VkSurfaceKHR Surface;									// 链接桌面和Vulkan的实例
+		FMemoryBlock& result = *block;
+		Blocks.emplace(result.Id, std::move(block));
+		return result;
+	}
 
-	VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;		// 物理显卡硬件
-	VkDevice Device;										// 逻辑硬件，对接物理硬件
+	bool HasOtherEmptyBlock(const FMemoryBlock& block) const
+	{
+		for (const auto& pair : Blocks) {
+			const FMemoryBlock& other = *pair.second;
+			if (&other != &block && !other.bDedicated && other.Allocator.GetAllocationCount() == 0 &&
+				other.MemoryTypeIndex == block.MemoryTypeIndex && other.Allocator.GetStrategy() == block.Allocator.GetStrategy()) {
+				return true;
+			}
+		}
+		return false;
+	}
 
-	VkQueue GraphicsQueue;									// 显卡的队列
-	VkQueue PresentQueue;									// 显示器的队列
+	bool AllocateFromBlock(FMemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, EMemoryResourceType type, FMemoryAllocation& outAllocation)
+	{
+		uint64_t offset;
+		if (!block.Allocator.Allocate(size, alignment, type, offset)) {
+			return false;
+		}
+		outAllocation = MakeAllocation(block, offset, size);
+		return true;
+	}
 
-	VkSwapchainKHR SwapChain;								// 缓存渲染图像队列，同步到显示器
-	std::vector<VkImage> SwapChainImages;					// 渲染图像队列
-	VkFormat SwapChainImageFormat;							// 渲染图像格式
-	VkExtent2D SwapChainExtent;								// 渲染图像范围
-	std::vector<VkImageView> SwapChainImageViews;			// 渲染图像队列对应的视图队列
-	std::vector<VkFramebuffer> SwapChainFramebuffers;		// 渲染图像队列对应的帧缓存队列
+	static FMemoryAllocation MakeAllocation(const FMemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+	{
+		FMemoryAllocation allocation;
+		allocation.Memory = block.Memory;
+		allocation.Offset = offset;
+		allocation.Size = size;
+		allocation.Mapped = block.Mapped ? block.Mapped + offset : nullptr;
+		allocation.MemoryTypeIndex = block.MemoryTypeIndex;
+		allocation.BlockId = block.Id;
+		return allocation;
+	}
 
-	VkRenderPass MainRenderPass;							// 渲染层，保存Framebuffer和采样信息
+	VkDevice Device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties MemoryProperties{};
+	VkDeviceSize BufferImageGranularity = 1;
+	uint32_t MaxMemoryAllocationCount = 4096;
+	VkDeviceSize BlockSize = 0;
+	uint32_t NextBlockId = 1;
+	std::map<uint32_t, std::unique_ptr<FMemoryBlock>> Blocks;
+	std::mutex Mutex;
+};
 
-	VkImage DepthImage;										// 深度纹理资源
-	VkDeviceMemory DepthImageMemory;						// 深度纹理内存
-	VkImageView DepthImageView;								// 深度纹理图像视口
 
-	uint32_t CubemapMaxMips;								// 环境反射纹理最大Mips数
-	VkImage CubemapImage;									// 环境反射纹理资源
-	VkDeviceMemory CubemapImageMemory;						// 环境反射纹理内存
-	VkImageView CubemapImageView;							// 环境反射纹理图像视口
-	VkSampler CubemapSampler;								// 环境反射纹理采样器
+/** 持久映射的环形StagingBuffer，上传数据直接写入映射的内存，不需要每次创建和映射临时缓存
+ * 按顺序从环中切出空间，GPU使用完成（Fence触发）后释放，队首连续释放的空间才会被重新使用*/
+struct FStagingRing
+{
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	FMemoryAllocation Memory;
+	uint8_t* Mapped = nullptr;
+	VkDeviceSize Size = 0;
 
-	std::vector<VkBuffer> BaseUniformBuffers;				// 统一缓存区
-	std::vector<VkDeviceMemory> BaseUniformBuffersMemory;	// 统一缓存区内存地址
+	/** 默认16字节对齐，满足BC压缩块和缓存拷贝的对齐要求*/
+	static constexpr VkDeviceSize ALIGNMENT = 16;
 
-	std::vector<VkBuffer> ViewUniformBuffers;				// 统一缓存区
-	std::vector<VkDeviceMemory> ViewUniformBuffersMemory;	// 统一缓存区内存地址
+	/** 分配一段空间，剩余的连续空间不够时返回false，解码线程也会直接在环中分配*/
+	bool Allocate(VkDeviceSize inSize, VkDeviceSize inAlignment, uint64_t& outId, VkDeviceSize& outOffset)
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		if (Mapped == nullptr) {
+			return false;
+		}
+		VkDeviceSize offset = (Head + inAlignment - 1) / inAlignment * inAlignment;
+		if (offset + inSize > Size) {
+			// 尾部放不下，跳过尾部从头开始，跳过的空间和这次分配一起释放
+			offset = 0;
+		}
+		VkDeviceSize bytes = (offset >= Head ? offset - Head : Size - Head) + inSize;
+		if (Used + bytes > Size) {
+			return false;
+		}
+		Used += bytes;
+		Head = offset + inSize;
+		outId = NextId++;
+		outOffset = offset;
+		Ranges.push_back({ outId, bytes, false });
+		return true;
+	}
 
-	VkCommandPool CommandPool;								// 指令池
-	VkCommandBuffer CommandBuffer;							// 指令缓存
+	/** GPU使用完成后释放*/
+	void Free(uint64_t inId)
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		for (FRange& range : Ranges) {
+			if (range.Id == inId) {
+				range.bFreed = true;
+				break;
+			}
+		}
+		while (!Ranges.empty() && Ranges.front().bFreed) {
+			Used -= Ranges.front().Bytes;
+			Ranges.pop_front();
+		}
+		if (Ranges.empty()) {
+			Head = 0;
+		}
+	}
 
-	VkSemaphore ImageAvailableSemaphore;					// 图像是否完成的信号
-	VkSemaphore RenderFinishedSemaphore;					// 渲染是否结束的信号
-	VkFence InFlightFence;									// 围栏，下一帧渲染前等待上一帧全部渲染完成
-
-	std::vector<VkCommandBuffer> CommandBuffers;			// 指令缓存
-	std::vector<VkSemaphore> ImageAvailableSemaphores;		// 图像是否完成的信号
-	std::vector<VkSemaphore> RenderFinishedSemaphores;		// 渲染是否结束的信号
-	std::vector<VkFence> InFlightFences;					// 围栏，下一帧渲染前等待上一帧全部渲染完成
-	uint32_t CurrentFrame = 0;								// 当前渲染帧序号
-
-	bool bFramebufferResized = false;
-public:
-	/** 主函数调用接口*/
-	void MainTask()
+	VkDeviceSize GetUsedSize()
 	{
-		InitWindow();		// 使用传统的GLFW，初始化窗口
-		InitVulkan();		// 初始化Vulkan，创建资源
-		MainTick();			// 每帧循环调用，执行渲染指令
-		ClearWindow();		// 渲染窗口关闭时，删除创建的资源
+		std::lock_guard<std::mutex> lock(Mutex);
+		return Used;
 	}
 
-public:
-	/** 初始化GUI渲染窗口*/
-	void InitWindow()
-	{
-		glfwInit();
+private:
+	struct FRange {
+		uint64_t Id;
+		VkDeviceSize Bytes;
+		bool bFreed;
+	};
+	std::mutex Mutex;
+	std::deque<FRange> Ranges;
+	VkDeviceSize Head = 0;
+	VkDeviceSize Used = 0;
+	uint64_t NextId = 1;
+};
 
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE); // 打开窗口的Resize功能
 
-		uint32_t viewportWidth = VIEWPORT_WIDTH;
-		uint32_t viewportHeight = VIEWPORT_HEIGHT;
-		Window = glfwCreateWindow(viewportWidth, viewportHeight, "LearnVulkan-09: Draw with Deferred", nullptr /* glfwGetPrimaryMonitor() 全屏模式*/, nullptr);
-		glfwSetWindowUserPointer(Window, this);
-		glfwSetFramebufferSizeCallback(Window, FramebufferResizeCallback);
-		GLFWimage iconImages[2];
-		iconImages[0].pixels = stbi_load("Resources/Appicons/vulkan_renderer.png", &iconImages[0].width, &iconImages[0].height, 0, STBI_rgb_alpha);
-		iconImages[1].pixels = stbi_load("Resources/Appicons/vulkan_renderer_small.png", &iconImages[1].width, &iconImages[1].height, 0, STBI_rgb_alpha);
-		glfwSetWindowIcon(Window, 2, iconImages);
-		stbi_image_free(iconImages[0].pixels);
-		stbi_image_free(iconImages[1].pixels);
+/** 每帧一个的统一缓存环，持久映射，一帧的统一缓存数据都从这里按顺序切出，通过动态偏移绑定
+ * 这一帧的Fence触发后GPU不再读取，帧开始时整体重置，不需要逐块释放*/
+struct FUniformRing
+{
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	FMemoryAllocation Memory;
+	VkDeviceSize Size = 0;
+	VkDeviceSize Alignment = 256;		// minUniformBufferOffsetAlignment
+	VkDeviceSize Head = 0;
 
-		GlobalInput.ResetToFocus();
-		GlobalInput.ResetAnimation();
-		GlobalConstants.ResetConstants();
+	void Reset()
+	{
+		Head = 0;
+	}
 
-		glfwSetKeyCallback(Window, KeyboardCallback);
-		glfwSetMouseButtonCallback(Window, MouseButtonCallback);
-		glfwSetCursorPosCallback(Window, MousePositionCallback);
-		glfwSetScrollCallback(Window, MouseScrollCallback);
+	/** 写入一段统一缓存数据，返回它的动态偏移*/
+	uint32_t Push(const void* inData, VkDeviceSize inSize)
+	{
+		VkDeviceSize offset = (Head + Alignment - 1) / Alignment * Alignment;
+		if (offset + inSize > Size) {
+			throw std::runtime_error("failed to allocate from uniform ring!");
+		}
+		memcpy(Memory.Mapped + offset, inData, static_cast<size_t>(inSize));
+		Head = offset + inSize;
+		return static_cast<uint32_t>(offset);
 	}
 
-	/** 初始化Vulkan的渲染管线*/
-	void InitVulkan()
+	template<typename T>
+	uint32_t Push(const T& inData)
 	{
-		CreateInstance();			// 连接此程序和Vulkan，一般由显卡驱动实现
-		CreateDebugMessenger();		// 创建调试打印信息
-		CreateWindowsSurface();		// 连接此程序的窗口和Vulkan，渲染Vulkan输出
-		SelectPhysicalDevice();		// 找到此电脑的物理显卡硬件
-		CreateLogicalDevice();		// 创建逻辑硬件，对应物理硬件
-		CreateSwapChain();			// 创建交换链，用于渲染数据和图像显示的中间交换
-		CreateSwapChainImageViews();// 创建图像显示，包含在SwapChain中
-		CreateRenderPass();			// 创建渲染通道
-		CreateFramebuffers();		// 创建帧缓存，包含在SwapChain中
-		CreateCommandPool();		// 创建指令池，存储所有的渲染指令
-		CreateUniformBuffers();		// 创建UnifromBuffer统一缓存区
-		CreateShadowmapPass();		// 创建阴影贴图渲染通道
-		CreateSkydomePass();		// 创建天空球和反射球通道
-		CreateBackgroundPass();		// 创建背景渲染通道
-		CreateBaseScenePass();		// 创建基础物体渲染通道
-		CreateBaseSceneIndirectPass();
-#if ENABLE_DEFEERED_RENDERING
-		CreateBaseSceneDeferredPass();
-#endif
-		CreateCommandBuffer();		// 创建指令缓存，指令发送前变成指令缓存
-		CreateSyncObjects();		// 创建同步围栏，确保下一帧渲染前，上一帧全部渲染完成
+		return Push(&inData, sizeof(T));
 	}
+};
 
-	/** 主循环，执行每帧渲染*/
-	void MainTick()
+
+/** 绑定描述符集合时的动态偏移，按集合中动态统一缓存的绑定顺序排列*/
+struct FDynamicOffsets
+{
+	uint32_t Count = 0;
+	uint32_t Offsets[2] = {};
+};
+
+
+/** 上传使用的一段StagingBuffer，来自环形StagingBuffer，放不下时是临时创建的缓存*/
+struct FStagingBlock {
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	VkDeviceSize Offset = 0;
+	uint8_t* Data = nullptr;
+	uint64_t RingAllocation = 0;				// 环形StagingBuffer中的分配，为0时是临时缓存
+	FMemoryAllocation Memory;					// 临时缓存的内存
+};
+
+
+/** 等待GPU使用完成后释放的StagingBuffer*/
+struct FStagingReleaseList {
+	std::vector<uint64_t> RingAllocations;
+	std::vector<VkBuffer> Buffers;
+	std::vector<FMemoryAllocation> Memorys;
+
+	size_t Num() const { return RingAllocations.size() + Buffers.size(); }
+};
+
+
+/** 全局几何缓存池中的一个大缓存，所有模型的顶点（或者点序）从中按元素子分配，场景绘制时只需要绑定一次
+ * 区间分配见 FGeometryRangeAllocator，放不下时由渲染器扩容并拷贝到新的缓存*/
+struct FGeometryPool : public FGeometryRangeAllocator
+{
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	FMemoryAllocation Memory;
+	VkBufferUsageFlags Usage = 0;
+	uint32_t ElementSize = 0;                       // 一个顶点或者一个点序的字节数
+};
+
+
+/** 解码后的贴图数据，像素直接解码到环形StagingBuffer中，上传时不需要再拷贝，环中放不下时存放在堆内存中*/
+struct FTextureAsset {
+	uint64_t ContentHash = 0;    // 文件内容哈希，用于贴图缓存
+	uint8_t* Pixels = nullptr;   // 贴图已经在缓存中或者已经上传时为空
+	size_t PixelSize = 0;
+	int Width = 0;
+	int Height = 0;
+	int Channels = 0;
+	int MipLevels = 1;
+	ECookedTextureFormat Format = ECookedTextureFormat::RGBA8;
+	std::vector<FCookedTextureMip> Mips; // 烘焙贴图预先计算的Mip，Offset相对于Pixels，为空时运行时生成Mip
+	FStagingRing* StagingRing = nullptr; // 像素所在的环形StagingBuffer
+	uint64_t StagingAllocation = 0;      // 环形StagingBuffer中的分配，为0时像素在HeapPixels中
+	VkDeviceSize StagingOffset = 0;
+	std::vector<uint8_t> HeapPixels;
+
+	FTextureAsset() = default;
+	FTextureAsset(const FTextureAsset&) = delete;
+	FTextureAsset& operator=(const FTextureAsset&) = delete;
+	~FTextureAsset() { ReleasePixels(); }
+
+	/** 为像素分配空间，优先使用环形StagingBuffer*/
+	uint8_t* AllocatePixels(size_t inSize, FStagingRing* inStagingRing)
 	{
-		while (!glfwWindowShouldClose(Window))
-		{
-			glfwPollEvents();
-			UpdateInputs();
-			DrawFrame(); // 绘制一帧
+		ReleasePixels();
+		if (inStagingRing && inStagingRing->Allocate(inSize, FStagingRing::ALIGNMENT, StagingAllocation, StagingOffset)) {
+			StagingRing = inStagingRing;
+			Pixels = inStagingRing->Mapped + StagingOffset;
 		}
-
-		vkDeviceWaitIdle(Device);
+		else {
+			HeapPixels.resize(inSize);
+			Pixels = HeapPixels.data();
+		}
+		PixelSize = inSize;
+		return Pixels;
 	}
 
-	/** 清除Vulkan的渲染管线*/
-	void ClearWindow()
+	/** 上传时取走环形StagingBuffer中的分配，由上传在GPU使用完成后释放*/
+	uint64_t DetachStaging()
 	{
-		CleanupSwapChain(); // 清理FrameBuffer相关的资源
-		DestroyVulkan(); // 删除Vulkan对象
-
-		glfwDestroyWindow(Window);
-		glfwTerminate();
+		uint64_t allocation = StagingAllocation;
+		StagingAllocation = 0;
+		StagingRing = nullptr;
+		ReleasePixels();
+		return allocation;
 	}
 
-	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height) {
-		auto app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
-		app->bFramebufferResized = true;
+	void ReleasePixels()
+	{
+		if (StagingAllocation != 0) {
+			StagingRing->Free(StagingAllocation);
+		}
+		StagingRing = nullptr;
+		StagingAllocation = 0;
+		StagingOffset = 0;
+		std::vector<uint8_t>().swap(HeapPixels);
+		Pixels = nullptr;
+		PixelSize = 0;
 	}
+};
 
-	static void KeyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
-	{
-		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
-		FGlobalInput* input = &app->GlobalInput;
-		FGlobalConstants* constants = &app->GlobalConstants;
 
-		if (action == GLFW_PRESS && key == GLFW_KEY_F)
-		{
-			input->ResetToFocus();
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_G)
-		{
-			input->ResetToTravel();
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_R)
-		{
-			input->ResetAnimation();
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_M)
-		{
-			input->bPlayStageRoll = !input->bPlayStageRoll;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_L)
-		{
-			input->bPlayLightRoll = !input->bPlayLightRoll;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_0)
-		{
-			constants->SpecConstants = 0;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_1)
-		{
-			constants->SpecConstants = 1;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_2)
-		{
-			constants->SpecConstants = 2;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_3)
-		{
-			constants->SpecConstants = 3;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_4)
-		{
-			constants->SpecConstants = 4;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_5)
-		{
-			constants->SpecConstants = 5;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_6)
-		{
-			constants->SpecConstants = 6;
-		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_7)
-		{
-			constants->SpecConstants = 7;
+/** 简单的任务系统，工作线程从队列中取出任务执行，用来并行解码模型和贴图
+ * 线程数为0时，任务直接在提交的线程上执行*/
+class FJobSystem
+{
+public:
+	explicit FJobSystem(uint32_t inThreadCount)
+	{
+		for (uint32_t i = 0; i < inThreadCount; i++) {
+			Workers.emplace_back([this, i]() { WorkerLoop(i); });
 		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_8)
+	}
+
+	FJobSystem(const FJobSystem&) = delete;
+	FJobSystem& operator=(const FJobSystem&) = delete;
+
+	~FJobSystem()
+	{
 		{
-			constants->SpecConstants = 8;
+			std::lock_guard<std::mutex> lock(Mutex);
+			bStopping = true;
 		}
-		if (action == GLFW_PRESS && key == GLFW_KEY_9)
-		{
-			constants->SpecConstants = 9;
+		Condition.notify_all();
+		for (std::thread& worker : Workers) {
+			worker.join();
 		}
 	}
 
-	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+	/** 提交一个任务，返回任务结果的future，任务中抛出的异常会在future.get()时重新抛出*/
+	template <typename F>
+	auto Submit(F&& job) -> std::future<decltype(job())>
 	{
-		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
-		FGlobalInput* input = &app->GlobalInput;
+		using R = decltype(job());
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(job));
+		std::future<R> result = task->get_future();
+		auto timedTask = [this, task]() {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			(*task)();
+			auto endTime = std::chrono::high_resolution_clock::now();
+			BusyMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+			JobCount++;
+		};
 
-		if (action == GLFW_PRESS && button == GLFW_MOUSE_BUTTON_RIGHT)
-		{
-			input->bUpdateCamera = true;
-			input->bFirstInit = true;
-			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+		if (Workers.empty()) {
+			timedTask();
+			return result;
 		}
-		if (action == GLFW_RELEASE && button == GLFW_MOUSE_BUTTON_RIGHT)
 		{
-			input->bUpdateCamera = false;
-			input->bFirstInit = true;
-			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+			std::lock_guard<std::mutex> lock(Mutex);
+			Jobs.push(std::move(timedTask));
 		}
+		Condition.notify_one();
+		return result;
 	}
 
-	static void MousePositionCallback(GLFWwindow* window, double xpos, double ypos)
-	{
-		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
-		FGlobalInput* input = &app->GlobalInput;
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(Workers.size()); }
+	/** 当前线程在这个任务系统中的序号，工作线程为 [0, GetThreadCount())，其它线程（比如直接执行任务的提交线程）为 GetThreadCount()*/
+	uint32_t GetCurrentThreadSlot() const { return CurrentJobSystem == this ? CurrentWorkerIndex : GetThreadCount(); }
+	uint32_t GetJobCount() const { return JobCount; }
+	/** 所有任务执行时间的总和，约等于串行执行需要的时间*/
+	double GetBusyMilliseconds() const { return BusyMicroseconds / 1000.0; }
 
-		if (!input->bUpdateCamera)
+private:
+	void WorkerLoop(uint32_t inWorkerIndex)
+	{
+		CurrentJobSystem = this;
+		CurrentWorkerIndex = inWorkerIndex;
+		while (true)
 		{
-			return;
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				Condition.wait(lock, [this]() { return bStopping || !Jobs.empty(); });
+				if (Jobs.empty()) {
+					return;
+				}
+				job = std::move(Jobs.front());
+				Jobs.pop();
+			}
+			job();
 		}
+	}
 
-		if (input->bFirstInit)
-		{
-			input->LastMouseX = xpos;
-			input->LastMouseY = ypos;
-			input->bFirstInit = false;
-		}
+	std::vector<std::thread> Workers;
+	std::queue<std::function<void()>> Jobs;
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	bool bStopping = false;
+	std::atomic<int64_t> BusyMicroseconds{ 0 };
+	std::atomic<uint32_t> JobCount{ 0 };
 
-		float CameraYaw = input->CameraYaw;
-		float CameraPitch = input->CameraPitch;
+	inline static thread_local const FJobSystem* CurrentJobSystem = nullptr;
+	inline static thread_local uint32_t CurrentWorkerIndex = 0;
+};
 
-		float xoffset = (float)(xpos - input->LastMouseX);
-		float yoffset = (float)(ypos - input->LastMouseY);
-		input->LastMouseX = xpos;
-		input->LastMouseY = ypos;
 
-		float sensitivityX = 1.0;
-		float sensitivityY = 0.5;
-		xoffset *= sensitivityX;
-		yoffset *= sensitivityY;
+const std::vector<const char*> ValidationLayers = { "VK_LAYER_KHRONOS_validation" }; // VK_LAYER_KHRONOS_validation这个是固定的，不能重命名
+const std::vector<const char*> DeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
-		CameraYaw -= xoffset;
-		CameraPitch += yoffset;
-		if (CameraPitch > 89.0)
-			CameraPitch = 89.0;
-		if (CameraPitch < -89.0)
-			CameraPitch = -89.0;
 
-		if (input->bFocusCamera)
-		{
-			glm::vec3 CameraPos = input->CameraPos;
-			float CameraArm = input->CameraArm;
-			CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-			CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-			CameraPos.z = sin(glm::radians(CameraPitch)) * CameraArm;
-			input->CameraPos = CameraPos;
-			input->CameraYaw = CameraYaw;
-			input->CameraPitch = CameraPitch;
-		}
-		else
-		{
-			// @TODO: 鼠标右键控制相机的旋转
-		}
-	}
+#ifdef NDEBUG
+const bool bEnableValidationLayers = false;  // Build Configuration: Release
+#else
+const bool bEnableValidationLayers = true;   // Build Configuration: Debug
+#endif
 
-	static void MouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
-	{
-		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
-		FGlobalInput* input = &app->GlobalInput;
 
-		if (input->bFocusCamera)
-		{
-			glm::vec3 CameraPos = input->CameraPos;
-			glm::vec3 CameraLookat = input->CameraLookat;
-			glm::vec3 lookatToPos = CameraLookat - CameraPos;
-			glm::vec3 Direction = glm::normalize(lookatToPos);
-			float cameraDeltaMove = (float)yoffset * 0.5f;
-			float camerArm = input->CameraArm;
-			camerArm += cameraDeltaMove;
-			camerArm = glm::max(camerArm, 1.0f);
-			CameraPos = CameraLookat - camerArm * Direction;
-			input->CameraPos = CameraPos;
-			input->CameraArm = camerArm;
-		}
+static VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
+	auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+	if (func != nullptr)
+	{
+		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
 	}
-
-	void UpdateInputs()
+	else
 	{
-		float DeltaTime = (float)GlobalInput.DeltaTime;    // Time between current frame and last frame
-		float lastFrame = (float)GlobalInput.CurrentTime;  // Time of last frame
-
-		float CurrentFrame = (float)glfwGetTime();
-		DeltaTime = CurrentFrame - lastFrame;
-
-		bool bFocusCamera = GlobalInput.bFocusCamera;
-		glm::vec3 CameraPos = GlobalInput.CameraPos;
-		glm::vec3 CameraLookat = GlobalInput.CameraLookat;
-		glm::vec3 cameraForward = glm::vec3(-1.0, 0.0, 0.0);
-		glm::vec3 cameraUp = glm::vec3(0.0, 0.0, 1.0);
-		float CameraSpeed = GlobalInput.CameraSpeed;
-		float CameraYaw = GlobalInput.CameraYaw;
-		float CameraPitch = GlobalInput.CameraPitch;
-		glm::vec3 cameraDirection = glm::normalize(CameraLookat - CameraPos);
-		const float cameraDeltaMove = 2.5f * DeltaTime; // adjust accordingly
-
-		if (glfwGetKey(Window, GLFW_KEY_W) == GLFW_PRESS)
-		{
-			if (bFocusCamera)
-			{
-				float CameraArm = GlobalInput.CameraArm;
-				CameraArm -= cameraDeltaMove;
-				CameraArm = glm::max(CameraArm, 1.0f);
-				CameraPos = CameraLookat - CameraArm * cameraDirection;
-				GlobalInput.CameraPos = CameraPos;
-				GlobalInput.CameraArm = CameraArm;
-			}
-			else
-			{
-				GlobalInput.CameraPos += cameraDeltaMove * cameraDirection;
-			}
-			GlobalInput.CameraLookat = bFocusCamera ? CameraLookat : (CameraPos + cameraDirection);
-		}
-		if (glfwGetKey(Window, GLFW_KEY_S) == GLFW_PRESS)
-		{
-			if (bFocusCamera)
-			{
-				float CameraArm = GlobalInput.CameraArm;
-				CameraArm += cameraDeltaMove;
-				CameraArm = glm::max(CameraArm, 1.0f);
-				CameraPos = CameraLookat - CameraArm * cameraDirection;
-				GlobalInput.CameraPos = CameraPos;
-				GlobalInput.CameraArm = CameraArm;
-			}
-			else
-			{
-				GlobalInput.CameraPos -= cameraDeltaMove * cameraDirection;
-			}
-			GlobalInput.CameraLookat = bFocusCamera ? CameraLookat : (CameraPos + cameraDirection);
-		}
-		if (glfwGetKey(Window, GLFW_KEY_A) == GLFW_PRESS)
-		{
-			if (bFocusCamera)
-			{
-				CameraYaw += cameraDeltaMove * 45.0f;
-				float CameraArm = GlobalInput.CameraArm;
-				CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-				CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-				GlobalInput.CameraYaw = CameraYaw;
-			}
-			else
-			{
-				CameraPos -= glm::normalize(glm::cross(cameraForward, cameraUp)) * cameraDeltaMove;
-				CameraLookat = CameraPos + cameraForward;
-			}
-			GlobalInput.CameraPos = CameraPos;
-			GlobalInput.CameraLookat = CameraLookat;
-		}
-		if (glfwGetKey(Window, GLFW_KEY_D) == GLFW_PRESS)
-		{
-			if (bFocusCamera)
-			{
-				CameraYaw -= cameraDeltaMove * 45.0f;
-				float CameraArm = GlobalInput.CameraArm;
-				CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-				CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
-				GlobalInput.CameraYaw = CameraYaw;
-			}
-			else
-			{
-				CameraPos += glm::normalize(glm::cross(cameraForward, cameraUp)) * cameraDeltaMove;
-				CameraLookat = CameraPos + cameraForward;
-			}
-			GlobalInput.CameraPos = CameraPos;
-			GlobalInput.CameraLookat = CameraLookat;
-		}
-		if (glfwGetKey(Window, GLFW_KEY_Q) == GLFW_PRESS)
-		{
-			if (!bFocusCamera)
-			{
-				CameraPos.z -= cameraDeltaMove;
-				CameraLookat = CameraPos + cameraForward;
-				GlobalInput.CameraPos = CameraPos;
-				GlobalInput.CameraLookat = CameraLookat;
-			}
-		}
-		if (glfwGetKey(Window, GLFW_KEY_E) == GLFW_PRESS)
-		{
-			if (!bFocusCamera)
-			{
-				CameraPos.z += cameraDeltaMove;
-				CameraLookat = CameraPos + cameraForward;
-				GlobalInput.CameraPos = CameraPos;
-				GlobalInput.CameraLookat = CameraLookat;
-			}
-		}
-		GlobalInput.CurrentTime = CurrentFrame;
-		GlobalInput.DeltaTime = DeltaTime;
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
 	}
+}
 
-	/** 在创建好一切必要资源后，执行绘制操作*/
-	void DrawFrame()
-	{
-		// 等待上一帧绘制完成
-		vkWaitForFences(Device, 1, &InFlightFences[CurrentFrame], VK_TRUE, UINT64_MAX);
 
-		uint32_t imageIndex;
-		VkResult result = vkAcquireNextImageKHR(Device, SwapChain, UINT64_MAX, ImageAvailableSemaphores[CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+static void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
+{
+	auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+	if (func != nullptr)
+	{
+		func(instance, debugMessenger, pAllocator);
+	}
+}
 
-		// 当窗口过期时（窗口尺寸改变或者窗口最小化后又重新显示），需要重新创建SwapChain并且停止这一帧的绘制
-		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-			RecreateSwapChain();
-			return;
-		}
-		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-			throw std::runtime_error("failed to acquire swap chain image!");
-		}
 
-		// 更新统一缓存区（UBO）
-		UpdateUniformBuffer(CurrentFrame);
-		vkResetFences(Device, 1, &InFlightFences[CurrentFrame]);
+/** 所有的硬件信息*/
+struct FQueueFamilyIndices
+{
+	std::optional<uint32_t> GraphicsFamily;
+	std::optional<uint32_t> PresentFamily;
+	std::optional<uint32_t> TransferFamily;		// 只支持传输的队列族，可选
 
-		// 清除渲染指令缓存
-		vkResetCommandBuffer(CommandBuffers[CurrentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-		// 记录新的所有的渲染指令缓存
-		RecordCommandBuffer(CommandBuffers[CurrentFrame], imageIndex);
+	bool IsComplete()
+	{
+		return GraphicsFamily.has_value() && PresentFamily.has_value();
+	}
+};
 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = { ImageAvailableSemaphores[CurrentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
+/** 设备能力表，选择物理硬件和创建逻辑硬件时查询一次
+ * 渲染路径按它选择实现，每帧录制时只读这里，不再查询物理硬件*/
+struct FDeviceCapabilities
+{
+	bool bMultiDrawIndirect = false;						// 一次 vkCmdDrawIndexedIndirect 可以绘制多条命令
+	bool bDrawIndirectFirstInstance = false;				// indirect draw 的 firstInstance 可以不为0
+	bool bDrawIndirectCount = false;						// VK_KHR_draw_indirect_count 可用，绘制数量可以由GPU写入
+	bool bDescriptorIndexing = false;						// VK_EXT_descriptor_indexing 可用，可以实现 bindless 材质
+	bool bTimestampQueries = false;							// 图形队列支持时间戳查询
+	float TimestampPeriod = 0.0f;							// 时间戳每个刻度的纳秒数
+	bool bTextureCompressionBC = false;						// 支持BC压缩贴图
+	uint32_t CookedTextureFormatSupport = 0;				// 设备支持的烘焙贴图格式，ECookedTextureFormat 的位掩码
+	bool bSamplerAnisotropy = false;						// 支持各向异性过滤，不支持时采样器关闭各向异性
+	float MaxSamplerAnisotropy = 1.0f;
+	VkDeviceSize MinUniformBufferOffsetAlignment = 256;		// 动态偏移的统一缓存区需要按这个对齐
+	VkDeviceSize MinStorageBufferOffsetAlignment = 256;		// 动态偏移的存储缓存需要按这个对齐
+};
 
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &CommandBuffers[CurrentFrame];
 
-		VkSemaphore signalSemaphores[] = { RenderFinishedSemaphores[CurrentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
+/** 支持的硬件细节信息*/
+struct FSwapChainSupportDetails
+{
+	VkSurfaceCapabilitiesKHR Capabilities;
+	std::vector<VkSurfaceFormatKHR> Formats;
+	std::vector<VkPresentModeKHR> PresentModes;
+};
 
-		// 提交渲染指令
-		if (vkQueueSubmit(GraphicsQueue, 1, &submitInfo, InFlightFences[CurrentFrame]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to submit draw command buffer!");
-		}
 
-		VkPresentInfoKHR presentInfo{};
-		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+class FVulkanRendererApp
+{
+	struct FGlobalInput {
+		glm::vec3 CameraPos;
+		glm::vec3 CameraLookat;
+		float CameraSpeed;
+		float CameraFOV;
+		float zNear;
+		float zFar;
 
-		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
+		float CameraArm;
+		float CameraYaw;
+		float CameraPitch;
 
-		VkSwapchainKHR swapChains[] = { SwapChain };
-		presentInfo.swapchainCount = 1;
-		presentInfo.pSwapchains = swapChains;
+		bool bFocusCamera;
+		bool bUpdateCamera;
 
-		presentInfo.pImageIndices = &imageIndex;
+		float CurrentTime;
+		float DeltaTime;
+		bool bFirstInit;
+		double LastMouseX, LastMouseY;
+		bool bPlayStageRoll;
+		float RollStage;
+		bool bPlayLightRoll;
+		float RollLight;
+		bool bSceneMultiDrawIndirect = ENABLE_SCENE_MULTI_DRAW_INDIRECT;	// 场景物体使用 Multi-Draw-Indirect 提交
+		bool bParallelCommandRecording = ENABLE_PARALLEL_COMMAND_RECORDING;	// 各个Pass在录制线程中并行录制
+		bool bCacheCommandBuffers = ENABLE_COMMAND_BUFFER_CACHE;	// 状态没有变化时重复提交缓存的 CommandBuffer
+		bool bDefragmentRequested = false;					// 按 K 键在下一帧开始时整理显存碎片
 
-		vkQueuePresentKHR(PresentQueue, &presentInfo);
+		void ResetToFocus()
+		{
+			CameraPos = glm::vec3(2.0, 2.0, 2.0);
+			CameraLookat = glm::vec3(0.0, 0.0, 0.0);
+			CameraSpeed = 2.5;
+			CameraFOV = 45.0;
+			zNear = 0.1f;
+			zFar = 45.0f;
 
-		CurrentFrame = (CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-	}
+			glm::mat4 transform = glm::lookAt(CameraPos, CameraLookat, glm::vec3(0.0f, 0.0f, 1.0f));
+			glm::quat rotation(transform);
+			glm::vec3 Direction = glm::normalize(CameraLookat - CameraPos);
+			CameraYaw = 30.0; //glm::degrees(glm::atan(Direction.x, Direction.y));
+			CameraPitch = 60.0; //glm::degrees(glm::asin(Direction.z));
+			CameraArm = 10.0;
+			bUpdateCamera = false;
+			bFocusCamera = true;
 
-protected:
-	/** 创建程序和Vulkan之间的连接，涉及程序和显卡驱动之间特殊细节*/
-	void CreateInstance()
-	{
-		if (bEnableValidationLayers && !CheckValidationLayerSupport())
-		{
-			throw std::runtime_error("validation layers requested, but not available!");
+			CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+			CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+			CameraPos.z = sin(glm::radians(CameraPitch)) * CameraArm;
 		}
-
-		VkApplicationInfo appInfo{};
-		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-		appInfo.pApplicationName = "Render the Scene";
-		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.pEngineName = "Vulkan Engine";
-		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
-
-		VkInstanceCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-		createInfo.pApplicationInfo = &appInfo;
-#ifdef __APPLE__
-		createInfo.flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
-#endif
-
-		// 获取需要的glfw拓展名
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
-
-		if (bEnableValidationLayers)
-		{
-			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-		}
-#ifdef __APPLE__
-        // Fix issue on Mac(m2) "vkCreateInstance: Found no drivers!"
-        extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
-        // Issue on Mac(m2), it's not a error, but a warning, ignore it by this time~
-        // vkCreateDevice():  VK_KHR_portability_subset must be enabled because physical device VkPhysicalDevice 0x600003764f40[] supports it. The Vulkan spec states: If the VK_KHR_portability_subset extension is included in pProperties of vkEnumerateDeviceExtensionProperties, ppEnabledExtensionNames must include "VK_KHR_portability_subset"
-        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-#endif
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-		createInfo.ppEnabledExtensionNames = extensions.data();
-
-		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-		if (bEnableValidationLayers)
+		void ResetToTravel()
 		{
-			createInfo.enabledLayerCount = static_cast<uint32_t>(ValidationLayers.size());
-			createInfo.ppEnabledLayerNames = ValidationLayers.data();
+			CameraPos = glm::vec3(2.0, 0.0, 0.0);
+			CameraLookat = glm::vec3(0.0, 0.0, 0.0);
+			CameraSpeed = 2.5;
+			CameraFOV = 45.0;
+			zNear = 0.1f;
+			zFar = 45.0f;
 
-			PopulateDebugMessengerCreateInfo(debugCreateInfo);
-			createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+			CameraArm = (float)(CameraLookat - CameraPos).length();
+			glm::mat4 transform = glm::lookAt(CameraPos, CameraLookat, glm::vec3(0.0f, 0.0f, 1.0f));
+			glm::quat rotation(transform);
+			CameraYaw = -90.0f;;
+			CameraPitch = 0.0;
+			bUpdateCamera = false;
+			bFocusCamera = false;
 		}
-		else
+		void ResetAnimation()
 		{
-			createInfo.enabledLayerCount = 0;
-
-			createInfo.pNext = nullptr;
+			bPlayStageRoll = false;
+			RollStage = 0.0;
+			bPlayLightRoll = false;
+			RollLight = 0.0;
 		}
+	} GlobalInput;
 
-		if (vkCreateInstance(&createInfo, nullptr, &Instance) != VK_SUCCESS)
+	/** 全局常量，所有 Pass 共用的 Push Constants
+	 * 会被录制进缓存的 CommandBuffer，所以不能放每帧变化的值（比如时间），需要时改用统一缓存*/
+	struct FGlobalConstants {
+		float MetallicFactor;
+		float RoughnessFactor;
+		uint32_t SpecConstants;
+		uint32_t SpecConstantsCount;                // 特殊常数，用于优化着色器变体
+		void ResetConstants()
 		{
-			throw std::runtime_error("failed to Create Instance!");
+			MetallicFactor = 0.0f;
+			RoughnessFactor = 1.0;
+			SpecConstants = 0;
+			SpecConstantsCount = 10;
 		}
-	}
+	} GlobalConstants;
 
-	/** 合法性监测层 Validation Layers
-	 *	- 检查参数规范，检测是否使用
-	 *	- 最终对象创建和销毁，找到资源泄漏
-	 *	- 通过追踪线程原始调用，检查线程安全性
-	 *	- 打印输出每次调用
-	 *	- 为优化和重现追踪Vulkan调用
-	*/
-	void CreateDebugMessenger()
-	{
-		if (!bEnableValidationLayers) return;
+	/** 相机和阴影信息，灯光本身在 SceneLights 的存储缓存中*/
+	struct FUniformBufferView {
+		glm::mat4 ShadowmapSpace;
+		glm::mat4 LocalToWorld;
+		glm::vec4 CameraInfo;
+		// LightsCount: [0] for number of DirectionalLights, [1] for number of PointLights, [2] for number of SpotLights, [3] for number of cube map max miplevels.
+		glm::ivec4 LightsCount;
+		glm::float32 zNear;
+		glm::float32 zFar;
+	} View;
 
-		VkDebugUtilsMessengerCreateInfoEXT createInfo;
-		PopulateDebugMessengerCreateInfo(createInfo);
+	FSceneLights SceneLights;								// 场景灯光，在 DrawData 描述符集合的 binding 1 中
+	VkBuffer LightBuffer = VK_NULL_HANDLE;					// 灯光存储缓存，每帧一段，通过动态偏移绑定
+	FMemoryAllocation LightBufferMemory;
+	uint32_t LightCapacity = 0;								// 每帧一段能存放的灯光数量
+	VkDeviceSize LightFrameStride = 0;						// 每帧一段的大小
+	VkBuffer LightDescriptorBuffers[MAX_FRAMES_IN_FLIGHT]{};	// 每帧的 DrawData 描述符集合当前指向的灯光存储缓存
 
-		if (CreateDebugUtilsMessengerEXT(Instance, &createInfo, nullptr, &DebugMessenger) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to set up debug messenger!");
-		}
-	}
+	struct FMesh {
+		uint32_t VertexCount = 0;                            // 顶点数量
+		uint32_t IndexCount = 0;                             // 点序数量，即 LOD0 的点序数量
+		uint32_t LodCount = 1;                               // LOD数量
+		FMeshLod Lods[MAX_MESH_LODS];                        // 每一级LOD在点序缓存中的范围
+		glm::vec3 BoundsMin = glm::vec3(0.0f);               // 包围盒
+		glm::vec3 BoundsMax = glm::vec3(0.0f);
+		EVertexFormat VertexFormat = EVertexFormat::Full;    // 顶点格式，决定使用哪一组渲染管线
+		FMeshConstants Dequantization;                       // 紧凑顶点的反量化参数
+		VkIndexType IndexType = VK_INDEX_TYPE_UINT32;        // 点序类型，顶点不超过65536个时为16位
+		int32_t VertexOffset = 0;                            // 在顶点格式对应的几何缓存池中的起始顶点，绘制时作为 vertexOffset
+		uint32_t FirstIndex = 0;                             // 在点序类型对应的几何缓存池中的起始点序，绘制时加到 firstIndex 上
+		uint32_t PoolIndexCount = 0;                         // 在几何缓存池中占用的点序数量，包括所有LOD
 
-	/** WSI (Window System Integration) 链接Vulkan和Window系统，渲染Vulkan到桌面*/
-	void CreateWindowsSurface()
-	{
-		if (glfwCreateWindowSurface(Instance, Window, nullptr, &Surface) != VK_SUCCESS) {
-			throw std::runtime_error("failed to Create Window Surface!");
-		}
-	}
+		// only init with instanced mesh
+		VkBuffer InstancedBuffer;                            // Instanced buffer
+		FMemoryAllocation InstancedBufferMemory;                // Instanced buffer memory
+	};
 
-	/** 选择支持Vulkan的显卡硬件*/
-	void SelectPhysicalDevice()
-	{
-		uint32_t deviceCount = 0;
-		vkEnumeratePhysicalDevices(Instance, &deviceCount, nullptr);
+	typedef FMesh FInstancedMesh;
 
-		if (deviceCount == 0)
-		{
-			throw std::runtime_error("failed to find GPUs with Vulkan support!");
-		}
+	struct FActor {
+		std::vector<FCluster> Clusters;
+	};
 
-		std::vector<VkPhysicalDevice> devices(deviceCount);
-		vkEnumeratePhysicalDevices(Instance, &deviceCount, devices.data());
+	struct FIndirectMesh : public FMesh
+	{
+		std::vector<FActor> Actors;
+	};
 
-		for (const auto& Device : devices)
-		{
-			if (IsDeviceSuitable(Device))
-			{
-				PhysicalDevice = Device;
-				break;
-			}
-		}
+	struct FIndirectInstancedMesh : public FInstancedMesh
+	{
+		std::vector<FActor> Actors;
+	};
 
-		if (PhysicalDevice == VK_NULL_HANDLE)
-		{
-			throw std::runtime_error("failed to find a suitable GPU!");
-		}
-	}
+	struct FMaterial {
+		std::vector<VkImage> TextureImages;                  // 贴图
+		std::vector<FMemoryAllocation> TextureImageMemorys;     // 贴图内存
+		std::vector<VkImageView> TextureImageViews;          // 贴图视口
+		std::vector<VkSampler> TextureSamplers;              // 贴图采样器
 
-	/** 创建逻辑硬件对接物理硬件，相同物理硬件可以对应多个逻辑硬件*/
-	void CreateLogicalDevice()
-	{
-		FQueueFamilyIndices queue_family_indices = FindQueueFamilies(PhysicalDevice);
+		std::vector<std::string> TextureKeys;                // 贴图缓存的Key，由缓存持有贴图资源
 
-		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { queue_family_indices.GraphicsFamily.value(), queue_family_indices.PresentFamily.value() };
+		VkDescriptorPool DescriptorPool;                     // 描述符池
+		std::vector<VkDescriptorSet> DescriptorSets;         // 描述符集合
+	};
 
-		float queuePriority = 1.0f;
-		for (uint32_t queueFamily : uniqueQueueFamilies)
-		{
-			VkDeviceQueueCreateInfo queueCreateInfo{};
-			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-			queueCreateInfo.queueFamilyIndex = queueFamily;
-			queueCreateInfo.queueCount = 1;
-			queueCreateInfo.pQueuePriorities = &queuePriority;
-			queueCreateInfos.push_back(queueCreateInfo);
-		}
+	/** 贴图缓存中共享的图像资源，引用计数为0时销毁*/
+	struct FTextureCacheEntry {
+		VkImage Image;
+		FMemoryAllocation Memory;
+		VkImageView ImageView;
+		VkSampler Sampler;
+		uint32_t RefCount = 0;
+	};
 
-		VkPhysicalDeviceFeatures deviceFeatures{};
-		deviceFeatures.multiDrawIndirect = VK_TRUE;
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
+	/** 上传批次，一个加载步骤中所有的缓存拷贝、布局转换和Mip生成都录制在同一个CommandBuffer中，只提交一次
+	 * 提交后不等待GPU，Fence触发之后再释放CommandBuffer和StagingBuffer*/
+	struct FUploadBatch {
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		VkFence Fence = VK_NULL_HANDLE;
+		FStagingReleaseList Staging;	// Fence触发之后释放的StagingBuffer
+		uint32_t CommandCount = 0;		// 合并进批次的单次提交数量
+		uint32_t Depth = 0;				// 加载步骤可以嵌套，最外层结束时提交
+	};
 
-		VkDeviceCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	/** 几何缓存池中等待GPU使用完成后释放的区间*/
+	struct FGeometryFree {
+		FGeometryPool* Pool;
+		uint32_t Offset;
+		uint32_t Count;
+	};
 
-		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-		createInfo.pQueueCreateInfos = queueCreateInfos.data();
+	/** 扩容时被替换的缓存，正在渲染的帧可能还在读取，等GPU使用完成后销毁*/
+	struct FBufferFree {
+		VkBuffer Buffer;
+		FMemoryAllocation Memory;
+	};
 
-		createInfo.pEnabledFeatures = &deviceFeatures;
+	/** 录制CommandBuffer时当前绑定的几何缓存，相同时跳过重复绑定*/
+	struct FGeometryBinding {
+		VkBuffer VertexBuffer = VK_NULL_HANDLE;
+		VkBuffer IndexBuffer = VK_NULL_HANDLE;
+		VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+	};
 
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(DeviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = DeviceExtensions.data();
+	/** 场景绘制的渲染状态，状态相同的 indirect draw 可以合并成一次 vkCmdDrawIndexedIndirect*/
+	struct FSceneDrawState {
+		VkPipeline Pipeline = VK_NULL_HANDLE;
+		VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;      // 材质不同时必须拆分
+		VkBuffer VertexBuffer = VK_NULL_HANDLE;
+		VkBuffer IndexBuffer = VK_NULL_HANDLE;
+		VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+		VkBuffer InstanceBuffer = VK_NULL_HANDLE;            // 普通物体为空
+		VkDeviceSize InstanceOffset = 0;
 
-		if (bEnableValidationLayers)
-		{
-			createInfo.enabledLayerCount = static_cast<uint32_t>(ValidationLayers.size());
-			createInfo.ppEnabledLayerNames = ValidationLayers.data();
+		bool operator<(const FSceneDrawState& other) const {
+			return std::tie(Pipeline, DescriptorSet, VertexBuffer, IndexBuffer, IndexType, InstanceBuffer, InstanceOffset)
+				< std::tie(other.Pipeline, other.DescriptorSet, other.VertexBuffer, other.IndexBuffer, other.IndexType, other.InstanceBuffer, other.InstanceOffset);
 		}
-		else
-		{
-			createInfo.enabledLayerCount = 0;
+		bool operator==(const FSceneDrawState& other) const {
+			return !(*this < other) && !(other < *this);
 		}
+	};
 
-		if (vkCreateDevice(PhysicalDevice, &createInfo, nullptr, &Device) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to Create logical Device!");
-		}
+	struct FSceneDraw {
+		FSceneDrawState State;
+		const FMesh* Mesh;                                   // 用来绑定几何缓存池
+		VkDrawIndexedIndirectCommand Command;
+	};
 
-		vkGetDeviceQueue(Device, queue_family_indices.GraphicsFamily.value(), 0, &GraphicsQueue);
-		vkGetDeviceQueue(Device, queue_family_indices.PresentFamily.value(), 0, &PresentQueue);
-	}
+	/** 排序后状态相同的一段连续命令*/
+	struct FSceneDrawRun {
+		FSceneDrawState State;
+		const FMesh* Mesh;
+		uint32_t FirstCommand;
+		uint32_t CommandCount;
+	};
 
-	/** 交换链 Swap Chain
-	 * Vulkan一种基础结构，持有帧缓存FrameBuffer
-	 * SwapChain持有显示到窗口的图像队列
-	 * 通常Vulkan获取图像，渲染到图像上，然后将图像推入SwapChain的图像队列
-	 * SwapChain显示图像，通常和屏幕刷新率保持同步
-	*/
-	void CreateSwapChain()
-	{
-		FSwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(PhysicalDevice);
+	/** 一个Pass中所有普通和 Instanced 物体的 indirect draw，每帧重新收集
+	 * 普通物体的 firstInstance 为 DrawData 序号，Instanced 物体的 firstInstance 为这一帧LOD桶的起始位置*/
+	struct FSceneDrawBatch {
+		VkBuffer Buffer = VK_NULL_HANDLE;                    // 每个同时渲染的帧使用独立的一段，持久映射
+		FMemoryAllocation Memory;
+		uint32_t Capacity = 0;                               // 每一段能放下的命令数量
+		std::vector<FSceneDraw> Draws;
+		std::vector<FSceneDrawRun> Runs;
+	};
 
-		VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.Formats);
-		VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.PresentModes);
-		VkExtent2D extent = ChooseSwapExtent(swapChainSupport.Capabilities);
+	/** 场景提交的录制耗时统计，切换提交方式时重新统计*/
+	struct FSceneDrawStats {
+		double RecordTime = 0.0;                             // 毫秒
+		uint64_t DrawCalls = 0;
+		uint32_t Frames = 0;
+		std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+		uint32_t CachedFrames = 0;                           // 直接提交缓存的 CommandBuffer 的帧数
+		bool bMultiDrawIndirect = false;
+		bool bParallelRecording = false;
+		bool bCacheCommandBuffers = false;
+	};
 
-		uint32_t imageCount = swapChainSupport.Capabilities.minImageCount + 1;
-		if (swapChainSupport.Capabilities.maxImageCount > 0 && imageCount > swapChainSupport.Capabilities.maxImageCount)
+	/** 一个Pass录制场景物体使用的渲染状态*/
+	struct FScenePassState {
+		VkPipelineLayout PipelineLayout;
+		VkPipeline Pipeline;
+		VkPipeline PipelineCompact;
+		VkPipeline PipelineInstanced;
+		VkPipeline PipelineInstancedCompact;
+		VkDescriptorSet SharedDescriptorSet;                 // 不为空时所有物体共用（阴影Pass），否则使用物体的材质描述符集合
+		FDynamicOffsets UniformOffsets;
+		FSceneDrawBatch* DrawBatch;                          // Multi-Draw-Indirect 提交时这个Pass的绘制批次
+
+		VkDescriptorSet GetDescriptorSet(const FMaterial& material, uint32_t frame) const
 		{
-			imageCount = swapChainSupport.Capabilities.maxImageCount;
+			return SharedDescriptorSet != VK_NULL_HANDLE ? SharedDescriptorSet : material.DescriptorSets[frame];
 		}
+	};
 
-		VkSwapchainCreateInfoKHR createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		createInfo.surface = Surface;
+	/** 一个录制线程录制一个 Primary CommandBuffer 时使用的指令池，Secondary CommandBuffer 从这里分配，重新录制时整个指令池一起重置*/
+	struct FRecordContext {
+		VkCommandPool CommandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> CommandBuffers;
+		uint32_t UsedCount = 0;
+	};
 
-		createInfo.minImageCount = imageCount;
-		createInfo.imageFormat = surfaceFormat.format;
-		createInfo.imageColorSpace = surfaceFormat.colorSpace;
-		createInfo.imageExtent = extent;
-		createInfo.imageArrayLayers = 1;
-		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	/** 一个（飞行帧，SwapChain 图像）组合的 Primary CommandBuffer，缓存有效时直接重新提交
+	 * 并行录制的 Secondary CommandBuffer 要和它一起保留，所以每个组合有自己的指令池*/
+	struct FCommandCacheEntry {
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		std::vector<FRecordContext> RecordContexts;          // 每个录制线程（包括主线程）一个，第一次并行录制时创建
+		uint64_t SceneDrawCalls = 0;                         // 录制时统计的场景 DrawCall 数量
+		bool bValid = false;
+	};
 
-		FQueueFamilyIndices queue_family_indices = FindQueueFamilies(PhysicalDevice);
-		uint32_t queueFamilyIndices[] = { queue_family_indices.GraphicsFamily.value(), queue_family_indices.PresentFamily.value() };
+	/** 录制 CommandBuffer 依赖的状态，变化时所有缓存的 CommandBuffer 一起失效
+	 * 统一缓存环每帧按相同的顺序分配，动态偏移不会变化；Push Constants 整块比较，改变任何一个值都会重新录制
+	 * 缓存、描述符集合被重新创建或者更新时直接调用 InvalidateCommandCache*/
+	struct FCommandCacheKey {
+		uint64_t SceneVersion = 0;                           // 场景注册表的版本，加上 LOD 分桶和可见簇数量变化的次数
+		FGlobalConstants Constants{};                        // 录制时的 Push Constants
+		bool bMultiDrawIndirect = false;
 
-		if (queue_family_indices.GraphicsFamily != queue_family_indices.PresentFamily)
-		{
-			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-			createInfo.queueFamilyIndexCount = 2;
-			createInfo.pQueueFamilyIndices = queueFamilyIndices;
-		}
-		else
+		bool operator==(const FCommandCacheKey& rhs) const
 		{
-			createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			return SceneVersion == rhs.SceneVersion && std::memcmp(&Constants, &rhs.Constants, sizeof(FGlobalConstants)) == 0
+				&& bMultiDrawIndirect == rhs.bMultiDrawIndirect;
 		}
+		bool operator!=(const FCommandCacheKey& rhs) const { return !(*this == rhs); }
+	};
 
-		createInfo.preTransform = swapChainSupport.Capabilities.currentTransform;
-		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-		createInfo.presentMode = presentMode;
-		createInfo.clipped = VK_TRUE;
+	/** 一个Pass的录制内容，按顺序执行的录制任务
+	 * 单线程录制时所有任务直接写入 Primary CommandBuffer；并行录制时每个任务写入一个 Secondary CommandBuffer
+	 * Secondary CommandBuffer 不继承动态状态和绑定，每个任务开始前都要调用 SetDynamicState*/
+	struct FPassRecording {
+		VkRenderPass RenderPass = VK_NULL_HANDLE;
+		VkFramebuffer Framebuffer = VK_NULL_HANDLE;
+		std::function<void(VkCommandBuffer)> SetDynamicState;
+		std::vector<std::function<void(VkCommandBuffer, FGeometryBinding&)>> Tasks;
+		std::vector<std::future<VkCommandBuffer>> Results;   // 并行录制时每个任务录制的 Secondary CommandBuffer
+	};
 
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
-
-		if (vkCreateSwapchainKHR(Device, &createInfo, nullptr, &SwapChain) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to Create swap chain!");
-		}
-
-		vkGetSwapchainImagesKHR(Device, SwapChain, &imageCount, nullptr);
-		SwapChainImages.resize(imageCount);
-		vkGetSwapchainImagesKHR(Device, SwapChain, &imageCount, SwapChainImages.data());
-
-		SwapChainImageFormat = surfaceFormat.format;
-		SwapChainExtent = extent;
-	}
+	/** 一次流式上传，拷贝在传输队列上执行并释放资源的所有权，完成后在图形队列上获取所有权（以及生成Mip）
+	 * 没有独立的传输队列族时，所有命令都录制在同一个图形队列的CommandBuffer中*/
+	struct FStreamingUpload {
+		VkCommandBuffer TransferCommandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer GraphicsCommandBuffer = VK_NULL_HANDLE;
+		VkFence Fence = VK_NULL_HANDLE;
+		FStagingReleaseList Staging;						// 传输完成之后释放的StagingBuffer
+		std::function<void()> OnComplete;					// 资源可以在图形队列上使用之后调用
+		bool bGraphicsSubmitted = false;
+		bool bRecording = false;
+	};
 
-	/** 重新创建SwapChain*/
-	void RecreateSwapChain()
+	struct FRenderBase
 	{
-		// 当窗口长宽都是零时，说明窗口被最小化了，这时需要等待
-		int Width = 0, Height = 0;
-		glfwGetFramebufferSize(Window, &Width, &Height);
-		while (Width == 0 || Height == 0) {
-			glfwGetFramebufferSize(Window, &Width, &Height);
-			glfwWaitEvents();
-		}
+		FMaterial MateData;
+		uint32_t DrawDataIndex = 0;                          // 在 DrawData 存储缓存中的序号，普通物体作为 firstInstance 传给顶点着色器
+	};
 
-		vkDeviceWaitIdle(Device);
+	/** 异步加载中的RenderObject资源，模型和贴图在工作线程中解码，Vulkan上传在主线程中完成*/
+	/** 解码完成的模型：映射的烘焙文件，选择紧凑顶点格式时还包含在工作线程中量化好的顶点*/
+	struct FMeshAsset
+	{
+		FMappedFile CookedFile;
+		EVertexFormat VertexFormat = EVertexFormat::Full;
+		std::vector<FCompactVertex> CompactVertices;
+		FMeshConstants Dequantization;
+	};
 
-		CleanupSwapChain();
+	struct FRenderObjectAssets
+	{
+		std::future<std::shared_ptr<FMeshAsset>> Mesh;
+		std::vector<std::string> TextureFiles;
+		std::vector<std::shared_future<std::shared_ptr<FTextureAsset>>> Textures;
+	};
 
-		CreateSwapChain();
-		CreateSwapChainImageViews();
-		CreateFramebuffers();
-#if ENABLE_DEFEERED_RENDERING
-		CreateBaseSceneDeferredPass();
-#endif
-	}
+	/** 构建 RenderObject 需要的 Vulkan 资源*/
+	struct FRenderObject : public FRenderBase
+	{
+		FMesh MeshData;
+	};
 
-	/** 清理旧的SwapChain*/
-	void CleanupSwapChain() {
-		vkDestroyImageView(Device, DepthImageView, nullptr);
-		vkDestroyImage(Device, DepthImage, nullptr);
-		vkFreeMemory(Device, DepthImageMemory, nullptr);
+	struct FRenderInstancedObject : public FRenderBase
+	{
+		FInstancedMesh MeshData;
+		uint32_t InstanceCount;
+		std::vector<FInstanceData> Instances;                // 开启LOD时保存所有Instance，每帧按LOD分桶写入 InstancedBuffer
+		std::vector<uint8_t> InstanceLods;                   // 每个Instance这一帧选择的LOD
+		uint32_t LodFirstInstance[MAX_MESH_LODS] = {};       // 这一帧每个LOD的Instance在 InstancedBuffer 中的范围
+		uint32_t LodInstanceCount[MAX_MESH_LODS] = {};
+		VkDeviceSize InstanceBufferOffset = 0;               // 这一帧的Instance数据在 InstancedBuffer 中的偏移
+	};
 
-		for (auto framebuffer : SwapChainFramebuffers) {
-			vkDestroyFramebuffer(Device, framebuffer, nullptr);
-		}
+	struct FRenderIndirectObjectBase : public FRenderBase
+	{
+		VkBuffer IndirectCommandsBuffer;							// 包含 the indirect drawing commands
+		FMemoryAllocation IndirectCommandsBufferMemory;
+		std::vector<VkDrawIndexedIndirectCommand> IndirectCommands; // 存储 indirect draw commands，包含 index offsets 和 Instance count per object
+	};
 
-		for (auto imageView : SwapChainImageViews) {
-			vkDestroyImageView(Device, imageView, nullptr);
-		}
+	struct FRenderIndirectObject : public FRenderIndirectObjectBase
+	{
+		FIndirectMesh MeshData;
+		VkBuffer VisibleCommandsBuffer;                      // 每帧剔除后可见簇的 indirect draw commands，持久映射
+		FMemoryAllocation VisibleCommandsBufferMemory;
+		uint32_t VisibleCommandCount = 0;                    // 这一帧可见簇的数量
+		VkDeviceSize VisibleCommandsOffset = 0;              // 这一帧的命令在 VisibleCommandsBuffer 中的偏移
+	};
 
-		vkDestroySwapchainKHR(Device, SwapChain, nullptr);
-	}
+	struct FRenderIndirectInstancedObject : public FRenderIndirectObjectBase
+	{
+		FIndirectInstancedMesh MeshData;
+		uint32_t InstanceCount;
+	};
 
-	/** 图像视图 Image View
-	 * 将视图显示为图像
-	 * ImageView定义了SwapChain里定义的图像是什么样的
-	 * 比如，带深度信息的RGB图像
-	*/
-	void CreateSwapChainImageViews()
+	/** 一个Pass中同一种物体的紧凑成员数组，SoA：模型、材质和 DrawData 序号分开存放，录制时只读需要的那几项
+	 * 指针指向注册表的槽位，槽位不会移动，物体移除之前一直有效*/
+	template<typename T>
+	struct TScenePassList
 	{
-		SwapChainImageViews.resize(SwapChainImages.size());
+		std::vector<T*> Objects;
+		std::vector<const decltype(T::MeshData)*> Meshes;
+		std::vector<const FMaterial*> Materials;
+		std::vector<uint32_t> DrawDataIndices;
+		std::vector<uint32_t> Slots;                         // 成员所在的槽位
 
-		for (size_t i = 0; i < SwapChainImages.size(); i++)
+		size_t Num() const
 		{
-			CreateImageView(SwapChainImageViews[i], SwapChainImages[i], SwapChainImageFormat);
+			return Objects.size();
 		}
-	}
+	};
 
-	/** 渲染层 RenderPass
-	 * 创建渲染管线之前，需要先创建渲染层，告诉Vulkan渲染时使用的帧缓存FrameBuffer
-	 * 我们需要指定渲染中使用的颜色缓存和深度缓存的数量，以及采样信息
-	*/
-	void CreateRenderPass()
+	/** 同一种场景物体的注册表，物体注册一次，按 PassFlags 加入对应Pass的成员数组
+	 * 物体存放在 std::deque 中，增加物体不会移动已有的物体；移除后槽位放入空闲列表，下次注册时复用
+	 * 增加、移除物体和修改 PassFlags 都只改动变化的那几个Pass成员，不需要每帧重建*/
+	template<typename T>
+	struct TSceneObjectPool
 	{
-		VkAttachmentDescription ColorAttachment{};
-		ColorAttachment.format = SwapChainImageFormat;
-		ColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		ColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		ColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		ColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		ColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		ColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentDescription DepthAttachment{};
-		DepthAttachment.format = FindDepthFormat();
-		DepthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-#if !ENABLE_DEFEERED_RENDERING
-		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-#else
-		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-#endif
-		DepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		DepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-#if !ENABLE_DEFEERED_RENDERING
-		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-#else
-		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-#endif
-		DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference ColorAttachmentRef{};
-		ColorAttachmentRef.attachment = 0;
-		ColorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		std::deque<T> Objects;
+		std::vector<uint32_t> Generations;
+		std::vector<uint32_t> PassFlags;
+		std::vector<uint8_t> Alive;
+		std::vector<std::array<uint32_t, SCENE_PASS_COUNT>> PassPositions;	// 在每个Pass成员数组中的位置
+		std::vector<uint32_t> FreeSlots;
+		TScenePassList<T> Passes[SCENE_PASS_COUNT];
+		uint64_t Version = 0;                                // Pass成员变化的次数
+
+		const TScenePassList<T>& GetPass(EScenePass inPass) const
+		{
+			return Passes[static_cast<size_t>(inPass)];
+		}
 
-		VkAttachmentReference DepthAttachmentRef{};
-		DepthAttachmentRef.attachment = 1;
-		DepthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		bool IsValid(FSceneHandle inHandle) const
+		{
+			return inHandle.Slot < Objects.size() && Alive[inHandle.Slot] && Generations[inHandle.Slot] == inHandle.Generation;
+		}
 
-		// 渲染子通道 SubPass
-		// SubPass是RenderPass的下属任务，和RenderPass共享Framebuffer等渲染资源
-		// 某些渲染操作，比如后处理的Blooming，当前渲染需要依赖上一个渲染结果，但是渲染资源不变，这是SubPass可以优化性能
-		VkSubpassDescription subpass{};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &ColorAttachmentRef;
-		subpass.pDepthStencilAttachment = &DepthAttachmentRef;
+		T* Get(FSceneHandle inHandle)
+		{
+			return IsValid(inHandle) ? &Objects[inHandle.Slot] : nullptr;
+		}
 
-		// 这里将渲染三角形的操作，简化成一个SubPass提交
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		/** 注册物体，物体的 MeshData、MateData 和 DrawDataIndex 在注册之后不能再修改*/
+		FSceneHandle Add(T&& inObject, uint32_t inPassFlags)
+		{
+			uint32_t slot;
+			if (!FreeSlots.empty()) {
+				slot = FreeSlots.back();
+				FreeSlots.pop_back();
+				Objects[slot] = std::move(inObject);
+			}
+			else {
+				slot = static_cast<uint32_t>(Objects.size());
+				Objects.push_back(std::move(inObject));
+				Generations.push_back(0);
+				PassFlags.push_back(0);
+				Alive.push_back(0);
+				PassPositions.emplace_back();
+			}
+			Alive[slot] = 1;
+			PassFlags[slot] = 0;
+			PassPositions[slot].fill(UINT32_MAX);
+			SetSlotPassFlags(slot, inPassFlags);
+			return { slot, Generations[slot] };
+		}
 
-		std::array<VkAttachmentDescription, 2> attachments = { ColorAttachment, DepthAttachment };
-		VkRenderPassCreateInfo renderPassCI{};
-		renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
-		renderPassCI.pAttachments = attachments.data();
-		renderPassCI.subpassCount = 1;
-		renderPassCI.pSubpasses = &subpass;
-		renderPassCI.dependencyCount = 1;
-		renderPassCI.pDependencies = &dependency;
-		if (vkCreateRenderPass(Device, &renderPassCI, nullptr, &MainRenderPass) != VK_SUCCESS) {
-			throw std::runtime_error("failed to Create render pass!");
+		/** 修改物体参与的Pass*/
+		void SetPassFlags(FSceneHandle inHandle, uint32_t inPassFlags)
+		{
+			if (IsValid(inHandle)) {
+				SetSlotPassFlags(inHandle.Slot, inPassFlags);
+			}
 		}
-	}
 
-	/** 创建指令池，管理所有的指令，比如DrawCall或者内存交换等*/
-	void CreateCommandPool()
-	{
-		FQueueFamilyIndices queueFamilyIndices = FindQueueFamilies(PhysicalDevice);
+		/** 移除物体，物体交给调用者，等GPU使用完成之后再释放它的资源*/
+		bool Remove(FSceneHandle inHandle, T& outObject)
+		{
+			if (!IsValid(inHandle)) {
+				return false;
+			}
+			SetSlotPassFlags(inHandle.Slot, 0);
+			outObject = std::move(Objects[inHandle.Slot]);
+			Objects[inHandle.Slot] = T{};
+			Alive[inHandle.Slot] = 0;
+			Generations[inHandle.Slot]++;
+			FreeSlots.push_back(inHandle.Slot);
+			return true;
+		}
+
+		/** 遍历所有注册的物体*/
+		template<typename F>
+		void ForEach(F&& inFunction)
+		{
+			for (size_t slot = 0; slot < Objects.size(); slot++) {
+				if (Alive[slot]) {
+					inFunction(Objects[slot]);
+				}
+			}
+		}
 
-		VkCommandPoolCreateInfo poolCI{};
-		poolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		poolCI.queueFamilyIndex = queueFamilyIndices.GraphicsFamily.value();
+	private:
+		void SetSlotPassFlags(uint32_t inSlot, uint32_t inPassFlags)
+		{
+			if (inPassFlags != PassFlags[inSlot]) {
+				Version++;
+			}
+			for (uint32_t pass = 0; pass < SCENE_PASS_COUNT; pass++) {
+				bool bWasMember = (PassFlags[inSlot] & (1u << pass)) != 0;
+				bool bIsMember = (inPassFlags & (1u << pass)) != 0;
+				if (bIsMember && !bWasMember) {
+					AddToPass(pass, inSlot);
+				}
+				else if (!bIsMember && bWasMember) {
+					RemoveFromPass(pass, inSlot);
+				}
+			}
+			PassFlags[inSlot] = inPassFlags;
+		}
 
-		if (vkCreateCommandPool(Device, &poolCI, nullptr, &CommandPool) != VK_SUCCESS)
+		void AddToPass(uint32_t inPass, uint32_t inSlot)
 		{
-			throw std::runtime_error("failed to Create command pool!");
+			TScenePassList<T>& list = Passes[inPass];
+			T& object = Objects[inSlot];
+			PassPositions[inSlot][inPass] = static_cast<uint32_t>(list.Num());
+			list.Objects.push_back(&object);
+			list.Meshes.push_back(&object.MeshData);
+			list.Materials.push_back(&object.MateData);
+			list.DrawDataIndices.push_back(object.DrawDataIndex);
+			list.Slots.push_back(inSlot);
+		}
+
+		/** 和末尾的成员交换后删除，其它成员的位置不变*/
+		void RemoveFromPass(uint32_t inPass, uint32_t inSlot)
+		{
+			TScenePassList<T>& list = Passes[inPass];
+			uint32_t position = PassPositions[inSlot][inPass];
+			uint32_t last = static_cast<uint32_t>(list.Num() - 1);
+			if (position != last) {
+				list.Objects[position] = list.Objects[last];
+				list.Meshes[position] = list.Meshes[last];
+				list.Materials[position] = list.Materials[last];
+				list.DrawDataIndices[position] = list.DrawDataIndices[last];
+				list.Slots[position] = list.Slots[last];
+				PassPositions[list.Slots[position]][inPass] = position;
+			}
+			list.Objects.pop_back();
+			list.Meshes.pop_back();
+			list.Materials.pop_back();
+			list.DrawDataIndices.pop_back();
+			list.Slots.pop_back();
+			PassPositions[inSlot][inPass] = UINT32_MAX;
 		}
-	}
+	};
 
-	/** 创建帧缓存，即每帧图像对应的渲染数据*/
-	void CreateFramebuffers()
+	/** 场景注册表，每种物体一个对象池，所有Pass都从这里取得要绘制的物体*/
+	struct FSceneRegistry
 	{
-		// 创建深度纹理资源
-		VkFormat depthFormat = FindDepthFormat();
-		CreateImage(DepthImage, DepthImageMemory, SwapChainExtent.width, SwapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(DepthImageView, DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-
-		SwapChainFramebuffers.resize(SwapChainImageViews.size());
+		TSceneObjectPool<FRenderObject> Objects;
+		TSceneObjectPool<FRenderInstancedObject> InstancedObjects;
+		TSceneObjectPool<FRenderIndirectObject> IndirectObjects;
+		TSceneObjectPool<FRenderIndirectInstancedObject> IndirectInstancedObjects;
 
-		for (size_t i = 0; i < SwapChainImageViews.size(); i++) 
+		template<typename T>
+		TSceneObjectPool<T>& GetPool()
 		{
-			std::array<VkImageView, 2> attachments = 
-			{
-				SwapChainImageViews[i],
-				DepthImageView
-			};
-			VkFramebufferCreateInfo frameBufferCI{};
-			frameBufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			frameBufferCI.renderPass = MainRenderPass;
-			frameBufferCI.attachmentCount = static_cast<uint32_t>(attachments.size());
-			frameBufferCI.pAttachments = attachments.data();
-			frameBufferCI.width = SwapChainExtent.width;
-			frameBufferCI.height = SwapChainExtent.height;
-			frameBufferCI.layers = 1;
-
-			if (vkCreateFramebuffer(Device, &frameBufferCI, nullptr, &SwapChainFramebuffers[i]) != VK_SUCCESS)
-			{
-				throw std::runtime_error("failed to Create framebuffer!");
+			if constexpr (std::is_same<T, FRenderObject>::value) {
+				return Objects;
+			}
+			else if constexpr (std::is_same<T, FRenderInstancedObject>::value) {
+				return InstancedObjects;
+			}
+			else if constexpr (std::is_same<T, FRenderIndirectObject>::value) {
+				return IndirectObjects;
+			}
+			else {
+				static_assert(std::is_same<T, FRenderIndirectInstancedObject>::value, "unknown scene object type");
+				return IndirectInstancedObjects;
 			}
 		}
-	}
-
 
-	/**
-	 * 创建阴影贴图资源 Shadow map
-	*/
-	void CreateShadowmapPass()
-	{
-		ShadowmapPass.Width = SHADOWMAP_DIM;
-		ShadowmapPass.Height = SHADOWMAP_DIM;
-		ShadowmapPass.Format = FindDepthFormat();
-		CreateImage(
-			ShadowmapPass.Image,
-			ShadowmapPass.Memory,
-			ShadowmapPass.Width, ShadowmapPass.Height, ShadowmapPass.Format,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(ShadowmapPass.ImageView, ShadowmapPass.Image, ShadowmapPass.Format, VK_IMAGE_ASPECT_DEPTH_BIT);
-		CreateSampler(ShadowmapPass.Sampler,
-			VK_FILTER_LINEAR,
-			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-			VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE); // @TODO: 是否应该将 sample filter 改成 VK_FILTER_NEAREST
-
-		//////////////////////////////////////////////////////////
-		// 创建 UniformBuffers 和 UniformBuffersMemory
-		VkDeviceSize bufferSize = sizeof(FUniformBufferBase);
-		ShadowmapPass.UniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-		ShadowmapPass.UniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			CreateBuffer(bufferSize,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				ShadowmapPass.UniformBuffers[i],
-				ShadowmapPass.UniformBuffersMemory[i]);
+		/** 任何一个Pass的成员变化时增加*/
+		uint64_t GetVersion() const
+		{
+			return Objects.Version + InstancedObjects.Version + IndirectObjects.Version + IndirectInstancedObjects.Version;
 		}
+	} SceneRegistry;
 
-		//////////////////////////////////////////////////////////
-		// 创建 DescriptorSetLayout
-		VkDescriptorSetLayoutBinding uboLayoutBinding{};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	/** 延迟管线 GBuffer*/
+	struct FGeometryBuffer {
+		// Depth Stencil RGBAFloat
+		VkFormat DepthStencilFormat;
+		VkImage DepthStencilImage;
+		FMemoryAllocation DepthStencilMemory;
+		VkImageView DepthStencilImageView;
+		VkSampler DepthStencilSampler;
+		// SceneColorDeferred RGBAHalf
+		VkFormat SceneColorFormat;
+		VkImage SceneColorImage;
+		FMemoryAllocation SceneColorMemory;
+		VkImageView SceneColorImageView;
+		VkSampler SceneColorSampler;
+		// Normal+CastShadow R10G10B10A2
+		VkFormat GBufferAFormat;
+		VkImage GBufferAImage;
+		FMemoryAllocation GBufferAMemory;
+		VkImageView GBufferAImageView;
+		VkSampler GBufferASampler;
+		// M+S+R+(ShadingModelID+SelectiveOutputMask) RGBA8888
+		VkFormat GBufferBFormat;
+		VkImage GBufferBImage;
+		FMemoryAllocation GBufferBMemory;
+		VkImageView GBufferBImageView;
+		VkSampler GBufferBSampler;
+		// BaseColor+AO
+		VkFormat GBufferCFormat;
+		VkImage GBufferCImage;
+		FMemoryAllocation GBufferCMemory;
+		VkImageView GBufferCImageView;
+		VkSampler GBufferCSampler;
+		// Position+ID
+		VkFormat GBufferDFormat;
+		VkImage GBufferDImage;
+		FMemoryAllocation GBufferDMemory;
+		VkImageView GBufferDImageView;
+		VkSampler GBufferDSampler;
+		// MotionVector+Velocity(Currently not implemented)
+		//VkImage GBufferVelocityImage;
+		//VkDeviceMemory GBufferVelocityMemory;
+		//VkImageView GBufferVelocityImageView;
+		
+		VkSampler Sampler;
+	} GBuffer;
+
+	/** 构建 ShadowmapPass 需要的 Vulkan 资源*/
+	struct FShadowmapPass {
+		float zNear, zFar;
+		int32_t Width, Height;
+		VkFormat Format;
+		VkFramebuffer FrameBuffer;
+		VkRenderPass RenderPass;
+		VkImage Image;
+		FMemoryAllocation Memory;
+		VkImageView ImageView;
+		VkSampler Sampler;
+		VkDescriptorSetLayout DescriptorSetLayout;
+		VkDescriptorPool DescriptorPool;
+		std::vector<VkDescriptorSet> DescriptorSets;
+		VkPipelineLayout PipelineLayout;
+		VkPipeline Pipeline;
+		VkPipeline PipelineInstanced;
+		VkPipeline PipelineCompact;
+		VkPipeline PipelineInstancedCompact;
+		FSceneDrawBatch DrawBatch;
+	} ShadowmapPass;
+
+	/** 构建 BackgroundPass 需要的 Vulkan 资源*/
+	struct FBackgroundPass {
+		VkImage Image;
+		FMemoryAllocation Memory;
+		VkImageView ImageView;
+		VkSampler Sampler;
+		VkRenderPass RenderPass;
+		VkDescriptorSetLayout DescriptorSetLayout;
+		VkDescriptorPool DescriptorPool;
+		std::vector<VkDescriptorSet> DescriptorSets;
+		VkPipelineLayout PipelineLayout;
+		std::vector<VkPipeline> Pipelines;
+	} BackgroundPass;
+
+
+	/** 构建 SkydomePass 需要的 Vulkan 资源*/
+	struct FSkydomePass {
+		FMesh SkydomeMesh;
+		VkImage Image;
+		FMemoryAllocation Memory;
+		VkImageView ImageView;
+		VkSampler Sampler;
+		VkRenderPass RenderPass;
+		VkDescriptorSetLayout DescriptorSetLayout;
+		VkDescriptorPool DescriptorPool;
+		std::vector<VkDescriptorSet> DescriptorSets;
+		VkPipelineLayout PipelineLayout;
+		std::vector<VkPipeline> Pipelines;
+	} SkydomePass;
+
+	/** 构建 BaseScenePass 需要的 Vulkan 资源*/
+	struct FBaseScenePass {
+		VkDescriptorSetLayout DescriptorSetLayout;					// 描述符集合布局
+		VkPipelineLayout PipelineLayout;							// 渲染管线布局
+		std::vector<VkPipeline> Pipelines;							// 渲染管线
+		std::vector<VkPipeline> PipelinesInstanced;					// 渲染管线
+		std::vector<VkPipeline> PipelinesCompact;					// 紧凑顶点格式的渲染管线
+		std::vector<VkPipeline> PipelinesInstancedCompact;			// 紧凑顶点格式的渲染管线
+		FSceneDrawBatch DrawBatch;									// Multi-Draw-Indirect 提交
+	} BaseScenePass;
+
+	struct FBaseSceneIndirectPass {
+		VkDescriptorSetLayout DescriptorSetLayout;									// 描述符集合布局
+		VkPipelineLayout PipelineLayout;											// 渲染管线布局
+		std::vector<VkPipeline> Pipelines;											// 渲染管线
+		std::vector<VkPipeline> PipelinesInstanced;									// 渲染管线
+	} BaseSceneIndirectPass;
+
+	struct FBaseSceneDeferredRenderingPass {
+		VkDescriptorSetLayout SceneDescriptorSetLayout;				// 描述符集合布局
+		VkPipelineLayout ScenePipelineLayout;						// 渲染管线布局
+		std::vector<VkPipeline> ScenePipelines;						// 渲染管线
+		std::vector<VkPipeline> ScenePipelinesInstanced;			// 渲染管线
+		std::vector<VkPipeline> ScenePipelinesCompact;				// 紧凑顶点格式的渲染管线
+		std::vector<VkPipeline> ScenePipelinesInstancedCompact;		// 紧凑顶点格式的渲染管线
+		FSceneDrawBatch SceneDrawBatch;								// Multi-Draw-Indirect 提交
+		VkFramebuffer SceneFrameBuffer;
+		VkRenderPass SceneRenderPass;
+		VkDescriptorSetLayout LightingDescriptorSetLayout;
+		VkDescriptorPool LightingDescriptorPool;
+		std::vector<VkDescriptorSet> LightingDescriptorSets;
+		VkPipelineLayout LightingPipelineLayout;
+		std::vector<VkPipeline> LightingPipelines;
+	} BaseSceneDeferredPass;
+
+	GLFWwindow* Window;										// Window 渲染桌面
+
+	VkInstance Instance;									// 链接程序的Vulkan实例
+	VkDebugUtilsMessengerEXT DebugMessenger;
+	VkSurfaceKHR Surface;									// 链接桌面和Vulkan的实例
+
+	VkPhysicalDevice PhysicalDevice = VK_NULL_HANDLE;		// 物理显卡硬件
+	VkDevice Device;										// 逻辑硬件，对接物理硬件
+	FDeviceMemoryAllocator MemoryAllocator;					// 显存子分配器，所有Buffer和Image的内存都从这里分配
+
+	VkQueue GraphicsQueue;									// 显卡的队列
+	VkQueue PresentQueue;									// 显示器的队列
+	VkQueue TransferQueue;									// 流式上传的传输队列，没有独立的传输队列族时等于GraphicsQueue
+	uint32_t GraphicsQueueFamily = 0;						// 图形队列族
+	uint32_t TransferQueueFamily = 0;						// 传输队列族
+	bool bDedicatedTransferQueue = false;					// 是否有独立的传输队列族
+
+	VkSwapchainKHR SwapChain;								// 缓存渲染图像队列，同步到显示器
+	std::vector<VkImage> SwapChainImages;					// 渲染图像队列
+	VkFormat SwapChainImageFormat;							// 渲染图像格式
+	VkExtent2D SwapChainExtent;								// 渲染图像范围
+	std::vector<VkImageView> SwapChainImageViews;			// 渲染图像队列对应的视图队列
+	std::vector<VkFramebuffer> SwapChainFramebuffers;		// 渲染图像队列对应的帧缓存队列
+
+	VkRenderPass MainRenderPass;							// 渲染层，保存Framebuffer和采样信息
+
+	VkImage DepthImage;										// 深度纹理资源
+	FMemoryAllocation DepthImageMemory;						// 深度纹理内存
+	VkImageView DepthImageView;								// 深度纹理图像视口
+
+	uint32_t CubemapMaxMips;								// 环境反射纹理最大Mips数
+	VkImage CubemapImage;									// 环境反射纹理资源
+	FMemoryAllocation CubemapImageMemory;						// 环境反射纹理内存
+	VkImageView CubemapImageView;							// 环境反射纹理图像视口
+	VkSampler CubemapSampler;								// 环境反射纹理采样器
+
+	std::vector<FUniformRing> UniformRings;					// 每帧一个的统一缓存环
+
+	/** 一帧的统一缓存在环中的动态偏移，UpdateUniformBuffer 写入，录制指令时使用*/
+	struct FFrameUniforms {
+		FDynamicOffsets Scene;		// 场景集合：binding 0 为 Base，binding 1 为 View
+		FDynamicOffsets Shadow;		// 阴影集合：binding 0 为阴影相机
+		FDynamicOffsets Lighting;	// 延迟光照集合：binding 0 为 View
+	};
+	std::vector<FFrameUniforms> FrameUniforms;
+
+	FDeviceCapabilities DeviceCaps;							// 设备能力表，启动时查询一次
+	std::unordered_map<std::string, FTextureCacheEntry> TextureCache;	// 贴图缓存，Key为 路径+内容哈希+sRGB
+	std::mutex TextureCacheMutex;											// 加载线程会查询贴图缓存
+	std::unordered_map<std::string, std::shared_future<std::shared_ptr<FTextureAsset>>> PendingTextureDecodes; // 正在解码的贴图，避免重复解码
+
+	VkCommandPool CommandPool;								// 指令池
+	VkCommandBuffer CommandBuffer;							// 指令缓存
+
+	FUploadBatch UploadBatch;								// 正在录制的上传批次
+	std::vector<FUploadBatch> PendingUploadBatches;			// 已经提交，等待Fence释放资源的上传批次
+	uint32_t UploadSubmitsSaved = 0;						// 上传批次合并掉的提交次数
+
+	VkCommandPool TransferCommandPool = VK_NULL_HANDLE;	// 传输队列族的指令池
+	FStagingRing StagingRing;								// 持久映射的环形StagingBuffer
+	FStreamingUpload StreamingUpload;						// 正在录制的流式上传
+	std::vector<FStreamingUpload> PendingStreamingUploads;	// 已经提交的流式上传，按提交顺序完成
+	std::vector<std::function<bool()>> StreamingTasks;		// 等待解码完成的流式加载任务，返回true表示已经提交上传
+
+	FGeometryPool VertexPools[2];							// 几何缓存池中的顶点缓存，按 EVertexFormat 区分
+	FGeometryPool IndexPools[2];							// 几何缓存池中的点序缓存，16位和32位点序
+	std::vector<FGeometryFree> PendingGeometryFrees[MAX_FRAMES_IN_FLIGHT];	// 这一帧的Fence触发之后才能重新使用的区间
+	std::vector<FBufferFree> PendingBufferFrees[MAX_FRAMES_IN_FLIGHT];		// 这一帧的Fence触发之后才能销毁的缓存
+
+	VkBuffer DrawDataBuffer = VK_NULL_HANDLE;				// 场景 DrawData 存储缓存，每个物体一条 FMeshConstants，持久映射
+	FMemoryAllocation DrawDataBufferMemory;
+	uint32_t DrawDataCount = 0;								// 已经分配的 DrawData 数量
+	VkDescriptorSetLayout DrawDataDescriptorSetLayout;		// 场景管线的 set 1
+	VkDescriptorPool DrawDataDescriptorPool;
+	VkDescriptorSet DrawDataDescriptorSets[MAX_FRAMES_IN_FLIGHT];	// 每帧一个，灯光存储缓存扩容后只更新GPU已经不再使用的那一帧
+	std::atomic<uint64_t> SceneDrawCalls{ 0 };				// 这一帧场景物体的 DrawCall 数量，录制线程同时累加
+	FSceneDrawStats SceneDrawStats;
+
+	VkSemaphore ImageAvailableSemaphore;					// 图像是否完成的信号
+	VkSemaphore RenderFinishedSemaphore;					// 渲染是否结束的信号
+	VkFence InFlightFence;									// 围栏，下一帧渲染前等待上一帧全部渲染完成
+
+	std::vector<FCommandCacheEntry> CommandCache;			// 指令缓存，每个（飞行帧，SwapChain 图像）组合一个
+	FCommandCacheKey CommandCacheKey;						// 缓存的指令录制时的状态
+	uint64_t SceneDrawVersion = 0;							// LOD 分桶和可见簇数量变化的次数，这些数量写在录制的 DrawCall 中
+	std::vector<VkSemaphore> ImageAvailableSemaphores;		// 图像是否完成的信号
+	std::vector<VkSemaphore> RenderFinishedSemaphores;		// 渲染是否结束的信号
+	std::vector<VkFence> InFlightFences;					// 围栏，下一帧渲染前等待上一帧全部渲染完成
+	uint32_t CurrentFrame = 0;								// 当前渲染帧序号
+
+	bool bFramebufferResized = false;
+
+	std::unique_ptr<FJobSystem> RecordJobs;					// 并行录制 Secondary CommandBuffer 的线程
+	std::unique_ptr<FJobSystem> AssetLoadJobs;				// 模型和贴图的解码线程，放在最后，最先析构，等待解码任务完成
+public:
+	/** 主函数调用接口*/
+	void MainTask()
+	{
+		InitWindow();		// 使用传统的GLFW，初始化窗口
+		InitVulkan();		// 初始化Vulkan，创建资源
+		MainTick();			// 每帧循环调用，执行渲染指令
+		ClearWindow();		// 渲染窗口关闭时，删除创建的资源
+	}
+
+public:
+	/** 初始化GUI渲染窗口*/
+	void InitWindow()
+	{
+		glfwInit();
+
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE); // 打开窗口的Resize功能
+
+		uint32_t viewportWidth = VIEWPORT_WIDTH;
+		uint32_t viewportHeight = VIEWPORT_HEIGHT;
+		Window = glfwCreateWindow(viewportWidth, viewportHeight, "LearnVulkan-09: Draw with Deferred", nullptr /* glfwGetPrimaryMonitor() 全屏模式*/, nullptr);
+		glfwSetWindowUserPointer(Window, this);
+		glfwSetFramebufferSizeCallback(Window, FramebufferResizeCallback);
+		GLFWimage iconImages[2];
+		iconImages[0].pixels = stbi_load("Resources/Appicons/vulkan_renderer.png", &iconImages[0].width, &iconImages[0].height, 0, STBI_rgb_alpha);
+		iconImages[1].pixels = stbi_load("Resources/Appicons/vulkan_renderer_small.png", &iconImages[1].width, &iconImages[1].height, 0, STBI_rgb_alpha);
+		glfwSetWindowIcon(Window, 2, iconImages);
+		stbi_image_free(iconImages[0].pixels);
+		stbi_image_free(iconImages[1].pixels);
+
+		GlobalInput.ResetToFocus();
+		GlobalInput.ResetAnimation();
+		GlobalConstants.ResetConstants();
+
+		glfwSetKeyCallback(Window, KeyboardCallback);
+		glfwSetMouseButtonCallback(Window, MouseButtonCallback);
+		glfwSetCursorPosCallback(Window, MousePositionCallback);
+		glfwSetScrollCallback(Window, MouseScrollCallback);
+	}
+
+	/** 初始化Vulkan的渲染管线*/
+	void InitVulkan()
+	{
+		CreateInstance();			// 连接此程序和Vulkan，一般由显卡驱动实现
+		CreateDebugMessenger();		// 创建调试打印信息
+		CreateWindowsSurface();		// 连接此程序的窗口和Vulkan，渲染Vulkan输出
+		SelectPhysicalDevice();		// 找到此电脑的物理显卡硬件
+		CreateLogicalDevice();		// 创建逻辑硬件，对应物理硬件
+		MemoryAllocator.Init(PhysicalDevice, Device, DEVICE_MEMORY_BLOCK_SIZE); // 创建显存子分配器
+		CreateSwapChain();			// 创建交换链，用于渲染数据和图像显示的中间交换
+		CreateSwapChainImageViews();// 创建图像显示，包含在SwapChain中
+		CreateRenderPass();			// 创建渲染通道
+		CreateFramebuffers();		// 创建帧缓存，包含在SwapChain中
+		CreateCommandPool();		// 创建指令池，存储所有的渲染指令
+		CreateStreamingUploader();	// 创建流式上传的传输指令池和所有上传共用的环形StagingBuffer
+		CreateUniformBuffers();		// 创建UnifromBuffer统一缓存区
+		CreateSceneDrawResources();	// 创建场景 DrawData 存储缓存和 Multi-Draw-Indirect 命令缓存
+		CreateShadowmapPass();		// 创建阴影贴图渲染通道
+		CreateSkydomePass();		// 创建天空球和反射球通道
+		CreateBackgroundPass();		// 创建背景渲染通道
+		CreateBaseScenePass();		// 创建基础物体渲染通道
+		CreateBaseSceneIndirectPass();
+#if ENABLE_DEFEERED_RENDERING
+		CreateBaseSceneDeferredPass();
+#endif
+		CreateCommandBuffer();		// 创建指令缓存，指令发送前变成指令缓存
+		CreateRecordJobs();			// 创建并行录制的线程
+		CreateSyncObjects();		// 创建同步围栏，确保下一帧渲染前，上一帧全部渲染完成
+
+		// 帧的Fence创建时已经触发，初始化时扩容替换掉的缓存要等初始化的上传批次完成之后再销毁
+		ReclaimUploadBatches(true);
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			ReclaimGeometryFrees(i);
+		}
+	}
+
+	/** 主循环，执行每帧渲染*/
+	void MainTick()
+	{
+		while (!glfwWindowShouldClose(Window))
+		{
+			glfwPollEvents();
+			UpdateInputs();
+			DrawFrame(); // 绘制一帧
+		}
+
+		vkDeviceWaitIdle(Device);
+	}
+
+	/** 清除Vulkan的渲染管线*/
+	void ClearWindow()
+	{
+		CleanupSwapChain(); // 清理FrameBuffer相关的资源
+		DestroyVulkan(); // 删除Vulkan对象
+
+		glfwDestroyWindow(Window);
+		glfwTerminate();
+	}
+
+	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height) {
+		auto app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
+		app->bFramebufferResized = true;
+	}
+
+	static void KeyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+	{
+		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
+		FGlobalInput* input = &app->GlobalInput;
+		FGlobalConstants* constants = &app->GlobalConstants;
+
+		if (action == GLFW_PRESS && key == GLFW_KEY_F)
+		{
+			input->ResetToFocus();
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_G)
+		{
+			input->ResetToTravel();
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_R)
+		{
+			input->ResetAnimation();
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_M)
+		{
+			input->bPlayStageRoll = !input->bPlayStageRoll;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_L)
+		{
+			input->bPlayLightRoll = !input->bPlayLightRoll;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_I)
+		{
+			input->bSceneMultiDrawIndirect = !input->bSceneMultiDrawIndirect;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_P)
+		{
+			input->bParallelCommandRecording = !input->bParallelCommandRecording;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_C)
+		{
+			input->bCacheCommandBuffers = !input->bCacheCommandBuffers;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_K)
+		{
+			input->bDefragmentRequested = true;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_0)
+		{
+			constants->SpecConstants = 0;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_1)
+		{
+			constants->SpecConstants = 1;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_2)
+		{
+			constants->SpecConstants = 2;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_3)
+		{
+			constants->SpecConstants = 3;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_4)
+		{
+			constants->SpecConstants = 4;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_5)
+		{
+			constants->SpecConstants = 5;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_6)
+		{
+			constants->SpecConstants = 6;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_7)
+		{
+			constants->SpecConstants = 7;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_8)
+		{
+			constants->SpecConstants = 8;
+		}
+		if (action == GLFW_PRESS && key == GLFW_KEY_9)
+		{
+			constants->SpecConstants = 9;
+		}
+	}
+
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+	{
+		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
+		FGlobalInput* input = &app->GlobalInput;
+
+		if (action == GLFW_PRESS && button == GLFW_MOUSE_BUTTON_RIGHT)
+		{
+			input->bUpdateCamera = true;
+			input->bFirstInit = true;
+			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+		}
+		if (action == GLFW_RELEASE && button == GLFW_MOUSE_BUTTON_RIGHT)
+		{
+			input->bUpdateCamera = false;
+			input->bFirstInit = true;
+			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+		}
+	}
+
+	static void MousePositionCallback(GLFWwindow* window, double xpos, double ypos)
+	{
+		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
+		FGlobalInput* input = &app->GlobalInput;
+
+		if (!input->bUpdateCamera)
+		{
+			return;
+		}
+
+		if (input->bFirstInit)
+		{
+			input->LastMouseX = xpos;
+			input->LastMouseY = ypos;
+			input->bFirstInit = false;
+		}
+
+		float CameraYaw = input->CameraYaw;
+		float CameraPitch = input->CameraPitch;
+
+		float xoffset = (float)(xpos - input->LastMouseX);
+		float yoffset = (float)(ypos - input->LastMouseY);
+		input->LastMouseX = xpos;
+		input->LastMouseY = ypos;
+
+		float sensitivityX = 1.0;
+		float sensitivityY = 0.5;
+		xoffset *= sensitivityX;
+		yoffset *= sensitivityY;
+
+		CameraYaw -= xoffset;
+		CameraPitch += yoffset;
+		if (CameraPitch > 89.0)
+			CameraPitch = 89.0;
+		if (CameraPitch < -89.0)
+			CameraPitch = -89.0;
+
+		if (input->bFocusCamera)
+		{
+			glm::vec3 CameraPos = input->CameraPos;
+			float CameraArm = input->CameraArm;
+			CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+			CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+			CameraPos.z = sin(glm::radians(CameraPitch)) * CameraArm;
+			input->CameraPos = CameraPos;
+			input->CameraYaw = CameraYaw;
+			input->CameraPitch = CameraPitch;
+		}
+		else
+		{
+			// @TODO: 鼠标右键控制相机的旋转
+		}
+	}
+
+	static void MouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
+	{
+		FVulkanRendererApp* app = reinterpret_cast<FVulkanRendererApp*>(glfwGetWindowUserPointer(window));
+		FGlobalInput* input = &app->GlobalInput;
+
+		if (input->bFocusCamera)
+		{
+			glm::vec3 CameraPos = input->CameraPos;
+			glm::vec3 CameraLookat = input->CameraLookat;
+			glm::vec3 lookatToPos = CameraLookat - CameraPos;
+			glm::vec3 Direction = glm::normalize(lookatToPos);
+			float cameraDeltaMove = (float)yoffset * 0.5f;
+			float camerArm = input->CameraArm;
+			camerArm += cameraDeltaMove;
+			camerArm = glm::max(camerArm, 1.0f);
+			CameraPos = CameraLookat - camerArm * Direction;
+			input->CameraPos = CameraPos;
+			input->CameraArm = camerArm;
+		}
+	}
+
+	void UpdateInputs()
+	{
+		float DeltaTime = (float)GlobalInput.DeltaTime;    // Time between current frame and last frame
+		float lastFrame = (float)GlobalInput.CurrentTime;  // Time of last frame
+
+		float CurrentFrame = (float)glfwGetTime();
+		DeltaTime = CurrentFrame - lastFrame;
+
+		bool bFocusCamera = GlobalInput.bFocusCamera;
+		glm::vec3 CameraPos = GlobalInput.CameraPos;
+		glm::vec3 CameraLookat = GlobalInput.CameraLookat;
+		glm::vec3 cameraForward = glm::vec3(-1.0, 0.0, 0.0);
+		glm::vec3 cameraUp = glm::vec3(0.0, 0.0, 1.0);
+		float CameraSpeed = GlobalInput.CameraSpeed;
+		float CameraYaw = GlobalInput.CameraYaw;
+		float CameraPitch = GlobalInput.CameraPitch;
+		glm::vec3 cameraDirection = glm::normalize(CameraLookat - CameraPos);
+		const float cameraDeltaMove = 2.5f * DeltaTime; // adjust accordingly
+
+		if (glfwGetKey(Window, GLFW_KEY_W) == GLFW_PRESS)
+		{
+			if (bFocusCamera)
+			{
+				float CameraArm = GlobalInput.CameraArm;
+				CameraArm -= cameraDeltaMove;
+				CameraArm = glm::max(CameraArm, 1.0f);
+				CameraPos = CameraLookat - CameraArm * cameraDirection;
+				GlobalInput.CameraPos = CameraPos;
+				GlobalInput.CameraArm = CameraArm;
+			}
+			else
+			{
+				GlobalInput.CameraPos += cameraDeltaMove * cameraDirection;
+			}
+			GlobalInput.CameraLookat = bFocusCamera ? CameraLookat : (CameraPos + cameraDirection);
+		}
+		if (glfwGetKey(Window, GLFW_KEY_S) == GLFW_PRESS)
+		{
+			if (bFocusCamera)
+			{
+				float CameraArm = GlobalInput.CameraArm;
+				CameraArm += cameraDeltaMove;
+				CameraArm = glm::max(CameraArm, 1.0f);
+				CameraPos = CameraLookat - CameraArm * cameraDirection;
+				GlobalInput.CameraPos = CameraPos;
+				GlobalInput.CameraArm = CameraArm;
+			}
+			else
+			{
+				GlobalInput.CameraPos -= cameraDeltaMove * cameraDirection;
+			}
+			GlobalInput.CameraLookat = bFocusCamera ? CameraLookat : (CameraPos + cameraDirection);
+		}
+		if (glfwGetKey(Window, GLFW_KEY_A) == GLFW_PRESS)
+		{
+			if (bFocusCamera)
+			{
+				CameraYaw += cameraDeltaMove * 45.0f;
+				float CameraArm = GlobalInput.CameraArm;
+				CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+				CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+				GlobalInput.CameraYaw = CameraYaw;
+			}
+			else
+			{
+				CameraPos -= glm::normalize(glm::cross(cameraForward, cameraUp)) * cameraDeltaMove;
+				CameraLookat = CameraPos + cameraForward;
+			}
+			GlobalInput.CameraPos = CameraPos;
+			GlobalInput.CameraLookat = CameraLookat;
+		}
+		if (glfwGetKey(Window, GLFW_KEY_D) == GLFW_PRESS)
+		{
+			if (bFocusCamera)
+			{
+				CameraYaw -= cameraDeltaMove * 45.0f;
+				float CameraArm = GlobalInput.CameraArm;
+				CameraPos.x = cos(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+				CameraPos.y = sin(glm::radians(CameraYaw)) * cos(glm::radians(CameraPitch)) * CameraArm;
+				GlobalInput.CameraYaw = CameraYaw;
+			}
+			else
+			{
+				CameraPos += glm::normalize(glm::cross(cameraForward, cameraUp)) * cameraDeltaMove;
+				CameraLookat = CameraPos + cameraForward;
+			}
+			GlobalInput.CameraPos = CameraPos;
+			GlobalInput.CameraLookat = CameraLookat;
+		}
+		if (glfwGetKey(Window, GLFW_KEY_Q) == GLFW_PRESS)
+		{
+			if (!bFocusCamera)
+			{
+				CameraPos.z -= cameraDeltaMove;
+				CameraLookat = CameraPos + cameraForward;
+				GlobalInput.CameraPos = CameraPos;
+				GlobalInput.CameraLookat = CameraLookat;
+			}
+		}
+		if (glfwGetKey(Window, GLFW_KEY_E) == GLFW_PRESS)
+		{
+			if (!bFocusCamera)
+			{
+				CameraPos.z += cameraDeltaMove;
+				CameraLookat = CameraPos + cameraForward;
+				GlobalInput.CameraPos = CameraPos;
+				GlobalInput.CameraLookat = CameraLookat;
+			}
+		}
+		GlobalInput.CurrentTime = CurrentFrame;
+		GlobalInput.DeltaTime = DeltaTime;
+	}
+
+	/** 在创建好一切必要资源后，执行绘制操作*/
+	void DrawFrame()
+	{
+		// 等待上一帧绘制完成
+		vkWaitForFences(Device, 1, &InFlightFences[CurrentFrame], VK_TRUE, UINT64_MAX);
+		// 这一帧之前释放的几何区间已经不再被GPU使用
+		ReclaimGeometryFrees(CurrentFrame);
+		// 释放已经上传完成的StagingBuffer
+		ReclaimUploadBatches();
+		if (GlobalInput.bDefragmentRequested) {
+			GlobalInput.bDefragmentRequested = false;
+			DefragmentDeviceMemory();
+		}
+		// 推进流式上传，完成的物体从这一帧开始绘制
+		TickStreamingUploads();
+		TickStreamingTasks();
+
+		uint32_t imageIndex;
+		VkResult result = vkAcquireNextImageKHR(Device, SwapChain, UINT64_MAX, ImageAvailableSemaphores[CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+
+		// 当窗口过期时（窗口尺寸改变或者窗口最小化后又重新显示），需要重新创建SwapChain并且停止这一帧的绘制
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			RecreateSwapChain();
+			return;
+		}
+		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			throw std::runtime_error("failed to acquire swap chain image!");
+		}
+
+		// 更新统一缓存区（UBO）
+		UpdateUniformBuffer(CurrentFrame);
+		vkResetFences(Device, 1, &InFlightFences[CurrentFrame]);
+
+		// 录制依赖的状态变化时，之前缓存的指令全部失效
+		FCommandCacheKey commandCacheKey = MakeCommandCacheKey();
+		if (commandCacheKey != CommandCacheKey)
+		{
+			InvalidateCommandCache();
+			CommandCacheKey = commandCacheKey;
+		}
+		// 这一帧和这个 SwapChain 图像对应的指令缓存，有效时只需要更新UBO然后提交
+		FCommandCacheEntry& commandCache = CommandCache[GetCommandCacheSlot(CurrentFrame, imageIndex)];
+		bool bCachedCommandBuffer = GlobalInput.bCacheCommandBuffers && commandCache.bValid;
+		auto recordStart = std::chrono::high_resolution_clock::now();
+		if (bCachedCommandBuffer)
+		{
+			SceneDrawCalls = commandCache.SceneDrawCalls;
+		}
+		else
+		{
+			// 清除渲染指令缓存
+			vkResetCommandBuffer(commandCache.CommandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+			// 记录新的所有的渲染指令缓存
+			RecordCommandBuffer(commandCache, imageIndex);
+			commandCache.SceneDrawCalls = SceneDrawCalls;
+			commandCache.bValid = true;
+		}
+		auto recordEnd = std::chrono::high_resolution_clock::now();
+		UpdateSceneDrawStats(std::chrono::duration<double, std::chrono::milliseconds::period>(recordEnd - recordStart).count(), bCachedCommandBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+		VkSemaphore waitSemaphores[] = { ImageAvailableSemaphores[CurrentFrame] };
+		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = waitSemaphores;
+		submitInfo.pWaitDstStageMask = waitStages;
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandCache.CommandBuffer;
+
+		VkSemaphore signalSemaphores[] = { RenderFinishedSemaphores[CurrentFrame] };
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+
+		// 提交渲染指令
+		if (vkQueueSubmit(GraphicsQueue, 1, &submitInfo, InFlightFences[CurrentFrame]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = signalSemaphores;
+
+		VkSwapchainKHR swapChains[] = { SwapChain };
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = swapChains;
+
+		presentInfo.pImageIndices = &imageIndex;
+
+		vkQueuePresentKHR(PresentQueue, &presentInfo);
+
+		CurrentFrame = (CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	}
+
+protected:
+	/** 创建程序和Vulkan之间的连接，涉及程序和显卡驱动之间特殊细节*/
+	void CreateInstance()
+	{
+		if (bEnableValidationLayers && !CheckValidationLayerSupport())
+		{
+			throw std::runtime_error("validation layers requested, but not available!");
+		}
+
+		VkApplicationInfo appInfo{};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "Render the Scene";
+		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.pEngineName = "Vulkan Engine";
+		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+		appInfo.apiVersion = VK_API_VERSION_1_0;
+
+		VkInstanceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+#ifdef __APPLE__
+		createInfo.flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+#endif
+
+		// 获取需要的glfw拓展名
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+		if (bEnableValidationLayers)
+		{
+			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+		}
+		bool bSyncValidation = bEnableValidationLayers && ENABLE_SYNC_VALIDATION && CheckValidationFeaturesSupport();
+		if (bSyncValidation)
+		{
+			extensions.push_back(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME);
+		}
+#ifdef __APPLE__
+        // Fix issue on Mac(m2) "vkCreateInstance: Found no drivers!"
+        extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+        // Issue on Mac(m2), it's not a error, but a warning, ignore it by this time~
+        // vkCreateDevice():  VK_KHR_portability_subset must be enabled because physical device VkPhysicalDevice 0x600003764f40[] supports it. The Vulkan spec states: If the VK_KHR_portability_subset extension is included in pProperties of vkEnumerateDeviceExtensionProperties, ppEnabledExtensionNames must include "VK_KHR_portability_subset"
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+#endif
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
+
+		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+		const VkValidationFeatureEnableEXT enabledValidationFeatures[] = { VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT };
+		VkValidationFeaturesEXT validationFeatures{};
+		if (bEnableValidationLayers)
+		{
+			createInfo.enabledLayerCount = static_cast<uint32_t>(ValidationLayers.size());
+			createInfo.ppEnabledLayerNames = ValidationLayers.data();
+
+			PopulateDebugMessengerCreateInfo(debugCreateInfo);
+			createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+
+			// 同步验证可以发现缺少的队列族所有权释放/获取，以及传输和渲染之间的读写冲突
+			if (bSyncValidation)
+			{
+				validationFeatures.sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT;
+				validationFeatures.enabledValidationFeatureCount = static_cast<uint32_t>(std::size(enabledValidationFeatures));
+				validationFeatures.pEnabledValidationFeatures = enabledValidationFeatures;
+				validationFeatures.pNext = &debugCreateInfo;
+				createInfo.pNext = &validationFeatures;
+			}
+		}
+		else
+		{
+			createInfo.enabledLayerCount = 0;
+
+			createInfo.pNext = nullptr;
+		}
+
+		if (vkCreateInstance(&createInfo, nullptr, &Instance) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create Instance!");
+		}
+	}
+
+	/** 合法性监测层 Validation Layers
+	 *	- 检查参数规范，检测是否使用
+	 *	- 最终对象创建和销毁，找到资源泄漏
+	 *	- 通过追踪线程原始调用，检查线程安全性
+	 *	- 打印输出每次调用
+	 *	- 为优化和重现追踪Vulkan调用
+	*/
+	void CreateDebugMessenger()
+	{
+		if (!bEnableValidationLayers) return;
+
+		VkDebugUtilsMessengerCreateInfoEXT createInfo;
+		PopulateDebugMessengerCreateInfo(createInfo);
+
+		if (CreateDebugUtilsMessengerEXT(Instance, &createInfo, nullptr, &DebugMessenger) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to set up debug messenger!");
+		}
+	}
+
+	/** WSI (Window System Integration) 链接Vulkan和Window系统，渲染Vulkan到桌面*/
+	void CreateWindowsSurface()
+	{
+		if (glfwCreateWindowSurface(Instance, Window, nullptr, &Surface) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create Window Surface!");
+		}
+	}
+
+	/** 选择支持Vulkan的显卡硬件*/
+	void SelectPhysicalDevice()
+	{
+		uint32_t deviceCount = 0;
+		vkEnumeratePhysicalDevices(Instance, &deviceCount, nullptr);
+
+		if (deviceCount == 0)
+		{
+			throw std::runtime_error("failed to find GPUs with Vulkan support!");
+		}
+
+		std::vector<VkPhysicalDevice> devices(deviceCount);
+		vkEnumeratePhysicalDevices(Instance, &deviceCount, devices.data());
+
+		for (const auto& Device : devices)
+		{
+			if (IsDeviceSuitable(Device))
+			{
+				PhysicalDevice = Device;
+				break;
+			}
+		}
+
+		if (PhysicalDevice == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("failed to find a suitable GPU!");
+		}
+
+		QueryDeviceCapabilities();
+	}
+
+	/** 查询选中的物理硬件的能力，只在启动时调用一次*/
+	void QueryDeviceCapabilities()
+	{
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(PhysicalDevice, &supportedFeatures);
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(PhysicalDevice, &properties);
+
+		DeviceCaps = FDeviceCapabilities{};
+		DeviceCaps.bMultiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+		DeviceCaps.bDrawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+		DeviceCaps.bTextureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+		DeviceCaps.bSamplerAnisotropy = supportedFeatures.samplerAnisotropy == VK_TRUE;
+		DeviceCaps.MaxSamplerAnisotropy = DeviceCaps.bSamplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 1.0f;
+		DeviceCaps.MinUniformBufferOffsetAlignment = properties.limits.minUniformBufferOffsetAlignment;
+		DeviceCaps.MinStorageBufferOffsetAlignment = properties.limits.minStorageBufferOffsetAlignment;
+		DeviceCaps.TimestampPeriod = properties.limits.timestampPeriod;
+
+		// 所有图形和计算队列都支持时间戳，或者图形队列族的时间戳有效位数不为0
+		FQueueFamilyIndices queue_family_indices = FindQueueFamilies(PhysicalDevice);
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+		DeviceCaps.bTimestampQueries = properties.limits.timestampPeriod > 0.0f &&
+			(properties.limits.timestampComputeAndGraphics == VK_TRUE || queueFamilies[queue_family_indices.GraphicsFamily.value()].timestampValidBits > 0);
+
+		// 扩展只记录是否可用，用到它们的渲染路径需要在创建逻辑硬件时开启
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+		for (const VkExtensionProperties& extension : availableExtensions)
+		{
+			if (strcmp(extension.extensionName, "VK_KHR_draw_indirect_count") == 0) {
+				DeviceCaps.bDrawIndirectCount = true;
+			}
+			if (strcmp(extension.extensionName, "VK_EXT_descriptor_indexing") == 0) {
+				DeviceCaps.bDescriptorIndexing = true;
+			}
+		}
+
+		// 不支持时默认回退到逐物体提交
+		GlobalInput.bSceneMultiDrawIndirect = ENABLE_SCENE_MULTI_DRAW_INDIRECT && DeviceCaps.bDrawIndirectFirstInstance;
+
+		std::cout << "[LOG]: " << properties.deviceName
+			<< " multiDrawIndirect: " << DeviceCaps.bMultiDrawIndirect
+			<< ", drawIndirectFirstInstance: " << DeviceCaps.bDrawIndirectFirstInstance
+			<< ", drawIndirectCount: " << DeviceCaps.bDrawIndirectCount
+			<< ", descriptorIndexing: " << DeviceCaps.bDescriptorIndexing
+			<< ", timestamps: " << DeviceCaps.bTimestampQueries
+			<< ", textureCompressionBC: " << DeviceCaps.bTextureCompressionBC
+			<< ", samplerAnisotropy: " << DeviceCaps.bSamplerAnisotropy << std::endl;
+	}
+
+	/** 创建逻辑硬件对接物理硬件，相同物理硬件可以对应多个逻辑硬件*/
+	void CreateLogicalDevice()
+	{
+		FQueueFamilyIndices queue_family_indices = FindQueueFamilies(PhysicalDevice);
+
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+		std::set<uint32_t> uniqueQueueFamilies = { queue_family_indices.GraphicsFamily.value(), queue_family_indices.PresentFamily.value() };
+		if (ENABLE_TRANSFER_QUEUE_UPLOAD && queue_family_indices.TransferFamily.has_value()) {
+			uniqueQueueFamilies.insert(queue_family_indices.TransferFamily.value());
+		}
+
+		float queuePriority = 1.0f;
+		for (uint32_t queueFamily : uniqueQueueFamilies)
+		{
+			VkDeviceQueueCreateInfo queueCreateInfo{};
+			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCreateInfo.queueFamilyIndex = queueFamily;
+			queueCreateInfo.queueCount = 1;
+			queueCreateInfo.pQueuePriorities = &queuePriority;
+			queueCreateInfos.push_back(queueCreateInfo);
+		}
+
+		// 只开启设备能力表中支持的特性
+		VkPhysicalDeviceFeatures deviceFeatures{};
+		deviceFeatures.multiDrawIndirect = DeviceCaps.bMultiDrawIndirect ? VK_TRUE : VK_FALSE;
+		deviceFeatures.drawIndirectFirstInstance = DeviceCaps.bDrawIndirectFirstInstance ? VK_TRUE : VK_FALSE;
+		deviceFeatures.samplerAnisotropy = DeviceCaps.bSamplerAnisotropy ? VK_TRUE : VK_FALSE;
+		deviceFeatures.textureCompressionBC = DeviceCaps.bTextureCompressionBC ? VK_TRUE : VK_FALSE;
+
+		VkDeviceCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+
+		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+		createInfo.pQueueCreateInfos = queueCreateInfos.data();
+
+		createInfo.pEnabledFeatures = &deviceFeatures;
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(DeviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = DeviceExtensions.data();
+
+		if (bEnableValidationLayers)
+		{
+			createInfo.enabledLayerCount = static_cast<uint32_t>(ValidationLayers.size());
+			createInfo.ppEnabledLayerNames = ValidationLayers.data();
+		}
+		else
+		{
+			createInfo.enabledLayerCount = 0;
+		}
+
+		if (vkCreateDevice(PhysicalDevice, &createInfo, nullptr, &Device) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create logical Device!");
+		}
+
+		vkGetDeviceQueue(Device, queue_family_indices.GraphicsFamily.value(), 0, &GraphicsQueue);
+		vkGetDeviceQueue(Device, queue_family_indices.PresentFamily.value(), 0, &PresentQueue);
+
+		// 没有独立的传输队列族，或者没有开启 ENABLE_TRANSFER_QUEUE_UPLOAD 时，流式上传回退到图形队列
+		GraphicsQueueFamily = queue_family_indices.GraphicsFamily.value();
+		bDedicatedTransferQueue = ENABLE_TRANSFER_QUEUE_UPLOAD && queue_family_indices.TransferFamily.has_value();
+		TransferQueueFamily = bDedicatedTransferQueue ? queue_family_indices.TransferFamily.value() : GraphicsQueueFamily;
+		vkGetDeviceQueue(Device, TransferQueueFamily, 0, &TransferQueue);
+		std::cout << "[LOG]: Transfer queue family " << TransferQueueFamily
+			<< (bDedicatedTransferQueue ? " (dedicated, ownership transfers enabled)" : " (shared with graphics)") << std::endl;
+
+		// 查询设备支持的烘焙贴图格式，不支持的压缩格式在加载时回退到 RGBA8 源文件
+		DeviceCaps.CookedTextureFormatSupport = 0;
+		for (uint32_t format = 0; format < static_cast<uint32_t>(ECookedTextureFormat::Count); format++)
+		{
+			if (IsTextureFormatSupported(GetTextureFormat(static_cast<ECookedTextureFormat>(format), false)) &&
+				IsTextureFormatSupported(GetTextureFormat(static_cast<ECookedTextureFormat>(format), true)))
+			{
+				DeviceCaps.CookedTextureFormatSupport |= 1u << format;
+			}
+		}
+	}
+
+	/** 交换链 Swap Chain
+	 * Vulkan一种基础结构，持有帧缓存FrameBuffer
+	 * SwapChain持有显示到窗口的图像队列
+	 * 通常Vulkan获取图像，渲染到图像上，然后将图像推入SwapChain的图像队列
+	 * SwapChain显示图像，通常和屏幕刷新率保持同步
+	*/
+	void CreateSwapChain()
+	{
+		FSwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(PhysicalDevice);
+
+		VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.Formats);
+		VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.PresentModes);
+		VkExtent2D extent = ChooseSwapExtent(swapChainSupport.Capabilities);
+
+		uint32_t imageCount = swapChainSupport.Capabilities.minImageCount + 1;
+		if (swapChainSupport.Capabilities.maxImageCount > 0 && imageCount > swapChainSupport.Capabilities.maxImageCount)
+		{
+			imageCount = swapChainSupport.Capabilities.maxImageCount;
+		}
+
+		VkSwapchainCreateInfoKHR createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+		createInfo.surface = Surface;
+
+		createInfo.minImageCount = imageCount;
+		createInfo.imageFormat = surfaceFormat.format;
+		createInfo.imageColorSpace = surfaceFormat.colorSpace;
+		createInfo.imageExtent = extent;
+		createInfo.imageArrayLayers = 1;
+		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+		FQueueFamilyIndices queue_family_indices = FindQueueFamilies(PhysicalDevice);
+		uint32_t queueFamilyIndices[] = { queue_family_indices.GraphicsFamily.value(), queue_family_indices.PresentFamily.value() };
+
+		if (queue_family_indices.GraphicsFamily != queue_family_indices.PresentFamily)
+		{
+			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+			createInfo.queueFamilyIndexCount = 2;
+			createInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+		else
+		{
+			createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		}
+
+		createInfo.preTransform = swapChainSupport.Capabilities.currentTransform;
+		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+		createInfo.presentMode = presentMode;
+		createInfo.clipped = VK_TRUE;
+
+		createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+		if (vkCreateSwapchainKHR(Device, &createInfo, nullptr, &SwapChain) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create swap chain!");
+		}
+
+		vkGetSwapchainImagesKHR(Device, SwapChain, &imageCount, nullptr);
+		SwapChainImages.resize(imageCount);
+		vkGetSwapchainImagesKHR(Device, SwapChain, &imageCount, SwapChainImages.data());
+
+		SwapChainImageFormat = surfaceFormat.format;
+		SwapChainExtent = extent;
+	}
+
+	/** 重新创建SwapChain*/
+	void RecreateSwapChain()
+	{
+		// 当窗口长宽都是零时，说明窗口被最小化了，这时需要等待
+		int Width = 0, Height = 0;
+		glfwGetFramebufferSize(Window, &Width, &Height);
+		while (Width == 0 || Height == 0) {
+			glfwGetFramebufferSize(Window, &Width, &Height);
+			glfwWaitEvents();
+		}
+
+		vkDeviceWaitIdle(Device);
+
+		CleanupSwapChain();
+
+		CreateSwapChain();
+		CreateSwapChainImageViews();
+		CreateFramebuffers();
+#if ENABLE_DEFEERED_RENDERING
+		CreateBaseSceneDeferredPass();
+#endif
+
+		// 缓存的指令引用了旧的帧缓存和GBuffer，SwapChain 图像数量变化时重新分配
+		if (CommandCache.size() != MAX_FRAMES_IN_FLIGHT * SwapChainImages.size()) {
+			DestroyCommandBuffer();
+			CreateCommandBuffer();
+		}
+		InvalidateCommandCache();
+	}
+
+	/** 清理旧的SwapChain*/
+	void CleanupSwapChain() {
+		vkDestroyImageView(Device, DepthImageView, nullptr);
+		vkDestroyImage(Device, DepthImage, nullptr);
+		MemoryAllocator.Free(DepthImageMemory);
+
+		for (auto framebuffer : SwapChainFramebuffers) {
+			vkDestroyFramebuffer(Device, framebuffer, nullptr);
+		}
+
+		for (auto imageView : SwapChainImageViews) {
+			vkDestroyImageView(Device, imageView, nullptr);
+		}
+
+		vkDestroySwapchainKHR(Device, SwapChain, nullptr);
+	}
+
+	/** 图像视图 Image View
+	 * 将视图显示为图像
+	 * ImageView定义了SwapChain里定义的图像是什么样的
+	 * 比如，带深度信息的RGB图像
+	*/
+	void CreateSwapChainImageViews()
+	{
+		SwapChainImageViews.resize(SwapChainImages.size());
+
+		for (size_t i = 0; i < SwapChainImages.size(); i++)
+		{
+			CreateImageView(SwapChainImageViews[i], SwapChainImages[i], SwapChainImageFormat);
+		}
+	}
+
+	/** 渲染层 RenderPass
+	 * 创建渲染管线之前，需要先创建渲染层，告诉Vulkan渲染时使用的帧缓存FrameBuffer
+	 * 我们需要指定渲染中使用的颜色缓存和深度缓存的数量，以及采样信息
+	*/
+	void CreateRenderPass()
+	{
+		VkAttachmentDescription ColorAttachment{};
+		ColorAttachment.format = SwapChainImageFormat;
+		ColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		ColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		ColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		ColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		ColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		ColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		VkAttachmentDescription DepthAttachment{};
+		DepthAttachment.format = FindDepthFormat();
+		DepthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+#if !ENABLE_DEFEERED_RENDERING
+		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+#else
+		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+#endif
+		DepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		DepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+#if !ENABLE_DEFEERED_RENDERING
+		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+#else
+		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+#endif
+		DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference ColorAttachmentRef{};
+		ColorAttachmentRef.attachment = 0;
+		ColorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference DepthAttachmentRef{};
+		DepthAttachmentRef.attachment = 1;
+		DepthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// 渲染子通道 SubPass
+		// SubPass是RenderPass的下属任务，和RenderPass共享Framebuffer等渲染资源
+		// 某些渲染操作，比如后处理的Blooming，当前渲染需要依赖上一个渲染结果，但是渲染资源不变，这是SubPass可以优化性能
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &ColorAttachmentRef;
+		subpass.pDepthStencilAttachment = &DepthAttachmentRef;
+
+		// 这里将渲染三角形的操作，简化成一个SubPass提交
+		VkSubpassDependency dependency{};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = 0;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		std::array<VkAttachmentDescription, 2> attachments = { ColorAttachment, DepthAttachment };
+		VkRenderPassCreateInfo renderPassCI{};
+		renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCI.pAttachments = attachments.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpass;
+		renderPassCI.dependencyCount = 1;
+		renderPassCI.pDependencies = &dependency;
+		if (vkCreateRenderPass(Device, &renderPassCI, nullptr, &MainRenderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create render pass!");
+		}
+	}
+
+	/** 创建指令池，管理所有的指令，比如DrawCall或者内存交换等*/
+	void CreateCommandPool()
+	{
+		FQueueFamilyIndices queueFamilyIndices = FindQueueFamilies(PhysicalDevice);
+
+		VkCommandPoolCreateInfo poolCI{};
+		poolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolCI.queueFamilyIndex = queueFamilyIndices.GraphicsFamily.value();
+
+		if (vkCreateCommandPool(Device, &poolCI, nullptr, &CommandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create command pool!");
+		}
+	}
+
+	/** 创建流式上传使用的传输指令池，以及所有上传共用的持久映射的环形StagingBuffer*/
+	void CreateStreamingUploader()
+	{
+		if (bDedicatedTransferQueue)
+		{
+			VkCommandPoolCreateInfo poolCI{};
+			poolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolCI.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolCI.queueFamilyIndex = TransferQueueFamily;
+
+			if (vkCreateCommandPool(Device, &poolCI, nullptr, &TransferCommandPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to Create transfer command pool!");
+			}
+		}
+
+		StagingRing.Size = STREAMING_STAGING_SIZE;
+		CreateBuffer(
+			StagingRing.Size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			StagingRing.Buffer,
+			StagingRing.Memory);
+		// 主机可见的显存块在分配时已经持久映射
+		StagingRing.Mapped = StagingRing.Memory.Mapped;
+
+		std::cout << "[LOG]: Streaming uploads use " << (bDedicatedTransferQueue ? "a dedicated transfer queue" : "the graphics queue")
+			<< " (queue family " << TransferQueueFamily << ") and a " << (StagingRing.Size >> 20) << " MB staging ring" << std::endl;
+	}
+
+	void DestroyStreamingUploader()
+	{
+		StagingRing.Mapped = nullptr;
+		vkDestroyBuffer(Device, StagingRing.Buffer, nullptr);
+		MemoryAllocator.Free(StagingRing.Memory);
+		if (TransferCommandPool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(Device, TransferCommandPool, nullptr);
+		}
+	}
+
+	/** 创建帧缓存，即每帧图像对应的渲染数据*/
+	void CreateFramebuffers()
+	{
+		// 创建深度纹理资源
+		VkFormat depthFormat = FindDepthFormat();
+		CreateImage(DepthImage, DepthImageMemory, SwapChainExtent.width, SwapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(DepthImageView, DepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+		SwapChainFramebuffers.resize(SwapChainImageViews.size());
+
+		for (size_t i = 0; i < SwapChainImageViews.size(); i++) 
+		{
+			std::array<VkImageView, 2> attachments = 
+			{
+				SwapChainImageViews[i],
+				DepthImageView
+			};
+			VkFramebufferCreateInfo frameBufferCI{};
+			frameBufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			frameBufferCI.renderPass = MainRenderPass;
+			frameBufferCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+			frameBufferCI.pAttachments = attachments.data();
+			frameBufferCI.width = SwapChainExtent.width;
+			frameBufferCI.height = SwapChainExtent.height;
+			frameBufferCI.layers = 1;
+
+			if (vkCreateFramebuffer(Device, &frameBufferCI, nullptr, &SwapChainFramebuffers[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to Create framebuffer!");
+			}
+		}
+	}
+
+
+	/**
+	 * 创建阴影贴图资源 Shadow map
+	*/
+	void CreateShadowmapPass()
+	{
+		ShadowmapPass.Width = SHADOWMAP_DIM;
+		ShadowmapPass.Height = SHADOWMAP_DIM;
+		ShadowmapPass.Format = FindDepthFormat();
+		CreateImage(
+			ShadowmapPass.Image,
+			ShadowmapPass.Memory,
+			ShadowmapPass.Width, ShadowmapPass.Height, ShadowmapPass.Format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(ShadowmapPass.ImageView, ShadowmapPass.Image, ShadowmapPass.Format, VK_IMAGE_ASPECT_DEPTH_BIT);
+		CreateSampler(ShadowmapPass.Sampler,
+			VK_FILTER_LINEAR,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE); // @TODO: 是否应该将 sample filter 改成 VK_FILTER_NEAREST
+
+		//////////////////////////////////////////////////////////
+		// 创建 DescriptorSetLayout，阴影相机的统一缓存在每帧的统一缓存环中
+		VkDescriptorSetLayoutBinding uboLayoutBinding{};
+		uboLayoutBinding.binding = 0;
+		uboLayoutBinding.descriptorCount = 1;
+		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		uboLayoutBinding.pImmutableSamplers = nullptr;
 		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 		std::vector<VkDescriptorSetLayoutBinding> bindings;
@@ -1562,2472 +3377,3905 @@ protected:
 		bindings[0] = uboLayoutBinding;
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
-		if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &ShadowmapPass.DescriptorSetLayout) != VK_SUCCESS) {
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &ShadowmapPass.DescriptorSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create descriptor set layout!");
+		}
+
+		//////////////////////////////////////////////////////////
+		// 创建 DescriptorPool
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		poolSizes.resize(1);
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		VkDescriptorPoolCreateInfo poolCI{};
+		poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolCI.pPoolSizes = poolSizes.data();
+		poolCI.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		if (vkCreateDescriptorPool(Device, &poolCI, nullptr, &ShadowmapPass.DescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create descriptor pool!");
+		}
+
+		//////////////////////////////////////////////////////////
+		// 创建 DescriptorSets
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, ShadowmapPass.DescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = ShadowmapPass.DescriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		allocInfo.pSetLayouts = layouts.data();
+		ShadowmapPass.DescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+		if (vkAllocateDescriptorSets(Device, &allocInfo, ShadowmapPass.DescriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+
+		//////////////////////////////////////////////////////////
+		// 绑定 DescriptorSets
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			std::vector<VkWriteDescriptorSet> descriptorWrites{};
+			descriptorWrites.resize(1);
+			VkDescriptorBufferInfo bufferInfo{};
+			bufferInfo.buffer = UniformRings[i].Buffer;
+			bufferInfo.offset = 0;
+			bufferInfo.range = sizeof(FUniformBufferBase);
+			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[0].dstSet = ShadowmapPass.DescriptorSets[i];
+			descriptorWrites[0].dstBinding = 0;
+			descriptorWrites[0].dstArrayElement = 0;
+			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			descriptorWrites[0].descriptorCount = 1;
+			descriptorWrites[0].pBufferInfo = &bufferInfo;
+			vkUpdateDescriptorSets(Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+
+		VkAttachmentDescription attachmentDescription{};
+		attachmentDescription.format = ShadowmapPass.Format;
+		attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+		// Clear depth at beginning of the render pass
+		attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		// We will read from depth, so it's important to store the depth attachment results
+		attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// We don't care about initial layout of the attachment
+		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Attachment will be transitioned to shader read at render pass end
+		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		VkAttachmentReference depthReference = {};
+		depthReference.attachment = 0;
+		// Attachment will be used as depth/stencil during render pass
+		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		// No color attachments
+		subpass.colorAttachmentCount = 0;
+		// Reference to our depth attachment
+		subpass.pDepthStencilAttachment = &depthReference;
+
+		// Use subpass dependencies for layout transitions
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassCreateInfo{};
+		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCreateInfo.attachmentCount = 1;
+		renderPassCreateInfo.pAttachments = &attachmentDescription;
+		renderPassCreateInfo.subpassCount = 1;
+		renderPassCreateInfo.pSubpasses = &subpass;
+		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());;
+		renderPassCreateInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(Device, &renderPassCreateInfo, nullptr, &ShadowmapPass.RenderPass)) {
+			throw std::runtime_error("failed to Create shadow map render pass!");
+		}
+
+		// Create frame buffer
+		VkFramebufferCreateInfo frameBufferCreateInfo{};
+		frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferCreateInfo.renderPass = ShadowmapPass.RenderPass;
+		frameBufferCreateInfo.attachmentCount = 1;
+		frameBufferCreateInfo.pAttachments = &ShadowmapPass.ImageView;
+		frameBufferCreateInfo.width = ShadowmapPass.Width;
+		frameBufferCreateInfo.height = ShadowmapPass.Height;
+		frameBufferCreateInfo.layers = 1;
+
+		if (vkCreateFramebuffer(Device, &frameBufferCreateInfo, nullptr, &ShadowmapPass.FrameBuffer)) {
+			throw std::runtime_error("failed to Create shadow map frame buffer!");
+		}
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI{};
+		inputAssemblyStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssemblyStateCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		inputAssemblyStateCI.primitiveRestartEnable = VK_FALSE;
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI{};
+		rasterizationStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizationStateCI.depthClampEnable = VK_FALSE;
+		rasterizationStateCI.rasterizerDiscardEnable = VK_FALSE;
+		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizationStateCI.lineWidth = 1.0f;
+		rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT /*VK_CULL_MODE_BACK_BIT*/;
+		rasterizationStateCI.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterizationStateCI.depthBiasEnable = VK_FALSE;
+		VkPipelineColorBlendAttachmentState blendAttachmentState{};
+		blendAttachmentState.colorWriteMask = 0xf;
+		blendAttachmentState.blendEnable = VK_FALSE;
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI{};
+		colorBlendStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlendStateCI.logicOpEnable = VK_FALSE;
+		colorBlendStateCI.logicOp = VK_LOGIC_OP_COPY;
+		colorBlendStateCI.attachmentCount = 1;
+		colorBlendStateCI.pAttachments = &blendAttachmentState;
+		colorBlendStateCI.blendConstants[0] = 0.0f;
+		colorBlendStateCI.blendConstants[1] = 0.0f;
+		colorBlendStateCI.blendConstants[2] = 0.0f;
+		colorBlendStateCI.blendConstants[3] = 0.0f;
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI{};
+		depthStencilStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencilStateCI.depthTestEnable = VK_TRUE;
+		depthStencilStateCI.depthWriteEnable = VK_TRUE;
+		depthStencilStateCI.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthStencilStateCI.depthBoundsTestEnable = VK_FALSE;
+		depthStencilStateCI.minDepthBounds = 0.0f; // Optional
+		depthStencilStateCI.maxDepthBounds = 1.0f; // Optional
+		depthStencilStateCI.stencilTestEnable = VK_FALSE; // 没有写轮廓信息，所以跳过轮廓测试
+		depthStencilStateCI.front = {}; // Optional
+		depthStencilStateCI.back = {}; // Optional
+		VkPipelineViewportStateCreateInfo viewportStateCI{};
+		viewportStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportStateCI.viewportCount = 1;
+		viewportStateCI.scissorCount = 1;
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI{};
+		multisampleStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampleStateCI.sampleShadingEnable = VK_FALSE;
+		multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI{};
+		dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
+		dynamicStateCI.pDynamicStates = dynamicStateEnables.data();
+
+		auto vertShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_vert.spv");
+		auto fragShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_frag.spv");
+		VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
+		VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+		VkPipelineShaderStageCreateInfo vertShaderStageCI{};
+		vertShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageCI.module = vertShaderModule;
+		vertShaderStageCI.pName = "main";
+		VkPipelineShaderStageCreateInfo fragShaderStageCI{};
+		fragShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageCI.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageCI.module = fragShaderModule;
+		fragShaderStageCI.pName = "main";
+		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCI, fragShaderStageCI };
+
+		VkPipelineVertexInputStateCreateInfo vertexInputCI{};
+		auto bindingDescription = FVertex::GetBindingDescription();
+		auto attributeDescriptions = FVertex::GetAttributeDescriptions();
+		vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputCI.vertexBindingDescriptionCount = 1;
+		vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputCI.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputCI.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+		// 设置 push constants
+		VkPushConstantRange pushConstant;
+		pushConstant.offset = 0;
+		pushConstant.size = sizeof(FGlobalConstants);
+		pushConstant.stageFlags = VK_SHADER_STAGE_ALL;
+
+		// set 1 为场景 DrawData 存储缓存
+		VkDescriptorSetLayout setLayouts[] = { ShadowmapPass.DescriptorSetLayout, DrawDataDescriptorSetLayout };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+		pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCI.setLayoutCount = 2;
+		pipelineLayoutCI.pSetLayouts = setLayouts;
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstant;
+
+		if (vkCreatePipelineLayout(Device, &pipelineLayoutCI, nullptr, &ShadowmapPass.PipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create pipeline layout!");
+		}
+
+		VkGraphicsPipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCI.stageCount = 2;
+		pipelineCI.pStages = shaderStages;
+		pipelineCI.pVertexInputState = &vertexInputCI;
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI; // 加上深度测试
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+		pipelineCI.layout = ShadowmapPass.PipelineLayout;
+		pipelineCI.renderPass = ShadowmapPass.RenderPass;
+		pipelineCI.subpass = 0;
+		pipelineCI.basePipelineHandle = VK_NULL_HANDLE;
+
+		// Offscreen pipeline (vertex shader only)
+		//shaderStages[0] = loadShader(getShadersPath() + "shadowmapping/offscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		pipelineCI.stageCount = 1;
+		// No blend attachment states (no color attachments used)
+		colorBlendStateCI.attachmentCount = 0;
+		// Disable culling, so all faces contribute to shadows
+		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+		depthStencilStateCI.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		// Enable depth bias
+		rasterizationStateCI.depthBiasEnable = VK_TRUE;
+		// Add depth bias to dynamic state, so we can change it at runtime
+		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
+		dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
+		dynamicStateCI.pDynamicStates = dynamicStateEnables.data();
+
+		pipelineCI.renderPass = ShadowmapPass.RenderPass;
+
+		if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &ShadowmapPass.Pipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create graphics pipeline!");
+		}
+
+		// Create vertex instanced pipeline
+		auto vertInstancedShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_instanced_vert.spv");
+		VkShaderModule vertInstancedShaderModule = CreateShaderModule(vertInstancedShaderCode);
+		VkPipelineShaderStageCreateInfo vertInstancedShaderStageCI{};
+		vertInstancedShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertInstancedShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertInstancedShaderStageCI.module = vertInstancedShaderModule;
+		vertInstancedShaderStageCI.pName = "main";
+		auto bindingInstancedDescriptions = FVertex::GetBindingInstancedDescriptions();
+		auto attributeInstancedDescriptions = FVertex::GetAttributeInstancedDescriptions();
+		vertexInputCI.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingInstancedDescriptions.size());
+		vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeInstancedDescriptions.size());
+		vertexInputCI.pVertexBindingDescriptions = bindingInstancedDescriptions.data();
+		vertexInputCI.pVertexAttributeDescriptions = attributeInstancedDescriptions.data();
+		pipelineCI.pVertexInputState = &vertexInputCI;
+		shaderStages[0] = vertInstancedShaderStageCI;
+		pipelineCI.pStages = shaderStages;
+		if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &ShadowmapPass.PipelineInstanced) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create graphics pipeline!");
+		}
+
+		// Create compact vertex pipelines, vertex shaders are compiled with COMPACT_VERTEX
+		auto vertCompactShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_compact_vert.spv");
+		auto vertInstancedCompactShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_instanced_compact_vert.spv");
+		VkShaderModule vertCompactShaderModule = CreateShaderModule(vertCompactShaderCode);
+		VkShaderModule vertInstancedCompactShaderModule = CreateShaderModule(vertInstancedCompactShaderCode);
+		auto bindingCompactDescription = FCompactVertex::GetBindingDescription();
+		auto attributeCompactDescriptions = FCompactVertex::GetAttributeDescriptions();
+		vertexInputCI.vertexBindingDescriptionCount = 1;
+		vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeCompactDescriptions.size());
+		vertexInputCI.pVertexBindingDescriptions = &bindingCompactDescription;
+		vertexInputCI.pVertexAttributeDescriptions = attributeCompactDescriptions.data();
+		shaderStages[0].module = vertCompactShaderModule;
+		if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &ShadowmapPass.PipelineCompact) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create graphics pipeline!");
+		}
+		auto bindingInstancedCompactDescriptions = FCompactVertex::GetBindingInstancedDescriptions();
+		auto attributeInstancedCompactDescriptions = FCompactVertex::GetAttributeInstancedDescriptions();
+		vertexInputCI.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingInstancedCompactDescriptions.size());
+		vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeInstancedCompactDescriptions.size());
+		vertexInputCI.pVertexBindingDescriptions = bindingInstancedCompactDescriptions.data();
+		vertexInputCI.pVertexAttributeDescriptions = attributeInstancedCompactDescriptions.data();
+		shaderStages[0].module = vertInstancedCompactShaderModule;
+		if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &ShadowmapPass.PipelineInstancedCompact) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create graphics pipeline!");
+		}
+
+		vkDestroyShaderModule(Device, fragShaderModule, nullptr);
+		vkDestroyShaderModule(Device, vertShaderModule, nullptr);
+		vkDestroyShaderModule(Device, vertInstancedShaderModule, nullptr);
+		vkDestroyShaderModule(Device, vertCompactShaderModule, nullptr);
+		vkDestroyShaderModule(Device, vertInstancedCompactShaderModule, nullptr);
+	}
+
+	/** Cube map Faces Rules:
+	 *       Y3
+	 *       ||
+	 * X1 == Z4 == X0 == Z5
+	 *       ||
+	 *       Y4
+	 * | https://matheowis.github.io/HDRI-to-CubeMap/    |
+	 * | X0(p-x) | X1(n-x) | Y2(p-z) | Y3(n-z) | Z4(n-y) | Z5(p-y)|
+	 * |    90   |   -90   |    0    |   180   |    0    |   180  |
+	 */
+	void CreateCubemapResources()
+	{
+		CreateImageHDRContext(CubemapImage, CubemapImageMemory, CubemapImageView, CubemapSampler, CubemapMaxMips, {
+			"Resources/Textures/cubemap_X0.png",
+			"Resources/Textures/cubemap_X1.png",
+			"Resources/Textures/cubemap_Y2.png",
+			"Resources/Textures/cubemap_Y3.png",
+			"Resources/Textures/cubemap_Z4.png",
+			"Resources/Textures/cubemap_Z5.png" });
+	}
+
+	/** 创建场景 DrawData 存储缓存和它的描述符集合，以及每个场景Pass的 Multi-Draw-Indirect 命令缓存
+	 * DrawData 创建之后不再改变，所有同时渲染的帧共用一份*/
+	void CreateSceneDrawResources()
+	{
+		CreateBuffer(
+			sizeof(FMeshConstants) * MAX_SCENE_DRAW_DATA,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			DrawDataBuffer,
+			DrawDataBufferMemory,
+			EMemoryAllocationStrategy::Linear);
+		DrawDataCount = 0;
+
+		VkDescriptorSetLayoutBinding drawDataLayoutBinding{};
+		drawDataLayoutBinding.binding = 0;
+		drawDataLayoutBinding.descriptorCount = 1;
+		drawDataLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		drawDataLayoutBinding.pImmutableSamplers = nullptr;
+		drawDataLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		// 灯光存储缓存，每帧一段，通过动态偏移选择这一帧的那一段
+		VkDescriptorSetLayoutBinding lightLayoutBinding{};
+		lightLayoutBinding.binding = 1;
+		lightLayoutBinding.descriptorCount = 1;
+		lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		lightLayoutBinding.pImmutableSamplers = nullptr;
+		lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutBinding bindings[] = { drawDataLayoutBinding, lightLayoutBinding };
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 2;
+		layoutInfo.pBindings = bindings;
+		if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &DrawDataDescriptorSetLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to Create descriptor set layout!");
 		}
 
-		//////////////////////////////////////////////////////////
-		// 创建 DescriptorPool
-		std::vector<VkDescriptorPoolSize> poolSizes;
-		poolSizes.resize(1);
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		VkDescriptorPoolCreateInfo poolCI{};
-		poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolCI.pPoolSizes = poolSizes.data();
-		poolCI.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		if (vkCreateDescriptorPool(Device, &poolCI, nullptr, &ShadowmapPass.DescriptorPool) != VK_SUCCESS) {
-			throw std::runtime_error("failed to Create descriptor pool!");
-		}
+		VkDescriptorPoolSize poolSizes[2]{};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+		VkDescriptorPoolCreateInfo poolCI{};
+		poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCI.poolSizeCount = 2;
+		poolCI.pPoolSizes = poolSizes;
+		poolCI.maxSets = MAX_FRAMES_IN_FLIGHT;
+		if (vkCreateDescriptorPool(Device, &poolCI, nullptr, &DrawDataDescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, DrawDataDescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = DrawDataDescriptorPool;
+		allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+		allocInfo.pSetLayouts = layouts.data();
+		if (vkAllocateDescriptorSets(Device, &allocInfo, DrawDataDescriptorSets) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+
+		CreateLightBuffer();
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			VkDescriptorBufferInfo bufferInfo{};
+			bufferInfo.buffer = DrawDataBuffer;
+			bufferInfo.offset = 0;
+			bufferInfo.range = VK_WHOLE_SIZE;
+			VkWriteDescriptorSet descriptorWrite{};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = DrawDataDescriptorSets[i];
+			descriptorWrite.dstBinding = 0;
+			descriptorWrite.dstArrayElement = 0;
+			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrite.descriptorCount = 1;
+			descriptorWrite.pBufferInfo = &bufferInfo;
+			vkUpdateDescriptorSets(Device, 1, &descriptorWrite, 0, nullptr);
+			UpdateLightDescriptor(i);
+		}
+
+		for (FSceneDrawBatch* batch : { &ShadowmapPass.DrawBatch, &BaseScenePass.DrawBatch, &BaseSceneDeferredPass.SceneDrawBatch }) {
+			CreateSceneDrawBatchBuffer(*batch, MAX_SCENE_DRAWS);
+		}
+
+		if (!DeviceCaps.bDrawIndirectFirstInstance) {
+			std::cout << "[LOG]: drawIndirectFirstInstance is not supported, scene objects are drawn one by one" << std::endl;
+		}
+	}
+
+	/** 创建场景绘制批次的命令缓存，每个同时渲染的帧一段，每段 capacity 条命令*/
+	void CreateSceneDrawBatchBuffer(FSceneDrawBatch& batch, uint32_t capacity)
+	{
+		CreateBuffer(
+			sizeof(VkDrawIndexedIndirectCommand) * capacity * MAX_FRAMES_IN_FLIGHT,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			batch.Buffer,
+			batch.Memory,
+			EMemoryAllocationStrategy::Linear);
+		batch.Capacity = capacity;
+		batch.Draws.reserve(capacity);
+	}
+
+	/** 命令缓存放不下 drawCount 条命令时按两倍扩容，录制线程中不能扩容，在主线程上分配录制任务时调用
+	 * 之前的帧可能还在读取旧缓存，旧缓存延迟销毁，缓存的指令引用的是旧缓存，全部失效*/
+	void EnsureSceneDrawBatchCapacity(FSceneDrawBatch& batch, size_t drawCount)
+	{
+		if (drawCount <= batch.Capacity) {
+			return;
+		}
+		size_t newCapacity = batch.Capacity;
+		while (newCapacity < drawCount) {
+			newCapacity *= 2;
+		}
+		if (newCapacity > UINT32_MAX) {
+			throw std::runtime_error("failed to grow scene draw batch, too many draws!");
+		}
+		std::cout << "[LOG]: Scene draw batch grown from " << batch.Capacity << " to " << newCapacity << " draws" << std::endl;
+		DeferBufferFree(batch.Buffer, batch.Memory);
+		CreateSceneDrawBatchBuffer(batch, static_cast<uint32_t>(newCapacity));
+		InvalidateCommandCache();
+	}
+
+	void DestroySceneDrawResources()
+	{
+		for (FSceneDrawBatch* batch : { &ShadowmapPass.DrawBatch, &BaseScenePass.DrawBatch, &BaseSceneDeferredPass.SceneDrawBatch })
+		{
+			vkDestroyBuffer(Device, batch->Buffer, nullptr);
+			MemoryAllocator.Free(batch->Memory);
+			*batch = FSceneDrawBatch{};
+		}
+		DestroyLightBuffer();
+		vkDestroyDescriptorPool(Device, DrawDataDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(Device, DrawDataDescriptorSetLayout, nullptr);
+		vkDestroyBuffer(Device, DrawDataBuffer, nullptr);
+		MemoryAllocator.Free(DrawDataBufferMemory);
+	}
+
+	/** 创建灯光存储缓存，每帧一段，容量按当前灯光数量向上取2的幂*/
+	void CreateLightBuffer()
+	{
+		LightCapacity = 16;
+		while (LightCapacity < SceneLights.Lights.size()) {
+			LightCapacity *= 2;
+		}
+		VkDeviceSize alignment = std::max<VkDeviceSize>(DeviceCaps.MinStorageBufferOffsetAlignment, 16);
+		LightFrameStride = (sizeof(FLight) * LightCapacity + alignment - 1) / alignment * alignment;
+		CreateBuffer(
+			LightFrameStride * MAX_FRAMES_IN_FLIGHT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			LightBuffer,
+			LightBufferMemory,
+			EMemoryAllocationStrategy::Linear);
+		// 新的存储缓存是空的，所有灯光都需要上传
+		SceneLights.MarkAllDirty();
+	}
+
+	/** 让这一帧的 DrawData 描述符集合指向当前的灯光存储缓存，只能在这一帧的Fence触发之后调用*/
+	void UpdateLightDescriptor(uint32_t frame)
+	{
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = LightBuffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(FLight) * LightCapacity;
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = DrawDataDescriptorSets[frame];
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(Device, 1, &descriptorWrite, 0, nullptr);
+		LightDescriptorBuffers[frame] = LightBuffer;
+	}
+
+	void DestroyLightBuffer()
+	{
+		vkDestroyBuffer(Device, LightBuffer, nullptr);
+		MemoryAllocator.Free(LightBufferMemory);
+		LightBuffer = VK_NULL_HANDLE;
+		LightCapacity = 0;
+		LightFrameStride = 0;
+	}
+
+	/** 把这一帧还没有上传的灯光修改写入这一帧的那一段灯光存储缓存*/
+	void UploadDirtyLights(const uint32_t currentFrame)
+	{
+		if (SceneLights.Lights.size() > LightCapacity) {
+			// 按两倍扩容，其它帧的描述符集合还指向旧缓存，旧缓存在这一帧的Fence触发之后销毁，那时其它帧都已经换到新缓存
+			uint32_t oldCapacity = LightCapacity;
+			DeferBufferFree(LightBuffer, LightBufferMemory);
+			CreateLightBuffer();
+			std::cout << "[LOG]: Light buffer grown from " << oldCapacity << " to " << LightCapacity << " lights per frame" << std::endl;
+			InvalidateCommandCache();
+		}
+		if (LightDescriptorBuffers[currentFrame] != LightBuffer) {
+			// 这一帧的Fence已经触发，描述符集合不再被GPU使用，其它帧轮到它们时再更新
+			UpdateLightDescriptor(currentFrame);
+		}
+
+		FLight* lights = reinterpret_cast<FLight*>(LightBufferMemory.Mapped + LightFrameStride * currentFrame);
+		const uint32_t frameBit = 1u << currentFrame;
+		for (size_t i = 0; i < SceneLights.Lights.size(); i++) {
+			if (SceneLights.DirtyFrames[i] & frameBit) {
+				lights[i] = SceneLights.Lights[i];
+				SceneLights.DirtyFrames[i] &= ~frameBit;
+			}
+		}
+	}
+
+	/** 给物体分配一条 DrawData，写入模型的反量化参数*/
+	uint32_t AllocateDrawData(const FMesh& mesh)
+	{
+		if (DrawDataCount >= MAX_SCENE_DRAW_DATA) {
+			throw std::runtime_error("failed to allocate scene draw data!");
+		}
+		static_assert(MAX_SCENE_DRAW_DATA <= UINT16_MAX + 1, "FInstanceData::InstanceDrawIndex is 16 bit");
+		uint32_t drawDataIndex = DrawDataCount++;
+		FMeshConstants* drawData = reinterpret_cast<FMeshConstants*>(DrawDataBufferMemory.Mapped);
+		drawData[drawDataIndex] = mesh.Dequantization;
+		return drawDataIndex;
+	}
+
+	/** 创建统一缓存区（UBO），每帧一个持久映射的统一缓存环，所有Pass的统一缓存都从环中分配*/
+	void CreateUniformBuffers()
+	{
+		UniformRings.resize(MAX_FRAMES_IN_FLIGHT);
+		FrameUniforms.resize(MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			// 统一缓存环所在的显存块是持久映射的，每帧直接写入，不需要 vkMapMemory
+			FUniformRing& ring = UniformRings[i];
+			ring.Size = UNIFORM_RING_SIZE;
+			ring.Alignment = std::max<VkDeviceSize>(DeviceCaps.MinUniformBufferOffsetAlignment, 16);
+			CreateBuffer(ring.Size,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				ring.Buffer,
+				ring.Memory);
+
+			// 动态偏移的数量由描述符集合中动态统一缓存的数量决定，偏移在每帧更新统一缓存时写入
+			FrameUniforms[i].Scene.Count = 2;
+			FrameUniforms[i].Shadow.Count = 1;
+			FrameUniforms[i].Lighting.Count = 1;
+		}
+
+		FLight Moonlight;
+		Moonlight.Position = glm::vec4(20.0f, 0.0f, 20.0f, 0.0);
+		Moonlight.Color = glm::vec4(0.0, 0.1, 0.6, 15.0);
+		Moonlight.Direction = glm::vec4(glm::normalize(glm::vec3(Moonlight.Position.x, Moonlight.Position.y, Moonlight.Position.z)), 0.0);
+		Moonlight.LightInfo = glm::vec4(0.0, 0.0, 0.0, 0.0);
+		SceneLights.Add(ELightType::Directional, Moonlight);
+		uint32_t PointLightNum = POINT_LIGHTS_NUM;
+		for (uint32_t i = 0; i < PointLightNum; i++)
+		{
+			FLight PointLight;
+			float radians = (((float)RandRange(0, 3600) / 10.0f));
+			float distance = (((float)RandRange(0, 500) / 100.0f)) + 1.0f;
+			float X = sin(glm::radians(radians)) * distance;
+			float Y = cos(glm::radians(radians)) * distance;
+			float Z = 1.0;
+			PointLight.Position = glm::vec4(glm::vec3(X, Y, Z), 0.0);
+			float R = (((float)RandRange(50, 75) / 100.0f));
+			float G = (((float)RandRange(25, 50) / 100.0f));
+			float B = 0.0;
+			PointLight.Color = glm::vec4(R, G, B, 10.0);
+			PointLight.Direction = glm::vec4(0.0, 0.0, 1.0, 1.5);
+			PointLight.LightInfo = glm::vec4(0.0, 0.0, 0.0, 0.0);
+			SceneLights.Add(ELightType::Point, PointLight);
+		}
+	}
+
+	void CreateBaseScenePass()
+	{
+		// 创建场景渲染流水线和着色器
+		uint32_t SpecConstantsCount = GlobalConstants.SpecConstantsCount;
+		CreateDescriptorSetLayout(BaseScenePass.DescriptorSetLayout, PBR_SAMPLER_NUMBER);
+		BaseScenePass.Pipelines.resize(SpecConstantsCount);
+		BaseScenePass.PipelinesInstanced.resize(SpecConstantsCount);
+		CreatePipelineLayout(BaseScenePass.PipelineLayout, BaseScenePass.DescriptorSetLayout, true);
+		CreateGraphicsPipelines(
+			BaseScenePass.Pipelines,
+			BaseScenePass.PipelineLayout, 
+			MainRenderPass,
+			SpecConstantsCount,
+			"Resources/Shaders/draw_with_deferred_base_vert.spv",
+			"Resources/Shaders/draw_with_deferred_base_frag.spv",
+			true/*bDepthTest*/, true/*bCullBack*/, false/*bInstanced*/);
+		CreateGraphicsPipelines(
+			BaseScenePass.PipelinesInstanced,
+			BaseScenePass.PipelineLayout,
+			MainRenderPass,
+			SpecConstantsCount,
+			"Resources/Shaders/draw_with_deferred_base_instanced_vert.spv",
+			"Resources/Shaders/draw_with_deferred_base_frag.spv",
+			true/*bDepthTest*/, true/*bCullBack*/, true/*bInstanced*/);
+		BaseScenePass.PipelinesCompact.resize(SpecConstantsCount);
+		BaseScenePass.PipelinesInstancedCompact.resize(SpecConstantsCount);
+		CreateGraphicsPipelines(
+			BaseScenePass.PipelinesCompact,
+			BaseScenePass.PipelineLayout,
+			MainRenderPass,
+			SpecConstantsCount,
+			"Resources/Shaders/draw_with_deferred_base_compact_vert.spv",
+			"Resources/Shaders/draw_with_deferred_base_frag.spv",
+			true/*bDepthTest*/, true/*bCullBack*/, false/*bInstanced*/, EVertexFormat::Compact);
+		CreateGraphicsPipelines(
+			BaseScenePass.PipelinesInstancedCompact,
+			BaseScenePass.PipelineLayout,
+			MainRenderPass,
+			SpecConstantsCount,
+			"Resources/Shaders/draw_with_deferred_base_instanced_compact_vert.spv",
+			"Resources/Shaders/draw_with_deferred_base_frag.spv",
+			true/*bDepthTest*/, true/*bCullBack*/, true/*bInstanced*/, EVertexFormat::Compact);
+
+#if !ENABLE_DEFEERED_RENDERING
+		CreateBaseSceneResources();
+#endif
+		//~ 结束 创建场景，包括VBO，UBO，贴图等
+	}
+
+	void CreateBaseSceneIndirectPass()
+	{
+		// 创建场景渲染流水线和着色器
+		CreateDescriptorSetLayout(BaseSceneIndirectPass.DescriptorSetLayout, PBR_SAMPLER_NUMBER);
+		uint32_t SpecConstantsCount = GlobalConstants.SpecConstantsCount;
+		BaseSceneIndirectPass.Pipelines.resize(SpecConstantsCount);
+		BaseSceneIndirectPass.PipelinesInstanced.resize(SpecConstantsCount);
+		CreatePipelineLayout(BaseSceneIndirectPass.PipelineLayout, BaseSceneIndirectPass.DescriptorSetLayout, true);
+		CreateGraphicsPipelines(
+			BaseSceneIndirectPass.Pipelines,
+			BaseSceneIndirectPass.PipelineLayout,
+			MainRenderPass,
+			SpecConstantsCount,
+			"Resources/Shaders/draw_with_deferred_base_vert.spv",
+			"Resources/Shaders/draw_with_deferred_base_frag.spv",
+			true/*bDepthTest*/, true/*bCullBack*/, false/*bInstanced*/);
+		CreateGraphicsPipelines(
+			BaseSceneIndirectPass.PipelinesInstanced,
+			BaseSceneIndirectPass.PipelineLayout,
+			MainRenderPass,
+			SpecConstantsCount,
+			"Resources/Shaders/draw_with_deferred_base_instanced_vert.spv",
+			"Resources/Shaders/draw_with_deferred_base_frag.spv",
+			true/*bDepthTest*/, true/*bCullBack*/, true/*bInstanced*/);
+
+		if (ENABLE_INDIRECT_DRAW)
+		{
+			BeginUploadBatch();
+
+			FRenderIndirectObject cube;
+			std::string cube_obj = "Resources/Models/cube.obj";
+			std::vector<std::string> cube_imgs = {
+				"Resources/Textures/default_grey.png",		// BaseColor
+				"Resources/Textures/default_orm.png",		// AmbientOcclution + Roughness + Metallic + Mask
+				"Resources/Textures/default_normal.png",	// Normal
+				"Resources/Textures/default_black.png" };	// Emissive
+			CreateRenderObject<FRenderIndirectObject>(cube, cube_obj, cube_imgs, BaseSceneIndirectPass.DescriptorSetLayout);
+
+			// 每个簇一条命令，顺序和 Actors[0].Clusters 一致，剔除时按下标对应
+			cube.IndirectCommands.clear();
+			for (const FCluster& cluster : cube.MeshData.Actors[0].Clusters)
+			{
+				VkDrawIndexedIndirectCommand indirectCmd{};
+				indirectCmd.indexCount = cluster.IndexCount; /*indexCount*/
+				indirectCmd.instanceCount = 1; /*instanceCount*/
+				indirectCmd.firstIndex = cube.MeshData.FirstIndex + cluster.FirstIndex; /*firstIndex*/
+				indirectCmd.vertexOffset = cube.MeshData.VertexOffset; /*vertexOffset*/
+				indirectCmd.firstInstance = 0; /*firstInstance*/
+				cube.IndirectCommands.push_back(indirectCmd);
+			}
+
+			CreateRenderIndirectBuffer<FRenderIndirectObject>(cube);
+			SceneRegistry.IndirectObjects.Add(std::move(cube), ScenePassBit(EScenePass::Shadow) | ScenePassBit(EScenePass::Indirect));
+
+			FRenderIndirectInstancedObject cube_inst;
+			std::string cube_inst_obj = "Resources/Models/cube.obj";
+			std::vector<std::string> cube_inst_imgs = {
+				"Resources/Textures/default_grey.png",		// BaseColor
+				"Resources/Textures/default_orm.png",		// AmbientOcclution + Roughness + Metallic + Mask
+				"Resources/Textures/default_normal.png",	// Normal
+				"Resources/Textures/default_black.png" };	// Emissive
+			CreateRenderObject<FRenderIndirectInstancedObject>(cube_inst, cube_inst_obj, cube_inst_imgs, BaseSceneIndirectPass.DescriptorSetLayout);
+
+			cube_inst.IndirectCommands.clear();
+
+			std::vector<FInstanceData> instanceData;
+			instanceData.resize(INSTANCE_COUNT);
+
+			for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+				VkDrawIndexedIndirectCommand indirectCmd{};
+				indirectCmd.indexCount = cube_inst.MeshData.IndexCount; /*indexCount*/
+				indirectCmd.instanceCount = INSTANCE_COUNT; /*instanceCount*/
+				indirectCmd.firstIndex = cube_inst.MeshData.FirstIndex; /*firstIndex*/
+				indirectCmd.vertexOffset = cube_inst.MeshData.VertexOffset; /*vertexOffset*/
+				indirectCmd.firstInstance = 0; /*firstInstance*/
+
+				cube_inst.IndirectCommands.push_back(indirectCmd);
+
+				float X = (((float)RandRange(-199, 199) / 100.0f));
+				float Y = (((float)RandRange(-199, 199) / 100.0f));
+				float Z = RandRange(0, 99) / 250.0f;
+				instanceData[i].InstancePosition = glm::vec3(X, Y, Z);
+				// Y(Pitch), Z(Yaw), X(Roll)
+				float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
+				float Pitch = float(M_PI) * RandRange(0, 99) / 100.0f;
+				float Roll = float(M_PI) * RandRange(0, 99) / 100.0f;
+				instanceData[i].InstanceRotation = glm::vec3(Pitch, Yaw, Roll);
+				instanceData[i].InstancePScale = RandRange(0, 99) / 500.0f;
+				instanceData[i].InstanceTexIndex = RandRange(0, 99);
+			}
+			CreateInstancedBuffer<FRenderIndirectInstancedObject>(cube_inst, instanceData);
+			CreateRenderIndirectBuffer<FRenderIndirectInstancedObject>(cube_inst);
+			SceneRegistry.IndirectInstancedObjects.Add(std::move(cube_inst), ScenePassBit(EScenePass::Shadow) | ScenePassBit(EScenePass::Indirect));
+
+			SubmitUploadBatch();
+		}
+	}
+
+	/** 创建GBuffer, 用于延迟渲染*/
+	void CreateBaseSceneDeferredPass()
+	{
+		auto CreateGraphicsPipelinesDeferred = [this](
+			std::vector<VkPipeline>& outPipelines,
+			const VkPipelineLayout& inPipelineLayout,
+			const VkRenderPass& inRenderPass,
+			const uint32_t inSpecConstantsCount,
+			const EVertexType VertexType,
+			const  EGraphicPipelineType GraphicPipelineType,
+			const std::string& inVertFilename,
+			const std::string& inFragFilename,
+			const EVertexFormat inVertexFormat = EVertexFormat::Full)
+		{
+			auto vertShaderCode = LoadShaderSource(inVertFilename);
+			auto fragShaderCode = LoadShaderSource(inFragFilename);
+
+			VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
+			VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+
+			VkPipelineShaderStageCreateInfo vertShaderStageCI{};
+			vertShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			vertShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
+			vertShaderStageCI.module = vertShaderModule;
+			vertShaderStageCI.pName = "main";
+
+			VkPipelineShaderStageCreateInfo fragShaderStageCI{};
+			fragShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			fragShaderStageCI.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			fragShaderStageCI.module = fragShaderModule;
+			fragShaderStageCI.pName = "main";
+
+			VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCI, fragShaderStageCI };
+
+			// 顶点缓存绑定的描述，定义了顶点都需要绑定什么数据，比如第一个位置绑定Position，第二个位置绑定Color，第三个位置绑定UV等
+			std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+			GetVertexInputDescriptions(inVertexFormat, VertexType == Instanced, bindingDescriptions, attributeDescriptions);
+
+			// 渲染管线VertexBuffer输入
+			VkPipelineVertexInputStateCreateInfo vertexInputCI{};
+			switch (VertexType)
+			{
+			case VertexIndexed:
+			case Instanced:
+			{
+				vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+				vertexInputCI.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+				vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+				vertexInputCI.pVertexBindingDescriptions = bindingDescriptions.data();
+				vertexInputCI.pVertexAttributeDescriptions = attributeDescriptions.data();
+				break;
+			}
+			case ScreenRect:
+			{
+				vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+				vertexInputCI.vertexBindingDescriptionCount = 0;
+				vertexInputCI.vertexAttributeDescriptionCount = 0;
+			}
+			default:
+				break;
+			}
+
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyCI{};
+			inputAssemblyCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+			inputAssemblyCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			inputAssemblyCI.primitiveRestartEnable = VK_FALSE;
+
+			VkPipelineViewportStateCreateInfo viewportStateCI{};
+			viewportStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			viewportStateCI.viewportCount = 1;
+			viewportStateCI.scissorCount = 1;
+
+			VkPipelineRasterizationStateCreateInfo rasterizerCI{};
+			rasterizerCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+			rasterizerCI.depthClampEnable = VK_FALSE;
+			rasterizerCI.rasterizerDiscardEnable = VK_FALSE;
+			rasterizerCI.polygonMode = VK_POLYGON_MODE_FILL;
+			rasterizerCI.lineWidth = 1.0f;
+			// @NOTE: hard-coded for foliage single face render
+			rasterizerCI.cullMode = VK_CULL_MODE_NONE;
+			rasterizerCI.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+			rasterizerCI.depthBiasEnable = VK_FALSE;
+
+			VkPipelineMultisampleStateCreateInfo multiSamplingCI{};
+			multiSamplingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+			multiSamplingCI.sampleShadingEnable = VK_FALSE;
+			multiSamplingCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-		//////////////////////////////////////////////////////////
-		// 创建 DescriptorSets
-		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, ShadowmapPass.DescriptorSetLayout);
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = ShadowmapPass.DescriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		allocInfo.pSetLayouts = layouts.data();
-		ShadowmapPass.DescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-		if (vkAllocateDescriptorSets(Device, &allocInfo, ShadowmapPass.DescriptorSets.data()) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate descriptor sets!");
-		}
+			// 打开深度测试
+			VkPipelineDepthStencilStateCreateInfo depthStencilCI{};
+			depthStencilCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+			depthStencilCI.depthTestEnable = (VertexType != ScreenRect) ? VK_TRUE : VK_FALSE;
+			depthStencilCI.depthWriteEnable = (VertexType != ScreenRect) ? VK_TRUE : VK_FALSE;
+			depthStencilCI.depthCompareOp = VK_COMPARE_OP_LESS;
+			depthStencilCI.depthBoundsTestEnable = VK_FALSE;
+			depthStencilCI.minDepthBounds = 0.0f; // Optional
+			depthStencilCI.maxDepthBounds = 1.0f; // Optional
+			depthStencilCI.stencilTestEnable = VK_FALSE; // 没有写轮廓信息，所以跳过轮廓测试
+			depthStencilCI.front = {}; // Optional
+			depthStencilCI.back = {}; // Optional
 
-		//////////////////////////////////////////////////////////
-		// 绑定 DescriptorSets
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			std::vector<VkWriteDescriptorSet> descriptorWrites{};
-			descriptorWrites.resize(1);
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = ShadowmapPass.UniformBuffers[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(FUniformBufferBase);
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = ShadowmapPass.DescriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &bufferInfo;
-			vkUpdateDescriptorSets(Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-		}
+			VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+			colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+			colorBlendAttachment.blendEnable = VK_FALSE;
 
-		VkAttachmentDescription attachmentDescription{};
-		attachmentDescription.format = ShadowmapPass.Format;
-		attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-		// Clear depth at beginning of the render pass
-		attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		// We will read from depth, so it's important to store the depth attachment results
-		attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		// We don't care about initial layout of the attachment
-		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		// Attachment will be transitioned to shader read at render pass end
-		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			VkPipelineColorBlendStateCreateInfo colorBlendingCI{};
+			colorBlendingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			colorBlendingCI.logicOpEnable = VK_FALSE;
+			colorBlendingCI.logicOp = VK_LOGIC_OP_COPY;
+			colorBlendingCI.blendConstants[0] = 0.0f;
+			colorBlendingCI.blendConstants[1] = 0.0f;
+			colorBlendingCI.blendConstants[2] = 0.0f;
+			colorBlendingCI.blendConstants[3] = 0.0f;
+			switch (GraphicPipelineType)
+			{
+			case Forward:
+			{
+				colorBlendingCI.attachmentCount = 1;
+				colorBlendingCI.pAttachments = &colorBlendAttachment;
+				break;
+			}
+			case DeferredScene:
+			{
+				std::array<VkPipelineColorBlendAttachmentState, 5> colorBlendAttachments;
+				colorBlendAttachments[0] = colorBlendAttachment;
+				colorBlendAttachments[1] = colorBlendAttachment;
+				colorBlendAttachments[2] = colorBlendAttachment;
+				colorBlendAttachments[3] = colorBlendAttachment;
+				colorBlendAttachments[4] = colorBlendAttachment;
+				colorBlendingCI.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+				colorBlendingCI.pAttachments = colorBlendAttachments.data();
+				break;
+			}
+			case DeferredLighting:
+			{
+				colorBlendingCI.attachmentCount = 1;
+				colorBlendingCI.pAttachments = &colorBlendAttachment;
+				break;
+			}
+			default:
+				break;
+			}
 
-		VkAttachmentReference depthReference = {};
-		depthReference.attachment = 0;
-		// Attachment will be used as depth/stencil during render pass
-		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			std::vector<VkDynamicState> dynamicStates = {
+				VK_DYNAMIC_STATE_VIEWPORT,
+				VK_DYNAMIC_STATE_SCISSOR
+			};
+			VkPipelineDynamicStateCreateInfo dynamicStateCI{};
+			dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+			dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+			dynamicStateCI.pDynamicStates = dynamicStates.data();
+
+			VkGraphicsPipelineCreateInfo pipelineCI{};
+			pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineCI.stageCount = 2;
+			pipelineCI.pStages = shaderStages;
+			pipelineCI.pVertexInputState = &vertexInputCI;
+			pipelineCI.pInputAssemblyState = &inputAssemblyCI;
+			pipelineCI.pViewportState = &viewportStateCI;
+			pipelineCI.pRasterizationState = &rasterizerCI;
+			pipelineCI.pMultisampleState = &multiSamplingCI;
+			pipelineCI.pDepthStencilState = &depthStencilCI; // 加上深度测试
+			pipelineCI.pColorBlendState = &colorBlendingCI;
+			pipelineCI.pDynamicState = &dynamicStateCI;
+			pipelineCI.layout = inPipelineLayout;
+			pipelineCI.renderPass = inRenderPass;
+			pipelineCI.subpass = 0;
+			pipelineCI.basePipelineHandle = VK_NULL_HANDLE;
+
+			// Use specialization constants 优化着色器变体
+			for (uint32_t i = 0; i < inSpecConstantsCount; i++)
+			{
+				uint32_t SpecConstants = i;
+				VkSpecializationMapEntry specializationMapEntry = VkSpecializationMapEntry{};
+				specializationMapEntry.constantID = 0;
+				specializationMapEntry.offset = 0;
+				specializationMapEntry.size = sizeof(uint32_t);
+				VkSpecializationInfo specializationCI = VkSpecializationInfo();
+				specializationCI.mapEntryCount = 1;
+				specializationCI.pMapEntries = &specializationMapEntry;
+				specializationCI.dataSize = sizeof(uint32_t);
+				specializationCI.pData = &SpecConstants;
+				shaderStages[1].pSpecializationInfo = &specializationCI;
+
+				if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &outPipelines[i]) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to Create graphics pipeline!");
+				}
+			}
+
+			vkDestroyShaderModule(Device, fragShaderModule, nullptr);
+			vkDestroyShaderModule(Device, vertShaderModule, nullptr);
+		};
+
+		// Depth Stencil (Currently depth-only)
+		GBuffer.DepthStencilFormat = VK_FORMAT_D32_SFLOAT;
+		CreateImage(GBuffer.DepthStencilImage, GBuffer.DepthStencilMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.DepthStencilFormat,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(GBuffer.DepthStencilImageView, GBuffer.DepthStencilImage, GBuffer.DepthStencilFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+		CreateSampler(GBuffer.DepthStencilSampler);
+
+		// Scene Color
+		GBuffer.SceneColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		CreateImage(GBuffer.SceneColorImage, GBuffer.SceneColorMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.SceneColorFormat,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(GBuffer.SceneColorImageView, GBuffer.SceneColorImage, GBuffer.SceneColorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		CreateSampler(GBuffer.SceneColorSampler);
+
+		// GBufferA Normal+(CastShadow+Masked)
+		GBuffer.GBufferAFormat = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
+		CreateImage(GBuffer.GBufferAImage, GBuffer.GBufferAMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferAFormat,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(GBuffer.GBufferAImageView, GBuffer.GBufferAImage, GBuffer.GBufferAFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		CreateSampler(GBuffer.GBufferASampler);
+
+		// GBufferB M+S+R+(ShadingModelID+SelectiveOutputMask) for unreal
+		// GBufferB M+S+R+(OpacityMask) for me
+		GBuffer.GBufferBFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		CreateImage(GBuffer.GBufferBImage, GBuffer.GBufferBMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferBFormat,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(GBuffer.GBufferBImageView, GBuffer.GBufferBImage, GBuffer.GBufferBFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		CreateSampler(GBuffer.GBufferBSampler);
+
+		// GBufferC BaseColor + AO
+		GBuffer.GBufferCFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		CreateImage(GBuffer.GBufferCImage, GBuffer.GBufferCMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferCFormat,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(GBuffer.GBufferCImageView, GBuffer.GBufferCImage, GBuffer.GBufferCFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		CreateSampler(GBuffer.GBufferCSampler);
+
+		// GBufferD Position + ID
+		GBuffer.GBufferDFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		CreateImage(GBuffer.GBufferDImage, GBuffer.GBufferDMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferDFormat,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CreateImageView(GBuffer.GBufferDImageView, GBuffer.GBufferDImage, GBuffer.GBufferDFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		CreateSampler(GBuffer.GBufferDSampler);
+
+		VkAttachmentDescription DepthAttachment{};
+		DepthAttachment.format = FindDepthFormat();
+		DepthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		DepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		DepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		VkAttachmentDescription ColorAttachment{};
+		ColorAttachment.format = SwapChainImageFormat;
+		ColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		ColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		ColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		ColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		ColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		ColorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		std::array<VkAttachmentDescription, 6> AttachmentDescriptions = {};
+		AttachmentDescriptions[0] = DepthAttachment;
+		AttachmentDescriptions[1] = ColorAttachment;
+		AttachmentDescriptions[2] = ColorAttachment;
+		AttachmentDescriptions[3] = ColorAttachment;
+		AttachmentDescriptions[4] = ColorAttachment;
+		AttachmentDescriptions[5] = ColorAttachment;
+		AttachmentDescriptions[0].format = GBuffer.DepthStencilFormat;
+		AttachmentDescriptions[1].format = GBuffer.SceneColorFormat;
+		AttachmentDescriptions[2].format = GBuffer.GBufferAFormat;
+		AttachmentDescriptions[3].format = GBuffer.GBufferBFormat;
+		AttachmentDescriptions[4].format = GBuffer.GBufferCFormat;
+		AttachmentDescriptions[5].format = GBuffer.GBufferDFormat;
+
+		VkAttachmentReference DepthAttachmentRef = {};
+		DepthAttachmentRef.attachment = 0;
+		DepthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		std::vector<VkAttachmentReference> ColorAttachmentRefs;
+		ColorAttachmentRefs.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		ColorAttachmentRefs.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		ColorAttachmentRefs.push_back({ 3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		ColorAttachmentRefs.push_back({ 4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		ColorAttachmentRefs.push_back({ 5, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
 
-		VkSubpassDescription subpass = {};
+		VkSubpassDescription subpass{};
 		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		// No color attachments
-		subpass.colorAttachmentCount = 0;
-		// Reference to our depth attachment
-		subpass.pDepthStencilAttachment = &depthReference;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(ColorAttachmentRefs.size());
+		subpass.pColorAttachments = ColorAttachmentRefs.data();
+		subpass.pDepthStencilAttachment = &DepthAttachmentRef;
 
-		// Use subpass dependencies for layout transitions
 		std::array<VkSubpassDependency, 2> dependencies;
-
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
-		VkRenderPassCreateInfo renderPassCreateInfo{};
-		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassCreateInfo.attachmentCount = 1;
-		renderPassCreateInfo.pAttachments = &attachmentDescription;
-		renderPassCreateInfo.subpassCount = 1;
-		renderPassCreateInfo.pSubpasses = &subpass;
-		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());;
-		renderPassCreateInfo.pDependencies = dependencies.data();
+		VkRenderPassCreateInfo renderPassCI = {};
+		renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCI.attachmentCount = static_cast<uint32_t>(AttachmentDescriptions.size());
+		renderPassCI.pAttachments = AttachmentDescriptions.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpass;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
 
-		if (vkCreateRenderPass(Device, &renderPassCreateInfo, nullptr, &ShadowmapPass.RenderPass)) {
-			throw std::runtime_error("failed to Create shadow map render pass!");
+		if (vkCreateRenderPass(Device, &renderPassCI, nullptr, &BaseSceneDeferredPass.SceneRenderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create render pass!");
 		}
 
-		// Create frame buffer
-		VkFramebufferCreateInfo frameBufferCreateInfo{};
-		frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		frameBufferCreateInfo.renderPass = ShadowmapPass.RenderPass;
-		frameBufferCreateInfo.attachmentCount = 1;
-		frameBufferCreateInfo.pAttachments = &ShadowmapPass.ImageView;
-		frameBufferCreateInfo.width = ShadowmapPass.Width;
-		frameBufferCreateInfo.height = ShadowmapPass.Height;
-		frameBufferCreateInfo.layers = 1;
+		std::array<VkImageView, 6> attachments =
+		{
+			GBuffer.DepthStencilImageView,
+			GBuffer.SceneColorImageView,
+			GBuffer.GBufferAImageView,
+			GBuffer.GBufferBImageView,
+			GBuffer.GBufferCImageView,
+			GBuffer.GBufferDImageView,
+		};
 
-		if (vkCreateFramebuffer(Device, &frameBufferCreateInfo, nullptr, &ShadowmapPass.FrameBuffer)) {
-			throw std::runtime_error("failed to Create shadow map frame buffer!");
-		}
+		VkFramebufferCreateInfo frameBufferCI{};
+		frameBufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferCI.renderPass = BaseSceneDeferredPass.SceneRenderPass;
+		frameBufferCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		frameBufferCI.pAttachments = attachments.data();
+		frameBufferCI.width = SwapChainExtent.width;
+		frameBufferCI.height = SwapChainExtent.height;
+		frameBufferCI.layers = 1;
 
-		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI{};
-		inputAssemblyStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssemblyStateCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssemblyStateCI.primitiveRestartEnable = VK_FALSE;
-		VkPipelineRasterizationStateCreateInfo rasterizationStateCI{};
-		rasterizationStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizationStateCI.depthClampEnable = VK_FALSE;
-		rasterizationStateCI.rasterizerDiscardEnable = VK_FALSE;
-		rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizationStateCI.lineWidth = 1.0f;
-		rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT /*VK_CULL_MODE_BACK_BIT*/;
-		rasterizationStateCI.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizationStateCI.depthBiasEnable = VK_FALSE;
-		VkPipelineColorBlendAttachmentState blendAttachmentState{};
-		blendAttachmentState.colorWriteMask = 0xf;
-		blendAttachmentState.blendEnable = VK_FALSE;
-		VkPipelineColorBlendStateCreateInfo colorBlendStateCI{};
-		colorBlendStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlendStateCI.logicOpEnable = VK_FALSE;
-		colorBlendStateCI.logicOp = VK_LOGIC_OP_COPY;
-		colorBlendStateCI.attachmentCount = 1;
-		colorBlendStateCI.pAttachments = &blendAttachmentState;
-		colorBlendStateCI.blendConstants[0] = 0.0f;
-		colorBlendStateCI.blendConstants[1] = 0.0f;
-		colorBlendStateCI.blendConstants[2] = 0.0f;
-		colorBlendStateCI.blendConstants[3] = 0.0f;
-		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI{};
-		depthStencilStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencilStateCI.depthTestEnable = VK_TRUE;
-		depthStencilStateCI.depthWriteEnable = VK_TRUE;
-		depthStencilStateCI.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		depthStencilStateCI.depthBoundsTestEnable = VK_FALSE;
-		depthStencilStateCI.minDepthBounds = 0.0f; // Optional
-		depthStencilStateCI.maxDepthBounds = 1.0f; // Optional
-		depthStencilStateCI.stencilTestEnable = VK_FALSE; // 没有写轮廓信息，所以跳过轮廓测试
-		depthStencilStateCI.front = {}; // Optional
-		depthStencilStateCI.back = {}; // Optional
-		VkPipelineViewportStateCreateInfo viewportStateCI{};
-		viewportStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportStateCI.viewportCount = 1;
-		viewportStateCI.scissorCount = 1;
-		VkPipelineMultisampleStateCreateInfo multisampleStateCI{};
-		multisampleStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampleStateCI.sampleShadingEnable = VK_FALSE;
-		multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-		VkPipelineDynamicStateCreateInfo dynamicStateCI{};
-		dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-		dynamicStateCI.pDynamicStates = dynamicStateEnables.data();
+		if (vkCreateFramebuffer(Device, &frameBufferCI, nullptr, &BaseSceneDeferredPass.SceneFrameBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to Create framebuffer!");
+		}
 
-		auto vertShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_vert.spv");
-		auto fragShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_frag.spv");
-		VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
-		VkPipelineShaderStageCreateInfo vertShaderStageCI{};
-		vertShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageCI.module = vertShaderModule;
-		vertShaderStageCI.pName = "main";
-		VkPipelineShaderStageCreateInfo fragShaderStageCI{};
-		fragShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageCI.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageCI.module = fragShaderModule;
-		fragShaderStageCI.pName = "main";
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCI, fragShaderStageCI };
+		CreateDescriptorSetLayout(BaseSceneDeferredPass.SceneDescriptorSetLayout, PBR_SAMPLER_NUMBER);
+		BaseSceneDeferredPass.ScenePipelines.resize(GlobalConstants.SpecConstantsCount);
+		BaseSceneDeferredPass.ScenePipelinesInstanced.resize(GlobalConstants.SpecConstantsCount);
+		CreatePipelineLayout(BaseSceneDeferredPass.ScenePipelineLayout, BaseSceneDeferredPass.SceneDescriptorSetLayout, true);
+		CreateGraphicsPipelinesDeferred(
+			BaseSceneDeferredPass.ScenePipelines,
+			BaseSceneDeferredPass.ScenePipelineLayout,
+			BaseSceneDeferredPass.SceneRenderPass,
+			GlobalConstants.SpecConstantsCount, VertexIndexed, DeferredScene,
+			"Resources/Shaders/draw_with_deferred_base_vert.spv",
+			"Resources/Shaders/draw_with_deferred_scene_frag.spv");
+		CreateGraphicsPipelinesDeferred(
+			BaseSceneDeferredPass.ScenePipelinesInstanced,
+			BaseSceneDeferredPass.ScenePipelineLayout,
+			BaseSceneDeferredPass.SceneRenderPass,
+			GlobalConstants.SpecConstantsCount, Instanced, DeferredScene,
+			"Resources/Shaders/draw_with_deferred_base_instanced_vert.spv",
+			"Resources/Shaders/draw_with_deferred_scene_frag.spv");
+		BaseSceneDeferredPass.ScenePipelinesCompact.resize(GlobalConstants.SpecConstantsCount);
+		BaseSceneDeferredPass.ScenePipelinesInstancedCompact.resize(GlobalConstants.SpecConstantsCount);
+		CreateGraphicsPipelinesDeferred(
+			BaseSceneDeferredPass.ScenePipelinesCompact,
+			BaseSceneDeferredPass.ScenePipelineLayout,
+			BaseSceneDeferredPass.SceneRenderPass,
+			GlobalConstants.SpecConstantsCount, VertexIndexed, DeferredScene,
+			"Resources/Shaders/draw_with_deferred_base_compact_vert.spv",
+			"Resources/Shaders/draw_with_deferred_scene_frag.spv",
+			EVertexFormat::Compact);
+		CreateGraphicsPipelinesDeferred(
+			BaseSceneDeferredPass.ScenePipelinesInstancedCompact,
+			BaseSceneDeferredPass.ScenePipelineLayout,
+			BaseSceneDeferredPass.SceneRenderPass,
+			GlobalConstants.SpecConstantsCount, Instanced, DeferredScene,
+			"Resources/Shaders/draw_with_deferred_base_instanced_compact_vert.spv",
+			"Resources/Shaders/draw_with_deferred_scene_frag.spv",
+			EVertexFormat::Compact);
 
-		VkPipelineVertexInputStateCreateInfo vertexInputCI{};
-		auto bindingDescription = FVertex::GetBindingDescription();
-		auto attributeDescriptions = FVertex::GetAttributeDescriptions();
-		vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputCI.vertexBindingDescriptionCount = 1;
-		vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputCI.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputCI.pVertexAttributeDescriptions = attributeDescriptions.data();
+		/** Create DescriptorSetLayout for Lighting*/
+		// UnifromBufferObject（ubo）绑定
+		VkDescriptorSetLayoutBinding viewLayoutBinding{};
+		viewLayoutBinding.binding = 0;
+		viewLayoutBinding.descriptorCount = 1;
+		viewLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		viewLayoutBinding.pImmutableSamplers = nullptr;
+		viewLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-		// 设置 push constants
-		VkPushConstantRange pushConstant;
-		pushConstant.offset = 0;
-		pushConstant.size = sizeof(FGlobalConstants);
-		pushConstant.stageFlags = VK_SHADER_STAGE_ALL;
+		// 环境反射Cubemap贴图绑定
+		VkDescriptorSetLayoutBinding cubemapLayoutBinding{};
+		cubemapLayoutBinding.binding = 1;
+		cubemapLayoutBinding.descriptorCount = 1;
+		cubemapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		cubemapLayoutBinding.pImmutableSamplers = nullptr;
+		cubemapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-		VkPipelineLayoutCreateInfo pipelineLayoutCI{};
-		pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutCI.setLayoutCount = 1;
-		pipelineLayoutCI.pSetLayouts = &ShadowmapPass.DescriptorSetLayout;
-		pipelineLayoutCI.pushConstantRangeCount = 1;
-		pipelineLayoutCI.pPushConstantRanges = &pushConstant;
+		// 阴影Shadowmap贴图绑定
+		VkDescriptorSetLayoutBinding shadowmapLayoutBinding{};
+		shadowmapLayoutBinding.binding = 2;
+		shadowmapLayoutBinding.descriptorCount = 1;
+		shadowmapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		shadowmapLayoutBinding.pImmutableSamplers = nullptr;
+		shadowmapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-		if (vkCreatePipelineLayout(Device, &pipelineLayoutCI, nullptr, &ShadowmapPass.PipelineLayout) != VK_SUCCESS)
+		// 将UnifromBufferObject和贴图采样器绑定到DescriptorSetLayout上
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		bindings.resize(9);
+		bindings[0] = viewLayoutBinding;
+		bindings[1] = cubemapLayoutBinding;
+		bindings[2] = shadowmapLayoutBinding;
+		for (size_t i = 0; i < 6; i++)
 		{
-			throw std::runtime_error("failed to Create pipeline layout!");
-		}
-
-		VkGraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineCI.stageCount = 2;
-		pipelineCI.pStages = shaderStages;
-		pipelineCI.pVertexInputState = &vertexInputCI;
-		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
-		pipelineCI.pViewportState = &viewportStateCI;
-		pipelineCI.pRasterizationState = &rasterizationStateCI;
-		pipelineCI.pMultisampleState = &multisampleStateCI;
-		pipelineCI.pDepthStencilState = &depthStencilStateCI; // 加上深度测试
-		pipelineCI.pColorBlendState = &colorBlendStateCI;
-		pipelineCI.pDynamicState = &dynamicStateCI;
-		pipelineCI.layout = ShadowmapPass.PipelineLayout;
-		pipelineCI.renderPass = ShadowmapPass.RenderPass;
-		pipelineCI.subpass = 0;
-		pipelineCI.basePipelineHandle = VK_NULL_HANDLE;
-
-		// Offscreen pipeline (vertex shader only)
-		//shaderStages[0] = loadShader(getShadersPath() + "shadowmapping/offscreen.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		pipelineCI.stageCount = 1;
-		// No blend attachment states (no color attachments used)
-		colorBlendStateCI.attachmentCount = 0;
-		// Disable culling, so all faces contribute to shadows
-		rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
-		depthStencilStateCI.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-		// Enable depth bias
-		rasterizationStateCI.depthBiasEnable = VK_TRUE;
-		// Add depth bias to dynamic state, so we can change it at runtime
-		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
-		dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-		dynamicStateCI.pDynamicStates = dynamicStateEnables.data();
-
-		pipelineCI.renderPass = ShadowmapPass.RenderPass;
+			VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+			samplerLayoutBinding.binding = static_cast<uint32_t>(i + 3);
+			samplerLayoutBinding.descriptorCount = 1;
+			samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			samplerLayoutBinding.pImmutableSamplers = nullptr;
+			samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-		if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &ShadowmapPass.Pipeline) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to Create graphics pipeline!");
+			bindings[i + 3] = samplerLayoutBinding;
+		}
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &BaseSceneDeferredPass.LightingDescriptorSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create descriptor set layout!");
 		}
 
-		// Create vertex instanced pipeline
-		auto vertInstancedShaderCode = LoadShaderSource("Resources/Shaders/draw_with_deferred_sm_instanced_vert.spv");
-		VkShaderModule vertInstancedShaderModule = CreateShaderModule(vertInstancedShaderCode);
-		VkPipelineShaderStageCreateInfo vertInstancedShaderStageCI{};
-		vertInstancedShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertInstancedShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertInstancedShaderStageCI.module = vertInstancedShaderModule;
-		vertInstancedShaderStageCI.pName = "main";
-		auto bindingInstancedDescriptions = FVertex::GetBindingInstancedDescriptions();
-		auto attributeInstancedDescriptions = FVertex::GetAttributeInstancedDescriptions();
-		vertexInputCI.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingInstancedDescriptions.size());
-		vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeInstancedDescriptions.size());
-		vertexInputCI.pVertexBindingDescriptions = bindingInstancedDescriptions.data();
-		vertexInputCI.pVertexAttributeDescriptions = attributeInstancedDescriptions.data();
-		pipelineCI.pVertexInputState = &vertexInputCI;
-		shaderStages[0] = vertInstancedShaderStageCI;
-		pipelineCI.pStages = shaderStages;
-		if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &ShadowmapPass.PipelineInstanced) != VK_SUCCESS)
+		/** Create DescriptorPool for Lighting*/
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		poolSizes.resize(9);
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < 6; i++)
 		{
-			throw std::runtime_error("failed to Create graphics pipeline!");
+			poolSizes[i + 3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			poolSizes[i + 3].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 		}
 
-		vkDestroyShaderModule(Device, fragShaderModule, nullptr);
-		vkDestroyShaderModule(Device, vertShaderModule, nullptr);
-		vkDestroyShaderModule(Device, vertInstancedShaderModule, nullptr);
-	}
-
-	/** Cube map Faces Rules:
-	 *       Y3
-	 *       ||
-	 * X1 == Z4 == X0 == Z5
-	 *       ||
-	 *       Y4
-	 * | https://matheowis.github.io/HDRI-to-CubeMap/    |
-	 * | X0(p-x) | X1(n-x) | Y2(p-z) | Y3(n-z) | Z4(n-y) | Z5(p-y)|
-	 * |    90   |   -90   |    0    |   180   |    0    |   180  |
-	 */
-	void CreateCubemapResources()
-	{
-		CreateImageHDRContext(CubemapImage, CubemapImageMemory, CubemapImageView, CubemapSampler, CubemapMaxMips, {
-			"Resources/Textures/cubemap_X0.png",
-			"Resources/Textures/cubemap_X1.png",
-			"Resources/Textures/cubemap_Y2.png",
-			"Resources/Textures/cubemap_Y3.png",
-			"Resources/Textures/cubemap_Z4.png",
-			"Resources/Textures/cubemap_Z5.png" });
-	}
+		VkDescriptorPoolCreateInfo poolCI{};
+		poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolCI.pPoolSizes = poolSizes.data();
+		poolCI.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
-	/** 创建统一缓存区（UBO）*/
-	void CreateUniformBuffers()
-	{
-		VkDeviceSize baseBufferSize = sizeof(FUniformBufferBase);
-		BaseUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-		BaseUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		if (vkCreateDescriptorPool(Device, &poolCI, nullptr, &BaseSceneDeferredPass.LightingDescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create descriptor pool!");
+		}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			CreateBuffer(baseBufferSize,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				BaseUniformBuffers[i],
-				BaseUniformBuffersMemory[i]);
+		/** 创建DescriptorSets*/
+		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, BaseSceneDeferredPass.LightingDescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = BaseSceneDeferredPass.LightingDescriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+		allocInfo.pSetLayouts = layouts.data();
 
-			// 这里会导致 memory stack overflow ，不应该在这里 vkMapMemory
-			//vkMapMemory(Device, BaseUniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+		BaseSceneDeferredPass.LightingDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+		if (vkAllocateDescriptorSets(Device, &allocInfo, BaseSceneDeferredPass.LightingDescriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
 		}
 
-		VkDeviceSize bufferSizeOfView = sizeof(FUniformBufferView);
-		ViewUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-		ViewUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			CreateBuffer(
-				bufferSizeOfView,
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				ViewUniformBuffers[i],
-				ViewUniformBuffersMemory[i]);
-		}
 
-		FLight Moonlight;
-		Moonlight.Position = glm::vec4(20.0f, 0.0f, 20.0f, 0.0);
-		Moonlight.Color = glm::vec4(0.0, 0.1, 0.6, 15.0);
-		Moonlight.Direction = glm::vec4(glm::normalize(glm::vec3(Moonlight.Position.x, Moonlight.Position.y, Moonlight.Position.z)), 0.0);
-		Moonlight.LightInfo = glm::vec4(0.0, 0.0, 0.0, 0.0);
-		View.DirectionalLights[0] = Moonlight;
-		uint32_t PointLightNum = POINT_LIGHTS_NUM;
-		for (uint32_t i = 0; i < PointLightNum; i++)
-		{
-			FLight PointLight;
-			float radians = (((float)RandRange(0, 3600) / 10.0f));
-			float distance = (((float)RandRange(0, 500) / 100.0f)) + 1.0f;
-			float X = sin(glm::radians(radians)) * distance;
-			float Y = cos(glm::radians(radians)) * distance;
-			float Z = 1.0;
-			PointLight.Position = glm::vec4(glm::vec3(X, Y, Z), 0.0);
-			float R = (((float)RandRange(50, 75) / 100.0f));
-			float G = (((float)RandRange(25, 50) / 100.0f));
-			float B = 0.0;
-			PointLight.Color = glm::vec4(R, G, B, 10.0);
-			PointLight.Direction = glm::vec4(0.0, 0.0, 1.0, 1.5);
-			PointLight.LightInfo = glm::vec4(0.0, 0.0, 0.0, 0.0);
-			View.PointLights[i] = PointLight;
-		}
-		View.LightsCount = glm::ivec4(1, PointLightNum, 0, CubemapMaxMips);
-	}
+			uint32_t write_size = 9;
+			std::vector<VkWriteDescriptorSet> descriptorWrites{};
+			descriptorWrites.resize(write_size);
 
-	void CreateBaseScenePass()
-	{
-		// 创建场景渲染流水线和着色器
-		uint32_t SpecConstantsCount = GlobalConstants.SpecConstantsCount;
-		CreateDescriptorSetLayout(BaseScenePass.DescriptorSetLayout, PBR_SAMPLER_NUMBER);
-		BaseScenePass.Pipelines.resize(SpecConstantsCount);
-		BaseScenePass.PipelinesInstanced.resize(SpecConstantsCount);
-		CreatePipelineLayout(BaseScenePass.PipelineLayout, BaseScenePass.DescriptorSetLayout);
-		CreateGraphicsPipelines(
-			BaseScenePass.Pipelines,
-			BaseScenePass.PipelineLayout, 
-			MainRenderPass,
-			SpecConstantsCount,
-			"Resources/Shaders/draw_with_deferred_base_vert.spv",
-			"Resources/Shaders/draw_with_deferred_base_frag.spv",
-			true/*bDepthTest*/, true/*bCullBack*/, false/*bInstanced*/);
-		CreateGraphicsPipelines(
-			BaseScenePass.PipelinesInstanced,
-			BaseScenePass.PipelineLayout,
-			MainRenderPass,
-			SpecConstantsCount,
-			"Resources/Shaders/draw_with_deferred_base_instanced_vert.spv",
-			"Resources/Shaders/draw_with_deferred_base_frag.spv",
-			true/*bDepthTest*/, true/*bCullBack*/, true/*bInstanced*/);
+			// 绑定 UnifromBuffer
+			VkDescriptorBufferInfo viewBufferInfo{};
+			viewBufferInfo.buffer = UniformRings[i].Buffer;
+			viewBufferInfo.offset = 0;
+			viewBufferInfo.range = sizeof(FUniformBufferView);
 
-#if !ENABLE_DEFEERED_RENDERING
-		CreateBaseSceneResources();
-#endif
-		//~ 结束 创建场景，包括VBO，UBO，贴图等
-	}
+			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[0].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
+			descriptorWrites[0].dstBinding = 0;
+			descriptorWrites[0].dstArrayElement = 0;
+			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			descriptorWrites[0].descriptorCount = 1;
+			descriptorWrites[0].pBufferInfo = &viewBufferInfo;
 
-	void CreateBaseSceneIndirectPass()
-	{
-		// 创建场景渲染流水线和着色器
-		CreateDescriptorSetLayout(BaseSceneIndirectPass.DescriptorSetLayout, PBR_SAMPLER_NUMBER);
-		uint32_t SpecConstantsCount = GlobalConstants.SpecConstantsCount;
-		BaseSceneIndirectPass.Pipelines.resize(SpecConstantsCount);
-		BaseSceneIndirectPass.PipelinesInstanced.resize(SpecConstantsCount);
-		CreatePipelineLayout(BaseSceneIndirectPass.PipelineLayout, BaseSceneIndirectPass.DescriptorSetLayout);
-		CreateGraphicsPipelines(
-			BaseSceneIndirectPass.Pipelines,
-			BaseSceneIndirectPass.PipelineLayout,
-			MainRenderPass,
-			SpecConstantsCount,
-			"Resources/Shaders/draw_with_deferred_base_vert.spv",
-			"Resources/Shaders/draw_with_deferred_base_frag.spv",
-			true/*bDepthTest*/, true/*bCullBack*/, false/*bInstanced*/);
-		CreateGraphicsPipelines(
-			BaseSceneIndirectPass.PipelinesInstanced,
-			BaseSceneIndirectPass.PipelineLayout,
-			MainRenderPass,
-			SpecConstantsCount,
-			"Resources/Shaders/draw_with_deferred_base_instanced_vert.spv",
-			"Resources/Shaders/draw_with_deferred_base_frag.spv",
-			true/*bDepthTest*/, true/*bCullBack*/, true/*bInstanced*/);
+			VkDescriptorImageInfo cubemapImageInfo{};
+			cubemapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			cubemapImageInfo.imageView = CubemapImageView;
+			cubemapImageInfo.sampler = CubemapSampler;
 
-		if (ENABLE_INDIRECT_DRAW)
-		{
-			FRenderIndirectObject cube;
-			std::string cube_obj = "Resources/Models/cube.obj";
-			std::vector<std::string> cube_imgs = {
-				"Resources/Textures/default_grey.png",		// BaseColor
-				"Resources/Textures/default_black.png",		// Metallic
-				"Resources/Textures/default_white.png",		// Roughness
-				"Resources/Textures/default_normal.png",	// Normal
-				"Resources/Textures/default_white.png",		// AmbientOcclution
-				"Resources/Textures/default_black.png",		// Emissive
-				"Resources/Textures/default_white.png" };	// Mask
-			CreateRenderObject<FRenderIndirectObject>(cube, cube_obj, cube_imgs, BaseSceneIndirectPass.DescriptorSetLayout);
+			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[1].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
+			descriptorWrites[1].dstBinding = 1;
+			descriptorWrites[1].dstArrayElement = 0;
+			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrites[1].descriptorCount = 1;
+			descriptorWrites[1].pImageInfo = &cubemapImageInfo;
 
-			cube.IndirectCommands.clear();
+			VkDescriptorImageInfo shadowmapImageInfo{};
+			shadowmapImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			shadowmapImageInfo.imageView = ShadowmapPass.ImageView;
+			shadowmapImageInfo.sampler = ShadowmapPass.Sampler;
 
-			VkDrawIndexedIndirectCommand indirectCmd{};
-			indirectCmd.indexCount = (uint32_t)cube.MeshData.Indices.size(); /*indexCount*/
-			indirectCmd.instanceCount = 1; /*instanceCount*/
-			indirectCmd.firstIndex = 0; /*firstIndex*/
-			indirectCmd.vertexOffset = 0; /*vertexOffset*/
-			indirectCmd.firstInstance = 0; /*firstInstance*/
-			cube.IndirectCommands.push_back(indirectCmd);
+			descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[2].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
+			descriptorWrites[2].dstBinding = 2;
+			descriptorWrites[2].dstArrayElement = 0;
+			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrites[2].descriptorCount = 1;
+			descriptorWrites[2].pImageInfo = &shadowmapImageInfo;
 
-			CreateRenderIndirectBuffer<FRenderIndirectObject>(cube);
-			BaseSceneIndirectPass.RenderIndirectObject.push_back(cube);
+			std::vector<VkImageView> ImageViews;
+			ImageViews.resize(6);
+			std::vector<VkSampler> Samplers;
+			Samplers.resize(6);
+			ImageViews[0] = GBuffer.DepthStencilImageView;
+			ImageViews[1] = GBuffer.SceneColorImageView;
+			ImageViews[2] = GBuffer.GBufferAImageView;
+			ImageViews[3] = GBuffer.GBufferBImageView;
+			ImageViews[4] = GBuffer.GBufferCImageView;
+			ImageViews[5] = GBuffer.GBufferDImageView;
+			Samplers[0] = GBuffer.DepthStencilSampler;
+			Samplers[1] = GBuffer.SceneColorSampler;
+			Samplers[2] = GBuffer.GBufferASampler;
+			Samplers[3] = GBuffer.GBufferBSampler;
+			Samplers[4] = GBuffer.GBufferCSampler;
+			Samplers[5] = GBuffer.GBufferDSampler;
+			// 绑定 Textures
+			// descriptorWrites会引用每一个创建的VkDescriptorImageInfo，所以需要用一个数组把它们存储起来
+			std::vector<VkDescriptorImageInfo> imageInfos;
+			imageInfos.resize(ImageViews.size());
+			for (size_t j = 0; j < ImageViews.size(); j++)
+			{
+				VkDescriptorImageInfo imageInfo{};
+				imageInfo.imageLayout = (j == 0) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				imageInfo.imageView = ImageViews[j];
+				imageInfo.sampler = Samplers[j];
+				imageInfos[j] = imageInfo;
 
-			FRenderIndirectInstancedObject cube_inst;
-			std::string cube_inst_obj = "Resources/Models/cube.obj";
-			std::vector<std::string> cube_inst_imgs = {
-				"Resources/Textures/default_grey.png",		// BaseColor
-				"Resources/Textures/default_black.png",		// Metallic
-				"Resources/Textures/default_white.png",		// Roughness
-				"Resources/Textures/default_normal.png",	// Normal
-				"Resources/Textures/default_white.png",		// AmbientOcclution
-				"Resources/Textures/default_black.png",		// Emissive
-				"Resources/Textures/default_white.png" };	// Mask
-			CreateRenderObject<FRenderIndirectInstancedObject>(cube_inst, cube_inst_obj, cube_inst_imgs, BaseSceneIndirectPass.DescriptorSetLayout);
+				descriptorWrites[j + 3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrites[j + 3].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
+				descriptorWrites[j + 3].dstBinding = static_cast<uint32_t>(j + 3);
+				descriptorWrites[j + 3].dstArrayElement = 0;
+				descriptorWrites[j + 3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				descriptorWrites[j + 3].descriptorCount = 1;
+				descriptorWrites[j + 3].pImageInfo = &imageInfos[j];
+			}
 
-			cube_inst.IndirectCommands.clear();
+			vkUpdateDescriptorSets(Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
 
-			std::vector<FInstanceData> instanceData;
-			instanceData.resize(INSTANCE_COUNT);
+		CreatePipelineLayout(BaseSceneDeferredPass.LightingPipelineLayout, BaseSceneDeferredPass.LightingDescriptorSetLayout, true);
+		BaseSceneDeferredPass.LightingPipelines.resize(GlobalConstants.SpecConstantsCount);
+		CreateGraphicsPipelinesDeferred(
+			BaseSceneDeferredPass.LightingPipelines,
+			BaseSceneDeferredPass.LightingPipelineLayout,
+			MainRenderPass,
+			GlobalConstants.SpecConstantsCount, ScreenRect, DeferredLighting,
+			"Resources/Shaders/draw_with_deferred_bg_vert.spv",
+			"Resources/Shaders/draw_with_deferred_lighting_frag.spv");
 
-			for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
-				VkDrawIndexedIndirectCommand indirectCmd{};
-				indirectCmd.indexCount = (uint32_t)cube_inst.MeshData.Indices.size(); /*indexCount*/
-				indirectCmd.instanceCount = INSTANCE_COUNT; /*instanceCount*/
-				indirectCmd.firstIndex = 0; /*firstIndex*/
-				indirectCmd.vertexOffset = 0; /*vertexOffset*/
-				indirectCmd.firstInstance = 0; /*firstInstance*/
+		CreateBaseSceneResources();
+	}
 
-				cube_inst.IndirectCommands.push_back(indirectCmd);
+	void CreateBaseSceneResources()
+	{
+		std::string terrain_obj = "Resources/Models/terrain.obj";
+		std::vector<std::string> terrain_imgs = {
+				"Resources/Textures/terrain_bc.png",		// BaseColor
+				"Resources/Textures/terrain_orm.png",		// AmbientOcclution + Roughness + Metallic + Mask
+				"Resources/Textures/terrain_n.png",			// Normal
+				"Resources/Textures/default_black.png" };	// Emissive
 
-				float X = (((float)RandRange(-199, 199) / 100.0f));
-				float Y = (((float)RandRange(-199, 199) / 100.0f));
-				float Z = RandRange(0, 99) / 250.0f;
-				instanceData[i].InstancePosition = glm::vec3(X, Y, Z);
-				// Y(Pitch), Z(Yaw), X(Roll)
-				float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
-				float Pitch = float(M_PI) * RandRange(0, 99) / 100.0f;
-				float Roll = float(M_PI) * RandRange(0, 99) / 100.0f;
-				instanceData[i].InstanceRotation = glm::vec3(Pitch, Yaw, Roll);
-				instanceData[i].InstancePScale = RandRange(0, 99) / 500.0f;
-				instanceData[i].InstanceTexIndex = RandRange(0, 99);
-			}
-			CreateInstancedBuffer<FRenderIndirectInstancedObject>(cube_inst, instanceData);
-			CreateRenderIndirectBuffer<FRenderIndirectInstancedObject>(cube_inst);
-			BaseSceneIndirectPass.RenderIndirectInstancedObject.push_back(cube_inst);
+		float rock01_zone = 1.0f;
+		std::string rock01_obj = "Resources/Models/rock_01.obj";
+		std::vector<std::string> rock01_imgs = {
+				"Resources/Textures/rock_01_bc.png",		// BaseColor
+				"Resources/Textures/rock_01_orm.png",		// AmbientOcclution + Roughness + Metallic + Mask
+				"Resources/Textures/rock_01_n.png",			// Normal
+				"Resources/Textures/default_black.png" };	// Emissive
+
+		std::string rock02_obj = "Resources/Models/rock_02.obj";
+		std::vector<std::string> rock02_imgs = {
+				"Resources/Textures/rock_02_bc.png",			// BaseColor
+				"Resources/Textures/rock_02_orm.png",		// AmbientOcclution + Roughness + Metallic + Mask
+				"Resources/Textures/rock_02_n.png",			// Normal
+				"Resources/Textures/default_black.png" };	// Emissive
+		std::vector<FInstanceData> rock_InstanceData;
+		uint32_t rock_InstanceCount = 64;
+		rock_InstanceData.resize(rock_InstanceCount);
+		for (uint32_t i = 0; i < rock_InstanceCount; i++) {
+			float radians = (((float)RandRange(0, 3600) / 10.0f));
+			float distance = (((float)RandRange(0, 500) / 100.0f)) + rock01_zone;
+			float X = sin(glm::radians(radians)) * distance;
+			float Y = cos(glm::radians(radians)) * distance;
+			float Z = 0.0;
+			rock_InstanceData[i].InstancePosition = glm::vec3(X, Y, Z);
+			// Y(Pitch), Z(Yaw), X(Roll)
+			float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
+			rock_InstanceData[i].InstanceRotation = glm::vec3(0.0, Yaw, 0.0);
+			rock_InstanceData[i].InstancePScale = RandRange(2, 5) / 10.0f;
+			rock_InstanceData[i].InstanceTexIndex = RandRange(0, 255);
 		}
-	}
 
-	/** 创建GBuffer, 用于延迟渲染*/
-	void CreateBaseSceneDeferredPass()
-	{
-		auto CreateGraphicsPipelinesDeferred = [this](
-			std::vector<VkPipeline>& outPipelines,
-			const VkPipelineLayout& inPipelineLayout,
-			const VkRenderPass& inRenderPass,
-			const uint32_t inSpecConstantsCount,
-			const EVertexType VertexType,
-			const  EGraphicPipelineType GraphicPipelineType,
-			const std::string& inVertFilename,
-			const std::string& inFragFilename)
+		std::string grass01_obj = "Resources/Models/grass_01.obj";
+		std::string grass02_obj = "Resources/Models/grass_02.obj";
+		if (ENABLE_MESH_IMPORT_BENCHMARK)
 		{
-			auto vertShaderCode = LoadShaderSource(inVertFilename);
-			auto fragShaderCode = LoadShaderSource(inFragFilename);
+			BenchmarkModelImport(terrain_obj);
+			BenchmarkModelImport(grass01_obj);
+		}
+		std::vector<std::string> grass_imgs = {
+				"Resources/Textures/grass_bc.png",			// BaseColor
+				"Resources/Textures/grass_orm.png",			// AmbientOcclution + Roughness + Metallic + Mask
+				"Resources/Textures/grass_n.png",			// Normal
+				"Resources/Textures/grass_ev.png" };		// Emissive
+
+		// 所有模型和贴图在工作线程中并行解码，主线程按提交顺序等待结果并上传到GPU
+		auto loadStartTime = std::chrono::high_resolution_clock::now();
+		// 流式上传时加载任务在函数返回后还在执行，工作线程和应用的生命周期一致
+		if (!AssetLoadJobs) {
+			uint32_t loadThreadCount = ENABLE_PARALLEL_ASSET_LOADING ? std::max(1u, std::thread::hardware_concurrency()) : 0;
+			AssetLoadJobs = std::make_unique<FJobSystem>(loadThreadCount);
+		}
+		FJobSystem& loadJobs = *AssetLoadJobs;
+		BeginUploadBatch();
+		// 场景模型使用紧凑顶点格式，阴影和GBuffer的顶点带宽减半
+		EVertexFormat sceneVertexFormat = ENABLE_COMPACT_VERTEX ? EVertexFormat::Compact : EVertexFormat::Full;
+		FRenderObjectAssets terrain_assets = LoadRenderObjectAssets(loadJobs, terrain_obj, terrain_imgs, sceneVertexFormat);
+		FRenderObjectAssets rock01_assets = LoadRenderObjectAssets(loadJobs, rock01_obj, rock01_imgs, sceneVertexFormat);
+		FRenderObjectAssets rock02_assets = LoadRenderObjectAssets(loadJobs, rock02_obj, rock02_imgs, sceneVertexFormat);
+		FRenderObjectAssets grass01_assets = LoadRenderObjectAssets(loadJobs, grass01_obj, grass_imgs, sceneVertexFormat);
+		FRenderObjectAssets grass02_assets = LoadRenderObjectAssets(loadJobs, grass02_obj, grass_imgs, sceneVertexFormat);
 
-			VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-			VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+		std::vector<FInstanceData> grass01_InstanceData;
+		uint32_t grass01_InstanceCount = INSTANCE_COUNT;
+		grass01_InstanceData.resize(grass01_InstanceCount);
+		for (uint32_t i = 0; i < grass01_InstanceCount; i++) {
+			float radians = (((float)RandRange(0, 3600) / 10.0f));
+			float distance = (((float)RandRange(0, 800) / 100.0f)) + rock01_zone * 2.0f;
+			float X = sin(glm::radians(radians)) * distance;
+			float Y = cos(glm::radians(radians)) * distance;
+			float Z = 0.0;
+			grass01_InstanceData[i].InstancePosition = glm::vec3(X, Y, Z);
+			// Y(Pitch), Z(Yaw), X(Roll)
+			float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
+			grass01_InstanceData[i].InstanceRotation = glm::vec3(0.0, Yaw, 0.0);
+			grass01_InstanceData[i].InstancePScale = RandRange(1, 5) / 10.0f;
+			grass01_InstanceData[i].InstanceTexIndex = RandRange(0, 255);
+		}
 
-			VkPipelineShaderStageCreateInfo vertShaderStageCI{};
-			vertShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			vertShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
-			vertShaderStageCI.module = vertShaderModule;
-			vertShaderStageCI.pName = "main";
+		std::vector<FInstanceData> grass_02_InstanceData;
+		uint32_t grass02_InstanceCount = INSTANCE_COUNT;
+		grass_02_InstanceData.resize(grass02_InstanceCount);
+		for (uint32_t i = 0; i < grass02_InstanceCount; i++) {
+			float radians = (((float)RandRange(0, 3600) / 10.0f));
+			float distance = (((float)RandRange(0, 900) / 100.0f)) + rock01_zone;
+			float X = sin(glm::radians(radians)) * distance;
+			float Y = cos(glm::radians(radians)) * distance;
+			float Z = 0.0;
+			grass_02_InstanceData[i].InstancePosition = glm::vec3(X, Y, Z);
+			// Y(Pitch), Z(Yaw), X(Roll)
+			float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
+			grass_02_InstanceData[i].InstanceRotation = glm::vec3(0.0, Yaw, 0.0);
+			grass_02_InstanceData[i].InstancePScale = RandRange(1, 5) / 10.0f;
+			grass_02_InstanceData[i].InstanceTexIndex = RandRange(0, 255);
+		}
 
-			VkPipelineShaderStageCreateInfo fragShaderStageCI{};
-			fragShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			fragShaderStageCI.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-			fragShaderStageCI.module = fragShaderModule;
-			fragShaderStageCI.pName = "main";
+		// 场景物体都投射阴影，主相机用前向或者延迟渲染绘制
+#if !ENABLE_DEFEERED_RENDERING
+		VkDescriptorSetLayout& sceneDescriptorSetLayout = BaseScenePass.DescriptorSetLayout;
+		uint32_t scenePassFlags = ScenePassBit(EScenePass::Shadow) | ScenePassBit(EScenePass::Forward);
+#else
+		VkDescriptorSetLayout& sceneDescriptorSetLayout = BaseSceneDeferredPass.SceneDescriptorSetLayout;
+		uint32_t scenePassFlags = ScenePassBit(EScenePass::Shadow) | ScenePassBit(EScenePass::Deferred);
+#endif
+		AddRenderObject<FRenderObject>(scenePassFlags, terrain_assets, sceneDescriptorSetLayout);
+		AddRenderObject<FRenderObject>(scenePassFlags, rock01_assets, sceneDescriptorSetLayout);
+		AddRenderObject<FRenderInstancedObject>(scenePassFlags, rock02_assets, sceneDescriptorSetLayout, rock_InstanceData);
+		AddRenderObject<FRenderInstancedObject>(scenePassFlags, grass01_assets, sceneDescriptorSetLayout, grass01_InstanceData);
+		AddRenderObject<FRenderInstancedObject>(scenePassFlags, grass02_assets, sceneDescriptorSetLayout, grass_02_InstanceData);
+
+		SubmitUploadBatch();
+
+		auto loadEndTime = std::chrono::high_resolution_clock::now();
+		float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(loadEndTime - loadStartTime).count();
+		std::cout << "[LOG]: Scene resources " << (ENABLE_STREAMING_UPLOAD ? "queued" : "loaded") << " in " << loadTime << " ms, "
+			<< loadJobs.GetJobCount() << " decode jobs took " << loadJobs.GetBusyMilliseconds() << " ms of CPU time on "
+			<< std::max(1u, loadJobs.GetThreadCount()) << " thread(s), "
+			<< TextureCache.size() << " unique textures in cache, "
+			<< (StagingRing.GetUsedSize() >> 20) << " MB of staging ring in use, "
+			<< StreamingTasks.size() << " objects waiting to stream" << std::endl;
+		PendingTextureDecodes.clear();
+		LogMemoryStats();
+	}
 
-			VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCI, fragShaderStageCI };
+	void CreateBackgroundPass()
+	{
+		// 创建背景贴图
+		BeginUploadBatch();
+		CreateImageContext(
+			BackgroundPass.Image,
+			BackgroundPass.Memory,
+			BackgroundPass.ImageView,
+			BackgroundPass.Sampler,
+			"Resources/Textures/background.png");
+		SubmitUploadBatch();
+		CreateDescriptorSetLayout(BackgroundPass.DescriptorSetLayout);
+		CreateDescriptorPool(BackgroundPass.DescriptorPool);
+		CreateDescriptorSets(
+			BackgroundPass.DescriptorSets,
+			BackgroundPass.DescriptorPool,
+			BackgroundPass.DescriptorSetLayout,
+			BackgroundPass.ImageView,
+			BackgroundPass.Sampler);
+		BackgroundPass.Pipelines.resize(1);
+		CreatePipelineLayout(BackgroundPass.PipelineLayout, BackgroundPass.DescriptorSetLayout);
 
-			// 顶点缓存绑定的描述，定义了顶点都需要绑定什么数据，比如第一个位置绑定Position，第二个位置绑定Color，第三个位置绑定UV等
-			auto bindingDescription = FVertex::GetBindingDescription();
-			auto attributeDescriptions = FVertex::GetAttributeDescriptions();
-			auto bindingInstancedDescriptions = FVertex::GetBindingInstancedDescriptions();
-			auto attributeInstancedDescriptions = FVertex::GetAttributeInstancedDescriptions();
+		CreateGraphicsPipelines(
+			BackgroundPass.Pipelines,
+			BackgroundPass.PipelineLayout, 
+			MainRenderPass,
+			1,
+			"Resources/Shaders/draw_with_deferred_bg_vert.spv",
+			"Resources/Shaders/draw_with_deferred_bg_frag.spv",
+			false/*bDepthTest*/, false/*bCullBack*/, false/*bInstanced*/);
+	}
 
-			// 渲染管线VertexBuffer输入
-			VkPipelineVertexInputStateCreateInfo vertexInputCI{};
-			switch (VertexType)
-			{
-			case VertexIndexed:
-			{
-				vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-				vertexInputCI.vertexBindingDescriptionCount = 1;
-				vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-				vertexInputCI.pVertexBindingDescriptions = &bindingDescription;
-				vertexInputCI.pVertexAttributeDescriptions = attributeDescriptions.data();
-				break;
-			}
-			case Instanced:
-			{
-				vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-				vertexInputCI.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingInstancedDescriptions.size());
-				vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeInstancedDescriptions.size());
-				vertexInputCI.pVertexBindingDescriptions = bindingInstancedDescriptions.data();
-				vertexInputCI.pVertexAttributeDescriptions = attributeInstancedDescriptions.data();
-				break;
-			}
-			case ScreenRect:
-			{
-				vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-				vertexInputCI.vertexBindingDescriptionCount = 0;
-				vertexInputCI.vertexAttributeDescriptionCount = 0;
-			}
-			default:
-				break;
-			}
+	void CreateSkydomePass()
+	{
+		// 环境反射纹理，天空球贴图和模型在同一个上传批次中提交
+		BeginUploadBatch();
 
-			VkPipelineInputAssemblyStateCreateInfo inputAssemblyCI{};
-			inputAssemblyCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-			inputAssemblyCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-			inputAssemblyCI.primitiveRestartEnable = VK_FALSE;
+		// 创建环境反射纹理资源
+		CreateCubemapResources();
 
-			VkPipelineViewportStateCreateInfo viewportStateCI{};
-			viewportStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-			viewportStateCI.viewportCount = 1;
-			viewportStateCI.scissorCount = 1;
+		// HDRI texture map
+		// @see https://polyhaven.com/a/preller_drive
+		CreateImageContext(
+			SkydomePass.Image,
+			SkydomePass.Memory,
+			SkydomePass.ImageView,
+			SkydomePass.Sampler,
+			"Resources/Textures/skydome.png");
+		CreateDescriptorSetLayout(SkydomePass.DescriptorSetLayout);
+		CreateDescriptorPool(SkydomePass.DescriptorPool);
+		CreateDescriptorSets(
+			SkydomePass.DescriptorSets,
+			SkydomePass.DescriptorPool,
+			SkydomePass.DescriptorSetLayout,
+			SkydomePass.ImageView,
+			SkydomePass.Sampler);
+		SkydomePass.Pipelines.resize(1);
+		CreatePipelineLayout(SkydomePass.PipelineLayout, SkydomePass.DescriptorSetLayout);
+		CreateGraphicsPipelines(
+			SkydomePass.Pipelines,
+			SkydomePass.PipelineLayout,
+			MainRenderPass,
+			1,
+			"Resources/Shaders/draw_with_deferred_sky_vert.spv",
+			"Resources/Shaders/draw_with_deferred_sky_frag.spv",
+			true/*bDepthTest*/, true/*bCullBack*/, false/*bInstanced*/);
 
-			VkPipelineRasterizationStateCreateInfo rasterizerCI{};
-			rasterizerCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-			rasterizerCI.depthClampEnable = VK_FALSE;
-			rasterizerCI.rasterizerDiscardEnable = VK_FALSE;
-			rasterizerCI.polygonMode = VK_POLYGON_MODE_FILL;
-			rasterizerCI.lineWidth = 1.0f;
-			// @NOTE: hard-coded for foliage single face render
-			rasterizerCI.cullMode = VK_CULL_MODE_NONE;
-			rasterizerCI.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-			rasterizerCI.depthBiasEnable = VK_FALSE;
+		std::string skydome_obj = "Resources/Models/skydome.obj";
+		CreateMesh(SkydomePass.SkydomeMesh, skydome_obj);
 
-			VkPipelineMultisampleStateCreateInfo multiSamplingCI{};
-			multiSamplingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-			multiSamplingCI.sampleShadingEnable = VK_FALSE;
-			multiSamplingCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		SubmitUploadBatch();
+	}
 
-			// 打开深度测试
-			VkPipelineDepthStencilStateCreateInfo depthStencilCI{};
-			depthStencilCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-			depthStencilCI.depthTestEnable = (VertexType != ScreenRect) ? VK_TRUE : VK_FALSE;
-			depthStencilCI.depthWriteEnable = (VertexType != ScreenRect) ? VK_TRUE : VK_FALSE;
-			depthStencilCI.depthCompareOp = VK_COMPARE_OP_LESS;
-			depthStencilCI.depthBoundsTestEnable = VK_FALSE;
-			depthStencilCI.minDepthBounds = 0.0f; // Optional
-			depthStencilCI.maxDepthBounds = 1.0f; // Optional
-			depthStencilCI.stencilTestEnable = VK_FALSE; // 没有写轮廓信息，所以跳过轮廓测试
-			depthStencilCI.front = {}; // Optional
-			depthStencilCI.back = {}; // Optional
+	/** 创建指令缓存，多个CPU Core可以并行的往CommandBuffer中发送指令，可以充分利用CPU的多核性能
+	 * 每个（飞行帧，SwapChain 图像）组合一个，录制依赖的状态没有变化时重复提交*/
+	void CreateCommandBuffer()
+	{
+		std::vector<VkCommandBuffer> commandBuffers(MAX_FRAMES_IN_FLIGHT * SwapChainImages.size());
 
-			VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-			colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-			colorBlendAttachment.blendEnable = VK_FALSE;
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = CommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
 
-			VkPipelineColorBlendStateCreateInfo colorBlendingCI{};
-			colorBlendingCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-			colorBlendingCI.logicOpEnable = VK_FALSE;
-			colorBlendingCI.logicOp = VK_LOGIC_OP_COPY;
-			colorBlendingCI.blendConstants[0] = 0.0f;
-			colorBlendingCI.blendConstants[1] = 0.0f;
-			colorBlendingCI.blendConstants[2] = 0.0f;
-			colorBlendingCI.blendConstants[3] = 0.0f;
-			switch (GraphicPipelineType)
-			{
-			case Forward:
-			{
-				colorBlendingCI.attachmentCount = 1;
-				colorBlendingCI.pAttachments = &colorBlendAttachment;
-				break;
-			}
-			case DeferredScene:
+		if (vkAllocateCommandBuffers(Device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+
+		CommandCache.resize(commandBuffers.size());
+		for (size_t i = 0; i < commandBuffers.size(); i++) {
+			CommandCache[i].CommandBuffer = commandBuffers[i];
+		}
+	}
+
+	void DestroyCommandBuffer()
+	{
+		for (FCommandCacheEntry& entry : CommandCache)
+		{
+			vkFreeCommandBuffers(Device, CommandPool, 1, &entry.CommandBuffer);
+			// 指令池销毁时一起释放其中的 Secondary CommandBuffer
+			for (FRecordContext& context : entry.RecordContexts)
 			{
-				std::array<VkPipelineColorBlendAttachmentState, 5> colorBlendAttachments;
-				colorBlendAttachments[0] = colorBlendAttachment;
-				colorBlendAttachments[1] = colorBlendAttachment;
-				colorBlendAttachments[2] = colorBlendAttachment;
-				colorBlendAttachments[3] = colorBlendAttachment;
-				colorBlendAttachments[4] = colorBlendAttachment;
-				colorBlendingCI.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
-				colorBlendingCI.pAttachments = colorBlendAttachments.data();
-				break;
+				vkDestroyCommandPool(Device, context.CommandPool, nullptr);
 			}
-			case DeferredLighting:
+		}
+		CommandCache.clear();
+	}
+
+	uint32_t GetCommandCacheSlot(uint32_t frame, uint32_t imageIndex) const
+	{
+		return frame * static_cast<uint32_t>(SwapChainImages.size()) + imageIndex;
+	}
+
+	/** 录制时的状态，SceneVersion 在任何一个计数增加时都会增加*/
+	FCommandCacheKey MakeCommandCacheKey() const
+	{
+		FCommandCacheKey key;
+		key.SceneVersion = SceneRegistry.GetVersion() + SceneDrawVersion;
+		key.Constants = GlobalConstants;
+		key.bMultiDrawIndirect = IsSceneMultiDrawIndirect();
+		return key;
+	}
+
+	/** 所有缓存的指令下次使用时重新录制
+	 * Multi-Draw-Indirect 的命令缓存每帧一段，由同一帧的所有 SwapChain 图像共用，所以状态变化时不能只让一部分缓存失效*/
+	void InvalidateCommandCache()
+	{
+		for (FCommandCacheEntry& entry : CommandCache) {
+			entry.bValid = false;
+		}
+	}
+
+	/** 创建并行录制的线程，指令池只能由一个线程使用，每个指令缓存中每个录制线程有自己的指令池*/
+	void CreateRecordJobs()
+	{
+		uint32_t recordThreadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		RecordJobs = std::make_unique<FJobSystem>(recordThreadCount);
+
+		std::cout << "[LOG]: Command recording uses " << RecordJobs->GetThreadCount() << " worker threads, parallel recording is "
+			<< (GlobalInput.bParallelCommandRecording ? "on" : "off") << " (press P to toggle), command buffer cache is "
+			<< (GlobalInput.bCacheCommandBuffers ? "on" : "off") << " (press C to toggle)" << std::endl;
+	}
+
+	void DestroyRecordJobs()
+	{
+		RecordJobs.reset();
+	}
+
+	/** 重新录制之前，上次录制的 Secondary CommandBuffer 都不再使用，重置整个指令池
+	 * 没有工作线程时任务在主线程上直接执行，主线程也有自己的指令池*/
+	void PrepareRecordContexts(FCommandCacheEntry& entry)
+	{
+		if (!entry.RecordContexts.empty())
+		{
+			for (FRecordContext& context : entry.RecordContexts)
 			{
-				colorBlendingCI.attachmentCount = 1;
-				colorBlendingCI.pAttachments = &colorBlendAttachment;
-				break;
-			}
-			default:
-				break;
+				vkResetCommandPool(Device, context.CommandPool, 0);
+				context.UsedCount = 0;
 			}
+			return;
+		}
 
-			std::vector<VkDynamicState> dynamicStates = {
-				VK_DYNAMIC_STATE_VIEWPORT,
-				VK_DYNAMIC_STATE_SCISSOR
-			};
-			VkPipelineDynamicStateCreateInfo dynamicStateCI{};
-			dynamicStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-			dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-			dynamicStateCI.pDynamicStates = dynamicStates.data();
+		FQueueFamilyIndices queueFamilyIndices = FindQueueFamilies(PhysicalDevice);
 
-			VkGraphicsPipelineCreateInfo pipelineCI{};
-			pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-			pipelineCI.stageCount = 2;
-			pipelineCI.pStages = shaderStages;
-			pipelineCI.pVertexInputState = &vertexInputCI;
-			pipelineCI.pInputAssemblyState = &inputAssemblyCI;
-			pipelineCI.pViewportState = &viewportStateCI;
-			pipelineCI.pRasterizationState = &rasterizerCI;
-			pipelineCI.pMultisampleState = &multiSamplingCI;
-			pipelineCI.pDepthStencilState = &depthStencilCI; // 加上深度测试
-			pipelineCI.pColorBlendState = &colorBlendingCI;
-			pipelineCI.pDynamicState = &dynamicStateCI;
-			pipelineCI.layout = inPipelineLayout;
-			pipelineCI.renderPass = inRenderPass;
-			pipelineCI.subpass = 0;
-			pipelineCI.basePipelineHandle = VK_NULL_HANDLE;
+		VkCommandPoolCreateInfo poolCI{};
+		poolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCI.queueFamilyIndex = queueFamilyIndices.GraphicsFamily.value();
 
-			// Use specialization constants 优化着色器变体
-			for (uint32_t i = 0; i < inSpecConstantsCount; i++)
+		entry.RecordContexts.resize(RecordJobs->GetThreadCount() + 1);
+		for (FRecordContext& context : entry.RecordContexts)
+		{
+			if (vkCreateCommandPool(Device, &poolCI, nullptr, &context.CommandPool) != VK_SUCCESS)
 			{
-				uint32_t SpecConstants = i;
-				VkSpecializationMapEntry specializationMapEntry = VkSpecializationMapEntry{};
-				specializationMapEntry.constantID = 0;
-				specializationMapEntry.offset = 0;
-				specializationMapEntry.size = sizeof(uint32_t);
-				VkSpecializationInfo specializationCI = VkSpecializationInfo();
-				specializationCI.mapEntryCount = 1;
-				specializationCI.pMapEntries = &specializationMapEntry;
-				specializationCI.dataSize = sizeof(uint32_t);
-				specializationCI.pData = &SpecConstants;
-				shaderStages[1].pSpecializationInfo = &specializationCI;
-
-				if (vkCreateGraphicsPipelines(Device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &outPipelines[i]) != VK_SUCCESS)
-				{
-					throw std::runtime_error("failed to Create graphics pipeline!");
-				}
+				throw std::runtime_error("failed to Create record command pool!");
 			}
+		}
+	}
 
-			vkDestroyShaderModule(Device, fragShaderModule, nullptr);
-			vkDestroyShaderModule(Device, vertShaderModule, nullptr);
-		};
+	bool IsParallelCommandRecording() const
+	{
+		return GlobalInput.bParallelCommandRecording && RecordJobs != nullptr;
+	}
 
-		// Depth Stencil (Currently depth-only)
-		GBuffer.DepthStencilFormat = VK_FORMAT_D32_SFLOAT;
-		CreateImage(GBuffer.DepthStencilImage, GBuffer.DepthStencilMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.DepthStencilFormat,
-			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(GBuffer.DepthStencilImageView, GBuffer.DepthStencilImage, GBuffer.DepthStencilFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-		CreateSampler(GBuffer.DepthStencilSampler);
+	/** 从当前录制线程的指令池中取出一个 Secondary CommandBuffer 并开始录制，不够时再分配*/
+	VkCommandBuffer BeginSecondaryCommandBuffer(std::vector<FRecordContext>& recordContexts, const VkCommandBufferInheritanceInfo& inheritanceInfo)
+	{
+		FRecordContext& context = recordContexts[RecordJobs->GetCurrentThreadSlot()];
+		if (context.UsedCount == context.CommandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = context.CommandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(Device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate secondary command buffers!");
+			}
+			context.CommandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = context.CommandBuffers[context.UsedCount++];
 
-		// Scene Color
-		GBuffer.SceneColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
-		CreateImage(GBuffer.SceneColorImage, GBuffer.SceneColorMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.SceneColorFormat,
-			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(GBuffer.SceneColorImageView, GBuffer.SceneColorImage, GBuffer.SceneColorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-		CreateSampler(GBuffer.SceneColorSampler);
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		// 缓存的 Primary CommandBuffer 会重复提交，Secondary CommandBuffer 不能是 ONE_TIME_SUBMIT
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		// GBufferA Normal+(CastShadow+Masked)
-		GBuffer.GBufferAFormat = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
-		CreateImage(GBuffer.GBufferAImage, GBuffer.GBufferAMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferAFormat,
-			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(GBuffer.GBufferAImageView, GBuffer.GBufferAImage, GBuffer.GBufferAFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-		CreateSampler(GBuffer.GBufferASampler);
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+		return commandBuffer;
+	}
 
-		// GBufferB M+S+R+(ShadingModelID+SelectiveOutputMask) for unreal
-		// GBufferB M+S+R+(OpacityMask) for me
-		GBuffer.GBufferBFormat = VK_FORMAT_R8G8B8A8_UNORM;
-		CreateImage(GBuffer.GBufferBImage, GBuffer.GBufferBMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferBFormat,
-			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(GBuffer.GBufferBImageView, GBuffer.GBufferBImage, GBuffer.GBufferBFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-		CreateSampler(GBuffer.GBufferBSampler);
+	/** 把一个Pass的录制任务交给录制线程，每个任务录制一个 Secondary CommandBuffer，结果按任务的顺序保存*/
+	void SubmitPassRecording(FPassRecording& pass, std::vector<FRecordContext>& recordContexts)
+	{
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = pass.RenderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = pass.Framebuffer;
+
+		pass.Results.clear();
+		for (const auto& task : pass.Tasks)
+		{
+			pass.Results.push_back(RecordJobs->Submit([this, &recordContexts, inheritanceInfo, setDynamicState = pass.SetDynamicState, task]() {
+				VkCommandBuffer commandBuffer = BeginSecondaryCommandBuffer(recordContexts, inheritanceInfo);
+				FGeometryBinding geometryBinding;
+				setDynamicState(commandBuffer);
+				task(commandBuffer, geometryBinding);
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to record secondary command buffer!");
+				}
+				return commandBuffer;
+			}));
+		}
+	}
 
-		// GBufferC BaseColor + AO
-		GBuffer.GBufferCFormat = VK_FORMAT_R8G8B8A8_UNORM;
-		CreateImage(GBuffer.GBufferCImage, GBuffer.GBufferCMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferCFormat,
-			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(GBuffer.GBufferCImageView, GBuffer.GBufferCImage, GBuffer.GBufferCFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-		CreateSampler(GBuffer.GBufferCSampler);
+	/** 在 Primary CommandBuffer 中录制一个Pass
+	 * 单线程录制时任务直接写入 Primary，并行录制时等待这个Pass的 Secondary CommandBuffer 全部录制完成，按顺序执行*/
+	void RecordPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo& renderPassInfo, FPassRecording& pass, FGeometryBinding& geometryBinding, bool bParallelRecording)
+	{
+		if (!bParallelRecording)
+		{
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			pass.SetDynamicState(commandBuffer);
+			for (const auto& task : pass.Tasks)
+			{
+				task(commandBuffer, geometryBinding);
+			}
+			vkCmdEndRenderPass(commandBuffer);
+			return;
+		}
 
-		// GBufferD Position + ID
-		GBuffer.GBufferDFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-		CreateImage(GBuffer.GBufferDImage, GBuffer.GBufferDMemory, SwapChainExtent.width, SwapChainExtent.height, GBuffer.GBufferDFormat,
-			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CreateImageView(GBuffer.GBufferDImageView, GBuffer.GBufferDImage, GBuffer.GBufferDFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-		CreateSampler(GBuffer.GBufferDSampler);
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+		secondaryCommandBuffers.reserve(pass.Results.size());
+		for (std::future<VkCommandBuffer>& result : pass.Results)
+		{
+			secondaryCommandBuffers.push_back(result.get());
+		}
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		if (!secondaryCommandBuffers.empty())
+		{
+			vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+		}
+		vkCmdEndRenderPass(commandBuffer);
+	}
 
-		VkAttachmentDescription DepthAttachment{};
-		DepthAttachment.format = FindDepthFormat();
-		DepthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		DepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		DepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	/** 把需要执行的指令写入指令缓存，对应每一个SwapChain的图像*/
+	void RecordCommandBuffer(FCommandCacheEntry& commandCache, uint32_t imageIndex)
+	{
+		VkCommandBuffer commandBuffer = commandCache.CommandBuffer;
+		auto BeginTransitionImageLayoutRT = [commandBuffer](VkImage & image, const VkImageAspectFlagBits aspectMask, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+		{
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = aspectMask;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
 
-		VkAttachmentDescription ColorAttachment{};
-		ColorAttachment.format = SwapChainImageFormat;
-		ColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		ColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		ColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		ColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		ColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		ColorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			VkPipelineStageFlags sourceStage;
+			VkPipelineStageFlags destinationStage;
 
-		std::array<VkAttachmentDescription, 6> AttachmentDescriptions = {};
-		AttachmentDescriptions[0] = DepthAttachment;
-		AttachmentDescriptions[1] = ColorAttachment;
-		AttachmentDescriptions[2] = ColorAttachment;
-		AttachmentDescriptions[3] = ColorAttachment;
-		AttachmentDescriptions[4] = ColorAttachment;
-		AttachmentDescriptions[5] = ColorAttachment;
-		AttachmentDescriptions[0].format = GBuffer.DepthStencilFormat;
-		AttachmentDescriptions[1].format = GBuffer.SceneColorFormat;
-		AttachmentDescriptions[2].format = GBuffer.GBufferAFormat;
-		AttachmentDescriptions[3].format = GBuffer.GBufferBFormat;
-		AttachmentDescriptions[4].format = GBuffer.GBufferCFormat;
-		AttachmentDescriptions[5].format = GBuffer.GBufferDFormat;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-		VkAttachmentReference DepthAttachmentRef = {};
-		DepthAttachmentRef.attachment = 0;
-		DepthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		std::vector<VkAttachmentReference> ColorAttachmentRefs;
-		ColorAttachmentRefs.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		ColorAttachmentRefs.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		ColorAttachmentRefs.push_back({ 3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		ColorAttachmentRefs.push_back({ 4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		ColorAttachmentRefs.push_back({ 5, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 
-		VkSubpassDescription subpass{};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = static_cast<uint32_t>(ColorAttachmentRefs.size());
-		subpass.pColorAttachments = ColorAttachmentRefs.data();
-		subpass.pDepthStencilAttachment = &DepthAttachmentRef;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				sourceStage, destinationStage,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier
+			);
+		};
 
-		std::array<VkSubpassDependency, 2> dependencies;
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		auto EndTransitionImageLayoutRT = [commandBuffer](VkImage& image, const VkImageAspectFlagBits aspectMask, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+		{
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = aspectMask;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
 
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			VkPipelineStageFlags sourceStage;
+			VkPipelineStageFlags destinationStage;
 
-		VkRenderPassCreateInfo renderPassCI = {};
-		renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassCI.attachmentCount = static_cast<uint32_t>(AttachmentDescriptions.size());
-		renderPassCI.pAttachments = AttachmentDescriptions.data();
-		renderPassCI.subpassCount = 1;
-		renderPassCI.pSubpasses = &subpass;
-		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
-		renderPassCI.pDependencies = dependencies.data();
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		if (vkCreateRenderPass(Device, &renderPassCI, nullptr, &BaseSceneDeferredPass.SceneRenderPass) != VK_SUCCESS) {
-			throw std::runtime_error("failed to Create render pass!");
-		}
+			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 
-		std::array<VkImageView, 6> attachments =
-		{
-			GBuffer.DepthStencilImageView,
-			GBuffer.SceneColorImageView,
-			GBuffer.GBufferAImageView,
-			GBuffer.GBufferBImageView,
-			GBuffer.GBufferCImageView,
-			GBuffer.GBufferDImageView,
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				sourceStage, destinationStage,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier
+			);
 		};
 
-		VkFramebufferCreateInfo frameBufferCI{};
-		frameBufferCI.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		frameBufferCI.renderPass = BaseSceneDeferredPass.SceneRenderPass;
-		frameBufferCI.attachmentCount = static_cast<uint32_t>(attachments.size());
-		frameBufferCI.pAttachments = attachments.data();
-		frameBufferCI.width = SwapChainExtent.width;
-		frameBufferCI.height = SwapChainExtent.height;
-		frameBufferCI.layers = 1;
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-		if (vkCreateFramebuffer(Device, &frameBufferCI, nullptr, &BaseSceneDeferredPass.SceneFrameBuffer) != VK_SUCCESS)
+		// 开始记录指令
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 		{
-			throw std::runtime_error("failed to Create framebuffer!");
+			throw std::runtime_error("failed to begin recording command buffer!");
 		}
 
-		CreateDescriptorSetLayout(BaseSceneDeferredPass.SceneDescriptorSetLayout, PBR_SAMPLER_NUMBER);
-		BaseSceneDeferredPass.ScenePipelines.resize(GlobalConstants.SpecConstantsCount);
-		BaseSceneDeferredPass.ScenePipelinesInstanced.resize(GlobalConstants.SpecConstantsCount);
-		CreatePipelineLayout(BaseSceneDeferredPass.ScenePipelineLayout, BaseSceneDeferredPass.SceneDescriptorSetLayout);
-		CreateGraphicsPipelinesDeferred(
-			BaseSceneDeferredPass.ScenePipelines,
-			BaseSceneDeferredPass.ScenePipelineLayout,
-			BaseSceneDeferredPass.SceneRenderPass,
-			GlobalConstants.SpecConstantsCount, VertexIndexed, DeferredScene,
-			"Resources/Shaders/draw_with_deferred_base_vert.spv",
-			"Resources/Shaders/draw_with_deferred_scene_frag.spv");
-		CreateGraphicsPipelinesDeferred(
-			BaseSceneDeferredPass.ScenePipelinesInstanced,
-			BaseSceneDeferredPass.ScenePipelineLayout,
-			BaseSceneDeferredPass.SceneRenderPass,
-			GlobalConstants.SpecConstantsCount, Instanced, DeferredScene,
-			"Resources/Shaders/draw_with_deferred_base_instanced_vert.spv",
-			"Resources/Shaders/draw_with_deferred_scene_frag.spv");
-
-		/** Create DescriptorSetLayout for Lighting*/
-		// UnifromBufferObject（ubo）绑定
-		VkDescriptorSetLayoutBinding viewLayoutBinding{};
-		viewLayoutBinding.binding = 0;
-		viewLayoutBinding.descriptorCount = 1;
-		viewLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		viewLayoutBinding.pImmutableSamplers = nullptr;
-		viewLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		// 所有模型共用几何缓存池，绑定在整个CommandBuffer中保持有效，只在缓存池切换时重新绑定
+		FGeometryBinding geometryBinding;
+		// 这一帧的统一缓存在统一缓存环中的动态偏移
+		const FFrameUniforms& frameUniforms = FrameUniforms[CurrentFrame];
+		// 场景物体通过 Multi-Draw-Indirect 提交，或者逐物体提交
+		bool bSceneMultiDrawIndirect = IsSceneMultiDrawIndirect();
+		SceneDrawCalls = 0;
+		uint32_t specConstants = GlobalConstants.SpecConstants;
+		// 并行录制时三个Pass的任务先全部交给录制线程，Primary 只负责 RenderPass 的开始和结束以及深度拷贝
+		bool bParallelRecording = IsParallelCommandRecording();
+		if (bParallelRecording)
+		{
+			PrepareRecordContexts(commandCache);
+		}
+
+		// 【阴影】所有注册了阴影Pass的物体，共用阴影Pass的描述符集合
+		FPassRecording shadowPass;
+		shadowPass.RenderPass = ShadowmapPass.RenderPass;
+		shadowPass.Framebuffer = ShadowmapPass.FrameBuffer;
+		shadowPass.SetDynamicState = [this](VkCommandBuffer cmd) { SetShadowDynamicState(cmd); };
+		AddSceneRecordTasks(shadowPass,
+			FScenePassState{ ShadowmapPass.PipelineLayout,
+				ShadowmapPass.Pipeline, ShadowmapPass.PipelineCompact, ShadowmapPass.PipelineInstanced, ShadowmapPass.PipelineInstancedCompact,
+				ShadowmapPass.DescriptorSets[CurrentFrame], frameUniforms.Shadow, &ShadowmapPass.DrawBatch },
+			SceneRegistry.Objects.GetPass(EScenePass::Shadow), SceneRegistry.InstancedObjects.GetPass(EScenePass::Shadow), bSceneMultiDrawIndirect);
+		shadowPass.Tasks.push_back([this, &frameUniforms](VkCommandBuffer cmd, FGeometryBinding& binding) {
+			RecordShadowIndirectObjects(cmd, frameUniforms, binding);
+		});
 
-		// 环境反射Cubemap贴图绑定
-		VkDescriptorSetLayoutBinding cubemapLayoutBinding{};
-		cubemapLayoutBinding.binding = 1;
-		cubemapLayoutBinding.descriptorCount = 1;
-		cubemapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		cubemapLayoutBinding.pImmutableSamplers = nullptr;
-		cubemapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+#if ENABLE_DEFEERED_RENDERING
+		// 【延迟渲染】场景写入GBuffer
+		FPassRecording deferredPass;
+		deferredPass.RenderPass = BaseSceneDeferredPass.SceneRenderPass;
+		deferredPass.Framebuffer = BaseSceneDeferredPass.SceneFrameBuffer;
+		deferredPass.SetDynamicState = [this](VkCommandBuffer cmd) { SetViewportDynamicState(cmd, SwapChainExtent); };
+		AddSceneRecordTasks(deferredPass,
+			FScenePassState{ BaseSceneDeferredPass.ScenePipelineLayout,
+				BaseSceneDeferredPass.ScenePipelines[specConstants], BaseSceneDeferredPass.ScenePipelinesCompact[specConstants],
+				BaseSceneDeferredPass.ScenePipelinesInstanced[specConstants], BaseSceneDeferredPass.ScenePipelinesInstancedCompact[specConstants],
+				VK_NULL_HANDLE, frameUniforms.Scene, &BaseSceneDeferredPass.SceneDrawBatch },
+			SceneRegistry.Objects.GetPass(EScenePass::Deferred), SceneRegistry.InstancedObjects.GetPass(EScenePass::Deferred), bSceneMultiDrawIndirect);
+#endif
 
-		// 阴影Shadowmap贴图绑定
-		VkDescriptorSetLayoutBinding shadowmapLayoutBinding{};
-		shadowmapLayoutBinding.binding = 2;
-		shadowmapLayoutBinding.descriptorCount = 1;
-		shadowmapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		shadowmapLayoutBinding.pImmutableSamplers = nullptr;
-		shadowmapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		// 【主场景】背景和延迟渲染灯光、前向渲染的场景、Indirect 场景、天空球，按这个顺序绘制
+		FPassRecording mainPass;
+		mainPass.RenderPass = MainRenderPass;
+		mainPass.Framebuffer = SwapChainFramebuffers[imageIndex];
+		mainPass.SetDynamicState = [this](VkCommandBuffer cmd) { SetViewportDynamicState(cmd, SwapChainExtent); };
+		mainPass.Tasks.push_back([this, &frameUniforms](VkCommandBuffer cmd, FGeometryBinding& binding) {
+			RecordBackground(cmd, frameUniforms);
+		});
+		AddSceneRecordTasks(mainPass,
+			FScenePassState{ BaseScenePass.PipelineLayout,
+				BaseScenePass.Pipelines[specConstants], BaseScenePass.PipelinesCompact[specConstants],
+				BaseScenePass.PipelinesInstanced[specConstants], BaseScenePass.PipelinesInstancedCompact[specConstants],
+				VK_NULL_HANDLE, frameUniforms.Scene, &BaseScenePass.DrawBatch },
+			SceneRegistry.Objects.GetPass(EScenePass::Forward), SceneRegistry.InstancedObjects.GetPass(EScenePass::Forward), bSceneMultiDrawIndirect);
+		mainPass.Tasks.push_back([this, &frameUniforms](VkCommandBuffer cmd, FGeometryBinding& binding) {
+			RecordIndirectObjects(cmd, frameUniforms, binding);
+			RecordSkydome(cmd, frameUniforms, binding);
+		});
+
+		if (bParallelRecording)
+		{
+			SubmitPassRecording(shadowPass, commandCache.RecordContexts);
+#if ENABLE_DEFEERED_RENDERING
+			SubmitPassRecording(deferredPass, commandCache.RecordContexts);
+#endif
+			SubmitPassRecording(mainPass, commandCache.RecordContexts);
+		}
 
-		// 将UnifromBufferObject和贴图采样器绑定到DescriptorSetLayout上
-		std::vector<VkDescriptorSetLayoutBinding> bindings;
-		bindings.resize(9);
-		bindings[0] = viewLayoutBinding;
-		bindings[1] = cubemapLayoutBinding;
-		bindings[2] = shadowmapLayoutBinding;
-		for (size_t i = 0; i < 6; i++)
+		// 【阴影】渲染阴影
 		{
-			VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-			samplerLayoutBinding.binding = static_cast<uint32_t>(i + 3);
-			samplerLayoutBinding.descriptorCount = 1;
-			samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			samplerLayoutBinding.pImmutableSamplers = nullptr;
-			samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = ShadowmapPass.RenderPass;
+			renderPassInfo.framebuffer = ShadowmapPass.FrameBuffer;
+			renderPassInfo.renderArea.extent.width = ShadowmapPass.Width;
+			renderPassInfo.renderArea.extent.height = ShadowmapPass.Height;
+			std::array<VkClearValue, 1> clearValues{};
+			clearValues[0].depthStencil = { 1.0f, 0 };
+			renderPassInfo.clearValueCount = 1;
+			renderPassInfo.pClearValues = clearValues.data();
 
-			bindings[i + 3] = samplerLayoutBinding;
-		}
-		VkDescriptorSetLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
-		if (vkCreateDescriptorSetLayout(Device, &layoutInfo, nullptr, &BaseSceneDeferredPass.LightingDescriptorSetLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to Create descriptor set layout!");
+			RecordPass(commandBuffer, renderPassInfo, shadowPass, geometryBinding, bParallelRecording);
 		}
 
-		/** Create DescriptorPool for Lighting*/
-		std::vector<VkDescriptorPoolSize> poolSizes;
-		poolSizes.resize(9);
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		for (size_t i = 0; i < 6; i++)
+#if ENABLE_DEFEERED_RENDERING
+		// 【延迟渲染】渲染场景
 		{
-			poolSizes[i + 3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			poolSizes[i + 3].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		}
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = BaseSceneDeferredPass.SceneRenderPass;
+			renderPassInfo.framebuffer = BaseSceneDeferredPass.SceneFrameBuffer;
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = SwapChainExtent;
 
-		VkDescriptorPoolCreateInfo poolCI{};
-		poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolCI.pPoolSizes = poolSizes.data();
-		poolCI.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+			std::array<VkClearValue, 6> clearValues{};
+			clearValues[0].depthStencil = { 1.0f, 0 };
+			clearValues[1].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+			clearValues[2].color = { {0.0f, 0.0f, 0.0f, 0.0f} };
+			clearValues[3].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+			clearValues[4].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+			clearValues[5].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
 
-		if (vkCreateDescriptorPool(Device, &poolCI, nullptr, &BaseSceneDeferredPass.LightingDescriptorPool) != VK_SUCCESS) {
-			throw std::runtime_error("failed to Create descriptor pool!");
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
+
+			RecordPass(commandBuffer, renderPassInfo, deferredPass, geometryBinding, bParallelRecording);
 		}
 
-		/** 创建DescriptorSets*/
-		std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, BaseSceneDeferredPass.LightingDescriptorSetLayout);
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = BaseSceneDeferredPass.LightingDescriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		allocInfo.pSetLayouts = layouts.data();
+		VkImageCopy copyRegion = {};
+		copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		copyRegion.srcSubresource.baseArrayLayer = 0;
+		copyRegion.srcSubresource.mipLevel = 0;
+		copyRegion.srcSubresource.layerCount = 1;
+		copyRegion.srcOffset = { 0, 0, 0 };
+		copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		copyRegion.dstSubresource.baseArrayLayer = 0;
+		copyRegion.dstSubresource.mipLevel = 0;
+		copyRegion.dstSubresource.layerCount = 1;
+		copyRegion.dstOffset = { 0, 0, 0 };
+		copyRegion.extent.width = static_cast<uint32_t>(SwapChainExtent.width);
+		copyRegion.extent.height = static_cast<uint32_t>(SwapChainExtent.height);
+		copyRegion.extent.depth = 1;
+
+		BeginTransitionImageLayoutRT(GBuffer.DepthStencilImage, 
+			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		BeginTransitionImageLayoutRT(DepthImage, 
+			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		vkCmdCopyImage(commandBuffer, GBuffer.DepthStencilImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			DepthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		EndTransitionImageLayoutRT(GBuffer.DepthStencilImage, 
+			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		EndTransitionImageLayoutRT(DepthImage, 
+			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+#endif
+
+		// 【主场景】渲染场景
+		{
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = MainRenderPass;
+			renderPassInfo.framebuffer = SwapChainFramebuffers[imageIndex];
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = SwapChainExtent;
+
+			std::array<VkClearValue, 2> clearValues{};
+			clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+			clearValues[1].depthStencil = { 1.0f, 0 };
+
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
 
-		BaseSceneDeferredPass.LightingDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-		if (vkAllocateDescriptorSets(Device, &allocInfo, BaseSceneDeferredPass.LightingDescriptorSets.data()) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate descriptor sets!");
+			RecordPass(commandBuffer, renderPassInfo, mainPass, geometryBinding, bParallelRecording);
 		}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		// 结束记录指令
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
 
-			uint32_t write_size = 9;
-			std::vector<VkWriteDescriptorSet> descriptorWrites{};
-			descriptorWrites.resize(write_size);
+	/** 阴影Pass的动态状态*/
+	void SetShadowDynamicState(VkCommandBuffer commandBuffer)
+	{
+		// 【阴影】视口信息
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)ShadowmapPass.Width;
+		viewport.height = (float)ShadowmapPass.Height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
 
-			// 绑定 UnifromBuffer
-			VkDescriptorBufferInfo viewBufferInfo{};
-			viewBufferInfo.buffer = ViewUniformBuffers[i];
-			viewBufferInfo.offset = 0;
-			viewBufferInfo.range = sizeof(FUniformBufferView);
+		// 【阴影】视口剪切信息
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent.width = ShadowmapPass.Width;
+		scissor.extent.height = ShadowmapPass.Height;
+
+		// 【阴影】设置渲染视口
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		// 【阴影】设置视口剪切，是否可以通过这个函数来实现 Tiled-Based Rendering ？
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Set depth bias (aka "Polygon offset")
+		// Required to avoid shadow mapping artifacts
+		// Depth bias (and slope) are used to avoid shadowing artifacts
+		// Constant depth bias factor (always applied)
+		float depthBiasConstant = 1.25f;
+		// Slope depth bias factor, applied depending on polygon's slope
+		float depthBiasSlope = 7.5; // change from 1.75f to fix PCF artifact
+		vkCmdSetDepthBias(
+			commandBuffer,
+			depthBiasConstant,
+			0.0f,
+			depthBiasSlope);
+	}
 
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &viewBufferInfo;
+	/** 渲染视口和视口剪切，覆盖整个 SwapChain 图像*/
+	void SetViewportDynamicState(VkCommandBuffer commandBuffer, VkExtent2D extent)
+	{
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)extent.width;
+		viewport.height = (float)extent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
 
-			VkDescriptorImageInfo cubemapImageInfo{};
-			cubemapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			cubemapImageInfo.imageView = CubemapImageView;
-			cubemapImageInfo.sampler = CubemapSampler;
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = extent;
 
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pImageInfo = &cubemapImageInfo;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
 
-			VkDescriptorImageInfo shadowmapImageInfo{};
-			shadowmapImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-			shadowmapImageInfo.imageView = ShadowmapPass.ImageView;
-			shadowmapImageInfo.sampler = ShadowmapPass.Sampler;
+	/** 阴影Pass中的 Indirect 物体*/
+	void RecordShadowIndirectObjects(VkCommandBuffer commandBuffer, const FFrameUniforms& frameUniforms, FGeometryBinding& geometryBinding)
+	{
+		// 【阴影】渲染Indirect场景
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ShadowmapPass.Pipeline);
+		BindSceneDescriptorSets(commandBuffer, ShadowmapPass.PipelineLayout, ShadowmapPass.DescriptorSets[CurrentFrame], frameUniforms.Shadow);
+		vkCmdPushConstants(commandBuffer, ShadowmapPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+		const TScenePassList<FRenderIndirectObject>& shadowIndirectObjects = SceneRegistry.IndirectObjects.GetPass(EScenePass::Shadow);
+		for (size_t i = 0; i < shadowIndirectObjects.Num(); i++)
+		{
+			FRenderIndirectObject* RenderIndirectObject = shadowIndirectObjects.Objects[i];
+			BindMeshGeometry(commandBuffer, RenderIndirectObject->MeshData, geometryBinding);
+			uint32_t indirectDrawCount = static_cast<uint32_t>(RenderIndirectObject->IndirectCommands.size());
+			if (DeviceCaps.bMultiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(
+					commandBuffer, /*commandBuffer*/
+					RenderIndirectObject->IndirectCommandsBuffer, /*buffer*/
+					0, /*offset*/
+					indirectDrawCount, /*drawCount*/
+					sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+			}
+			else
+			{
+				// If multi draw is not available, we must issue separate draw commands
+				for (auto j = 0; j < RenderIndirectObject->IndirectCommands.size(); j++)
+				{
+					vkCmdDrawIndexedIndirect(
+						commandBuffer, /*commandBuffer*/
+						RenderIndirectObject->IndirectCommandsBuffer, /*buffer*/
+						j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
+						1, /*drawCount*/
+						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+				}
+			}
+		}
+		// 【阴影】渲染Indirect Instanced 场景
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ShadowmapPass.PipelineInstanced);
+		BindSceneDescriptorSets(commandBuffer, ShadowmapPass.PipelineLayout, ShadowmapPass.DescriptorSets[CurrentFrame], frameUniforms.Shadow);
+		vkCmdPushConstants(commandBuffer, ShadowmapPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+		const TScenePassList<FRenderIndirectInstancedObject>& shadowIndirectInstancedObjects = SceneRegistry.IndirectInstancedObjects.GetPass(EScenePass::Shadow);
+		for (size_t i = 0; i < shadowIndirectInstancedObjects.Num(); i++)
+		{
+			FRenderIndirectInstancedObject* RenderIndirectInstancedObject = shadowIndirectInstancedObjects.Objects[i];
+			BindMeshGeometry(commandBuffer, RenderIndirectInstancedObject->MeshData, geometryBinding);
+			VkBuffer objectInstanceBuffers[] = { RenderIndirectInstancedObject->MeshData.InstancedBuffer };
+			VkDeviceSize objectOffsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectOffsets);
+			uint32_t indirectDrawCount = static_cast<uint32_t>(RenderIndirectInstancedObject->IndirectCommands.size());
+			if (DeviceCaps.bMultiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(
+					commandBuffer, /*commandBuffer*/
+					RenderIndirectInstancedObject->IndirectCommandsBuffer, /*buffer*/
+					0, /*offset*/
+					indirectDrawCount, /*drawCount*/
+					sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+			}
+			else
+			{
+				// If multi draw is not available, we must issue separate draw commands
+				for (auto j = 0; j < RenderIndirectInstancedObject->IndirectCommands.size(); j++)
+				{
+					vkCmdDrawIndexedIndirect(
+						commandBuffer, /*commandBuffer*/
+						RenderIndirectInstancedObject->IndirectCommandsBuffer, /*buffer*/
+						j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
+						1, /*drawCount*/
+						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+				}
+			}
+		}
 
-			descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[2].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
-			descriptorWrites[2].dstBinding = 2;
-			descriptorWrites[2].dstArrayElement = 0;
-			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[2].descriptorCount = 1;
-			descriptorWrites[2].pImageInfo = &shadowmapImageInfo;
+	}
 
-			std::vector<VkImageView> ImageViews;
-			ImageViews.resize(6);
-			std::vector<VkSampler> Samplers;
-			Samplers.resize(6);
-			ImageViews[0] = GBuffer.DepthStencilImageView;
-			ImageViews[1] = GBuffer.SceneColorImageView;
-			ImageViews[2] = GBuffer.GBufferAImageView;
-			ImageViews[3] = GBuffer.GBufferBImageView;
-			ImageViews[4] = GBuffer.GBufferCImageView;
-			ImageViews[5] = GBuffer.GBufferDImageView;
-			Samplers[0] = GBuffer.DepthStencilSampler;
-			Samplers[1] = GBuffer.SceneColorSampler;
-			Samplers[2] = GBuffer.GBufferASampler;
-			Samplers[3] = GBuffer.GBufferBSampler;
-			Samplers[4] = GBuffer.GBufferCSampler;
-			Samplers[5] = GBuffer.GBufferDSampler;
-			// 绑定 Textures
-			// descriptorWrites会引用每一个创建的VkDescriptorImageInfo，所以需要用一个数组把它们存储起来
-			std::vector<VkDescriptorImageInfo> imageInfos;
-			imageInfos.resize(ImageViews.size());
-			for (size_t j = 0; j < ImageViews.size(); j++)
-			{
-				VkDescriptorImageInfo imageInfo{};
-				imageInfo.imageLayout = (j == 0) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				imageInfo.imageView = ImageViews[j];
-				imageInfo.sampler = Samplers[j];
-				imageInfos[j] = imageInfo;
+	/** 主场景的背景面片，以及延迟渲染的灯光*/
+	void RecordBackground(VkCommandBuffer commandBuffer, const FFrameUniforms& frameUniforms)
+	{
+		// 【主场景】渲染背景面片
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BackgroundPass.Pipelines[0]);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BackgroundPass.PipelineLayout, 0, 1, &BackgroundPass.DescriptorSets[CurrentFrame], frameUniforms.Scene.Count, frameUniforms.Scene.Offsets);
+		vkCmdPushConstants(commandBuffer, BackgroundPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+		vkCmdDraw(commandBuffer, 6, 1, 0, 0);
 
-				descriptorWrites[j + 3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				descriptorWrites[j + 3].dstSet = BaseSceneDeferredPass.LightingDescriptorSets[i];
-				descriptorWrites[j + 3].dstBinding = static_cast<uint32_t>(j + 3);
-				descriptorWrites[j + 3].dstArrayElement = 0;
-				descriptorWrites[j + 3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				descriptorWrites[j + 3].descriptorCount = 1;
-				descriptorWrites[j + 3].pImageInfo = &imageInfos[j];
-			}
+#if ENABLE_DEFEERED_RENDERING
+		// 【主场景】渲染延迟渲染灯光
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BaseSceneDeferredPass.LightingPipelines[GlobalConstants.SpecConstants]);
+		BindSceneDescriptorSets(commandBuffer, BaseSceneDeferredPass.LightingPipelineLayout, BaseSceneDeferredPass.LightingDescriptorSets[CurrentFrame], frameUniforms.Lighting);
+		vkCmdPushConstants(commandBuffer, BaseSceneDeferredPass.LightingPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+		vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+#endif
+	}
 
-			vkUpdateDescriptorSets(Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	/** 主场景中的 Indirect 物体，普通物体只绘制主相机可见的簇*/
+	void RecordIndirectObjects(VkCommandBuffer commandBuffer, const FFrameUniforms& frameUniforms, FGeometryBinding& geometryBinding)
+	{
+		// 【主场景】渲染 Indirect 场景
+		const TScenePassList<FRenderIndirectObject>& indirectObjects = SceneRegistry.IndirectObjects.GetPass(EScenePass::Indirect);
+		for (size_t i = 0; i < indirectObjects.Num(); i++)
+		{
+			VkPipeline indirectScenePassPipeline = BaseSceneIndirectPass.Pipelines[GlobalConstants.SpecConstants];
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectScenePassPipeline);
+			const FRenderIndirectObject& RenderIndirectObject = *indirectObjects.Objects[i];
+			BindMeshGeometry(commandBuffer, RenderIndirectObject.MeshData, geometryBinding);
+			BindSceneDescriptorSets(commandBuffer, BaseSceneIndirectPass.PipelineLayout, RenderIndirectObject.MateData.DescriptorSets[CurrentFrame], frameUniforms.Scene);
+			vkCmdPushConstants(commandBuffer, BaseSceneIndirectPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+			// 只绘制这一帧主相机可见的簇
+			uint32_t indirectDrawCount = RenderIndirectObject.VisibleCommandCount;
+			if (indirectDrawCount == 0)
+			{
+				continue;
+			}
+			if (DeviceCaps.bMultiDrawIndirect)
+			{
+				/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+				//01 void FakeDrawIndexedIndirect(VkCommandBuffer commandBuffer, void* buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+				//02 {
+				//03 	char* memory = (char*)buffer + offset;
+				//04 
+				//05 	for (uint32_t i = 0; i < drawCount; i++)
+				//06 	{
+				//07 		VkDrawIndexedIndirectCommand* command = (VkDrawIndexedIndirectCommand*)(memory + (i * stride));
+				//08 
+				//09 		vkCmdDrawIndexed(commandBuffer,
+				//10 			command->indexCount,
+				//11 			command->instanceCount,
+				//12 			command->firstIndex,
+				//13 			command->vertexOffset,
+				//14 			command->firstInstance);
+				//15 	}
+				//16 }
+				vkCmdDrawIndexedIndirect(
+					commandBuffer, /*commandBuffer*/
+					RenderIndirectObject.VisibleCommandsBuffer, /*buffer*/
+					RenderIndirectObject.VisibleCommandsOffset, /*offset*/
+					indirectDrawCount, /*drawCount*/
+					sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+			}
+			else
+			{
+				// If multi draw is not available, we must issue separate draw commands
+				for (uint32_t j = 0; j < indirectDrawCount; j++)
+				{
+					vkCmdDrawIndexedIndirect(
+						commandBuffer, /*commandBuffer*/
+						RenderIndirectObject.VisibleCommandsBuffer, /*buffer*/
+						RenderIndirectObject.VisibleCommandsOffset + j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
+						1, /*drawCount*/
+						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+				}
+			}
 		}
+		// 【主场景】渲染 Indirect Instanced 场景
+		const TScenePassList<FRenderIndirectInstancedObject>& indirectInstancedObjects = SceneRegistry.IndirectInstancedObjects.GetPass(EScenePass::Indirect);
+		for (size_t i = 0; i < indirectInstancedObjects.Num(); i++)
+		{
+			VkPipeline indirectScenePassPipelineInstanced = BaseSceneIndirectPass.PipelinesInstanced[GlobalConstants.SpecConstants];
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectScenePassPipelineInstanced);
+			const FRenderIndirectInstancedObject& RenderIndirectInstancedObject = *indirectInstancedObjects.Objects[i];
+			BindMeshGeometry(commandBuffer, RenderIndirectInstancedObject.MeshData, geometryBinding);
+			VkBuffer objectInstanceBuffers[] = { RenderIndirectInstancedObject.MeshData.InstancedBuffer };
+			VkDeviceSize objectOffsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectOffsets);
+			BindSceneDescriptorSets(commandBuffer, BaseSceneIndirectPass.PipelineLayout, RenderIndirectInstancedObject.MateData.DescriptorSets[CurrentFrame], frameUniforms.Scene);
+			vkCmdPushConstants(commandBuffer, BaseSceneIndirectPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+			uint32_t indirectDrawCount = static_cast<uint32_t>(RenderIndirectInstancedObject.IndirectCommands.size());
+			if (DeviceCaps.bMultiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(
+					commandBuffer, /*commandBuffer*/
+					RenderIndirectInstancedObject.IndirectCommandsBuffer, /*buffer*/
+					0, /*offset*/
+					indirectDrawCount, /*drawCount*/
+					sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+			}
+			else
+			{
+				// If multi draw is not available, we must issue separate draw commands
+				for (auto j = 0; j < RenderIndirectInstancedObject.IndirectCommands.size(); j++)
+				{
+					vkCmdDrawIndexedIndirect(
+						commandBuffer, /*commandBuffer*/
+						RenderIndirectInstancedObject.IndirectCommandsBuffer, /*buffer*/
+						j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
+						1, /*drawCount*/
+						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
+				}
+			}
+		}
+	}
 
-		CreatePipelineLayout(BaseSceneDeferredPass.LightingPipelineLayout, BaseSceneDeferredPass.LightingDescriptorSetLayout);
-		BaseSceneDeferredPass.LightingPipelines.resize(GlobalConstants.SpecConstantsCount);
-		CreateGraphicsPipelinesDeferred(
-			BaseSceneDeferredPass.LightingPipelines,
-			BaseSceneDeferredPass.LightingPipelineLayout,
-			MainRenderPass,
-			GlobalConstants.SpecConstantsCount, ScreenRect, DeferredLighting,
-			"Resources/Shaders/draw_with_deferred_bg_vert.spv",
-			"Resources/Shaders/draw_with_deferred_lighting_frag.spv");
-
-		CreateBaseSceneResources();
+	/** 主场景的天空球，最后绘制*/
+	void RecordSkydome(VkCommandBuffer commandBuffer, const FFrameUniforms& frameUniforms, FGeometryBinding& geometryBinding)
+	{
+		// 【主场景】渲染天空球
+		if (SCENE_SHOW_SKYDOME && GlobalConstants.SpecConstants == 0 /* Don't render sky on debug mode*/)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, SkydomePass.Pipelines[0]);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, SkydomePass.PipelineLayout, 0, 1, &SkydomePass.DescriptorSets[CurrentFrame], frameUniforms.Scene.Count, frameUniforms.Scene.Offsets);
+			BindMeshGeometry(commandBuffer, SkydomePass.SkydomeMesh, geometryBinding);
+			vkCmdDrawIndexed(commandBuffer, SkydomePass.SkydomeMesh.IndexCount, 1, SkydomePass.SkydomeMesh.FirstIndex, SkydomePass.SkydomeMesh.VertexOffset, 0);
+		}
 	}
 
-	void CreateBaseSceneResources()
+	/** 创建同步物体，同步显示当前渲染*/
+	void CreateSyncObjects()
 	{
-		FRenderObject terrain;
-		std::string terrain_obj = "Resources/Models/terrain.obj";
-		std::vector<std::string> terrain_imgs = {
-				"Resources/Textures/terrain_bc.png",		// BaseColor
-				"Resources/Textures/default_black.png",		// Metallic
-				"Resources/Textures/terrain_r.png",			// Roughness
-				"Resources/Textures/terrain_n.png",			// Normal
-				"Resources/Textures/terrain_ao.png",		// AmbientOcclution
-				"Resources/Textures/default_black.png",		// Emissive
-				"Resources/Textures/default_white.png" };	// Mask
+		ImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+		RenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+		InFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
-		FRenderObject rock01;
-		float rock01_zone = 1.0f;
-		std::string rock01_obj = "Resources/Models/rock_01.obj";
-		std::vector<std::string> rock01_imgs = {
-				"Resources/Textures/rock_01_bc.png",		// BaseColor
-				"Resources/Textures/default_black.png",		// Metallic
-				"Resources/Textures/rock_01_r.png",			// Roughness
-				"Resources/Textures/rock_01_n.png",			// Normal
-				"Resources/Textures/default_white.png",		// AmbientOcclution
-				"Resources/Textures/default_black.png",		// Emissive
-				"Resources/Textures/default_white.png" };	// Mask
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		FRenderInstancedObject rock02;
-		std::string rock02_obj = "Resources/Models/rock_02.obj";
-		std::vector<std::string> rock02_imgs = {
-				"Resources/Textures/rock_02_bc.png",			// BaseColor
-				"Resources/Textures/default_black.png",		// Metallic
-				"Resources/Textures/rock_02_r.png",			// Roughness
-				"Resources/Textures/rock_02_n.png",			// Normal
-				"Resources/Textures/default_white.png",		// AmbientOcclution
-				"Resources/Textures/default_black.png",		// Emissive
-				"Resources/Textures/default_white.png" };	// Mask
-		std::vector<FInstanceData> rock_InstanceData;
-		uint32_t rock_InstanceCount = 64;
-		rock_InstanceData.resize(rock_InstanceCount);
-		for (uint32_t i = 0; i < rock_InstanceCount; i++) {
-			float radians = (((float)RandRange(0, 3600) / 10.0f));
-			float distance = (((float)RandRange(0, 500) / 100.0f)) + rock01_zone;
-			float X = sin(glm::radians(radians)) * distance;
-			float Y = cos(glm::radians(radians)) * distance;
-			float Z = 0.0;
-			rock_InstanceData[i].InstancePosition = glm::vec3(X, Y, Z);
-			// Y(Pitch), Z(Yaw), X(Roll)
-			float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
-			rock_InstanceData[i].InstanceRotation = glm::vec3(0.0, Yaw, 0.0);
-			rock_InstanceData[i].InstancePScale = RandRange(2, 5) / 10.0f;
-			rock_InstanceData[i].InstanceTexIndex = RandRange(0, 255);
-		}
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-		FRenderInstancedObject grass01;
-		std::string grass01_obj = "Resources/Models/grass_01.obj";
-		FRenderInstancedObject grass02;
-		std::string grass02_obj = "Resources/Models/grass_02.obj";
-		std::vector<std::string> grass_imgs = {
-				"Resources/Textures/grass_bc.png",			// BaseColor
-				"Resources/Textures/default_black.png",		// Metallic
-				"Resources/Textures/grass_r.png",			// Roughness
-				"Resources/Textures/grass_n.png",			// Normal
-				"Resources/Textures/grass_ao.png",			// AmbientOcclution
-				"Resources/Textures/grass_ev.png",			// Emissive
-				"Resources/Textures/grass_ms.png" };		// Mask
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			if (vkCreateSemaphore(Device, &semaphoreInfo, nullptr, &ImageAvailableSemaphores[i]) != VK_SUCCESS ||
+				vkCreateSemaphore(Device, &semaphoreInfo, nullptr, &RenderFinishedSemaphores[i]) != VK_SUCCESS ||
+				vkCreateFence(Device, &fenceInfo, nullptr, &InFlightFences[i]) != VK_SUCCESS) {
 
-		std::vector<FInstanceData> grass01_InstanceData;
-		uint32_t grass01_InstanceCount = INSTANCE_COUNT;
-		grass01_InstanceData.resize(grass01_InstanceCount);
-		for (uint32_t i = 0; i < grass01_InstanceCount; i++) {
-			float radians = (((float)RandRange(0, 3600) / 10.0f));
-			float distance = (((float)RandRange(0, 800) / 100.0f)) + rock01_zone * 2.0f;
-			float X = sin(glm::radians(radians)) * distance;
-			float Y = cos(glm::radians(radians)) * distance;
-			float Z = 0.0;
-			grass01_InstanceData[i].InstancePosition = glm::vec3(X, Y, Z);
-			// Y(Pitch), Z(Yaw), X(Roll)
-			float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
-			grass01_InstanceData[i].InstanceRotation = glm::vec3(0.0, Yaw, 0.0);
-			grass01_InstanceData[i].InstancePScale = RandRange(1, 5) / 10.0f;
-			grass01_InstanceData[i].InstanceTexIndex = RandRange(0, 255);
+				throw std::runtime_error("failed to Create synchronization objects for a frame!");
+			}
 		}
+	}
 
-		std::vector<FInstanceData> grass_02_InstanceData;
-		uint32_t grass02_InstanceCount = INSTANCE_COUNT;
-		grass_02_InstanceData.resize(grass02_InstanceCount);
-		for (uint32_t i = 0; i < grass02_InstanceCount; i++) {
-			float radians = (((float)RandRange(0, 3600) / 10.0f));
-			float distance = (((float)RandRange(0, 900) / 100.0f)) + rock01_zone;
-			float X = sin(glm::radians(radians)) * distance;
-			float Y = cos(glm::radians(radians)) * distance;
-			float Z = 0.0;
-			grass_02_InstanceData[i].InstancePosition = glm::vec3(X, Y, Z);
-			// Y(Pitch), Z(Yaw), X(Roll)
-			float Yaw = float(M_PI) * RandRange(0, 99) / 100.0f;
-			grass_02_InstanceData[i].InstanceRotation = glm::vec3(0.0, Yaw, 0.0);
-			grass_02_InstanceData[i].InstancePScale = RandRange(1, 5) / 10.0f;
-			grass_02_InstanceData[i].InstanceTexIndex = RandRange(0, 255);
+	/** 删除函数 InitVulkan 中创建的元素*/
+	void DestroyVulkan()
+	{
+		ReclaimUploadBatches(true);
+		// 还没有开始上传的流式任务直接丢弃，已经提交的等待完成，加入渲染列表后和其他物体一起销毁
+		StreamingTasks.clear();
+		// 等待解码线程退出，解码结果会写入环形StagingBuffer
+		AssetLoadJobs.reset();
+		TickStreamingUploads(true);
+
+		// CommandBuffer 不需要释放
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			vkDestroySemaphore(Device, RenderFinishedSemaphores[i], nullptr);
+			vkDestroySemaphore(Device, ImageAvailableSemaphores[i], nullptr);
+			vkDestroyFence(Device, InFlightFences[i], nullptr);
 		}
 
-#if !ENABLE_DEFEERED_RENDERING
-		CreateRenderObject<FRenderObject>(terrain, terrain_obj, terrain_imgs, BaseScenePass.DescriptorSetLayout);
-		BaseScenePass.RenderObjects.push_back(terrain);
+		vkDestroyRenderPass(Device, MainRenderPass, nullptr);
 
-		CreateRenderObject<FRenderObject>(rock01, rock01_obj, rock01_imgs, BaseScenePass.DescriptorSetLayout);
-		BaseScenePass.RenderObjects.push_back(rock01);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			vkDestroyBuffer(Device, UniformRings[i].Buffer, nullptr);
+			MemoryAllocator.Free(UniformRings[i].Memory);
+		}
 
-		CreateRenderObject<FRenderInstancedObject>(rock02, rock02_obj, rock02_imgs, BaseScenePass.DescriptorSetLayout);
-		CreateInstancedBuffer<FRenderInstancedObject>(rock02, rock_InstanceData);
-		BaseScenePass.RenderInstancedObjects.push_back(rock02);
+		vkDestroyImageView(Device, CubemapImageView, nullptr);
+		vkDestroySampler(Device, CubemapSampler, nullptr);
+		vkDestroyImage(Device, CubemapImage, nullptr);
+		MemoryAllocator.Free(CubemapImageMemory);
 
-		CreateRenderObject<FRenderInstancedObject>(grass01, grass01_obj, grass_imgs, BaseScenePass.DescriptorSetLayout);
-		CreateInstancedBuffer<FRenderInstancedObject>(grass01, grass01_InstanceData);
-		BaseScenePass.RenderInstancedObjects.push_back(grass01);
+		// 清理 ShadowmapPass
+		vkDestroyRenderPass(Device, ShadowmapPass.RenderPass, nullptr);
+		vkDestroyFramebuffer(Device, ShadowmapPass.FrameBuffer, nullptr);
+		vkDestroyDescriptorPool(Device, ShadowmapPass.DescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(Device, ShadowmapPass.DescriptorSetLayout, nullptr);
+		vkDestroyPipelineLayout(Device, ShadowmapPass.PipelineLayout, nullptr);
+		vkDestroyPipeline(Device, ShadowmapPass.Pipeline, nullptr);
+		vkDestroyPipeline(Device, ShadowmapPass.PipelineInstanced, nullptr);
+		vkDestroyPipeline(Device, ShadowmapPass.PipelineCompact, nullptr);
+		vkDestroyPipeline(Device, ShadowmapPass.PipelineInstancedCompact, nullptr);
+		vkDestroyImageView(Device, ShadowmapPass.ImageView, nullptr);
+		vkDestroySampler(Device, ShadowmapPass.Sampler, nullptr);
+		vkDestroyImage(Device, ShadowmapPass.Image, nullptr);
+		MemoryAllocator.Free(ShadowmapPass.Memory);
 
-		CreateRenderObject<FRenderInstancedObject>(grass02, grass02_obj, grass_imgs, BaseScenePass.DescriptorSetLayout);
-		CreateInstancedBuffer<FRenderInstancedObject>(grass02, grass_02_InstanceData);
-		BaseScenePass.RenderInstancedObjects.push_back(grass02);
-#else
-		CreateRenderObject<FRenderObject>(terrain, terrain_obj, terrain_imgs, BaseSceneDeferredPass.SceneDescriptorSetLayout);
-		BaseSceneDeferredPass.RenderObjects.push_back(terrain);
+		// 清理 SkydomePass
+		vkDestroyDescriptorSetLayout(Device, SkydomePass.DescriptorSetLayout, nullptr);
+		vkDestroyPipelineLayout(Device, SkydomePass.PipelineLayout, nullptr);
+		vkDestroyPipeline(Device, SkydomePass.Pipelines[0], nullptr);
+		vkDestroyDescriptorPool(Device, SkydomePass.DescriptorPool, nullptr);
+		vkDestroyImageView(Device, SkydomePass.ImageView, nullptr);
+		vkDestroySampler(Device, SkydomePass.Sampler, nullptr);
+		vkDestroyImage(Device, SkydomePass.Image, nullptr);
+		MemoryAllocator.Free(SkydomePass.Memory);
+		FreeMeshGeometry(SkydomePass.SkydomeMesh);
 
-		CreateRenderObject<FRenderObject>(rock01, rock01_obj, rock01_imgs, BaseSceneDeferredPass.SceneDescriptorSetLayout);
-		BaseSceneDeferredPass.RenderObjects.push_back(rock01);
+		// 清理 BackgroundPass
+		vkDestroyDescriptorSetLayout(Device, BackgroundPass.DescriptorSetLayout, nullptr);
+		vkDestroyPipelineLayout(Device, BackgroundPass.PipelineLayout, nullptr);
+		vkDestroyPipeline(Device, BackgroundPass.Pipelines[0], nullptr);
+		vkDestroyDescriptorPool(Device, BackgroundPass.DescriptorPool, nullptr);
+		vkDestroyImageView(Device, BackgroundPass.ImageView, nullptr);
+		vkDestroySampler(Device, BackgroundPass.Sampler, nullptr);
+		vkDestroyImage(Device, BackgroundPass.Image, nullptr);
+		MemoryAllocator.Free(BackgroundPass.Memory);
 
-		CreateRenderObject<FRenderInstancedObject>(rock02, rock02_obj, rock02_imgs, BaseSceneDeferredPass.SceneDescriptorSetLayout);
-		CreateInstancedBuffer<FRenderInstancedObject>(rock02, rock_InstanceData);
-		BaseSceneDeferredPass.RenderInstancedObjects.push_back(rock02);
+		// 清理 BaseScenePass
+		vkDestroyDescriptorSetLayout(Device, BaseScenePass.DescriptorSetLayout, nullptr);
+		vkDestroyPipelineLayout(Device, BaseScenePass.PipelineLayout, nullptr);
+		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
+		{
+			vkDestroyPipeline(Device, BaseScenePass.Pipelines[i], nullptr);
+			vkDestroyPipeline(Device, BaseScenePass.PipelinesInstanced[i], nullptr);
+			vkDestroyPipeline(Device, BaseScenePass.PipelinesCompact[i], nullptr);
+			vkDestroyPipeline(Device, BaseScenePass.PipelinesInstancedCompact[i], nullptr);
+		}
 
-		CreateRenderObject<FRenderInstancedObject>(grass01, grass01_obj, grass_imgs, BaseSceneDeferredPass.SceneDescriptorSetLayout);
-		CreateInstancedBuffer<FRenderInstancedObject>(grass01, grass01_InstanceData);
-		BaseSceneDeferredPass.RenderInstancedObjects.push_back(grass01);
+		// 清理场景注册表中的所有物体
+		SceneRegistry.Objects.ForEach([this](FRenderObject& renderObject) {
+			vkDestroyDescriptorPool(Device, renderObject.MateData.DescriptorPool, nullptr);
 
-		CreateRenderObject<FRenderInstancedObject>(grass02, grass02_obj, grass_imgs, BaseSceneDeferredPass.SceneDescriptorSetLayout);
-		CreateInstancedBuffer<FRenderInstancedObject>(grass02, grass_02_InstanceData);
-		BaseSceneDeferredPass.RenderInstancedObjects.push_back(grass02);
-#endif
-	}
+			ReleaseMaterialTextures(renderObject.MateData);
 
-	void CreateBackgroundPass()
-	{
-		// 创建背景贴图
-		CreateImageContext(
-			BackgroundPass.Image,
-			BackgroundPass.Memory,
-			BackgroundPass.ImageView,
-			BackgroundPass.Sampler,
-			"Resources/Textures/background.png");
-		CreateDescriptorSetLayout(BackgroundPass.DescriptorSetLayout);
-		CreateDescriptorPool(BackgroundPass.DescriptorPool);
-		CreateDescriptorSets(
-			BackgroundPass.DescriptorSets,
-			BackgroundPass.DescriptorPool,
-			BackgroundPass.DescriptorSetLayout,
-			BackgroundPass.ImageView,
-			BackgroundPass.Sampler);
-		BackgroundPass.Pipelines.resize(1);
-		CreatePipelineLayout(BackgroundPass.PipelineLayout, BackgroundPass.DescriptorSetLayout);
+			FreeMeshGeometry(renderObject.MeshData);
+		});
+		SceneRegistry.InstancedObjects.ForEach([this](FRenderInstancedObject& renderInstancedObject) {
+			vkDestroyDescriptorPool(Device, renderInstancedObject.MateData.DescriptorPool, nullptr);
 
-		CreateGraphicsPipelines(
-			BackgroundPass.Pipelines,
-			BackgroundPass.PipelineLayout, 
-			MainRenderPass,
-			1,
-			"Resources/Shaders/draw_with_deferred_bg_vert.spv",
-			"Resources/Shaders/draw_with_deferred_bg_frag.spv",
-			false/*bDepthTest*/, false/*bCullBack*/, false/*bInstanced*/);
-	}
+			ReleaseMaterialTextures(renderInstancedObject.MateData);
 
-	void CreateSkydomePass()
-	{
-		// 创建环境反射纹理资源
-		CreateCubemapResources();
+			vkDestroyBuffer(Device, renderInstancedObject.MeshData.InstancedBuffer, nullptr);
+			MemoryAllocator.Free(renderInstancedObject.MeshData.InstancedBufferMemory);
+			FreeMeshGeometry(renderInstancedObject.MeshData);
+		});
+		SceneRegistry.IndirectObjects.ForEach([this](FRenderIndirectObject& RenderIndirectObject) {
+			vkDestroyDescriptorPool(Device, RenderIndirectObject.MateData.DescriptorPool, nullptr);
 
-		// HDRI texture map
-		// @see https://polyhaven.com/a/preller_drive
-		CreateImageContext(
-			SkydomePass.Image,
-			SkydomePass.Memory,
-			SkydomePass.ImageView,
-			SkydomePass.Sampler,
-			"Resources/Textures/skydome.png");
-		CreateDescriptorSetLayout(SkydomePass.DescriptorSetLayout);
-		CreateDescriptorPool(SkydomePass.DescriptorPool);
-		CreateDescriptorSets(
-			SkydomePass.DescriptorSets,
-			SkydomePass.DescriptorPool,
-			SkydomePass.DescriptorSetLayout,
-			SkydomePass.ImageView,
-			SkydomePass.Sampler);
-		SkydomePass.Pipelines.resize(1);
-		CreatePipelineLayout(SkydomePass.PipelineLayout, SkydomePass.DescriptorSetLayout);
-		CreateGraphicsPipelines(
-			SkydomePass.Pipelines,
-			SkydomePass.PipelineLayout,
-			MainRenderPass,
-			1,
-			"Resources/Shaders/draw_with_deferred_sky_vert.spv",
-			"Resources/Shaders/draw_with_deferred_sky_frag.spv",
-			true/*bDepthTest*/, true/*bCullBack*/, false/*bInstanced*/);
+			ReleaseMaterialTextures(RenderIndirectObject.MateData);
+			FreeMeshGeometry(RenderIndirectObject.MeshData);
+			vkDestroyBuffer(Device, RenderIndirectObject.IndirectCommandsBuffer, nullptr);
+			MemoryAllocator.Free(RenderIndirectObject.IndirectCommandsBufferMemory);
+			vkDestroyBuffer(Device, RenderIndirectObject.VisibleCommandsBuffer, nullptr);
+			MemoryAllocator.Free(RenderIndirectObject.VisibleCommandsBufferMemory);
+		});
+		SceneRegistry.IndirectInstancedObjects.ForEach([this](FRenderIndirectInstancedObject& RenderIndirectInstancedObject) {
+			vkDestroyDescriptorPool(Device, RenderIndirectInstancedObject.MateData.DescriptorPool, nullptr);
 
-		std::string skydome_obj = "Resources/Models/skydome.obj";
-		CreateMesh(SkydomePass.SkydomeMesh.Vertices, SkydomePass.SkydomeMesh.Indices, skydome_obj);
-		CreateVertexBuffer(
-			SkydomePass.SkydomeMesh.VertexBuffer,
-			SkydomePass.SkydomeMesh.VertexBufferMemory,
-			SkydomePass.SkydomeMesh.Vertices);
-		CreateIndexBuffer(
-			SkydomePass.SkydomeMesh.IndexBuffer,
-			SkydomePass.SkydomeMesh.IndexBufferMemory,
-			SkydomePass.SkydomeMesh.Indices);
-	}
-
-	/** 创建指令缓存，多个CPU Core可以并行的往CommandBuffer中发送指令，可以充分利用CPU的多核性能*/
-	void CreateCommandBuffer()
-	{
-		CommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+			ReleaseMaterialTextures(RenderIndirectInstancedObject.MateData);
 
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = CommandPool;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = (uint32_t)CommandBuffers.size();
+			vkDestroyBuffer(Device, RenderIndirectInstancedObject.MeshData.InstancedBuffer, nullptr);
+			MemoryAllocator.Free(RenderIndirectInstancedObject.MeshData.InstancedBufferMemory);
+			FreeMeshGeometry(RenderIndirectInstancedObject.MeshData);
+			vkDestroyBuffer(Device, RenderIndirectInstancedObject.IndirectCommandsBuffer, nullptr);
+			MemoryAllocator.Free(RenderIndirectInstancedObject.IndirectCommandsBufferMemory);
+		});
 
-		if (vkAllocateCommandBuffers(Device, &allocInfo, CommandBuffers.data()) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate command buffers!");
+		// 清理 BaseSceneIndirectPass
+		vkDestroyDescriptorSetLayout(Device, BaseSceneIndirectPass.DescriptorSetLayout, nullptr);
+		vkDestroyPipelineLayout(Device, BaseSceneIndirectPass.PipelineLayout, nullptr);
+		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
+		{
+			vkDestroyPipeline(Device, BaseSceneIndirectPass.Pipelines[i], nullptr);
+			vkDestroyPipeline(Device, BaseSceneIndirectPass.PipelinesInstanced[i], nullptr);
 		}
-	}
 
-	/** 把需要执行的指令写入指令缓存，对应每一个SwapChain的图像*/
-	void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
-	{
-		auto BeginTransitionImageLayoutRT = [commandBuffer](VkImage & image, const VkImageAspectFlagBits aspectMask, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+		// 清理 BaseSceneDeferredPass
+#if ENABLE_DEFEERED_RENDERING
+		vkDestroyDescriptorSetLayout(Device, BaseSceneDeferredPass.LightingDescriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(Device, BaseSceneDeferredPass.LightingDescriptorPool, nullptr);
+		vkDestroyPipelineLayout(Device, BaseSceneDeferredPass.LightingPipelineLayout, nullptr);
+		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
 		{
-			VkImageMemoryBarrier barrier{};
-			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			barrier.oldLayout = oldLayout;
-			barrier.newLayout = newLayout;
-			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.image = image;
-			barrier.subresourceRange.aspectMask = aspectMask;
-			barrier.subresourceRange.baseMipLevel = 0;
-			barrier.subresourceRange.levelCount = 1;
-			barrier.subresourceRange.baseArrayLayer = 0;
-			barrier.subresourceRange.layerCount = 1;
-
-			VkPipelineStageFlags sourceStage;
-			VkPipelineStageFlags destinationStage;
-
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkDestroyPipeline(Device, BaseSceneDeferredPass.LightingPipelines[i], nullptr);
+		}
+		vkDestroyRenderPass(Device, BaseSceneDeferredPass.SceneRenderPass, nullptr);
+		vkDestroyFramebuffer(Device, BaseSceneDeferredPass.SceneFrameBuffer, nullptr);
+		vkDestroyDescriptorSetLayout(Device, BaseSceneDeferredPass.SceneDescriptorSetLayout, nullptr);
+		vkDestroyPipelineLayout(Device, BaseSceneDeferredPass.ScenePipelineLayout, nullptr);
+		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
+		{
+			vkDestroyPipeline(Device, BaseSceneDeferredPass.ScenePipelines[i], nullptr);
+			vkDestroyPipeline(Device, BaseSceneDeferredPass.ScenePipelinesInstanced[i], nullptr);
+			vkDestroyPipeline(Device, BaseSceneDeferredPass.ScenePipelinesCompact[i], nullptr);
+			vkDestroyPipeline(Device, BaseSceneDeferredPass.ScenePipelinesInstancedCompact[i], nullptr);
+		}
+		vkDestroyImageView(Device, GBuffer.DepthStencilImageView, nullptr);
+		vkDestroySampler(Device, GBuffer.DepthStencilSampler, nullptr);
+		vkDestroyImage(Device, GBuffer.DepthStencilImage, nullptr);
+		MemoryAllocator.Free(GBuffer.DepthStencilMemory);
+		vkDestroyImageView(Device, GBuffer.SceneColorImageView, nullptr);
+		vkDestroySampler(Device, GBuffer.SceneColorSampler, nullptr);
+		vkDestroyImage(Device, GBuffer.SceneColorImage, nullptr);
+		MemoryAllocator.Free(GBuffer.SceneColorMemory);
+		vkDestroyImageView(Device, GBuffer.GBufferAImageView, nullptr);
+		vkDestroySampler(Device, GBuffer.GBufferASampler, nullptr);
+		vkDestroyImage(Device, GBuffer.GBufferAImage, nullptr);
+		MemoryAllocator.Free(GBuffer.GBufferAMemory);
+		vkDestroyImageView(Device, GBuffer.GBufferBImageView, nullptr);
+		vkDestroySampler(Device, GBuffer.GBufferBSampler, nullptr);
+		vkDestroyImage(Device, GBuffer.GBufferBImage, nullptr);
+		MemoryAllocator.Free(GBuffer.GBufferBMemory);
+		vkDestroyImageView(Device, GBuffer.GBufferCImageView, nullptr);
+		vkDestroySampler(Device, GBuffer.GBufferCSampler, nullptr);
+		vkDestroyImage(Device, GBuffer.GBufferCImage, nullptr);
+		MemoryAllocator.Free(GBuffer.GBufferCMemory);
+		vkDestroyImageView(Device, GBuffer.GBufferDImageView, nullptr);
+		vkDestroySampler(Device, GBuffer.GBufferDSampler, nullptr);
+		vkDestroyImage(Device, GBuffer.GBufferDImage, nullptr);
+		MemoryAllocator.Free(GBuffer.GBufferDMemory);
+#endif
 
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		DestroySceneDrawResources();
+		DestroyGeometryPools();
+		DestroyStreamingUploader();
+		DestroyRecordJobs();
+		DestroyCommandBuffer();
+		vkDestroyCommandPool(Device, CommandPool, nullptr);
 
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				sourceStage, destinationStage,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &barrier
-			);
-		};
+		LogMemoryStats();
+		MemoryAllocator.Destroy();
+		vkDestroyDevice(Device, nullptr);
 
-		auto EndTransitionImageLayoutRT = [commandBuffer](VkImage& image, const VkImageAspectFlagBits aspectMask, const VkImageLayout oldLayout, const VkImageLayout newLayout)
+		if (bEnableValidationLayers)
 		{
-			VkImageMemoryBarrier barrier{};
-			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			barrier.oldLayout = oldLayout;
-			barrier.newLayout = newLayout;
-			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			barrier.image = image;
-			barrier.subresourceRange.aspectMask = aspectMask;
-			barrier.subresourceRange.baseMipLevel = 0;
-			barrier.subresourceRange.levelCount = 1;
-			barrier.subresourceRange.baseArrayLayer = 0;
-			barrier.subresourceRange.layerCount = 1;
-
-			VkPipelineStageFlags sourceStage;
-			VkPipelineStageFlags destinationStage;
-
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			DestroyDebugUtilsMessengerEXT(Instance, DebugMessenger, nullptr);
+		}
 
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		vkDestroySurfaceKHR(Instance, Surface, nullptr);
+		vkDestroyInstance(Instance, nullptr);
+	}
 
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				sourceStage, destinationStage,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &barrier
-			);
-		};
+protected:
+	/** 选择SwapChain渲染到视图的图像的格式*/
+	VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+	{
+		// 找到合适的图像格式
+		// VK_FORMAT_B8G8R8A8_SRGB 将图像BGRA存储在 unsigned normalized format 中，使用SRGB 非线性编码，颜色空间为非线性空间，不用Gamma矫正最终结果
+		// VK_FORMAT_R8G8B8A8_UNORM 将图像BGRA存储在 unsigned normalized format 中，颜色空间为线性空间，像素的最终输出颜色需要Gamma矫正
+		for (const auto& availableFormat : availableFormats)
+		{
+			// 将 FrameBuffer Image 设置为线性空间，方便 PBR 的工作流以及颜色矫正（ColorCorrection）
+			//if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+			if (availableFormat.format == VK_FORMAT_R8G8B8A8_UNORM)
+			{
+				return availableFormat;
+			}
+		}
 
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		return availableFormats[0];
+	}
 
-		// 开始记录指令
-		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	/** 选择SwapChain的显示方式
+	 * VK_PRESENT_MODE_IMMEDIATE_KHR 图形立即显示在屏幕上，会出现图像撕裂
+	 * VK_PRESENT_MODE_FIFO_KHR 图像会被推入一个队列，先入后出显示到屏幕，如果队列满了，程序会等待，和垂直同步相似
+	 * VK_PRESENT_MODE_FIFO_RELAXED_KHR 基于第二个Mode，当队列满了，程序不会等待，而是直接渲染到屏幕，会出现图像撕裂
+	 * VK_PRESENT_MODE_MAILBOX_KHR 基于第二个Mode，当队列满了，程序不会等待，而是直接替换队列中的图像，
+	*/
+	VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+	{
+		for (const auto& availablePresentMode : availablePresentModes)
 		{
-			throw std::runtime_error("failed to begin recording command buffer!");
+			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+			{
+				return availablePresentMode;
+			}
 		}
 
-		// 【阴影】渲染阴影
-		{
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = ShadowmapPass.RenderPass;
-			renderPassInfo.framebuffer = ShadowmapPass.FrameBuffer;
-			renderPassInfo.renderArea.extent.width = ShadowmapPass.Width;
-			renderPassInfo.renderArea.extent.height = ShadowmapPass.Height;
-			std::array<VkClearValue, 1> clearValues{};
-			clearValues[0].depthStencil = { 1.0f, 0 };
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = clearValues.data();
+		return VK_PRESENT_MODE_FIFO_KHR;
+	}
 
-			// 【阴影】开始 RenderPass
-			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& Capabilities)
+	{
+		if (Capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+		{
+			return Capabilities.currentExtent;
+		}
+		else
+		{
+			int Width, Height;
+			glfwGetFramebufferSize(Window, &Width, &Height);
 
-			// 【阴影】视口信息
-			VkViewport viewport{};
-			viewport.x = 0.0f;
-			viewport.y = 0.0f;
-			viewport.width = (float)ShadowmapPass.Width;
-			viewport.height = (float)ShadowmapPass.Height;
-			viewport.minDepth = 0.0f;
-			viewport.maxDepth = 1.0f;
-
-			// 【阴影】视口剪切信息
-			VkRect2D scissor{};
-			scissor.offset = { 0, 0 };
-			scissor.extent.width = ShadowmapPass.Width;
-			scissor.extent.height = ShadowmapPass.Height;
-
-			// 【阴影】设置渲染视口
-			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-			// 【阴影】设置视口剪切，是否可以通过这个函数来实现 Tiled-Based Rendering ？
-			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-			// Set depth bias (aka "Polygon offset")
-			// Required to avoid shadow mapping artifacts
-			// Depth bias (and slope) are used to avoid shadowing artifacts
-			// Constant depth bias factor (always applied)
-			float depthBiasConstant = 1.25f;
-			// Slope depth bias factor, applied depending on polygon's slope
-			float depthBiasSlope = 7.5; // change from 1.75f to fix PCF artifact
-			vkCmdSetDepthBias(
-				commandBuffer,
-				depthBiasConstant,
-				0.0f,
-				depthBiasSlope);
+			VkExtent2D actualExtent = {
+				static_cast<uint32_t>(Width),
+				static_cast<uint32_t>(Height)
+			};
 
-			// 【阴影】渲染场景
-			for (size_t i = 0; i < ShadowmapPass.RenderObjects.size(); i++)
-			{
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ShadowmapPass.Pipeline);
-				FRenderObject* renderObject = ShadowmapPass.RenderObjects[i];
-				VkBuffer objectVertexBuffers[] = { renderObject->MeshData.VertexBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, 0, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, renderObject->MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-					ShadowmapPass.PipelineLayout, 0, 1, &ShadowmapPass.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, ShadowmapPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderObject->MeshData.Indices.size()), 1, 0, 0, 0);
-			}
-			// 【阴影】渲染 Instanced 场景
-			for (size_t i = 0; i < ShadowmapPass.RenderInstancedObjects.size(); i++)
-			{
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ShadowmapPass.PipelineInstanced);
-				FRenderInstancedObject* renderInstancedObject = ShadowmapPass.RenderInstancedObjects[i];
-				VkBuffer objectVertexBuffers[] = { renderInstancedObject->MeshData.VertexBuffer };
-				VkBuffer objectInstanceBuffers[] = { renderInstancedObject->MeshData.InstancedBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, renderInstancedObject->MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-					ShadowmapPass.PipelineLayout, 0, 1, &ShadowmapPass.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, ShadowmapPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderInstancedObject->MeshData.Indices.size()), renderInstancedObject->InstanceCount, 0, 0, 0);
-			}
-			// 【阴影】渲染Indirect场景
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ShadowmapPass.Pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				ShadowmapPass.PipelineLayout, 0, 1, &ShadowmapPass.DescriptorSets[CurrentFrame], 0, nullptr);
-			vkCmdPushConstants(commandBuffer, ShadowmapPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-			for (size_t i = 0; i < ShadowmapPass.RenderIndirectObject.size(); i++)
-			{
-				FRenderIndirectObject* RenderIndirectObject = ShadowmapPass.RenderIndirectObject[i];
-				VkBuffer objectVertexBuffers[] = { RenderIndirectObject->MeshData.VertexBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, 0, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, RenderIndirectObject->MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				uint32_t indirectDrawCount = static_cast<uint32_t>(RenderIndirectObject->IndirectCommands.size());
-				if (IsSupportMultiDrawIndirect(PhysicalDevice))
-				{
-					vkCmdDrawIndexedIndirect(
-						commandBuffer, /*commandBuffer*/
-						RenderIndirectObject->IndirectCommandsBuffer, /*buffer*/
-						0, /*offset*/
-						indirectDrawCount, /*drawCount*/
-						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-				}
-				else
-				{
-					// If multi draw is not available, we must issue separate draw commands
-					for (auto j = 0; j < RenderIndirectObject->IndirectCommands.size(); j++)
-					{
-						vkCmdDrawIndexedIndirect(
-							commandBuffer, /*commandBuffer*/
-							RenderIndirectObject->IndirectCommandsBuffer, /*buffer*/
-							j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
-							1, /*drawCount*/
-							sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-					}
-				}
-			}
-			// 【阴影】渲染Indirect Instanced 场景
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ShadowmapPass.PipelineInstanced);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-				ShadowmapPass.PipelineLayout, 0, 1, &ShadowmapPass.DescriptorSets[CurrentFrame], 0, nullptr);
-			vkCmdPushConstants(commandBuffer, ShadowmapPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-			for (size_t i = 0; i < ShadowmapPass.RenderIndirectInstancedObject.size(); i++)
-			{
-				FRenderIndirectInstancedObject* RenderIndirectInstancedObject = ShadowmapPass.RenderIndirectInstancedObject[i];
-				VkBuffer objectVertexBuffers[] = { RenderIndirectInstancedObject->MeshData.VertexBuffer };
-				VkBuffer objectInstanceBuffers[] = { RenderIndirectInstancedObject->MeshData.InstancedBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, RenderIndirectInstancedObject->MeshData.IndexBuffer, 0 , VK_INDEX_TYPE_UINT32);
-				uint32_t indirectDrawCount = static_cast<uint32_t>(RenderIndirectInstancedObject->IndirectCommands.size());
-				if (IsSupportMultiDrawIndirect(PhysicalDevice))
-				{
-					vkCmdDrawIndexedIndirect(
-						commandBuffer, /*commandBuffer*/
-						RenderIndirectInstancedObject->IndirectCommandsBuffer, /*buffer*/
-						0, /*offset*/
-						indirectDrawCount, /*drawCount*/
-						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-				}
-				else
-				{
-					// If multi draw is not available, we must issue separate draw commands
-					for (auto j = 0; j < RenderIndirectInstancedObject->IndirectCommands.size(); j++)
-					{
-						vkCmdDrawIndexedIndirect(
-							commandBuffer, /*commandBuffer*/
-							RenderIndirectInstancedObject->IndirectCommandsBuffer, /*buffer*/
-							j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
-							1, /*drawCount*/
-							sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-					}
-				}
-			}
+			actualExtent.width = std::clamp(actualExtent.width, Capabilities.minImageExtent.width, Capabilities.maxImageExtent.width);
+			actualExtent.height = std::clamp(actualExtent.height, Capabilities.minImageExtent.height, Capabilities.maxImageExtent.height);
 
-			// 【阴影】结束 RenderPass
-			vkCmdEndRenderPass(commandBuffer);
+			return actualExtent;
 		}
+	}
 
-		// 渲染视口信息
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)SwapChainExtent.width;
-		viewport.height = (float)SwapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
+	FSwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice Device)
+	{
+		FSwapChainSupportDetails details;
 
-		// 视口剪切信息
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = SwapChainExtent;
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Device, Surface, &details.Capabilities);
 
-#if ENABLE_DEFEERED_RENDERING
-		// 【延迟渲染】渲染场景
+		uint32_t formatCount;
+		vkGetPhysicalDeviceSurfaceFormatsKHR(Device, Surface, &formatCount, nullptr);
+
+		if (formatCount != 0)
 		{
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = BaseSceneDeferredPass.SceneRenderPass;
-			renderPassInfo.framebuffer = BaseSceneDeferredPass.SceneFrameBuffer;
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = SwapChainExtent;
+			details.Formats.resize(formatCount);
+			vkGetPhysicalDeviceSurfaceFormatsKHR(Device, Surface, &formatCount, details.Formats.data());
+		}
 
-			std::array<VkClearValue, 6> clearValues{};
-			clearValues[0].depthStencil = { 1.0f, 0 };
-			clearValues[1].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-			clearValues[2].color = { {0.0f, 0.0f, 0.0f, 0.0f} };
-			clearValues[3].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-			clearValues[4].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-			clearValues[5].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+		uint32_t presentModeCount;
+		vkGetPhysicalDeviceSurfacePresentModesKHR(Device, Surface, &presentModeCount, nullptr);
 
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
+		if (presentModeCount != 0)
+		{
+			details.PresentModes.resize(presentModeCount);
+			vkGetPhysicalDeviceSurfacePresentModesKHR(Device, Surface, &presentModeCount, details.PresentModes.data());
+		}
 
-			// 【延迟渲染】开始 RenderPass
-			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		return details;
+	}
 
-			// 【延迟渲染】渲染场景
-			for (size_t i = 0; i < BaseSceneDeferredPass.RenderObjects.size(); i++)
-			{
-				uint32_t SpecConstants = GlobalConstants.SpecConstants;
-				VkPipeline baseScenePassPipeline = BaseSceneDeferredPass.ScenePipelines[SpecConstants];
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, baseScenePassPipeline);
-				FRenderObject renderObject = BaseSceneDeferredPass.RenderObjects[i];
-				VkBuffer objectVertexBuffers[] = { renderObject.MeshData.VertexBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, 0, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, renderObject.MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(
-					commandBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					BaseSceneDeferredPass.ScenePipelineLayout, 0, 1,
-					&renderObject.MateData.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, BaseSceneDeferredPass.ScenePipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderObject.MeshData.Indices.size()), 1, 0, 0, 0);
-			}
-			// 【延迟渲染】渲染 Instanced 场景
-			for (size_t i = 0; i < BaseSceneDeferredPass.RenderInstancedObjects.size(); i++)
-			{
-				uint32_t SpecConstants = GlobalConstants.SpecConstants;
-				VkPipeline BaseScenePassPipelineInstanced = BaseSceneDeferredPass.ScenePipelinesInstanced[SpecConstants];
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BaseScenePassPipelineInstanced);
-				FRenderInstancedObject renderInstancedObject = BaseSceneDeferredPass.RenderInstancedObjects[i];
-				VkBuffer objectVertexBuffers[] = { renderInstancedObject.MeshData.VertexBuffer };
-				VkBuffer objectInstanceBuffers[] = { renderInstancedObject.MeshData.InstancedBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, renderInstancedObject.MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(
-					commandBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					BaseSceneDeferredPass.ScenePipelineLayout, 0, 1,
-					&renderInstancedObject.MateData.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, BaseSceneDeferredPass.ScenePipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderInstancedObject.MeshData.Indices.size()), renderInstancedObject.InstanceCount, 0, 0, 0);
-			}
-
-			// 【延迟渲染】结束RenderPass
-			vkCmdEndRenderPass(commandBuffer);
-		}
+	/** 检测硬件是否合适*/
+	bool IsDeviceSuitable(VkPhysicalDevice Device)
+	{
+		FQueueFamilyIndices queue_family_indices = FindQueueFamilies(Device);
 
-		VkImageCopy copyRegion = {};
-		copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		copyRegion.srcSubresource.baseArrayLayer = 0;
-		copyRegion.srcSubresource.mipLevel = 0;
-		copyRegion.srcSubresource.layerCount = 1;
-		copyRegion.srcOffset = { 0, 0, 0 };
-		copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		copyRegion.dstSubresource.baseArrayLayer = 0;
-		copyRegion.dstSubresource.mipLevel = 0;
-		copyRegion.dstSubresource.layerCount = 1;
-		copyRegion.dstOffset = { 0, 0, 0 };
-		copyRegion.extent.width = static_cast<uint32_t>(SwapChainExtent.width);
-		copyRegion.extent.height = static_cast<uint32_t>(SwapChainExtent.height);
-		copyRegion.extent.depth = 1;
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(Device, nullptr, &extensionCount, nullptr);
 
-		BeginTransitionImageLayoutRT(GBuffer.DepthStencilImage, 
-			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-		BeginTransitionImageLayoutRT(DepthImage, 
-			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		vkCmdCopyImage(commandBuffer, GBuffer.DepthStencilImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			DepthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-		EndTransitionImageLayoutRT(GBuffer.DepthStencilImage, 
-			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-		EndTransitionImageLayoutRT(DepthImage, 
-			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-#endif
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(Device, nullptr, &extensionCount, availableExtensions.data());
 
-		// 【主场景】渲染场景
+		std::set<std::string> requiredExtensions(DeviceExtensions.begin(), DeviceExtensions.end());
+
+		for (const auto& extension : availableExtensions)
 		{
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = MainRenderPass;
-			renderPassInfo.framebuffer = SwapChainFramebuffers[imageIndex];
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = SwapChainExtent;
+			requiredExtensions.erase(extension.extensionName);
+		}
 
-			std::array<VkClearValue, 2> clearValues{};
-			clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-			clearValues[1].depthStencil = { 1.0f, 0 };
+		bool extensionsSupported = requiredExtensions.empty();
 
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
+		bool swapChainAdequate = false;
+		if (extensionsSupported)
+		{
+			FSwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(Device);
+			swapChainAdequate = !swapChainSupport.Formats.empty() && !swapChainSupport.PresentModes.empty();
+		}
 
-			// 【主场景】开始 RenderPass
-			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// 各向异性过滤是可选的，记录在 FDeviceCapabilities 中
+		return queue_family_indices.IsComplete() && extensionsSupported && swapChainAdequate;
+	}
 
-			// 【主场景】设置渲染视口
-			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	/** 队列家族 Queue Family
+	 * 找到所有支持Vulkan的显卡硬件
+	*/
+	FQueueFamilyIndices FindQueueFamilies(VkPhysicalDevice Device)
+	{
+		FQueueFamilyIndices queue_family_indices;
 
-			// 【主场景】设置视口剪切，是否可以通过这个函数来实现 Tiled-Based Rendering ？
-			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(Device, &queueFamilyCount, nullptr);
 
-			// 【主场景】渲染背景面片
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BackgroundPass.Pipelines[0]);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BackgroundPass.PipelineLayout, 0, 1, &BackgroundPass.DescriptorSets[CurrentFrame], 0, nullptr);
-			vkCmdPushConstants(commandBuffer, BackgroundPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-			vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(Device, &queueFamilyCount, queueFamilies.data());
 
-#if ENABLE_DEFEERED_RENDERING
-			// 【主场景】渲染延迟渲染灯光
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BaseSceneDeferredPass.LightingPipelines[GlobalConstants.SpecConstants]);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BaseSceneDeferredPass.LightingPipelineLayout, 0, 1, &BaseSceneDeferredPass.LightingDescriptorSets[CurrentFrame], 0, nullptr);
-			vkCmdPushConstants(commandBuffer, BaseSceneDeferredPass.LightingPipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-			vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-#endif
-			// 【主场景】渲染场景
-			for (size_t i = 0; i < BaseScenePass.RenderObjects.size(); i++)
-			{
-				VkPipeline baseScenePassPipeline = BaseScenePass.Pipelines[GlobalConstants.SpecConstants];
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, baseScenePassPipeline);
-				FRenderObject renderObject = BaseScenePass.RenderObjects[i];
-				VkBuffer objectVertexBuffers[] = { renderObject.MeshData.VertexBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, 0, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, renderObject.MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(
-					commandBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					BaseScenePass.PipelineLayout, 0, 1,
-					&renderObject.MateData.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, BaseScenePass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderObject.MeshData.Indices.size()), 1, 0, 0, 0);
-			}
-			// 【主场景】渲染 Instanced 场景
-			for (size_t i = 0; i < BaseScenePass.RenderInstancedObjects.size(); i++)
-			{
-				VkPipeline BaseScenePassPipelineInstanced = BaseScenePass.PipelinesInstanced[GlobalConstants.SpecConstants];
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, BaseScenePassPipelineInstanced);
-				FRenderInstancedObject renderInstancedObject = BaseScenePass.RenderInstancedObjects[i];
-				VkBuffer objectVertexBuffers[] = { renderInstancedObject.MeshData.VertexBuffer };
-				VkBuffer objectInstanceBuffers[] = { renderInstancedObject.MeshData.InstancedBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, renderInstancedObject.MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(
-					commandBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					BaseScenePass.PipelineLayout, 0, 1,
-					&renderInstancedObject.MateData.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, BaseScenePass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderInstancedObject.MeshData.Indices.size()), renderInstancedObject.InstanceCount, 0, 0, 0);
-			}
-			// 【主场景】渲染 Indirect 场景
-			for (size_t i = 0; i < BaseSceneIndirectPass.RenderIndirectObject.size(); i++)
+		int i = 0;
+		for (const auto& queueFamily : queueFamilies)
+		{
+			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 			{
-				VkPipeline indirectScenePassPipeline = BaseSceneIndirectPass.Pipelines[GlobalConstants.SpecConstants];
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectScenePassPipeline);
-				FRenderIndirectObject RenderIndirectObject = BaseSceneIndirectPass.RenderIndirectObject[i];
-				VkBuffer objectVertexBuffers[] = { RenderIndirectObject.MeshData.VertexBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, 0, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, RenderIndirectObject.MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(
-					commandBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					BaseSceneIndirectPass.PipelineLayout, 0, 1,
-					&RenderIndirectObject.MateData.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, BaseSceneIndirectPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				uint32_t indirectDrawCount = static_cast<uint32_t>(RenderIndirectObject.IndirectCommands.size());
-				if (IsSupportMultiDrawIndirect(PhysicalDevice))
-				{
-					/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-					//01 void FakeDrawIndexedIndirect(VkCommandBuffer commandBuffer, void* buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
-					//02 {
-					//03 	char* memory = (char*)buffer + offset;
-					//04 
-					//05 	for (uint32_t i = 0; i < drawCount; i++)
-					//06 	{
-					//07 		VkDrawIndexedIndirectCommand* command = (VkDrawIndexedIndirectCommand*)(memory + (i * stride));
-					//08 
-					//09 		vkCmdDrawIndexed(commandBuffer,
-					//10 			command->indexCount,
-					//11 			command->instanceCount,
-					//12 			command->firstIndex,
-					//13 			command->vertexOffset,
-					//14 			command->firstInstance);
-					//15 	}
-					//16 }
-					vkCmdDrawIndexedIndirect(
-						commandBuffer, /*commandBuffer*/
-						RenderIndirectObject.IndirectCommandsBuffer, /*buffer*/
-						0, /*offset*/
-						indirectDrawCount, /*drawCount*/
-						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-				}
-				else
-				{
-					// If multi draw is not available, we must issue separate draw commands
-					for (auto j = 0; j < RenderIndirectObject.IndirectCommands.size(); j++)
-					{
-						vkCmdDrawIndexedIndirect(
-							commandBuffer, /*commandBuffer*/
-							RenderIndirectObject.IndirectCommandsBuffer, /*buffer*/
-							j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
-							1, /*drawCount*/
-							sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-					}
-				}
+				queue_family_indices.GraphicsFamily = i;
 			}
-			// 【主场景】渲染 Indirect Instanced 场景
-			for (size_t i = 0; i < BaseSceneIndirectPass.RenderIndirectInstancedObject.size(); i++)
+
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(Device, i, Surface, &presentSupport);
+
+			if (presentSupport)
 			{
-				VkPipeline indirectScenePassPipelineInstanced = BaseSceneIndirectPass.PipelinesInstanced[GlobalConstants.SpecConstants];
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectScenePassPipelineInstanced);
-				FRenderIndirectInstancedObject RenderIndirectInstancedObject = BaseSceneIndirectPass.RenderIndirectInstancedObject[i];
-				VkBuffer objectVertexBuffers[] = { RenderIndirectInstancedObject.MeshData.VertexBuffer };
-				VkBuffer objectInstanceBuffers[] = { RenderIndirectInstancedObject.MeshData.InstancedBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				// Binding point 0 : Mesh vertex buffer
-				vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, objectVertexBuffers, objectOffsets);
-				// Binding point 1 : Instance data buffer
-				vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, RenderIndirectInstancedObject.MeshData.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(
-					commandBuffer,
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					BaseSceneIndirectPass.PipelineLayout, 0, 1,
-					&RenderIndirectInstancedObject.MateData.DescriptorSets[CurrentFrame], 0, nullptr);
-				vkCmdPushConstants(commandBuffer, BaseSceneIndirectPass.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
-				uint32_t indirectDrawCount = static_cast<uint32_t>(RenderIndirectInstancedObject.IndirectCommands.size());
-				if (IsSupportMultiDrawIndirect(PhysicalDevice))
-				{
-					vkCmdDrawIndexedIndirect(
-						commandBuffer, /*commandBuffer*/
-						RenderIndirectInstancedObject.IndirectCommandsBuffer, /*buffer*/
-						0, /*offset*/
-						indirectDrawCount, /*drawCount*/
-						sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-				}
-				else
-				{
-					// If multi draw is not available, we must issue separate draw commands
-					for (auto j = 0; j < RenderIndirectInstancedObject.IndirectCommands.size(); j++)
-					{
-						vkCmdDrawIndexedIndirect(
-							commandBuffer, /*commandBuffer*/
-							RenderIndirectInstancedObject.IndirectCommandsBuffer, /*buffer*/
-							j * sizeof(VkDrawIndexedIndirectCommand), /*offset*/
-							1, /*drawCount*/
-							sizeof(VkDrawIndexedIndirectCommand) /*stride*/);
-					}
-				}
+				queue_family_indices.PresentFamily = i;
 			}
 
-			// 【主场景】渲染天空球
-			if (SCENE_SHOW_SKYDOME && GlobalConstants.SpecConstants == 0 /* Don't render sky on debug mode*/)
+			if (queue_family_indices.IsComplete())
 			{
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, SkydomePass.Pipelines[0]);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, SkydomePass.PipelineLayout, 0, 1, &SkydomePass.DescriptorSets[CurrentFrame], 0, nullptr);
-				VkBuffer objectVertexBuffers[] = { SkydomePass.SkydomeMesh.VertexBuffer };
-				VkDeviceSize objectOffsets[] = { 0 };
-				vkCmdBindVertexBuffers(commandBuffer, 0, 1, objectVertexBuffers, objectOffsets);
-				vkCmdBindIndexBuffer(commandBuffer, SkydomePass.SkydomeMesh.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(SkydomePass.SkydomeMesh.Indices.size()), 1, 0, 0, 0);
+				break;
 			}
 
-			// 【主场景】结束RenderPass
-			vkCmdEndRenderPass(commandBuffer);
+			i++;
 		}
 
-		// 结束记录指令
-		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		// 只支持传输的队列族一般对应显卡的DMA引擎，可以和渲染并行拷贝数据
+		// 要求拷贝粒度为1个像素，这样Mip链末尾很小的级别也可以拷贝
+		for (uint32_t j = 0; j < queueFamilyCount; j++)
 		{
-			throw std::runtime_error("failed to record command buffer!");
+			const VkQueueFamilyProperties& properties = queueFamilies[j];
+			const VkExtent3D& granularity = properties.minImageTransferGranularity;
+			if ((properties.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+				!(properties.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+				granularity.width == 1 && granularity.height == 1 && granularity.depth == 1)
+			{
+				queue_family_indices.TransferFamily = j;
+				break;
+			}
+		}
+
+		return queue_family_indices;
+	}
+
+	/** 找到物理硬件支持的图片格式*/
+	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+		for (VkFormat format : candidates) {
+			VkFormatProperties props;
+			vkGetPhysicalDeviceFormatProperties(PhysicalDevice, format, &props);
+
+			if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
+				return format;
+			}
+			else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+				return format;
+			}
 		}
-	}
-
-	/** 创建同步物体，同步显示当前渲染*/
-	void CreateSyncObjects()
-	{
-		ImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		RenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		InFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
-		VkSemaphoreCreateInfo semaphoreInfo{};
-		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		throw std::runtime_error("failed to find supported format!");
+	}
 
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	/** 找到支持深度贴图的格式*/
+	VkFormat FindDepthFormat() {
+		return FindSupportedFormat(
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+		);
+	}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			if (vkCreateSemaphore(Device, &semaphoreInfo, nullptr, &ImageAvailableSemaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(Device, &semaphoreInfo, nullptr, &RenderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(Device, &fenceInfo, nullptr, &InFlightFences[i]) != VK_SUCCESS) {
+	/** 查找内存类型*/
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+	{
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &memProperties);
 
-				throw std::runtime_error("failed to Create synchronization objects for a frame!");
+		// 自动寻找适合的内存类型
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
 			}
 		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
 	}
 
-	/** 删除函数 InitVulkan 中创建的元素*/
-	void DestroyVulkan()
+	VkCommandBuffer BeginSingleTimeCommands()
 	{
-		// CommandBuffer 不需要释放
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			vkDestroySemaphore(Device, RenderFinishedSemaphores[i], nullptr);
-			vkDestroySemaphore(Device, ImageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(Device, InFlightFences[i], nullptr);
+		// 正在录制上传批次时，直接录制到批次的CommandBuffer中
+		if (UploadBatch.Depth > 0) {
+			UploadBatch.CommandCount++;
+			return UploadBatch.CommandBuffer;
 		}
 
-		vkDestroyRenderPass(Device, MainRenderPass, nullptr);
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			vkDestroyBuffer(Device, BaseUniformBuffers[i], nullptr);
-			vkFreeMemory(Device, BaseUniformBuffersMemory[i], nullptr);
-		}
+		// 和渲染一样，使用commandBuffer拷贝缓存
+		return BeginOneTimeCommandBuffer(CommandPool);
+	}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			vkDestroyBuffer(Device, ViewUniformBuffers[i], nullptr);
-			vkFreeMemory(Device, ViewUniformBuffersMemory[i], nullptr);
-		}
+	/** 从指令池中分配一个只提交一次的CommandBuffer并开始录制*/
+	VkCommandBuffer BeginOneTimeCommandBuffer(VkCommandPool commandPool)
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
 
-		vkDestroyImageView(Device, CubemapImageView, nullptr);
-		vkDestroySampler(Device, CubemapSampler, nullptr);
-		vkDestroyImage(Device, CubemapImage, nullptr);
-		vkFreeMemory(Device, CubemapImageMemory, nullptr);
+		VkCommandBuffer commandBuffer;
+		vkAllocateCommandBuffers(Device, &allocInfo, &commandBuffer);
 
-		// 清理 ShadowmapPass
-		vkDestroyRenderPass(Device, ShadowmapPass.RenderPass, nullptr);
-		vkDestroyFramebuffer(Device, ShadowmapPass.FrameBuffer, nullptr);
-		vkDestroyDescriptorPool(Device, ShadowmapPass.DescriptorPool, nullptr);
-		vkDestroyDescriptorSetLayout(Device, ShadowmapPass.DescriptorSetLayout, nullptr);
-		vkDestroyPipelineLayout(Device, ShadowmapPass.PipelineLayout, nullptr);
-		vkDestroyPipeline(Device, ShadowmapPass.Pipeline, nullptr);
-		vkDestroyPipeline(Device, ShadowmapPass.PipelineInstanced, nullptr);
-		vkDestroyImageView(Device, ShadowmapPass.ImageView, nullptr);
-		vkDestroySampler(Device, ShadowmapPass.Sampler, nullptr);
-		vkDestroyImage(Device, ShadowmapPass.Image, nullptr);
-		vkFreeMemory(Device, ShadowmapPass.Memory, nullptr);
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			vkDestroyBuffer(Device, ShadowmapPass.UniformBuffers[i], nullptr);
-			vkFreeMemory(Device, ShadowmapPass.UniformBuffersMemory[i], nullptr);
-		}
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		// 清理 SkydomePass
-		vkDestroyDescriptorSetLayout(Device, SkydomePass.DescriptorSetLayout, nullptr);
-		vkDestroyPipelineLayout(Device, SkydomePass.PipelineLayout, nullptr);
-		vkDestroyPipeline(Device, SkydomePass.Pipelines[0], nullptr);
-		vkDestroyDescriptorPool(Device, SkydomePass.DescriptorPool, nullptr);
-		vkDestroyImageView(Device, SkydomePass.ImageView, nullptr);
-		vkDestroySampler(Device, SkydomePass.Sampler, nullptr);
-		vkDestroyImage(Device, SkydomePass.Image, nullptr);
-		vkFreeMemory(Device, SkydomePass.Memory, nullptr);
-		vkDestroyBuffer(Device, SkydomePass.SkydomeMesh.VertexBuffer, nullptr);
-		vkFreeMemory(Device, SkydomePass.SkydomeMesh.VertexBufferMemory, nullptr);
-		vkDestroyBuffer(Device, SkydomePass.SkydomeMesh.IndexBuffer, nullptr);
-		vkFreeMemory(Device, SkydomePass.SkydomeMesh.IndexBufferMemory, nullptr);
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-		// 清理 BackgroundPass
-		vkDestroyDescriptorSetLayout(Device, BackgroundPass.DescriptorSetLayout, nullptr);
-		vkDestroyPipelineLayout(Device, BackgroundPass.PipelineLayout, nullptr);
-		vkDestroyPipeline(Device, BackgroundPass.Pipelines[0], nullptr);
-		vkDestroyDescriptorPool(Device, BackgroundPass.DescriptorPool, nullptr);
-		vkDestroyImageView(Device, BackgroundPass.ImageView, nullptr);
-		vkDestroySampler(Device, BackgroundPass.Sampler, nullptr);
-		vkDestroyImage(Device, BackgroundPass.Image, nullptr);
-		vkFreeMemory(Device, BackgroundPass.Memory, nullptr);
+		return commandBuffer;
+	}
 
-		// 清理 BaseScenePass
-		vkDestroyDescriptorSetLayout(Device, BaseScenePass.DescriptorSetLayout, nullptr);
-		vkDestroyPipelineLayout(Device, BaseScenePass.PipelineLayout, nullptr);
-		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
-		{
-			vkDestroyPipeline(Device, BaseScenePass.Pipelines[i], nullptr);
-			vkDestroyPipeline(Device, BaseScenePass.PipelinesInstanced[i], nullptr);
+	void EndSingleTimeCommands(VkCommandBuffer commandBuffer)
+	{
+		// 上传批次在 SubmitUploadBatch 中统一提交
+		if (UploadBatch.Depth > 0) {
+			return;
 		}
-		for (size_t i = 0; i < BaseScenePass.RenderObjects.size(); i++)
-		{
-			FRenderObject& renderObject = BaseScenePass.RenderObjects[i];
 
-			vkDestroyDescriptorPool(Device, renderObject.MateData.DescriptorPool, nullptr);
+		vkEndCommandBuffer(commandBuffer);
 
-			for (size_t j = 0; j < renderObject.MateData.TextureImages.size(); j++)
-			{
-				vkDestroyImageView(Device, renderObject.MateData.TextureImageViews[j], nullptr);
-				vkDestroySampler(Device, renderObject.MateData.TextureSamplers[j], nullptr);
-				vkDestroyImage(Device, renderObject.MateData.TextureImages[j], nullptr);
-				vkFreeMemory(Device, renderObject.MateData.TextureImageMemorys[j], nullptr);
-			}
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
 
-			vkDestroyBuffer(Device, renderObject.MeshData.VertexBuffer, nullptr);
-			vkFreeMemory(Device, renderObject.MeshData.VertexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, renderObject.MeshData.IndexBuffer, nullptr);
-			vkFreeMemory(Device, renderObject.MeshData.IndexBufferMemory, nullptr);
-		}
-		for (size_t i = 0; i < BaseScenePass.RenderInstancedObjects.size(); i++)
-		{
-			FRenderInstancedObject& renderInstancedObject = BaseScenePass.RenderInstancedObjects[i];
+		vkQueueSubmit(GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		vkQueueWaitIdle(GraphicsQueue);
 
-			vkDestroyDescriptorPool(Device, renderInstancedObject.MateData.DescriptorPool, nullptr);
+		vkFreeCommandBuffers(Device, CommandPool, 1, &commandBuffer);
+	}
 
-			for (size_t j = 0; j < renderInstancedObject.MateData.TextureImages.size(); j++)
-			{
-				vkDestroyImageView(Device, renderInstancedObject.MateData.TextureImageViews[j], nullptr);
-				vkDestroySampler(Device, renderInstancedObject.MateData.TextureSamplers[j], nullptr);
-				vkDestroyImage(Device, renderInstancedObject.MateData.TextureImages[j], nullptr);
-				vkFreeMemory(Device, renderInstancedObject.MateData.TextureImageMemorys[j], nullptr);
-			}
+	/** 开始一个加载步骤的上传批次，之后的 BeginSingleTimeCommands/EndSingleTimeCommands 都录制到同一个CommandBuffer*/
+	void BeginUploadBatch()
+	{
+		if (UploadBatch.Depth > 0) {
+			UploadBatch.Depth++;
+			return;
+		}
 
-			vkDestroyBuffer(Device, renderInstancedObject.MeshData.InstancedBuffer, nullptr);
-			vkFreeMemory(Device, renderInstancedObject.MeshData.InstancedBufferMemory, nullptr);
-			vkDestroyBuffer(Device, renderInstancedObject.MeshData.VertexBuffer, nullptr);
-			vkFreeMemory(Device, renderInstancedObject.MeshData.VertexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, renderInstancedObject.MeshData.IndexBuffer, nullptr);
-			vkFreeMemory(Device, renderInstancedObject.MeshData.IndexBufferMemory, nullptr);
+		UploadBatch.CommandBuffer = BeginSingleTimeCommands();
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(Device, &fenceInfo, nullptr, &UploadBatch.Fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload batch fence!");
 		}
+		UploadBatch.Depth = 1;
+	}
 
-		// 清理 BaseSceneIndirectPass
-		vkDestroyDescriptorSetLayout(Device, BaseSceneIndirectPass.DescriptorSetLayout, nullptr);
-		vkDestroyPipelineLayout(Device, BaseSceneIndirectPass.PipelineLayout, nullptr);
-		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
-		{
-			vkDestroyPipeline(Device, BaseSceneIndirectPass.Pipelines[i], nullptr);
-			vkDestroyPipeline(Device, BaseSceneIndirectPass.PipelinesInstanced[i], nullptr);
+	/** 结束上传批次并提交一次，不等待GPU完成，StagingBuffer在 ReclaimUploadBatches 中释放*/
+	void SubmitUploadBatch()
+	{
+		if (--UploadBatch.Depth > 0) {
+			return;
+		}
+		if (UploadBatch.CommandCount == 0) {
+			// 流式上传时加载步骤中可能没有任何上传
+			vkEndCommandBuffer(UploadBatch.CommandBuffer);
+			vkFreeCommandBuffers(Device, CommandPool, 1, &UploadBatch.CommandBuffer);
+			vkDestroyFence(Device, UploadBatch.Fence, nullptr);
+			UploadBatch = FUploadBatch{};
+			return;
 		}
-		for (size_t i = 0; i < BaseSceneIndirectPass.RenderIndirectObject.size(); i++)
-		{
-			FRenderIndirectObject& RenderIndirectObject = BaseSceneIndirectPass.RenderIndirectObject[i];
 
-			vkDestroyDescriptorPool(Device, RenderIndirectObject.MateData.DescriptorPool, nullptr);
+		// 贴图的Image屏障已经转换到 SHADER_READ，缓存拷贝还需要一个全局屏障，保证之后的顶点、点序和间接绘制读取到拷贝结果
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			UploadBatch.CommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+		vkEndCommandBuffer(UploadBatch.CommandBuffer);
 
-			for (size_t j = 0; j < RenderIndirectObject.MateData.TextureImages.size(); j++)
-			{
-				vkDestroyImageView(Device, RenderIndirectObject.MateData.TextureImageViews[j], nullptr);
-				vkDestroySampler(Device, RenderIndirectObject.MateData.TextureSamplers[j], nullptr);
-				vkDestroyImage(Device, RenderIndirectObject.MateData.TextureImages[j], nullptr);
-				vkFreeMemory(Device, RenderIndirectObject.MateData.TextureImageMemorys[j], nullptr);
-			}
-			vkDestroyBuffer(Device, RenderIndirectObject.MeshData.VertexBuffer, nullptr);
-			vkFreeMemory(Device, RenderIndirectObject.MeshData.VertexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, RenderIndirectObject.MeshData.IndexBuffer, nullptr);
-			vkFreeMemory(Device, RenderIndirectObject.MeshData.IndexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, RenderIndirectObject.IndirectCommandsBuffer, nullptr);
-			vkFreeMemory(Device, RenderIndirectObject.IndirectCommandsBufferMemory, nullptr);
+		// 同一个队列上后续的渲染提交会按提交顺序等待这些屏障，所以这里不需要 vkQueueWaitIdle
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &UploadBatch.CommandBuffer;
+		if (vkQueueSubmit(GraphicsQueue, 1, &submitInfo, UploadBatch.Fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload batch!");
 		}
-		for (size_t i = 0; i < BaseSceneIndirectPass.RenderIndirectInstancedObject.size(); i++)
-		{
-			FRenderIndirectInstancedObject& RenderIndirectInstancedObject = BaseSceneIndirectPass.RenderIndirectInstancedObject[i];
 
-			vkDestroyDescriptorPool(Device, RenderIndirectInstancedObject.MateData.DescriptorPool, nullptr);
+		uint32_t submitsSaved = UploadBatch.CommandCount > 1 ? UploadBatch.CommandCount - 1 : 0;
+		UploadSubmitsSaved += submitsSaved;
+		std::cout << "[LOG]: Upload batch submitted, " << UploadBatch.CommandCount << " upload commands in 1 submit, "
+			<< submitsSaved << " submits saved (" << UploadSubmitsSaved << " in total), "
+			<< UploadBatch.Staging.Num() << " staging blocks pending" << std::endl;
 
-			for (size_t j = 0; j < RenderIndirectInstancedObject.MateData.TextureImages.size(); j++)
-			{
-				vkDestroyImageView(Device, RenderIndirectInstancedObject.MateData.TextureImageViews[j], nullptr);
-				vkDestroySampler(Device, RenderIndirectInstancedObject.MateData.TextureSamplers[j], nullptr);
-				vkDestroyImage(Device, RenderIndirectInstancedObject.MateData.TextureImages[j], nullptr);
-				vkFreeMemory(Device, RenderIndirectInstancedObject.MateData.TextureImageMemorys[j], nullptr);
-			}
+		PendingUploadBatches.push_back(std::move(UploadBatch));
+		UploadBatch = FUploadBatch{};
+	}
 
-			vkDestroyBuffer(Device, RenderIndirectInstancedObject.MeshData.InstancedBuffer, nullptr);
-			vkFreeMemory(Device, RenderIndirectInstancedObject.MeshData.InstancedBufferMemory, nullptr);
-			vkDestroyBuffer(Device, RenderIndirectInstancedObject.MeshData.VertexBuffer, nullptr);
-			vkFreeMemory(Device, RenderIndirectInstancedObject.MeshData.VertexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, RenderIndirectInstancedObject.MeshData.IndexBuffer, nullptr);
-			vkFreeMemory(Device, RenderIndirectInstancedObject.MeshData.IndexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, RenderIndirectInstancedObject.IndirectCommandsBuffer, nullptr);
-			vkFreeMemory(Device, RenderIndirectInstancedObject.IndirectCommandsBufferMemory, nullptr);
+	/** 释放Fence已经触发的上传批次的资源，bWait为true时等待所有批次完成*/
+	void ReclaimUploadBatches(bool bWait = false)
+	{
+		for (auto it = PendingUploadBatches.begin(); it != PendingUploadBatches.end();)
+		{
+			if (bWait) {
+				vkWaitForFences(Device, 1, &it->Fence, VK_TRUE, UINT64_MAX);
+			}
+			else if (vkGetFenceStatus(Device, it->Fence) != VK_SUCCESS) {
+				++it;
+				continue;
+			}
+			ReleaseStagingList(it->Staging);
+			vkFreeCommandBuffers(Device, CommandPool, 1, &it->CommandBuffer);
+			vkDestroyFence(Device, it->Fence, nullptr);
+			it = PendingUploadBatches.erase(it);
 		}
+	}
 
-		// 清理 BaseSceneDeferredPass
-#if ENABLE_DEFEERED_RENDERING
-		vkDestroyDescriptorSetLayout(Device, BaseSceneDeferredPass.LightingDescriptorSetLayout, nullptr);
-		vkDestroyDescriptorPool(Device, BaseSceneDeferredPass.LightingDescriptorPool, nullptr);
-		vkDestroyPipelineLayout(Device, BaseSceneDeferredPass.LightingPipelineLayout, nullptr);
-		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
-		{
-			vkDestroyPipeline(Device, BaseSceneDeferredPass.LightingPipelines[i], nullptr);
+	/** 在环形StagingBuffer中分配上传空间，环满时先回收已经完成的上传批次，仍然放不下时创建临时的StagingBuffer*/
+	FStagingBlock AllocateStaging(VkDeviceSize size)
+	{
+		FStagingBlock block{};
+		bool bAllocated = StagingRing.Allocate(size, FStagingRing::ALIGNMENT, block.RingAllocation, block.Offset);
+		if (!bAllocated && !PendingUploadBatches.empty()) {
+			ReclaimUploadBatches();
+			bAllocated = StagingRing.Allocate(size, FStagingRing::ALIGNMENT, block.RingAllocation, block.Offset);
 		}
-		vkDestroyRenderPass(Device, BaseSceneDeferredPass.SceneRenderPass, nullptr);
-		vkDestroyFramebuffer(Device, BaseSceneDeferredPass.SceneFrameBuffer, nullptr);
-		vkDestroyDescriptorSetLayout(Device, BaseSceneDeferredPass.SceneDescriptorSetLayout, nullptr);
-		vkDestroyPipelineLayout(Device, BaseSceneDeferredPass.ScenePipelineLayout, nullptr);
-		for (uint32_t i = 0; i < GlobalConstants.SpecConstantsCount; i++)
-		{
-			vkDestroyPipeline(Device, BaseSceneDeferredPass.ScenePipelines[i], nullptr);
-			vkDestroyPipeline(Device, BaseSceneDeferredPass.ScenePipelinesInstanced[i], nullptr);
+		if (bAllocated) {
+			block.Buffer = StagingRing.Buffer;
+			block.Data = StagingRing.Mapped + block.Offset;
+			return block;
 		}
-		for (size_t i = 0; i < BaseSceneDeferredPass.RenderObjects.size(); i++)
-		{
-			FRenderObject& renderObject = BaseSceneDeferredPass.RenderObjects[i];
 
-			vkDestroyDescriptorPool(Device, renderObject.MateData.DescriptorPool, nullptr);
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, block.Buffer, block.Memory);
+		block.Data = block.Memory.Mapped;
+		return block;
+	}
 
-			for (size_t j = 0; j < renderObject.MateData.TextureImages.size(); j++)
-			{
-				vkDestroyImageView(Device, renderObject.MateData.TextureImageViews[j], nullptr);
-				vkDestroySampler(Device, renderObject.MateData.TextureSamplers[j], nullptr);
-				vkDestroyImage(Device, renderObject.MateData.TextureImages[j], nullptr);
-				vkFreeMemory(Device, renderObject.MateData.TextureImageMemorys[j], nullptr);
+	/** 贴图像素已经解码在环形StagingBuffer中时直接作为拷贝源，否则分配一段StagingBuffer并拷贝像素*/
+	FStagingBlock AcquireTextureStaging(FTextureAsset& texture)
+	{
+		FStagingBlock block{};
+		if (texture.StagingRing == &StagingRing) {
+			block.Buffer = StagingRing.Buffer;
+			block.Offset = texture.StagingOffset;
+			block.Data = texture.Pixels;
+			block.RingAllocation = texture.DetachStaging();
+			return block;
+		}
+		block = AllocateStaging(texture.PixelSize);
+		memcpy(block.Data, texture.Pixels, texture.PixelSize);
+		texture.ReleasePixels();
+		return block;
+	}
+
+	/** 释放StagingBuffer，录制流式上传或者上传批次时延迟到对应的Fence触发之后，否则拷贝已经完成，立即释放*/
+	void ReleaseStaging(const FStagingBlock& block)
+	{
+		FStagingReleaseList* deferred = StreamingUpload.bRecording ? &StreamingUpload.Staging : (UploadBatch.Depth > 0 ? &UploadBatch.Staging : nullptr);
+		if (deferred) {
+			if (block.RingAllocation != 0) {
+				deferred->RingAllocations.push_back(block.RingAllocation);
 			}
+			else {
+				deferred->Buffers.push_back(block.Buffer);
+				deferred->Memorys.push_back(block.Memory);
+			}
+			return;
+		}
+		if (block.RingAllocation != 0) {
+			StagingRing.Free(block.RingAllocation);
+		}
+		else {
+			vkDestroyBuffer(Device, block.Buffer, nullptr);
+			MemoryAllocator.Free(block.Memory);
+		}
+	}
 
-			vkDestroyBuffer(Device, renderObject.MeshData.VertexBuffer, nullptr);
-			vkFreeMemory(Device, renderObject.MeshData.VertexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, renderObject.MeshData.IndexBuffer, nullptr);
-			vkFreeMemory(Device, renderObject.MeshData.IndexBufferMemory, nullptr);
+	/** GPU使用完成后释放StagingBuffer*/
+	void ReleaseStagingList(FStagingReleaseList& staging)
+	{
+		for (uint64_t allocation : staging.RingAllocations) {
+			StagingRing.Free(allocation);
 		}
-		for (size_t i = 0; i < BaseSceneDeferredPass.RenderInstancedObjects.size(); i++)
-		{
-			FRenderInstancedObject& renderInstancedObject = BaseSceneDeferredPass.RenderInstancedObjects[i];
+		for (size_t i = 0; i < staging.Buffers.size(); i++) {
+			vkDestroyBuffer(Device, staging.Buffers[i], nullptr);
+			MemoryAllocator.Free(staging.Memorys[i]);
+		}
+		staging = FStagingReleaseList{};
+	}
 
-			vkDestroyDescriptorPool(Device, renderInstancedObject.MateData.DescriptorPool, nullptr);
+	/** 开始录制一次流式上传，之后的 UploadBufferData/UploadImageData 都录制到传输队列，不阻塞渲染循环*/
+	void BeginStreamingUpload()
+	{
+		if (StreamingUpload.bRecording) {
+			throw std::runtime_error("streaming upload is already recording!");
+		}
 
-			for (size_t j = 0; j < renderInstancedObject.MateData.TextureImages.size(); j++)
-			{
-				vkDestroyImageView(Device, renderInstancedObject.MateData.TextureImageViews[j], nullptr);
-				vkDestroySampler(Device, renderInstancedObject.MateData.TextureSamplers[j], nullptr);
-				vkDestroyImage(Device, renderInstancedObject.MateData.TextureImages[j], nullptr);
-				vkFreeMemory(Device, renderInstancedObject.MateData.TextureImageMemorys[j], nullptr);
-			}
+		StreamingUpload = FStreamingUpload{};
+		StreamingUpload.GraphicsCommandBuffer = BeginOneTimeCommandBuffer(CommandPool);
+		StreamingUpload.TransferCommandBuffer = bDedicatedTransferQueue ? BeginOneTimeCommandBuffer(TransferCommandPool) : StreamingUpload.GraphicsCommandBuffer;
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(Device, &fenceInfo, nullptr, &StreamingUpload.Fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create streaming upload fence!");
+		}
+		StreamingUpload.bRecording = true;
+	}
 
-			vkDestroyBuffer(Device, renderInstancedObject.MeshData.InstancedBuffer, nullptr);
-			vkFreeMemory(Device, renderInstancedObject.MeshData.InstancedBufferMemory, nullptr);
-			vkDestroyBuffer(Device, renderInstancedObject.MeshData.VertexBuffer, nullptr);
-			vkFreeMemory(Device, renderInstancedObject.MeshData.VertexBufferMemory, nullptr);
-			vkDestroyBuffer(Device, renderInstancedObject.MeshData.IndexBuffer, nullptr);
-			vkFreeMemory(Device, renderInstancedObject.MeshData.IndexBufferMemory, nullptr);
+	/** 提交流式上传，不等待完成，资源在图形队列上可以使用之后由 TickStreamingUploads 调用onComplete*/
+	void SubmitStreamingUpload(std::function<void()> onComplete)
+	{
+		StreamingUpload.OnComplete = std::move(onComplete);
+		StreamingUpload.bRecording = false;
+		vkEndCommandBuffer(StreamingUpload.TransferCommandBuffer);
+		if (bDedicatedTransferQueue) {
+			vkEndCommandBuffer(StreamingUpload.GraphicsCommandBuffer);
 		}
-		vkDestroyImageView(Device, GBuffer.DepthStencilImageView, nullptr);
-		vkDestroySampler(Device, GBuffer.DepthStencilSampler, nullptr);
-		vkDestroyImage(Device, GBuffer.DepthStencilImage, nullptr);
-		vkFreeMemory(Device, GBuffer.DepthStencilMemory, nullptr);
-		vkDestroyImageView(Device, GBuffer.SceneColorImageView, nullptr);
-		vkDestroySampler(Device, GBuffer.SceneColorSampler, nullptr);
-		vkDestroyImage(Device, GBuffer.SceneColorImage, nullptr);
-		vkFreeMemory(Device, GBuffer.SceneColorMemory, nullptr);
-		vkDestroyImageView(Device, GBuffer.GBufferAImageView, nullptr);
-		vkDestroySampler(Device, GBuffer.GBufferASampler, nullptr);
-		vkDestroyImage(Device, GBuffer.GBufferAImage, nullptr);
-		vkFreeMemory(Device, GBuffer.GBufferAMemory, nullptr);
-		vkDestroyImageView(Device, GBuffer.GBufferBImageView, nullptr);
-		vkDestroySampler(Device, GBuffer.GBufferBSampler, nullptr);
-		vkDestroyImage(Device, GBuffer.GBufferBImage, nullptr);
-		vkFreeMemory(Device, GBuffer.GBufferBMemory, nullptr);
-		vkDestroyImageView(Device, GBuffer.GBufferCImageView, nullptr);
-		vkDestroySampler(Device, GBuffer.GBufferCSampler, nullptr);
-		vkDestroyImage(Device, GBuffer.GBufferCImage, nullptr);
-		vkFreeMemory(Device, GBuffer.GBufferCMemory, nullptr);
-		vkDestroyImageView(Device, GBuffer.GBufferDImageView, nullptr);
-		vkDestroySampler(Device, GBuffer.GBufferDSampler, nullptr);
-		vkDestroyImage(Device, GBuffer.GBufferDImage, nullptr);
-		vkFreeMemory(Device, GBuffer.GBufferDMemory, nullptr);
-#endif
 
-		vkDestroyCommandPool(Device, CommandPool, nullptr);
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &StreamingUpload.TransferCommandBuffer;
+		if (vkQueueSubmit(TransferQueue, 1, &submitInfo, StreamingUpload.Fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit streaming upload!");
+		}
+		StreamingUpload.bGraphicsSubmitted = !bDedicatedTransferQueue;
 
-		vkDestroyDevice(Device, nullptr);
+		PendingStreamingUploads.push_back(std::move(StreamingUpload));
+		StreamingUpload = FStreamingUpload{};
+	}
 
-		if (bEnableValidationLayers)
-		{
-			DestroyDebugUtilsMessengerEXT(Instance, DebugMessenger, nullptr);
-		}
+	/** 传输已经完成的流式上传，释放StagingBuffer并在图形队列上提交获取所有权*/
+	void SubmitStreamingAcquire(FStreamingUpload& upload)
+	{
+		// 主机等待过Fence，获取所有权的提交不需要再等待信号量
+		ReleaseStagingList(upload.Staging);
+		vkResetFences(Device, 1, &upload.Fence);
 
-		vkDestroySurfaceKHR(Instance, Surface, nullptr);
-		vkDestroyInstance(Instance, nullptr);
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &upload.GraphicsCommandBuffer;
+		if (vkQueueSubmit(GraphicsQueue, 1, &submitInfo, upload.Fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit streaming upload!");
+		}
+		upload.bGraphicsSubmitted = true;
 	}
 
-protected:
-	/** 选择SwapChain渲染到视图的图像的格式*/
-	VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+	/** 等待传输队列上的流式上传完成并提交获取所有权，不等待图形队列，资源在下一次 TickStreamingUploads 中通知可用*/
+	void SubmitStreamingAcquires()
 	{
-		// 找到合适的图像格式
-		// VK_FORMAT_B8G8R8A8_SRGB 将图像BGRA存储在 unsigned normalized format 中，使用SRGB 非线性编码，颜色空间为非线性空间，不用Gamma矫正最终结果
-		// VK_FORMAT_R8G8B8A8_UNORM 将图像BGRA存储在 unsigned normalized format 中，颜色空间为线性空间，像素的最终输出颜色需要Gamma矫正
-		for (const auto& availableFormat : availableFormats)
+		for (FStreamingUpload& upload : PendingStreamingUploads)
 		{
-			// 将 FrameBuffer Image 设置为线性空间，方便 PBR 的工作流以及颜色矫正（ColorCorrection）
-			//if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
-			if (availableFormat.format == VK_FORMAT_R8G8B8A8_UNORM)
-			{
-				return availableFormat;
+			if (!upload.bGraphicsSubmitted) {
+				vkWaitForFences(Device, 1, &upload.Fence, VK_TRUE, UINT64_MAX);
+				SubmitStreamingAcquire(upload);
 			}
 		}
-
-		return availableFormats[0];
 	}
 
-	/** 选择SwapChain的显示方式
-	 * VK_PRESENT_MODE_IMMEDIATE_KHR 图形立即显示在屏幕上，会出现图像撕裂
-	 * VK_PRESENT_MODE_FIFO_KHR 图像会被推入一个队列，先入后出显示到屏幕，如果队列满了，程序会等待，和垂直同步相似
-	 * VK_PRESENT_MODE_FIFO_RELAXED_KHR 基于第二个Mode，当队列满了，程序不会等待，而是直接渲染到屏幕，会出现图像撕裂
-	 * VK_PRESENT_MODE_MAILBOX_KHR 基于第二个Mode，当队列满了，程序不会等待，而是直接替换队列中的图像，
-	*/
-	VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+	/** 推进已经提交的流式上传：传输完成后释放StagingBuffer，在图形队列上获取所有权，然后通知资源可用
+	 * 按提交顺序完成，后面的上传可能共享前面上传的贴图，bWait为true时等待全部完成*/
+	void TickStreamingUploads(bool bWait = false)
 	{
-		for (const auto& availablePresentMode : availablePresentModes)
+		for (auto it = PendingStreamingUploads.begin(); it != PendingStreamingUploads.end();)
 		{
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+			FStreamingUpload& upload = *it;
+			if (!upload.bGraphicsSubmitted)
 			{
-				return availablePresentMode;
+				if (bWait) {
+					vkWaitForFences(Device, 1, &upload.Fence, VK_TRUE, UINT64_MAX);
+				}
+				else if (vkGetFenceStatus(Device, upload.Fence) != VK_SUCCESS) {
+					break;
+				}
+				SubmitStreamingAcquire(upload);
 			}
-		}
 
-		return VK_PRESENT_MODE_FIFO_KHR;
+			// 之后的渲染提交在图形队列上排在获取所有权之后，资源从下一次提交开始就可以使用
+			if (upload.OnComplete) {
+				upload.OnComplete();
+				upload.OnComplete = nullptr;
+			}
+
+			if (bWait) {
+				vkWaitForFences(Device, 1, &upload.Fence, VK_TRUE, UINT64_MAX);
+			}
+			else if (vkGetFenceStatus(Device, upload.Fence) != VK_SUCCESS) {
+				++it;
+				continue;
+			}
+			ReleaseStagingList(upload.Staging);
+			vkFreeCommandBuffers(Device, CommandPool, 1, &upload.GraphicsCommandBuffer);
+			if (bDedicatedTransferQueue) {
+				vkFreeCommandBuffers(Device, TransferCommandPool, 1, &upload.TransferCommandBuffer);
+			}
+			vkDestroyFence(Device, upload.Fence, nullptr);
+			it = PendingStreamingUploads.erase(it);
+		}
 	}
 
-	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& Capabilities)
+	/** 流式上传缓存数据：在传输队列上拷贝并释放所有权，在图形队列上获取所有权
+	 * 所有权只转移写入的范围，几何缓存池中其他模型的区间仍然归图形队列使用*/
+	void StreamBufferData(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, VkDeviceSize dstOffset = 0)
 	{
-		if (Capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+		FStagingBlock staging = AllocateStaging(size);
+		memcpy(staging.Data, data, static_cast<size_t>(size));
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = staging.Offset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(StreamingUpload.TransferCommandBuffer, staging.Buffer, dstBuffer, 1, &copyRegion);
+		ReleaseStaging(staging);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.buffer = dstBuffer;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		if (bDedicatedTransferQueue)
 		{
-			return Capabilities.currentExtent;
+			// 释放所有权，目标访问掩码被忽略
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = TransferQueueFamily;
+			barrier.dstQueueFamilyIndex = GraphicsQueueFamily;
+			vkCmdPipelineBarrier(StreamingUpload.TransferCommandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr,
+				1, &barrier,
+				0, nullptr);
+
+			// 获取所有权，队列族和范围必须和释放时一致，源访问掩码被忽略
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = dstAccessMask;
+			vkCmdPipelineBarrier(StreamingUpload.GraphicsCommandBuffer,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0,
+				0, nullptr,
+				1, &barrier,
+				0, nullptr);
 		}
 		else
 		{
-			int Width, Height;
-			glfwGetFramebufferSize(Window, &Width, &Height);
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			vkCmdPipelineBarrier(StreamingUpload.GraphicsCommandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0,
+				0, nullptr,
+				1, &barrier,
+				0, nullptr);
+		}
+	}
 
-			VkExtent2D actualExtent = {
-				static_cast<uint32_t>(Width),
-				static_cast<uint32_t>(Height)
-			};
+	/** 流式上传贴图：在传输队列上拷贝所有Mip并释放所有权，在图形队列上获取所有权
+	 * 没有烘焙Mip链的贴图只拷贝第0级，在图形队列上用 vkCmdBlitImage 生成Mip（传输队列不支持Blit）*/
+	void StreamImageData(VkImage image, VkFormat format, FTextureAsset& texture)
+	{
+		uint32_t mipLevels = static_cast<uint32_t>(texture.MipLevels);
+		size_t pixelSize = texture.PixelSize;
+		FStagingBlock staging = AcquireTextureStaging(texture);
 
-			actualExtent.width = std::clamp(actualExtent.width, Capabilities.minImageExtent.width, Capabilities.maxImageExtent.width);
-			actualExtent.height = std::clamp(actualExtent.height, Capabilities.minImageExtent.height, Capabilities.maxImageExtent.height);
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.image = image;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(StreamingUpload.TransferCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
 
-			return actualExtent;
+		bool bGenerateMips = texture.Mips.empty();
+		std::vector<FCookedTextureMip> mips = texture.Mips;
+		if (bGenerateMips) {
+			mips.push_back({ 0, pixelSize, static_cast<uint32_t>(texture.Width), static_cast<uint32_t>(texture.Height) });
+		}
+		std::vector<VkBufferImageCopy> regions = GetMipCopyRegions(mips, staging.Offset);
+		vkCmdCopyBufferToImage(StreamingUpload.TransferCommandBuffer, staging.Buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+		ReleaseStaging(staging);
+
+		// 烘焙的Mip链直接转换到着色器读取，需要生成Mip时保持 TRANSFER_DST
+		VkImageLayout finalLayout = bGenerateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		VkAccessFlags finalAccessMask = bGenerateMips ? (VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT) : VK_ACCESS_SHADER_READ_BIT;
+		VkPipelineStageFlags finalStageMask = bGenerateMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		if (bDedicatedTransferQueue)
+		{
+			// 释放和获取所有权的布局转换必须一致
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = TransferQueueFamily;
+			barrier.dstQueueFamilyIndex = GraphicsQueueFamily;
+			vkCmdPipelineBarrier(StreamingUpload.TransferCommandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = finalAccessMask;
+			vkCmdPipelineBarrier(StreamingUpload.GraphicsCommandBuffer,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, finalStageMask, 0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
+		}
+		else if (!bGenerateMips)
+		{
+			barrier.dstAccessMask = finalAccessMask;
+			vkCmdPipelineBarrier(StreamingUpload.GraphicsCommandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, finalStageMask, 0,
+				0, nullptr,
+				0, nullptr,
+				1, &barrier);
+		}
+
+		if (bGenerateMips) {
+			// 生成Mip的第一个屏障会等待第0级的拷贝完成
+			RecordGenerateMipmaps(StreamingUpload.GraphicsCommandBuffer, image, format, texture.Width, texture.Height, mipLevels);
 		}
 	}
 
-	FSwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice Device)
+	/** 上传缓存数据：流式上传时录制到传输队列，否则通过临时的StagingBuffer拷贝（录制上传批次时合并提交）*/
+	void UploadBufferData(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, VkDeviceSize dstOffset = 0)
 	{
-		FSwapChainSupportDetails details;
+		if (StreamingUpload.bRecording) {
+			StreamBufferData(dstBuffer, data, size, dstAccessMask, dstStageMask, dstOffset);
+			return;
+		}
 
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(Device, Surface, &details.Capabilities);
+		FStagingBlock staging = AllocateStaging(size);
+		memcpy(staging.Data, data, static_cast<size_t>(size));
 
-		uint32_t formatCount;
-		vkGetPhysicalDeviceSurfaceFormatsKHR(Device, Surface, &formatCount, nullptr);
+		CopyBuffer(staging.Buffer, dstBuffer, size, staging.Offset, dstOffset);
 
-		if (formatCount != 0)
-		{
-			details.Formats.resize(formatCount);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(Device, Surface, &formatCount, details.Formats.data());
+		ReleaseStaging(staging);
+	}
+
+	/** 上传贴图数据并转换到着色器读取的布局，没有烘焙Mip链时在GPU上生成Mip
+	 * 像素所在的StagingBuffer交给这次上传，上传之后贴图数据被清空*/
+	void UploadImageData(VkImage& image, VkFormat format, FTextureAsset& texture)
+	{
+		if (StreamingUpload.bRecording) {
+			StreamImageData(image, format, texture);
+			return;
 		}
 
-		uint32_t presentModeCount;
-		vkGetPhysicalDeviceSurfacePresentModesKHR(Device, Surface, &presentModeCount, nullptr);
+		uint32_t mipLevels = static_cast<uint32_t>(texture.MipLevels);
+		bool bGenerateMips = texture.Mips.empty();
+		std::vector<FCookedTextureMip> mips = texture.Mips;
+		if (bGenerateMips) {
+			mips.push_back({ 0, texture.PixelSize, static_cast<uint32_t>(texture.Width), static_cast<uint32_t>(texture.Height) });
+		}
+		FStagingBlock staging = AcquireTextureStaging(texture);
 
-		if (presentModeCount != 0)
-		{
-			details.PresentModes.resize(presentModeCount);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(Device, Surface, &presentModeCount, details.PresentModes.data());
+		TransitionImageLayout(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		// 烘焙贴图带有完整的Mip链，一次 vkCmdCopyBufferToImage 拷贝所有级别，不需要再生成Mip
+		CopyBufferToImage(staging.Buffer, image, mips, staging.Offset);
+		ReleaseStaging(staging);
+		if (bGenerateMips) {
+			GenerateMipmaps(image, format, texture.Width, texture.Height, mipLevels);
 		}
+		else {
+			TransitionImageLayout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+		}
+	}
 
-		return details;
+	/** 通用函数用来创建Buffer，内存从显存子分配器中分配*/
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, FMemoryAllocation& bufferMemory,
+		EMemoryAllocationStrategy strategy = EMemoryAllocationStrategy::FreeList) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(Device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to Create buffer!");
+		}
+
+		// 为VertexBuffer创建内存，并赋予
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(Device, buffer, &memRequirements);
+
+		// 自动找到适合的内存类型，从这个类型的显存块中切分
+		uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+		bufferMemory = MemoryAllocator.Allocate(memRequirements, memoryTypeIndex, EMemoryResourceType::Linear, strategy);
+		// 绑定VertexBuffer和它的内存地址
+		vkBindBufferMemory(Device, buffer, bufferMemory.Memory, bufferMemory.Offset);
 	}
 
-	/** 检测硬件是否支持 multiDrawIndirect*/
-	bool IsSupportMultiDrawIndirect(VkPhysicalDevice Device)
+	/** 打印显存子分配器的统计：块数、分配数、使用量和碎片率*/
+	void LogMemoryStats()
 	{
-		VkPhysicalDeviceFeatures supportedFeatures;
-		vkGetPhysicalDeviceFeatures(Device, &supportedFeatures);
-		return supportedFeatures.multiDrawIndirect;
+		FMemoryStats stats = MemoryAllocator.GetStats();
+		std::cout << "[LOG]: Device memory " << stats.BlockCount << " blocks ("
+			<< stats.DedicatedBlockCount << " dedicated), "
+			<< stats.AllocationCount << " allocations, "
+			<< (stats.UsedBytes >> 20) << " / " << (stats.BlockBytes >> 20) << " MB used, "
+			<< static_cast<int>(stats.GetFragmentation() * 100.0f) << "% fragmentation" << std::endl;
+		FDefragmentationPlan plan = MemoryAllocator.PlanDefragmentation(UINT32_MAX);
+		if (plan.FreedBlockCount > 0) {
+			std::cout << "[LOG]: Defragmentation could move " << plan.MoveCount << " allocations ("
+				<< (plan.MovedBytes >> 10) << " KB) and release " << plan.FreedBlockCount << " blocks, press K to defragment" << std::endl;
+		}
 	}
 
-	/** 检测硬件是否合适*/
-	bool IsDeviceSuitable(VkPhysicalDevice Device)
+	/** 整理显存碎片：拷贝命令录制在一个上传批次中，不等待GPU，旧缓存在批次的Fence触发之后释放
+	 * 目前只有 Instance 缓存可以移动，贴图、几何缓存池等其他资源的回调返回false，保持原位*/
+	void DefragmentDeviceMemory()
 	{
-		FQueueFamilyIndices queue_family_indices = FindQueueFamilies(Device);
+		BeginUploadBatch();
+		uint32_t moveCount = MemoryAllocator.Defragment(UINT32_MAX, [this](const FMemoryAllocation& from, const FMemoryAllocation& to) {
+			bool bMoved = false;
+			SceneRegistry.InstancedObjects.ForEach([&](FRenderInstancedObject& object) {
+				bMoved = bMoved || MoveInstancedBuffer(object.MeshData, object.InstanceCount, from, to);
+			});
+			SceneRegistry.IndirectInstancedObjects.ForEach([&](FRenderIndirectInstancedObject& object) {
+				bMoved = bMoved || MoveInstancedBuffer(object.MeshData, object.InstanceCount, from, to);
+			});
+			return bMoved;
+		});
+		SubmitUploadBatch();
+		if (moveCount > 0) {
+			// 缓存的指令绑定的是旧缓存
+			InvalidateCommandCache();
+		}
+		std::cout << "[LOG]: Defragmentation moved " << moveCount << " allocations" << std::endl;
+		LogMemoryStats();
+	}
 
-		uint32_t extensionCount;
-		vkEnumerateDeviceExtensionProperties(Device, nullptr, &extensionCount, nullptr);
+	/** 碎片整理的移动回调：from 是这个模型的 Instance 缓存时，在 to 上创建新缓存并拷贝，旧缓存放进上传批次的释放列表
+	 * 之前提交的帧在批次之前，批次的Fence触发时已经不再读取旧缓存*/
+	bool MoveInstancedBuffer(FMesh& mesh, uint32_t instanceCount, const FMemoryAllocation& from, const FMemoryAllocation& to)
+	{
+		if (mesh.InstancedBufferMemory.BlockId != from.BlockId || mesh.InstancedBufferMemory.Offset != from.Offset || instanceCount == 0) {
+			return false;
+		}
+		VkDeviceSize bufferSize = VkDeviceSize(instanceCount) * sizeof(FInstanceData);
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = bufferSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VkBuffer newBuffer;
+		if (vkCreateBuffer(Device, &bufferInfo, nullptr, &newBuffer) != VK_SUCCESS) {
+			return false;
+		}
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(Device, newBuffer, &memRequirements);
+		if (memRequirements.size > to.Size || to.Offset % memRequirements.alignment != 0 || (memRequirements.memoryTypeBits & (1u << to.MemoryTypeIndex)) == 0) {
+			vkDestroyBuffer(Device, newBuffer, nullptr);
+			return false;
+		}
+		vkBindBufferMemory(Device, newBuffer, to.Memory, to.Offset);
 
-		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-		vkEnumerateDeviceExtensionProperties(Device, nullptr, &extensionCount, availableExtensions.data());
+		VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+		VkBufferCopy copyRegion{};
+		copyRegion.size = bufferSize;
+		vkCmdCopyBuffer(commandBuffer, mesh.InstancedBuffer, newBuffer, 1, &copyRegion);
+		EndSingleTimeCommands(commandBuffer);
 
-		std::set<std::string> requiredExtensions(DeviceExtensions.begin(), DeviceExtensions.end());
+		UploadBatch.Staging.Buffers.push_back(mesh.InstancedBuffer);
+		UploadBatch.Staging.Memorys.push_back(mesh.InstancedBufferMemory);
+		mesh.InstancedBuffer = newBuffer;
+		mesh.InstancedBufferMemory = to;
+		return true;
+	}
 
-		for (const auto& extension : availableExtensions)
-		{
-			requiredExtensions.erase(extension.extensionName);
-		}
+	/** 通用函数用来拷贝Buffer*/
+	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0)
+	{
+		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
 
-		bool extensionsSupported = requiredExtensions.empty();
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(CommandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
-		bool swapChainAdequate = false;
-		if (extensionsSupported)
-		{
-			FSwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(Device);
-			swapChainAdequate = !swapChainSupport.Formats.empty() && !swapChainSupport.PresentModes.empty();
+		EndSingleTimeCommands(CommandBuffer);
+	}
+
+	/** 从文件中读取顶点和点序，并创建顶点缓存和点序缓存
+	 * 读取的是内存映射的烘焙模型，映射的指针直接拷贝进StagingBuffer，不经过中间的vector*/
+	void CreateMesh(FMesh& outMesh, const std::string& filename)
+	{
+		FMappedFile cookedFile;
+		LoadCookedModelAsset(filename, cookedFile);
+		CreateMesh(outMesh, cookedFile);
+	}
+
+	/** 用解码完成的模型创建顶点缓存和点序缓存，紧凑格式使用量化好的顶点*/
+	void CreateMesh(FMesh& outMesh, const FMeshAsset& meshAsset)
+	{
+		if (meshAsset.VertexFormat != EVertexFormat::Compact) {
+			CreateMesh(outMesh, meshAsset.CookedFile);
+			return;
 		}
 
-		VkPhysicalDeviceFeatures supportedFeatures;
-		vkGetPhysicalDeviceFeatures(Device, &supportedFeatures);
+		const FCookedMeshHeader* header = reinterpret_cast<const FCookedMeshHeader*>(meshAsset.CookedFile.Data);
+		outMesh.VertexCount = header->VertexCount;
+		SetMeshLods(outMesh, header);
+		outMesh.BoundsMin = header->BoundsMin;
+		outMesh.BoundsMax = header->BoundsMax;
+		outMesh.VertexFormat = EVertexFormat::Compact;
+		outMesh.Dequantization = meshAsset.Dequantization;
+		outMesh.IndexType = GetCookedIndexType(header);
+		AllocateMeshGeometry(
+			outMesh,
+			meshAsset.CompactVertices.data(),
+			meshAsset.CookedFile.Data + header->IndexOffset,
+			header->IndexCount);
+	}
 
-		return queue_family_indices.IsComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	/** 烘焙模型的点序类型*/
+	static VkIndexType GetCookedIndexType(const FCookedMeshHeader* header)
+	{
+		return header->IndexStride == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 	}
 
-	/** 队列家族 Queue Family
-	 * 找到所有支持Vulkan的显卡硬件
-	*/
-	FQueueFamilyIndices FindQueueFamilies(VkPhysicalDevice Device)
+	/** 读取烘焙模型的LOD，IndexCount 为 LOD0 的点序数量，不使用LOD的绘制只画 LOD0*/
+	static void SetMeshLods(FMesh& outMesh, const FCookedMeshHeader* header)
 	{
-		FQueueFamilyIndices queue_family_indices;
+		outMesh.LodCount = header->LodCount;
+		std::copy(header->Lods, header->Lods + header->LodCount, outMesh.Lods);
+		outMesh.IndexCount = header->Lods[0].IndexCount;
+	}
 
-		uint32_t queueFamilyCount = 0;
-		vkGetPhysicalDeviceQueueFamilyProperties(Device, &queueFamilyCount, nullptr);
+	/** 读取烘焙模型 LOD0 的簇，整个模型作为一个Actor*/
+	template <typename T>
+	static void LoadMeshClusters(T& outMesh, const FMappedFile& cookedFile)
+	{
+		const FCookedMeshHeader* header = reinterpret_cast<const FCookedMeshHeader*>(cookedFile.Data);
+		const FCluster* clusters = reinterpret_cast<const FCluster*>(cookedFile.Data + header->ClusterOffset);
+		outMesh.Actors.resize(1);
+		outMesh.Actors[0].Clusters.assign(clusters, clusters + header->ClusterCount);
+	}
 
-		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(Device, &queueFamilyCount, queueFamilies.data());
+	/** 用已经映射的烘焙模型创建顶点缓存和点序缓存*/
+	void CreateMesh(FMesh& outMesh, const FMappedFile& cookedFile)
+	{
+		const FCookedMeshHeader* header = reinterpret_cast<const FCookedMeshHeader*>(cookedFile.Data);
+
+		outMesh.VertexCount = header->VertexCount;
+		SetMeshLods(outMesh, header);
+		outMesh.BoundsMin = header->BoundsMin;
+		outMesh.BoundsMax = header->BoundsMax;
+		outMesh.IndexType = GetCookedIndexType(header);
+		AllocateMeshGeometry(
+			outMesh,
+			cookedFile.Data + header->VertexOffset,
+			cookedFile.Data + header->IndexOffset,
+			header->IndexCount);
+	}
 
-		int i = 0;
-		for (const auto& queueFamily : queueFamilies)
-		{
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-			{
-				queue_family_indices.GraphicsFamily = i;
-			}
+	/** 顶点格式对应的几何缓存池*/
+	FGeometryPool& GetVertexPool(EVertexFormat vertexFormat)
+	{
+		return VertexPools[static_cast<uint32_t>(vertexFormat)];
+	}
 
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(Device, i, Surface, &presentSupport);
+	/** 点序类型对应的几何缓存池*/
+	FGeometryPool& GetIndexPool(VkIndexType indexType)
+	{
+		return IndexPools[indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1];
+	}
 
-			if (presentSupport)
-			{
-				queue_family_indices.PresentFamily = i;
-			}
+	/** 保证几何缓存池中有count个连续的空闲元素，第一次使用时创建缓存，放不下时按两倍扩容
+	 * 扩容时把旧缓存整体拷贝到新缓存，之前录制的上传仍然写入旧缓存，所以不能在录制流式上传时扩容，流式任务在录制之前调用 ReserveMeshGeometry
+	 * 扩容拷贝放在上传批次中提交，不等待GPU，旧缓存在这一帧的Fence触发之后销毁*/
+	void EnsureGeometryPoolCapacity(FGeometryPool& pool, uint32_t elementSize, VkBufferUsageFlags usage, uint32_t minCapacity, uint32_t count)
+	{
+		if (pool.Buffer != VK_NULL_HANDLE && pool.CanAllocate(count)) {
+			return;
+		}
+		if (pool.Buffer == VK_NULL_HANDLE)
+		{
+			pool.ElementSize = elementSize;
+			pool.Usage = usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			uint32_t capacity = std::max(minCapacity, count);
+			CreateBuffer(VkDeviceSize(capacity) * elementSize, pool.Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pool.Buffer, pool.Memory);
+			pool.Grow(capacity);
+			return;
+		}
+		if (StreamingUpload.bRecording) {
+			throw std::runtime_error("failed to grow geometry pool while recording a streaming upload!");
+		}
 
-			if (queue_family_indices.IsComplete())
-			{
-				break;
-			}
+		uint64_t newCapacity = pool.GetGrowCapacity(count);
+		if (newCapacity > UINT32_MAX) {
+			throw std::runtime_error("failed to grow geometry pool, too many elements!");
+		}
 
-			i++;
+		// 写入旧缓存的流式上传和之前的上传批次都在图形队列上先提交，扩容拷贝开头的屏障保证在这些写入之后读取
+		// 使用独立的传输队列时，写入的区间还归传输队列所有，需要先在图形队列上获取所有权
+		if (bDedicatedTransferQueue) {
+			SubmitStreamingAcquires();
 		}
+		VkBuffer newBuffer;
+		FMemoryAllocation newMemory;
+		CreateBuffer(newCapacity * elementSize, pool.Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newBuffer, newMemory);
+		BeginUploadBatch();
+		VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		VkBufferCopy copyRegion{};
+		copyRegion.size = VkDeviceSize(pool.Capacity) * pool.ElementSize;
+		vkCmdCopyBuffer(commandBuffer, pool.Buffer, newBuffer, 1, &copyRegion);
+		EndSingleTimeCommands(commandBuffer);
+		SubmitUploadBatch();
+
+		DeferBufferFree(pool.Buffer, pool.Memory);
+		std::cout << "[LOG]: Geometry pool grown from " << pool.Capacity << " to " << newCapacity << " elements of " << elementSize << " bytes" << std::endl;
+		pool.Buffer = newBuffer;
+		pool.Memory = newMemory;
+		pool.Grow(static_cast<uint32_t>(newCapacity));
+		// 缓存的指令绑定的是旧缓存
+		InvalidateCommandCache();
+	}
 
-		return queue_family_indices;
+	/** 流式任务在开始录制之前预留模型需要的几何缓存池空间，需要扩容时在这里完成*/
+	void ReserveMeshGeometry(const FMeshAsset& meshAsset)
+	{
+		const FCookedMeshHeader* header = reinterpret_cast<const FCookedMeshHeader*>(meshAsset.CookedFile.Data);
+		uint32_t vertexSize = meshAsset.VertexFormat == EVertexFormat::Compact ? sizeof(FCompactVertex) : sizeof(FVertex);
+		VkIndexType indexType = GetCookedIndexType(header);
+		EnsureGeometryPoolCapacity(GetVertexPool(meshAsset.VertexFormat), vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, GEOMETRY_POOL_MIN_VERTICES, header->VertexCount);
+		EnsureGeometryPoolCapacity(GetIndexPool(indexType), header->IndexStride, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, GEOMETRY_POOL_MIN_INDICES, header->IndexCount);
 	}
 
-	/** 找到物理硬件支持的图片格式*/
-	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
-		for (VkFormat format : candidates) {
-			VkFormatProperties props;
-			vkGetPhysicalDeviceFormatProperties(PhysicalDevice, format, &props);
+	/** 从几何缓存池中为模型分配顶点和点序区间并上传，VertexFormat、VertexCount 和 IndexType 需要先设置好
+	 * 点序保持模型内的局部编号，绘制时通过 vertexOffset 偏移到缓存池中的位置*/
+	void AllocateMeshGeometry(FMesh& outMesh, const void* inVertices, const void* inIndices, uint32_t inIndexCount)
+	{
+		uint32_t vertexSize = outMesh.VertexFormat == EVertexFormat::Compact ? sizeof(FCompactVertex) : sizeof(FVertex);
+		uint32_t indexSize = outMesh.IndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		FGeometryPool& vertexPool = GetVertexPool(outMesh.VertexFormat);
+		FGeometryPool& indexPool = GetIndexPool(outMesh.IndexType);
+		EnsureGeometryPoolCapacity(vertexPool, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, GEOMETRY_POOL_MIN_VERTICES, outMesh.VertexCount);
+		EnsureGeometryPoolCapacity(indexPool, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, GEOMETRY_POOL_MIN_INDICES, inIndexCount);
+
+		uint32_t vertexOffset = vertexPool.Allocate(outMesh.VertexCount);
+		uint32_t firstIndex = indexPool.Allocate(inIndexCount);
+		if (vertexOffset == FGeometryPool::INVALID_OFFSET || firstIndex == FGeometryPool::INVALID_OFFSET) {
+			throw std::runtime_error("failed to allocate mesh from geometry pool!");
+		}
+		outMesh.VertexOffset = static_cast<int32_t>(vertexOffset);
+		outMesh.FirstIndex = firstIndex;
+		outMesh.PoolIndexCount = inIndexCount;
+
+		UploadBufferData(vertexPool.Buffer, inVertices, VkDeviceSize(outMesh.VertexCount) * vertexSize,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VkDeviceSize(vertexOffset) * vertexSize);
+		UploadBufferData(indexPool.Buffer, inIndices, VkDeviceSize(inIndexCount) * indexSize,
+			VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VkDeviceSize(firstIndex) * indexSize);
+	}
+
+	/** 把模型占用的区间还给几何缓存池，正在渲染的帧可能还在读取，等这一帧的Fence触发之后才能重新分配*/
+	void FreeMeshGeometry(FMesh& mesh)
+	{
+		PendingGeometryFrees[CurrentFrame].push_back({ &GetVertexPool(mesh.VertexFormat), static_cast<uint32_t>(mesh.VertexOffset), mesh.VertexCount });
+		PendingGeometryFrees[CurrentFrame].push_back({ &GetIndexPool(mesh.IndexType), mesh.FirstIndex, mesh.PoolIndexCount });
+		mesh.VertexCount = 0;
+		mesh.PoolIndexCount = 0;
+	}
+
+	/** 延迟销毁被替换的缓存，之前提交的拷贝和渲染都在这一帧的提交之前，这一帧的Fence触发之后才能销毁*/
+	void DeferBufferFree(VkBuffer buffer, const FMemoryAllocation& memory)
+	{
+		PendingBufferFrees[CurrentFrame].push_back({ buffer, memory });
+	}
+
+	/** 这一帧的Fence已经触发，释放之前延迟的几何区间和缓存*/
+	void ReclaimGeometryFrees(uint32_t frame)
+	{
+		for (const FGeometryFree& pending : PendingGeometryFrees[frame]) {
+			pending.Pool->Free(pending.Offset, pending.Count);
+		}
+		PendingGeometryFrees[frame].clear();
+		for (const FBufferFree& pending : PendingBufferFrees[frame]) {
+			vkDestroyBuffer(Device, pending.Buffer, nullptr);
+			MemoryAllocator.Free(pending.Memory);
+		}
+		PendingBufferFrees[frame].clear();
+	}
 
-			if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-				return format;
+	/** 销毁几何缓存池，所有模型已经释放*/
+	void DestroyGeometryPools()
+	{
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			ReclaimGeometryFrees(i);
+		}
+		for (FGeometryPool* pool : { &VertexPools[0], &VertexPools[1], &IndexPools[0], &IndexPools[1] })
+		{
+			if (pool->Used > 0) {
+				std::cout << "[LOG]: " << pool->Used << " geometry pool elements were not freed" << std::endl;
 			}
-			else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
-				return format;
+			if (pool->Buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(Device, pool->Buffer, nullptr);
+				MemoryAllocator.Free(pool->Memory);
 			}
+			*pool = FGeometryPool{};
 		}
+	}
 
-		throw std::runtime_error("failed to find supported format!");
+	/** 绑定模型所在的几何缓存池，和上一次绑定的缓存相同时跳过*/
+	void BindMeshGeometry(VkCommandBuffer commandBuffer, const FMesh& mesh, FGeometryBinding& binding)
+	{
+		VkBuffer vertexBuffer = GetVertexPool(mesh.VertexFormat).Buffer;
+		if (binding.VertexBuffer != vertexBuffer)
+		{
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer, offsets);
+			binding.VertexBuffer = vertexBuffer;
+		}
+		VkBuffer indexBuffer = GetIndexPool(mesh.IndexType).Buffer;
+		if (binding.IndexBuffer != indexBuffer || binding.IndexType != mesh.IndexType)
+		{
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, mesh.IndexType);
+			binding.IndexBuffer = indexBuffer;
+			binding.IndexType = mesh.IndexType;
+		}
 	}
 
-	/** 找到支持深度贴图的格式*/
-	VkFormat FindDepthFormat() {
-		return FindSupportedFormat(
-			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-		);
+	/** 绑定模型顶点格式对应的渲染管线，紧凑顶点的反量化参数在 DrawData 存储缓存中*/
+	void BindMeshPipeline(VkCommandBuffer commandBuffer, const FMesh& mesh, VkPipeline fullPipeline, VkPipeline compactPipeline)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mesh.VertexFormat == EVertexFormat::Compact ? compactPipeline : fullPipeline);
 	}
 
-	/** 查找内存类型*/
-	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+	/** 绑定场景物体的描述符集合，set 0 为材质（或者阴影Pass的全局集合），set 1 为 DrawData 和灯光存储缓存
+	 * uniformOffsets 为 set 0 中统一缓存在这一帧统一缓存环中的动态偏移*/
+	void BindSceneDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, const FDynamicOffsets& uniformOffsets)
 	{
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &memProperties);
+		// 动态偏移按集合和绑定的顺序排列，set 1 中灯光存储缓存的偏移在最后
+		uint32_t dynamicOffsets[3];
+		std::copy(uniformOffsets.Offsets, uniformOffsets.Offsets + uniformOffsets.Count, dynamicOffsets);
+		dynamicOffsets[uniformOffsets.Count] = static_cast<uint32_t>(LightFrameStride * CurrentFrame);
+		VkDescriptorSet descriptorSets[] = { descriptorSet, DrawDataDescriptorSets[CurrentFrame] };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptorSets, uniformOffsets.Count + 1, dynamicOffsets);
+	}
 
-		// 自动寻找适合的内存类型
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
+	/** 绘制 Instanced 物体，每个有Instance的LOD一次DrawCall*/
+	void DrawInstancedLods(VkCommandBuffer commandBuffer, const FRenderInstancedObject& object)
+	{
+		VkBuffer objectInstanceBuffers[] = { object.MeshData.InstancedBuffer };
+		VkDeviceSize objectInstanceOffsets[] = { object.InstanceBufferOffset };
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, objectInstanceBuffers, objectInstanceOffsets);
+		for (uint32_t lod = 0; lod < object.MeshData.LodCount; lod++)
+		{
+			if (object.LodInstanceCount[lod] == 0) {
+				continue;
 			}
+			const FMeshLod& meshLod = object.MeshData.Lods[lod];
+			vkCmdDrawIndexed(commandBuffer, meshLod.IndexCount, object.LodInstanceCount[lod], object.MeshData.FirstIndex + meshLod.FirstIndex, object.MeshData.VertexOffset, object.LodFirstInstance[lod]);
+			SceneDrawCalls++;
 		}
-
-		throw std::runtime_error("failed to find suitable memory type!");
 	}
 
-	VkCommandBuffer BeginSingleTimeCommands()
+	/** 是否使用 Multi-Draw-Indirect 提交场景，普通物体的 firstInstance 需要 drawIndirectFirstInstance*/
+	bool IsSceneMultiDrawIndirect() const
 	{
-		// 和渲染一样，使用commandBuffer拷贝缓存
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = CommandPool;
-		allocInfo.commandBufferCount = 1;
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(Device, &allocInfo, &commandBuffer);
-
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-		return commandBuffer;
+		return GlobalInput.bSceneMultiDrawIndirect && DeviceCaps.bDrawIndirectFirstInstance;
 	}
 
-	void EndSingleTimeCommands(VkCommandBuffer commandBuffer)
+	/** 填充绘制的渲染状态，几何缓存池由模型的顶点格式和点序类型决定*/
+	FSceneDraw MakeSceneDraw(const FMesh& mesh, VkPipeline fullPipeline, VkPipeline compactPipeline, VkDescriptorSet descriptorSet)
 	{
-		vkEndCommandBuffer(commandBuffer);
-
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(GraphicsQueue);
+		FSceneDraw draw{};
+		draw.State.Pipeline = mesh.VertexFormat == EVertexFormat::Compact ? compactPipeline : fullPipeline;
+		draw.State.DescriptorSet = descriptorSet;
+		draw.State.VertexBuffer = GetVertexPool(mesh.VertexFormat).Buffer;
+		draw.State.IndexBuffer = GetIndexPool(mesh.IndexType).Buffer;
+		draw.State.IndexType = mesh.IndexType;
+		draw.Mesh = &mesh;
+		return draw;
+	}
 
-		vkFreeCommandBuffers(Device, CommandPool, 1, &commandBuffer);
+	/** 普通物体加入场景绘制，firstInstance 为物体的 DrawData 序号*/
+	void AddSceneDraw(FSceneDrawBatch& batch, const FMesh& mesh, uint32_t drawDataIndex, VkPipeline fullPipeline, VkPipeline compactPipeline, VkDescriptorSet descriptorSet)
+	{
+		FSceneDraw draw = MakeSceneDraw(mesh, fullPipeline, compactPipeline, descriptorSet);
+		draw.Command.indexCount = mesh.IndexCount;
+		draw.Command.instanceCount = 1;
+		draw.Command.firstIndex = mesh.FirstIndex;
+		draw.Command.vertexOffset = mesh.VertexOffset;
+		draw.Command.firstInstance = drawDataIndex;
+		batch.Draws.push_back(draw);
 	}
 
-	/** 通用函数用来创建Buffer*/
-	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-		VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = size;
-		bufferInfo.usage = usage;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	/** Instanced 物体加入场景绘制，每个有Instance的LOD一条命令，和 DrawInstancedLods 相同*/
+	void AddSceneInstancedDraws(FSceneDrawBatch& batch, const FRenderInstancedObject& object, VkPipeline fullPipeline, VkPipeline compactPipeline, VkDescriptorSet descriptorSet)
+	{
+		FSceneDraw draw = MakeSceneDraw(object.MeshData, fullPipeline, compactPipeline, descriptorSet);
+		draw.State.InstanceBuffer = object.MeshData.InstancedBuffer;
+		draw.State.InstanceOffset = object.InstanceBufferOffset;
+		for (uint32_t lod = 0; lod < object.MeshData.LodCount; lod++)
+		{
+			if (object.LodInstanceCount[lod] == 0) {
+				continue;
+			}
+			const FMeshLod& meshLod = object.MeshData.Lods[lod];
+			draw.Command.indexCount = meshLod.IndexCount;
+			draw.Command.instanceCount = object.LodInstanceCount[lod];
+			draw.Command.firstIndex = object.MeshData.FirstIndex + meshLod.FirstIndex;
+			draw.Command.vertexOffset = object.MeshData.VertexOffset;
+			draw.Command.firstInstance = object.LodFirstInstance[lod];
+			batch.Draws.push_back(draw);
+		}
+	}
 
-		if (vkCreateBuffer(Device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to Create buffer!");
+	/** 把一个Pass的场景物体拆分成录制任务
+	 * Multi-Draw-Indirect 提交时要对整个Pass的绘制排序合并，只有一个任务；逐物体提交时每 RECORD_OBJECTS_PER_TASK 个物体一个任务，普通物体在前*/
+	void AddSceneRecordTasks(FPassRecording& pass, const FScenePassState& state, const TScenePassList<FRenderObject>& objects, const TScenePassList<FRenderInstancedObject>& instancedObjects, bool bMultiDrawIndirect)
+	{
+		size_t objectCount = objects.Num() + instancedObjects.Num();
+		if (objectCount == 0) {
+			return;
 		}
+		if (bMultiDrawIndirect)
+		{
+			// Instanced 物体每个LOD最多一条命令，按最多的情况预留命令缓存
+			size_t maxDrawCount = objects.Num();
+			for (const FRenderInstancedObject* renderInstancedObject : instancedObjects.Objects) {
+				maxDrawCount += renderInstancedObject->MeshData.LodCount;
+			}
+			EnsureSceneDrawBatchCapacity(*state.DrawBatch, maxDrawCount);
+			pass.Tasks.push_back([this, state, &objects, &instancedObjects](VkCommandBuffer commandBuffer, FGeometryBinding& geometryBinding) {
+				RecordSceneObjectsBatched(commandBuffer, state, objects, instancedObjects, geometryBinding);
+			});
+			return;
+		}
+		for (size_t begin = 0; begin < objectCount; begin += RECORD_OBJECTS_PER_TASK)
+		{
+			size_t end = std::min(objectCount, begin + RECORD_OBJECTS_PER_TASK);
+			pass.Tasks.push_back([this, state, &objects, &instancedObjects, begin, end](VkCommandBuffer commandBuffer, FGeometryBinding& geometryBinding) {
+				RecordSceneObjects(commandBuffer, state, objects, instancedObjects, begin, end, geometryBinding);
+			});
+		}
+	}
 
-		// 为VertexBuffer创建内存，并赋予
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(Device, buffer, &memRequirements);
+	/** 逐物体提交一段场景物体，[begin, end) 是普通物体和 Instanced 物体连起来之后的序号*/
+	void RecordSceneObjects(VkCommandBuffer commandBuffer, const FScenePassState& state, const TScenePassList<FRenderObject>& objects, const TScenePassList<FRenderInstancedObject>& instancedObjects, size_t begin, size_t end, FGeometryBinding& geometryBinding)
+	{
+		size_t objectEnd = std::min(end, objects.Num());
+		for (size_t i = begin; i < objectEnd; i++)
+		{
+			const FMesh& mesh = *objects.Meshes[i];
+			BindMeshPipeline(commandBuffer, mesh, state.Pipeline, state.PipelineCompact);
+			BindMeshGeometry(commandBuffer, mesh, geometryBinding);
+			BindSceneDescriptorSets(commandBuffer, state.PipelineLayout, state.GetDescriptorSet(*objects.Materials[i], CurrentFrame), state.UniformOffsets);
+			vkCmdPushConstants(commandBuffer, state.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+			vkCmdDrawIndexed(commandBuffer, mesh.IndexCount, 1, mesh.FirstIndex, mesh.VertexOffset, objects.DrawDataIndices[i]);
+			SceneDrawCalls++;
+		}
+		for (size_t i = std::max(begin, objects.Num()); i < end; i++)
+		{
+			const FRenderInstancedObject& renderInstancedObject = *instancedObjects.Objects[i - objects.Num()];
+			BindMeshPipeline(commandBuffer, renderInstancedObject.MeshData, state.PipelineInstanced, state.PipelineInstancedCompact);
+			BindMeshGeometry(commandBuffer, renderInstancedObject.MeshData, geometryBinding);
+			BindSceneDescriptorSets(commandBuffer, state.PipelineLayout, state.GetDescriptorSet(renderInstancedObject.MateData, CurrentFrame), state.UniformOffsets);
+			vkCmdPushConstants(commandBuffer, state.PipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+			DrawInstancedLods(commandBuffer, renderInstancedObject);
+		}
+	}
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		// 自动找到适合的内存类型
-		allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-		// 关联分配的内存地址
-		if (vkAllocateMemory(Device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate buffer memory!");
+	/** 收集一个Pass的所有场景物体，通过 Multi-Draw-Indirect 提交*/
+	void RecordSceneObjectsBatched(VkCommandBuffer commandBuffer, const FScenePassState& state, const TScenePassList<FRenderObject>& objects, const TScenePassList<FRenderInstancedObject>& instancedObjects, FGeometryBinding& geometryBinding)
+	{
+		FSceneDrawBatch& drawBatch = *state.DrawBatch;
+		drawBatch.Draws.clear();
+		for (size_t i = 0; i < objects.Num(); i++) {
+			AddSceneDraw(drawBatch, *objects.Meshes[i], objects.DrawDataIndices[i], state.Pipeline, state.PipelineCompact,
+				state.GetDescriptorSet(*objects.Materials[i], CurrentFrame));
 		}
-		// 绑定VertexBuffer和它的内存地址
-		vkBindBufferMemory(Device, buffer, bufferMemory, 0);
+		for (const FRenderInstancedObject* renderInstancedObject : instancedObjects.Objects) {
+			AddSceneInstancedDraws(drawBatch, *renderInstancedObject, state.PipelineInstanced, state.PipelineInstancedCompact,
+				state.GetDescriptorSet(renderInstancedObject->MateData, CurrentFrame));
+		}
+		RecordSceneDrawBatch(commandBuffer, drawBatch, state.PipelineLayout, state.UniformOffsets, geometryBinding);
 	}
 
-	/** 通用函数用来拷贝Buffer*/
-	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+	/** 录制一个Pass收集的场景绘制
+	 * 按渲染状态排序后写入这一帧的命令缓存，状态相同的连续命令合并成一次 vkCmdDrawIndexedIndirect
+	 * 没有 bindless 时材质描述符集合不同的物体不能合并，所以阴影Pass合并得最多
+	 * 命令缓存的容量在 AddSceneRecordTasks 中已经预留好*/
+	void RecordSceneDrawBatch(VkCommandBuffer commandBuffer, FSceneDrawBatch& batch, VkPipelineLayout pipelineLayout, const FDynamicOffsets& uniformOffsets, FGeometryBinding& geometryBinding)
 	{
-		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+		if (batch.Draws.empty()) {
+			return;
+		}
+		std::stable_sort(batch.Draws.begin(), batch.Draws.end(), [](const FSceneDraw& a, const FSceneDraw& b) {
+			return a.State < b.State;
+		});
 
-		VkBufferCopy copyRegion{};
-		copyRegion.size = size;
-		vkCmdCopyBuffer(CommandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+		VkDeviceSize frameOffset = VkDeviceSize(CurrentFrame) * batch.Capacity * sizeof(VkDrawIndexedIndirectCommand);
+		VkDrawIndexedIndirectCommand* commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(batch.Memory.Mapped + frameOffset);
+		batch.Runs.clear();
+		for (uint32_t i = 0; i < static_cast<uint32_t>(batch.Draws.size()); i++)
+		{
+			const FSceneDraw& draw = batch.Draws[i];
+			commands[i] = draw.Command;
+			if (batch.Runs.empty() || !(batch.Runs.back().State == draw.State)) {
+				batch.Runs.push_back({ draw.State, draw.Mesh, i, 0 });
+			}
+			batch.Runs.back().CommandCount++;
+		}
 
-		EndSingleTimeCommands(CommandBuffer);
+		bool bMultiDrawIndirect = DeviceCaps.bMultiDrawIndirect;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(FGlobalConstants), &GlobalConstants);
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+		VkBuffer boundInstanceBuffer = VK_NULL_HANDLE;
+		VkDeviceSize boundInstanceOffset = 0;
+		for (const FSceneDrawRun& run : batch.Runs)
+		{
+			if (run.State.Pipeline != boundPipeline)
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, run.State.Pipeline);
+				boundPipeline = run.State.Pipeline;
+			}
+			if (run.State.DescriptorSet != boundDescriptorSet)
+			{
+				BindSceneDescriptorSets(commandBuffer, pipelineLayout, run.State.DescriptorSet, uniformOffsets);
+				boundDescriptorSet = run.State.DescriptorSet;
+			}
+			BindMeshGeometry(commandBuffer, *run.Mesh, geometryBinding);
+			if (run.State.InstanceBuffer != VK_NULL_HANDLE && (run.State.InstanceBuffer != boundInstanceBuffer || run.State.InstanceOffset != boundInstanceOffset))
+			{
+				vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &run.State.InstanceBuffer, &run.State.InstanceOffset);
+				boundInstanceBuffer = run.State.InstanceBuffer;
+				boundInstanceOffset = run.State.InstanceOffset;
+			}
+
+			VkDeviceSize offset = frameOffset + VkDeviceSize(run.FirstCommand) * sizeof(VkDrawIndexedIndirectCommand);
+			if (bMultiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, batch.Buffer, offset, run.CommandCount, sizeof(VkDrawIndexedIndirectCommand));
+				SceneDrawCalls++;
+			}
+			else
+			{
+				// If multi draw is not available, we must issue separate draw commands
+				for (uint32_t j = 0; j < run.CommandCount; j++)
+				{
+					vkCmdDrawIndexedIndirect(commandBuffer, batch.Buffer, offset + j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+				}
+				SceneDrawCalls += run.CommandCount;
+			}
+		}
 	}
 
-	/** 从文件中读取顶点和点序*/
-	void CreateMesh(std::vector<FVertex>& outVertices, std::vector<uint32_t>& outIndices, const std::string& filename)
+	/** 统计录制CommandBuffer的CPU耗时和场景的DrawCall数量，每隔 SCENE_DRAW_STATS_INTERVAL 秒打印一次平均值
+	 * 直接提交缓存的 CommandBuffer 的帧也计入平均值，录制耗时只有判断缓存是否有效的时间*/
+	void UpdateSceneDrawStats(double recordTime, bool bCachedCommandBuffer)
 	{
-		LoadModelAsset(filename, outVertices, outIndices);
+		bool bMultiDrawIndirect = IsSceneMultiDrawIndirect();
+		bool bParallelRecording = IsParallelCommandRecording();
+		bool bCacheCommandBuffers = GlobalInput.bCacheCommandBuffers;
+		if (bMultiDrawIndirect != SceneDrawStats.bMultiDrawIndirect || bParallelRecording != SceneDrawStats.bParallelRecording
+			|| bCacheCommandBuffers != SceneDrawStats.bCacheCommandBuffers)
+		{
+			SceneDrawStats = FSceneDrawStats{};
+			SceneDrawStats.bMultiDrawIndirect = bMultiDrawIndirect;
+			SceneDrawStats.bParallelRecording = bParallelRecording;
+			SceneDrawStats.bCacheCommandBuffers = bCacheCommandBuffers;
+		}
+		SceneDrawStats.RecordTime += recordTime;
+		SceneDrawStats.DrawCalls += SceneDrawCalls;
+		SceneDrawStats.CachedFrames += bCachedCommandBuffer ? 1 : 0;
+		SceneDrawStats.Frames++;
+
+		auto now = std::chrono::high_resolution_clock::now();
+		float elapsed = std::chrono::duration<float, std::chrono::seconds::period>(now - SceneDrawStats.Start).count();
+		if (elapsed < SCENE_DRAW_STATS_INTERVAL) {
+			return;
+		}
+		std::cout << "[LOG]: Scene submission (" << (bMultiDrawIndirect ? "multi-draw-indirect" : "per-object") << ", "
+			<< (bParallelRecording ? "parallel recording on " + std::to_string(RecordJobs->GetThreadCount()) + " threads" : std::string("single-threaded recording")) << "): "
+			<< SceneDrawStats.RecordTime / SceneDrawStats.Frames << " ms to record command buffer, "
+			<< SceneDrawStats.DrawCalls / SceneDrawStats.Frames << " scene draw calls per frame, "
+			<< SceneDrawStats.CachedFrames << "/" << SceneDrawStats.Frames << " frames reused a cached command buffer" << std::endl;
+		SceneDrawStats = FSceneDrawStats{};
+		SceneDrawStats.bMultiDrawIndirect = bMultiDrawIndirect;
+		SceneDrawStats.bParallelRecording = bParallelRecording;
+		SceneDrawStats.bCacheCommandBuffers = bCacheCommandBuffers;
 	}
 
-	/** 创建顶点缓存区VBO*/
-	void CreateVertexBuffer(VkBuffer& outBuffer, VkDeviceMemory& outMemory, const std::vector<FVertex>& inVertices)
+	/** 按屏幕空间大小给每个Instance选择LOD，按LOD分桶后写入这一帧的Instance缓存
+	 * 屏幕空间大小为包围球直径占屏幕高度的比例，LOD的简化误差投影到屏幕上不超过 LOD_ERROR_PIXELS 时使用这个LOD
+	 * 阴影和GBuffer使用相同的分桶结果
+	 * 返回每级LOD的Instance数量是否变化，数量写在录制的 DrawCall 中*/
+	bool UpdateInstanceLods(FRenderInstancedObject& object, uint32_t currentFrame, const glm::mat4& localToWorld, const glm::vec3& cameraPos, float projScale)
 	{
-		// 根据Vertices大小创建VertexBuffer
-		VkDeviceSize bufferSize = sizeof(inVertices[0]) * inVertices.size();
-
-		// 为什么需要stagingBuffer，因为直接创建VertexBuffer，CPU端可以直接通过VertexBufferMemory范围GPU使用的内存，这样太危险了，
-		// 所以我们先创建一个临时的Buffer写入数据，然后将这个Buffer拷贝给最终的VertexBuffer，
-		// VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT标签，使得最终的VertexBuffer位于硬件本地内存中，比如显卡的显存。
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		// 通用函数用来创建VertexBuffer，这样可以方便创建StagingBuffer和真正的VertexBuffer
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		if (object.Instances.empty()) {
+			return false;
+		}
+		const FMesh& mesh = object.MeshData;
+		glm::vec3 boundsCenter = (mesh.BoundsMin + mesh.BoundsMax) * 0.5f;
+		float boundsRadius = glm::length(boundsCenter) + glm::length(mesh.BoundsMax - mesh.BoundsMin) * 0.5f;
+		float screenHeight = static_cast<float>(SwapChainExtent.height);
 
-		// 把数据拷贝到顶点缓存区中
-		void* data;
-		vkMapMemory(Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, inVertices.data(), (size_t)bufferSize);
-		vkUnmapMemory(Device, stagingBufferMemory);
+		// 每级LOD可以使用的最大屏幕空间大小，误差越大的LOD只能在越小的屏幕尺寸下使用
+		float lodScreenSizes[MAX_MESH_LODS];
+		for (uint32_t lod = 1; lod < mesh.LodCount; lod++) {
+			float error = std::max(mesh.Lods[lod].Error, 1e-6f);
+			lodScreenSizes[lod] = 2.0f * LOD_ERROR_PIXELS * boundsRadius / (error * screenHeight);
+		}
 
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outBuffer, outMemory);
+		uint32_t lodCounts[MAX_MESH_LODS] = {};
+		for (size_t i = 0; i < object.Instances.size(); i++)
+		{
+			const FInstanceData& instance = object.Instances[i];
+			glm::vec3 worldPosition = glm::vec3(localToWorld * glm::vec4(instance.InstancePosition, 1.0f));
+			float radius = boundsRadius * instance.InstancePScale;
+			float distance = std::max(glm::length(worldPosition - cameraPos), radius);
+			float screenSize = radius > 0.0f ? projScale * radius / distance : 0.0f;
+
+			uint8_t selectedLod = 0;
+			for (uint32_t lod = mesh.LodCount - 1; lod > 0; lod--) {
+				if (screenSize <= lodScreenSizes[lod]) {
+					selectedLod = static_cast<uint8_t>(lod);
+					break;
+				}
+			}
+			object.InstanceLods[i] = selectedLod;
+			lodCounts[selectedLod]++;
+		}
 
-		CopyBuffer(stagingBuffer, outBuffer, bufferSize);
+		bool bLodCountsChanged = !std::equal(lodCounts, lodCounts + MAX_MESH_LODS, object.LodInstanceCount);
+		uint32_t firstInstance = 0;
+		for (uint32_t lod = 0; lod < MAX_MESH_LODS; lod++) {
+			object.LodFirstInstance[lod] = firstInstance;
+			object.LodInstanceCount[lod] = lodCounts[lod];
+			firstInstance += lodCounts[lod];
+		}
 
-		vkDestroyBuffer(Device, stagingBuffer, nullptr);
-		vkFreeMemory(Device, stagingBufferMemory, nullptr);
+		object.InstanceBufferOffset = VkDeviceSize(currentFrame) * object.Instances.size() * sizeof(FInstanceData);
+		FInstanceData* instanceData = reinterpret_cast<FInstanceData*>(object.MeshData.InstancedBufferMemory.Mapped + object.InstanceBufferOffset);
+		uint32_t cursor[MAX_MESH_LODS];
+		std::copy(object.LodFirstInstance, object.LodFirstInstance + MAX_MESH_LODS, cursor);
+		for (size_t i = 0; i < object.Instances.size(); i++) {
+			instanceData[cursor[object.InstanceLods[i]]++] = object.Instances[i];
+		}
+		return bLodCountsChanged;
 	}
 
-	/** 创建点序缓存区IBO*/
-	void CreateIndexBuffer(VkBuffer& outBuffer, VkDeviceMemory& outMemory, const std::vector<uint32_t>& inIndices)
+	/** 用主相机剔除簇，可见簇的命令写入这一帧的 VisibleCommandsBuffer
+	 * 在模型空间中剔除：包围球在视锥外，或者法线锥内的三角形全部背对相机时剔除整簇
+	 * 阴影使用完整的 IndirectCommands，不受主相机剔除影响
+	 * 返回可见簇的数量是否变化，数量写在录制的 DrawCall 中*/
+	bool UpdateVisibleClusters(FRenderIndirectObject& object, uint32_t currentFrame, const glm::mat4& localToClip, const glm::mat4& localToWorld, const glm::vec3& cameraPos)
 	{
-		VkDeviceSize bufferSize = sizeof(inIndices[0]) * inIndices.size();
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, inIndices.data(), (size_t)bufferSize);
-		vkUnmapMemory(Device, stagingBufferMemory);
-
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outBuffer, outMemory);
+		if (object.MeshData.Actors.empty() || object.IndirectCommands.empty()) {
+			return false;
+		}
+		const std::vector<FCluster>& clusters = object.MeshData.Actors[0].Clusters;
 
-		CopyBuffer(stagingBuffer, outBuffer, bufferSize);
+		// 从 MVP 矩阵中提取模型空间的视锥平面，深度范围为（0.0， 1.0）
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(localToClip[0][i], localToClip[1][i], localToClip[2][i], localToClip[3][i]);
+		}
+		glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+		for (glm::vec4& plane : planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		glm::vec3 localCameraPos = glm::vec3(glm::inverse(localToWorld) * glm::vec4(cameraPos, 1.0f));
 
-		vkDestroyBuffer(Device, stagingBuffer, nullptr);
-		vkFreeMemory(Device, stagingBufferMemory, nullptr);
+		object.VisibleCommandsOffset = VkDeviceSize(currentFrame) * object.IndirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+		VkDrawIndexedIndirectCommand* visibleCommands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(object.VisibleCommandsBufferMemory.Mapped + object.VisibleCommandsOffset);
+		uint32_t visibleCount = 0;
+		for (size_t i = 0; i < clusters.size(); i++)
+		{
+			const FCluster& cluster = clusters[i];
+			bool bVisible = true;
+			for (const glm::vec4& plane : planes) {
+				if (glm::dot(glm::vec3(plane), cluster.BoundsCenter) + plane.w < -cluster.BoundsRadius) {
+					bVisible = false;
+					break;
+				}
+			}
+			glm::vec3 toCluster = cluster.BoundsCenter - localCameraPos;
+			if (bVisible && glm::dot(toCluster, cluster.ConeAxis) >= cluster.ConeCutoff * glm::length(toCluster) + cluster.BoundsRadius) {
+				bVisible = false;
+			}
+			if (bVisible) {
+				visibleCommands[visibleCount++] = object.IndirectCommands[i];
+			}
+		}
+		bool bVisibleCountChanged = object.VisibleCommandCount != visibleCount;
+		object.VisibleCommandCount = visibleCount;
+		return bVisibleCountChanged;
 	}
 
 	/** 更新统一缓存区（UBO）*/
@@ -4040,11 +7288,6 @@ protected:
 		float zNear = GlobalInput.zNear;
 		float zFar = GlobalInput.zFar;
 
-		static auto startTime = std::chrono::high_resolution_clock::now();
-		auto CurrentTime = std::chrono::high_resolution_clock::now();
-		float Time = std::chrono::duration<float, std::chrono::seconds::period>(CurrentTime - startTime).count();
-		GlobalConstants.Time = Time;
-
 		ShadowmapPass.zNear = zNear;
 		ShadowmapPass.zFar = zFar;
 
@@ -4054,8 +7297,8 @@ protected:
 
 		glm::vec3 center = glm::vec3(0.0f);
 		
-		FLight* MoonLight = &View.DirectionalLights[0];
-		glm::vec3 lightPos = glm::vec3(MoonLight->Position.x, MoonLight->Position.y, MoonLight->Position.z);
+		const FLight& MoonLight = SceneLights.Get(ELightType::Directional, 0);
+		glm::vec3 lightPos = glm::vec3(MoonLight.Position.x, MoonLight.Position.y, MoonLight.Position.z);
 		float RollStage = GlobalInput.bPlayStageRoll ?
 			(GlobalInput.RollStage + GlobalInput.DeltaTime * glm::radians(15.0f)) : GlobalInput.RollStage;
 		GlobalInput.RollStage = RollStage;
@@ -4070,16 +7313,18 @@ protected:
 		UBOBaseData.Proj = glm::perspective(glm::radians(CameraFOV), SwapChainExtent.width / (float)SwapChainExtent.height, zNear, zFar);
 		UBOBaseData.Proj[1][1] *= -1;
 
-		void* data_base_ubo;
-		vkMapMemory(Device, BaseUniformBuffersMemory[currentImageIdx], 0, sizeof(UBOBaseData), 0, &data_base_ubo);
-		memcpy(data_base_ubo, &UBOBaseData, sizeof(UBOBaseData));
-		vkUnmapMemory(Device, BaseUniformBuffersMemory[currentImageIdx]);
+		// 这一帧的Fence已经触发，GPU不再读取这一帧的统一缓存环，从头重新分配
+		FUniformRing& uniformRing = UniformRings[currentImageIdx];
+		FFrameUniforms& frameUniforms = FrameUniforms[currentImageIdx];
+		uniformRing.Reset();
+		uint32_t baseOffset = uniformRing.Push(UBOBaseData);
 
 		// ShadowmapSpace 的 MVP 矩阵中，M矩阵在FS中计算，所以传入 localToWorld 进入FS
 		View.ShadowmapSpace = shadowProjection * shadowView;
 		View.LocalToWorld = localToWorld;
 		View.CameraInfo = glm::vec4(CameraPos, CameraFOV);
-		uint32_t PointLightNum = POINT_LIGHTS_NUM;
+		// 只有位置变化的点光源需要重新上传，灯光不转动时没有上传
+		uint32_t PointLightNum = SceneLights.Num(ELightType::Point);
 		for (uint32_t i = 0; i < PointLightNum; i++)
 		{
 			float radians = ((float)i / (float)PointLightNum) * 360.0f - RollLight * 100.0f;
@@ -4087,58 +7332,52 @@ protected:
 			float X = sin(glm::radians(radians)) * distance;
 			float Y = cos(glm::radians(radians)) * distance;
 			float Z = 1.5;
-			View.PointLights[i].Position = glm::vec4(X, Y, Z, 1.0);
+			glm::vec4 position = glm::vec4(X, Y, Z, 1.0);
+			if (SceneLights.Get(ELightType::Point, i).Position != position) {
+				SceneLights.Edit(ELightType::Point, i).Position = position;
+			}
 		}
-		View.LightsCount = glm::ivec4(1, PointLightNum, 0, CubemapMaxMips);
+		UploadDirtyLights(currentImageIdx);
+		View.LightsCount = glm::ivec4(SceneLights.Num(ELightType::Directional), PointLightNum, SceneLights.Num(ELightType::Spot), CubemapMaxMips);
 		View.zNear = ShadowmapPass.zNear;
 		View.zFar = ShadowmapPass.zFar;
 
-		void* data_view;
-		vkMapMemory(Device, ViewUniformBuffersMemory[currentImageIdx], 0, sizeof(View), 0, &data_view);
-		memcpy(data_view, &View, sizeof(View));
-		vkUnmapMemory(Device, ViewUniformBuffersMemory[currentImageIdx]);
+		uint32_t viewOffset = uniformRing.Push(View);
 
 		FUniformBufferBase UBOShadowData{};
 		UBOShadowData.Model = localToWorld;
 		UBOShadowData.View = shadowView;
 		UBOShadowData.Proj = shadowProjection;
 
-		void* data_shadow_ubo;
-		vkMapMemory(Device, ShadowmapPass.UniformBuffersMemory[currentImageIdx], 0, sizeof(UBOShadowData), 0, &data_shadow_ubo);
-		memcpy(data_shadow_ubo, &UBOShadowData, sizeof(UBOShadowData));
-		vkUnmapMemory(Device, ShadowmapPass.UniformBuffersMemory[currentImageIdx]);
+		uint32_t shadowOffset = uniformRing.Push(UBOShadowData);
 
-		// Push all render objects into shadow map pending rendering list
-		ShadowmapPass.RenderObjects.clear();
-		ShadowmapPass.RenderInstancedObjects.clear();
-		ShadowmapPass.RenderIndirectObject.clear();
-		ShadowmapPass.RenderIndirectInstancedObject.clear();
-		for (size_t i = 0; i < BaseScenePass.RenderObjects.size(); i++)
-		{
-			ShadowmapPass.RenderObjects.push_back(&BaseScenePass.RenderObjects[i]);
-		}
-		for (size_t i = 0; i < BaseScenePass.RenderInstancedObjects.size(); i++)
-		{
-			ShadowmapPass.RenderInstancedObjects.push_back(&BaseScenePass.RenderInstancedObjects[i]);
-		}
-		for (size_t i = 0; i < BaseSceneIndirectPass.RenderIndirectObject.size(); i++)
-		{
-			ShadowmapPass.RenderIndirectObject.push_back(&BaseSceneIndirectPass.RenderIndirectObject[i]);
-		}
-		for (size_t i = 0; i < BaseSceneIndirectPass.RenderIndirectInstancedObject.size(); i++)
-		{
-			ShadowmapPass.RenderIndirectInstancedObject.push_back(&BaseSceneIndirectPass.RenderIndirectInstancedObject[i]);
+		frameUniforms.Scene.Offsets[0] = baseOffset;
+		frameUniforms.Scene.Offsets[1] = viewOffset;
+		frameUniforms.Shadow.Offsets[0] = shadowOffset;
+		frameUniforms.Lighting.Offsets[0] = viewOffset;
+
+		// Instanced 物体按主相机的屏幕空间大小选择LOD
+		float projScale = std::abs(UBOBaseData.Proj[1][1]);
+		for (FRenderInstancedObject* renderInstancedObject : SceneRegistry.InstancedObjects.GetPass(EScenePass::Forward).Objects) {
+			if (UpdateInstanceLods(*renderInstancedObject, currentImageIdx, localToWorld, CameraPos, projScale)) {
+				SceneDrawVersion++;
+			}
 		}
 #if ENABLE_DEFEERED_RENDERING
-		for (size_t i = 0; i < BaseSceneDeferredPass.RenderObjects.size(); i++)
-		{
-			ShadowmapPass.RenderObjects.push_back(&BaseSceneDeferredPass.RenderObjects[i]);
-		}
-		for (size_t i = 0; i < BaseSceneDeferredPass.RenderInstancedObjects.size(); i++)
-		{
-			ShadowmapPass.RenderInstancedObjects.push_back(&BaseSceneDeferredPass.RenderInstancedObjects[i]);
+		for (FRenderInstancedObject* renderInstancedObject : SceneRegistry.InstancedObjects.GetPass(EScenePass::Deferred).Objects) {
+			if (UpdateInstanceLods(*renderInstancedObject, currentImageIdx, localToWorld, CameraPos, projScale)) {
+				SceneDrawVersion++;
+			}
 		}
 #endif
+
+		// Indirect 物体只绘制主相机可见的簇
+		glm::mat4 localToClip = UBOBaseData.Proj * UBOBaseData.View * localToWorld;
+		for (FRenderIndirectObject* renderIndirectObject : SceneRegistry.IndirectObjects.GetPass(EScenePass::Indirect).Objects) {
+			if (UpdateVisibleClusters(*renderIndirectObject, currentImageIdx, localToClip, localToWorld, CameraPos)) {
+				SceneDrawVersion++;
+			}
+		}
 	}
 
 	/** 创建Shader模块*/
@@ -4158,8 +7397,43 @@ protected:
 		return shaderModule;
 	}
 
+	/** 按顶点格式取得顶点输入描述，bInstanced 时包含 Instance 数据的绑定*/
+	static void GetVertexInputDescriptions(
+		const EVertexFormat inVertexFormat,
+		const bool bInstanced,
+		std::vector<VkVertexInputBindingDescription>& outBindings,
+		std::vector<VkVertexInputAttributeDescription>& outAttributes)
+	{
+		if (inVertexFormat == EVertexFormat::Compact && bInstanced)
+		{
+			auto bindings = FCompactVertex::GetBindingInstancedDescriptions();
+			auto attributes = FCompactVertex::GetAttributeInstancedDescriptions();
+			outBindings.assign(bindings.begin(), bindings.end());
+			outAttributes.assign(attributes.begin(), attributes.end());
+		}
+		else if (inVertexFormat == EVertexFormat::Compact)
+		{
+			auto attributes = FCompactVertex::GetAttributeDescriptions();
+			outBindings = { FCompactVertex::GetBindingDescription() };
+			outAttributes.assign(attributes.begin(), attributes.end());
+		}
+		else if (bInstanced)
+		{
+			auto bindings = FVertex::GetBindingInstancedDescriptions();
+			auto attributes = FVertex::GetAttributeInstancedDescriptions();
+			outBindings.assign(bindings.begin(), bindings.end());
+			outAttributes.assign(attributes.begin(), attributes.end());
+		}
+		else
+		{
+			auto attributes = FVertex::GetAttributeDescriptions();
+			outBindings = { FVertex::GetBindingDescription() };
+			outAttributes.assign(attributes.begin(), attributes.end());
+		}
+	}
+
 	/**创建图形渲染管线*/
-	void CreatePipelineLayout(VkPipelineLayout& outPipelineLayout, const VkDescriptorSetLayout& inDescriptorSetLayout)
+	void CreatePipelineLayout(VkPipelineLayout& outPipelineLayout, const VkDescriptorSetLayout& inDescriptorSetLayout, bool bSceneDrawData = false)
 	{
 		// 设置 push constants
 		VkPushConstantRange pushConstant;
@@ -4170,10 +7444,12 @@ protected:
 		pushConstant.stageFlags = VK_SHADER_STAGE_ALL;
 
 		// 在渲染管线创建时，指定DescriptorSetLayout，用来传UniformBuffer
+		// 场景物体和延迟光照的管线在 set 1 上额外绑定 DrawData 和灯光存储缓存
+		VkDescriptorSetLayout setLayouts[] = { inDescriptorSetLayout, DrawDataDescriptorSetLayout };
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &inDescriptorSetLayout;
+		pipelineLayoutInfo.setLayoutCount = bSceneDrawData ? 2 : 1;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
 		pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
 		pipelineLayoutInfo.pushConstantRangeCount = 1;
 
@@ -4195,7 +7471,8 @@ protected:
 		const std::string& inFragFilename,
 		const bool bDepthTest = true,
 		const bool bCullBack = true,
-		const bool bInstanced = false)
+		const bool bInstanced = false,
+		const EVertexFormat inVertexFormat = EVertexFormat::Full)
 	{
 		auto vertShaderCode = LoadShaderSource(inVertFilename);
 		auto fragShaderCode = LoadShaderSource(inFragFilename);
@@ -4218,10 +7495,9 @@ protected:
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCI, fragShaderStageCI };
 
 		// 顶点缓存绑定的描述，定义了顶点都需要绑定什么数据，比如第一个位置绑定Position，第二个位置绑定Color，第三个位置绑定UV等
-		auto bindingDescription = FVertex::GetBindingDescription();
-		auto attributeDescriptions = FVertex::GetAttributeDescriptions();
-		auto bindingInstancedDescriptions = FVertex::GetBindingInstancedDescriptions();
-		auto attributeInstancedDescriptions = FVertex::GetAttributeInstancedDescriptions();
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		GetVertexInputDescriptions(inVertexFormat, bInstanced, bindingDescriptions, attributeDescriptions);
 
 		// 渲染管线VertexBuffer输入
 		VkPipelineVertexInputStateCreateInfo vertexInputCI{};
@@ -4231,20 +7507,12 @@ protected:
 			vertexInputCI.vertexBindingDescriptionCount = 0;
 			vertexInputCI.vertexAttributeDescriptionCount = 0;
 		}
-		else if (bInstanced)
-		{
-			vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-			vertexInputCI.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingInstancedDescriptions.size());
-			vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeInstancedDescriptions.size());
-			vertexInputCI.pVertexBindingDescriptions = bindingInstancedDescriptions.data();
-			vertexInputCI.pVertexAttributeDescriptions = attributeInstancedDescriptions.data();
-		}
-		else // 正常VBO渲染绑定
+		else // 正常VBO渲染绑定，Instanced时多一个Instance数据的绑定
 		{
 			vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-			vertexInputCI.vertexBindingDescriptionCount = 1;
+			vertexInputCI.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 			vertexInputCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-			vertexInputCI.pVertexBindingDescriptions = &bindingDescription;
+			vertexInputCI.pVertexBindingDescriptions = bindingDescriptions.data();
 			vertexInputCI.pVertexAttributeDescriptions = attributeDescriptions.data();
 		}
 
@@ -4358,44 +7626,42 @@ protected:
 	/** 读取一个贴图路径，然后创建图像、视口和采样器等资源*/
 	void CreateImageContext(
 		VkImage& outImage,
-		VkDeviceMemory& outMemory,
+		FMemoryAllocation& outMemory,
 		VkImageView& outImageView,
 		VkSampler& outSampler,
 		const std::string& filename, bool sRGB = true)
 	{
-		int texWidth, texHeight, texChannels, mipLevels;
-        std::vector<uint8_t> pixels;
-        LoadTextureAsset(filename, pixels, texWidth, texHeight, texChannels, mipLevels);
-
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        void* data;
-		vkMapMemory(Device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels.data(), static_cast<size_t>(imageSize));
-		vkUnmapMemory(Device, stagingBufferMemory);
-        
-		VkFormat format = sRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
-		// VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT 告诉Vulkan这张贴图即要被读也要被写
+		FTextureAsset texture;
+		LoadTextureAsset(filename, texture, DeviceCaps.CookedTextureFormatSupport, &StagingRing);
+		CreateImageContext(outImage, outMemory, outImageView, outSampler, texture, sRGB);
+	}
+
+	/** 用已经解码的贴图数据创建图像，视口和采样器*/
+	void CreateImageContext(
+		VkImage& outImage,
+		FMemoryAllocation& outMemory,
+		VkImageView& outImageView,
+		VkSampler& outSampler,
+		FTextureAsset& texture, bool sRGB = true)
+	{
+		int texWidth = texture.Width;
+		int texHeight = texture.Height;
+		int mipLevels = texture.MipLevels;
+
+		VkFormat format = GetTextureFormat(texture.Format, sRGB);
+		// 烘焙贴图带有完整的Mip链，只需要拷贝，否则 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT 告诉Vulkan这张贴图即要被读也要被写
+		VkImageUsageFlags usage = texture.Mips.empty() ?
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT :
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		CreateImage(
 			outImage,
 			outMemory,
 			texWidth, texHeight, format,
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			usage,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevels);
 
-		TransitionImageLayout(outImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-		CopyBufferToImage(stagingBuffer, outImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		//TransitionImageLayout(outImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		vkDestroyBuffer(Device, stagingBuffer, nullptr);
-		vkFreeMemory(Device, stagingBufferMemory, nullptr);
-
-		GenerateMipmaps(outImage, format, texWidth, texHeight, mipLevels);
+		UploadImageData(outImage, format, texture);
 
 		CreateImageView(outImageView, outImage, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 		CreateSampler(outSampler,
@@ -4410,7 +7676,7 @@ protected:
 	/** 读取一个HDR贴图路径，然后创建CUBEMAP图像资源*/
 	void CreateImageHDRContext(
 		VkImage& outImage,
-		VkDeviceMemory& outMemory,
+		FMemoryAllocation& outMemory,
 		VkImageView& outImageView,
 		VkSampler& outSampler,
 		uint32_t& outMaxMipLevels,
@@ -4418,22 +7684,17 @@ protected:
 	{
 		// https://matheowis.github.io/HDRI-to-CubeMap/
 		int texWidth, texHeight, texChannels, mipLevels;
-        std::vector<std::vector<uint8_t>> pixels_array;
-        pixels_array.resize(6);
-		for (int i = 0; i < 6; ++i) {
-			LoadTextureAsset(filenames[i], pixels_array[i], texWidth, texHeight, texChannels, mipLevels);
-		}
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		CreateBuffer(imageSize * 6, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
+		VkDeviceSize imageSize = 0;
+		FStagingBlock staging{};
+		// 六个面依次解码，直接拷贝进StagingBuffer
 		for (int i = 0; i < 6; ++i) {
-			void* writeLocation;
-			vkMapMemory(Device, stagingBufferMemory, imageSize * i, imageSize, 0, &writeLocation);
-			memcpy(writeLocation, pixels_array[i].data(), imageSize);
-			vkUnmapMemory(Device, stagingBufferMemory);
+			stbi_uc* pixels = DecodeTextureFile(filenames[i], texWidth, texHeight, texChannels, mipLevels);
+			if (i == 0) {
+				imageSize = texWidth * texHeight * 4;
+				staging = AllocateStaging(imageSize * 6);
+			}
+			memcpy(staging.Data + imageSize * i, pixels, static_cast<size_t>(imageSize));
+			stbi_image_free(pixels);
 		}
 
 		// CreateImage
@@ -4461,16 +7722,10 @@ protected:
 			VkMemoryRequirements memRequirements;
 			vkGetImageMemoryRequirements(Device, outImage, &memRequirements);
 
-			VkMemoryAllocateInfo allocInfo{};
-			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			allocInfo.allocationSize = memRequirements.size;
-			allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			outMemory = MemoryAllocator.Allocate(memRequirements, memoryTypeIndex, EMemoryResourceType::Optimal, EMemoryAllocationStrategy::FreeList);
 
-			if (vkAllocateMemory(Device, &allocInfo, nullptr, &outMemory) != VK_SUCCESS) {
-				throw std::runtime_error("failed to allocate image memory!");
-			}
-
-			vkBindImageMemory(Device, outImage, outMemory, 0);
+			vkBindImageMemory(Device, outImage, outMemory.Memory, outMemory.Offset);
 		}
 		// TransitionImageLayout
 		{
@@ -4510,7 +7765,7 @@ protected:
 			VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
 
 			VkBufferImageCopy region{};
-			region.bufferOffset = 0;
+			region.bufferOffset = staging.Offset;
 			region.bufferRowLength = 0;
 			region.bufferImageHeight = 0;
 			VkImageSubresourceLayers imageSubresource;
@@ -4525,7 +7780,7 @@ protected:
 				static_cast<uint32_t>(texHeight),
 				1
 			};
-			vkCmdCopyBufferToImage(CommandBuffer, stagingBuffer, outImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+			vkCmdCopyBufferToImage(CommandBuffer, staging.Buffer, outImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 			EndSingleTimeCommands(CommandBuffer);
 		}
 		// GenerateMipmaps
@@ -4623,8 +7878,7 @@ protected:
 
 			EndSingleTimeCommands(CommandBuffer);
 		}
-		vkDestroyBuffer(Device, stagingBuffer, nullptr);
-		vkFreeMemory(Device, stagingBufferMemory, nullptr);
+		ReleaseStaging(staging);
 
 		// CreateImageView
 		{
@@ -4704,6 +7958,14 @@ protected:
 	}
 
 	void GenerateMipmaps(VkImage& outImage, const VkFormat& imageFormat, const int32_t texWidth, const int32_t texHeight, const uint32_t mipLevels)
+	{
+		VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+		RecordGenerateMipmaps(commandBuffer, outImage, imageFormat, texWidth, texHeight, mipLevels);
+		EndSingleTimeCommands(commandBuffer);
+	}
+
+	/** 录制用 vkCmdBlitImage 逐级生成Mip的指令，第0级需要处于 TRANSFER_DST 布局，完成后所有级别转换到着色器读取*/
+	void RecordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, const VkFormat& imageFormat, const int32_t texWidth, const int32_t texHeight, const uint32_t mipLevels)
 	{
 		// 检查图像格式是否支持 linear blitting
 		VkFormatProperties formatProperties;
@@ -4713,11 +7975,9 @@ protected:
 			throw std::runtime_error("texture image format does not support linear blitting!");
 		}
 
-		VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.image = outImage;
+		barrier.image = image;
 		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -4756,8 +8016,8 @@ protected:
 			blit.dstSubresource.layerCount = 1;
 
 			vkCmdBlitImage(commandBuffer,
-				outImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				outImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				1, &blit,
 				VK_FILTER_LINEAR);
 
@@ -4787,35 +8047,69 @@ protected:
 			0, nullptr,
 			0, nullptr,
 			1, &barrier);
+	}
 
-		EndSingleTimeCommands(commandBuffer);
+	/** 烘焙贴图格式对应的 VkFormat，BC4/BC5 存储的是线性数据，没有 sRGB 版本*/
+	static VkFormat GetTextureFormat(ECookedTextureFormat format, bool sRGB)
+	{
+		switch (format)
+		{
+		case ECookedTextureFormat::BC1:
+			return sRGB ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case ECookedTextureFormat::BC4:
+			return VK_FORMAT_BC4_UNORM_BLOCK;
+		case ECookedTextureFormat::BC5:
+			return VK_FORMAT_BC5_UNORM_BLOCK;
+		case ECookedTextureFormat::BC7:
+			return sRGB ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		default:
+			return sRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
 	}
 
-	/** 将缓存拷贝到图片对象中*/
-	void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+	/** 检查贴图格式是否可以采样并且线性过滤*/
+	bool IsTextureFormatSupported(VkFormat format)
 	{
-		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(PhysicalDevice, format, &formatProperties);
+		VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+	}
 
-		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = { width, height, 1 };
+	/** 将缓存中的多级Mip一次拷贝到图片对象中，每一级Mip一个拷贝区域*/
+	void CopyBufferToImage(VkBuffer buffer, VkImage image, const std::vector<FCookedTextureMip>& mips, VkDeviceSize bufferOffset = 0)
+	{
+		VkCommandBuffer CommandBuffer = BeginSingleTimeCommands();
 
-		vkCmdCopyBufferToImage(CommandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		std::vector<VkBufferImageCopy> regions = GetMipCopyRegions(mips, bufferOffset);
+		vkCmdCopyBufferToImage(CommandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
 
 		EndSingleTimeCommands(CommandBuffer);
 	}
 
+	/** 每一级Mip对应的拷贝区域，bufferOffset为Mip数据在缓存中的起始位置*/
+	static std::vector<VkBufferImageCopy> GetMipCopyRegions(const std::vector<FCookedTextureMip>& mips, VkDeviceSize bufferOffset)
+	{
+		std::vector<VkBufferImageCopy> regions(mips.size());
+		for (size_t i = 0; i < mips.size(); i++)
+		{
+			regions[i].bufferOffset = bufferOffset + mips[i].Offset;
+			regions[i].bufferRowLength = 0;
+			regions[i].bufferImageHeight = 0;
+			regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[i].imageSubresource.mipLevel = static_cast<uint32_t>(i);
+			regions[i].imageSubresource.baseArrayLayer = 0;
+			regions[i].imageSubresource.layerCount = 1;
+			regions[i].imageOffset = { 0, 0, 0 };
+			regions[i].imageExtent = { mips[i].Width, mips[i].Height, 1 };
+		}
+		return regions;
+	}
+
 	/** 创建图像资源*/
 	void CreateImage(
 		VkImage& outImage,
-		VkDeviceMemory& outImageMemory,
+		FMemoryAllocation& outImageMemory,
 		const uint32_t inWidth, const uint32_t inHeight, const VkFormat format,
 		const VkImageTiling tiling, const VkImageUsageFlags usage,
 		const VkMemoryPropertyFlags properties, const uint32_t miplevels = 1)
@@ -4842,16 +8136,12 @@ protected:
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(Device, outImage, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(Device, &allocInfo, nullptr, &outImageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate image memory!");
-		}
+		// Linear 布局的图像和Buffer一样，Optimal 布局的图像和Buffer相邻时需要按 bufferImageGranularity 隔开
+		uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+		EMemoryResourceType resourceType = (tiling == VK_IMAGE_TILING_LINEAR) ? EMemoryResourceType::Linear : EMemoryResourceType::Optimal;
+		outImageMemory = MemoryAllocator.Allocate(memRequirements, memoryTypeIndex, resourceType, EMemoryAllocationStrategy::FreeList);
 
-		vkBindImageMemory(Device, outImage, outImageMemory, 0);
+		vkBindImageMemory(Device, outImage, outImageMemory.Memory, outImageMemory.Offset);
 	}
 
 	/** 创建图像视口*/
@@ -4888,9 +8178,6 @@ protected:
 		const VkBorderColor borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
 		const uint32_t miplevels = 1)
 	{
-		VkPhysicalDeviceProperties properties{};
-		vkGetPhysicalDeviceProperties(PhysicalDevice, &properties);
-
 		VkSamplerCreateInfo samplerInfo{};
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 		samplerInfo.magFilter = filter;
@@ -4898,9 +8185,9 @@ protected:
 		samplerInfo.addressModeU = addressModeU;
 		samplerInfo.addressModeV = addressModeV;
 		samplerInfo.addressModeW = addressModeW;
-		// 可在此处关闭各项异性，有些硬件可能不支持
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+		// 有些硬件不支持各项异性，这时关闭
+		samplerInfo.anisotropyEnable = DeviceCaps.bSamplerAnisotropy ? VK_TRUE : VK_FALSE;
+		samplerInfo.maxAnisotropy = DeviceCaps.MaxSamplerAnisotropy;
 		samplerInfo.borderColor = borderColor;
 		samplerInfo.unnormalizedCoordinates = VK_FALSE;
 		samplerInfo.compareEnable = VK_FALSE;
@@ -4922,7 +8209,7 @@ protected:
 		VkDescriptorSetLayoutBinding baseUBOLayoutBinding{};
 		baseUBOLayoutBinding.binding = 0;
 		baseUBOLayoutBinding.descriptorCount = 1;
-		baseUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		baseUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		baseUBOLayoutBinding.pImmutableSamplers = nullptr;
 		baseUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -4930,7 +8217,7 @@ protected:
 		VkDescriptorSetLayoutBinding viewUBOLayoutBinding{};
 		viewUBOLayoutBinding.binding = 1;
 		viewUBOLayoutBinding.descriptorCount = 1;
-		viewUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		viewUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		viewUBOLayoutBinding.pImmutableSamplers = nullptr;
 		viewUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // View ubo 主要信息用于 fragment shader
 
@@ -4985,9 +8272,9 @@ protected:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes;
 		poolSizes.resize(inSamplerNumber + 4);
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
@@ -5041,9 +8328,9 @@ protected:
 			std::vector<VkWriteDescriptorSet> descriptorWrites{};
 			descriptorWrites.resize(write_size);
 
-			// 绑定 UnifromBuffer
+			// 绑定 UnifromBuffer，两个统一缓存都在这一帧的统一缓存环中，偏移在绑定时动态指定
 			VkDescriptorBufferInfo baseBufferInfo{};
-			baseBufferInfo.buffer = BaseUniformBuffers[i];
+			baseBufferInfo.buffer = UniformRings[i].Buffer;
 			baseBufferInfo.offset = 0;
 			baseBufferInfo.range = sizeof(FUniformBufferBase);
 
@@ -5051,13 +8338,13 @@ protected:
 			descriptorWrites[0].dstSet = outDescriptorSets[i];
 			descriptorWrites[0].dstBinding = 0;
 			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			descriptorWrites[0].descriptorCount = 1;
 			descriptorWrites[0].pBufferInfo = &baseBufferInfo;
 
 			// 绑定 UnifromBuffer
 			VkDescriptorBufferInfo viewBufferInfo{};
-			viewBufferInfo.buffer = ViewUniformBuffers[i];
+			viewBufferInfo.buffer = UniformRings[i].Buffer;
 			viewBufferInfo.offset = 0;
 			viewBufferInfo.range = sizeof(FUniformBufferView);
 
@@ -5065,7 +8352,7 @@ protected:
 			descriptorWrites[1].dstSet = outDescriptorSets[i];
 			descriptorWrites[1].dstBinding = 1;
 			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			descriptorWrites[1].descriptorCount = 1;
 			descriptorWrites[1].pBufferInfo = &viewBufferInfo;
 
@@ -5115,42 +8402,93 @@ protected:
 				descriptorWrites[j + 4].descriptorCount = 1;
 				descriptorWrites[j + 4].pImageInfo = &imageInfos[j]; // 注意，这里是引用了VkDescriptorImageInfo，所有需要创建imageInfos这个数组，存储所有的imageInfo而不是使用局部变量imageInfo
 			}
-
-			vkUpdateDescriptorSets(Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+			vkUpdateDescriptorSets(Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+	}
+
+	template <typename T>
+	void CreateRenderObject(T& outObject, const std::string& objfile, const std::vector<std::string>& pngfiles, const VkDescriptorSetLayout& inDescriptorSetLayout)
+	{
+		// 没有工作线程时，解码任务直接在当前线程执行
+		FJobSystem inlineJobs(0);
+		FRenderObjectAssets assets = LoadRenderObjectAssets(inlineJobs, objfile, pngfiles);
+		CreateRenderObject<T>(outObject, assets, inDescriptorSetLayout);
+		PendingTextureDecodes.clear();
+	};
+
+	/** 提交RenderObject的模型和贴图解码任务，同一张贴图只解码一次，已经在缓存中的贴图只计算哈希*/
+	FRenderObjectAssets LoadRenderObjectAssets(FJobSystem& jobs, const std::string& objfile, const std::vector<std::string>& pngfiles,
+		EVertexFormat vertexFormat = EVertexFormat::Full)
+	{
+		FRenderObjectAssets assets;
+		assets.Mesh = jobs.Submit([objfile, vertexFormat]() {
+			auto meshAsset = std::make_shared<FMeshAsset>();
+			const FCookedMeshHeader* header = LoadCookedModelAsset(objfile, meshAsset->CookedFile);
+			// 紧凑格式在工作线程中量化，主线程只需要上传
+			if (vertexFormat == EVertexFormat::Compact) {
+				meshAsset->VertexFormat = EVertexFormat::Compact;
+				FCompactVertex::Quantize(
+					reinterpret_cast<const FVertex*>(meshAsset->CookedFile.Data + header->VertexOffset), header->VertexCount,
+					meshAsset->CompactVertices, meshAsset->Dequantization);
+			}
+			return meshAsset;
+		});
+		assets.TextureFiles = pngfiles;
+		for (size_t i = 0; i < pngfiles.size(); i++)
+		{
+			const std::string& pngfile = pngfiles[i];
+			bool sRGB = (i == 0);
+			std::string pendingKey = pngfile + (sRGB ? "#srgb" : "#linear");
+			auto pending = PendingTextureDecodes.find(pendingKey);
+			if (pending == PendingTextureDecodes.end())
+			{
+				std::shared_future<std::shared_ptr<FTextureAsset>> decode = jobs.Submit([this, pngfile, sRGB]() {
+					auto texture = std::make_shared<FTextureAsset>();
+					texture->ContentHash = HashTextureContent(pngfile);
+					if (!IsTextureCached(MakeTextureCacheKey(pngfile, texture->ContentHash, sRGB))) {
+						LoadTextureAsset(pngfile, *texture, DeviceCaps.CookedTextureFormatSupport, &StagingRing);
+					}
+					return texture;
+				}).share();
+				pending = PendingTextureDecodes.emplace(pendingKey, decode).first;
+			}
+			assets.Textures.push_back(pending->second);
 		}
+		return assets;
 	}
 
+	/** 等待解码完成，然后创建RenderObject的Vulkan资源*/
 	template <typename T>
-	void CreateRenderObject(T& outObject, const std::string& objfile, const std::vector<std::string>& pngfiles, const VkDescriptorSetLayout& inDescriptorSetLayout)
+	void CreateRenderObject(T& outObject, FRenderObjectAssets& assets, const VkDescriptorSetLayout& inDescriptorSetLayout)
 	{
-		CreateMesh(outObject.MeshData.Vertices, outObject.MeshData.Indices, objfile);
-		outObject.MateData.TextureImages.resize(pngfiles.size());
-		outObject.MateData.TextureImageMemorys.resize(pngfiles.size());
-		outObject.MateData.TextureImageViews.resize(pngfiles.size());
-		outObject.MateData.TextureSamplers.resize(pngfiles.size());
-		for (size_t i = 0; i < pngfiles.size(); i++)
+		size_t textureCount = assets.Textures.size();
+		outObject.MateData.TextureImages.resize(textureCount);
+		outObject.MateData.TextureImageMemorys.resize(textureCount);
+		outObject.MateData.TextureImageViews.resize(textureCount);
+		outObject.MateData.TextureSamplers.resize(textureCount);
+		outObject.MateData.TextureKeys.resize(textureCount);
+		for (size_t i = 0; i < textureCount; i++)
 		{
-			// 一个便捷函数，创建图像，视口和采样器
+			// 从贴图缓存中取得共享的图像，视口和采样器
 			bool sRGB = (i == 0);
-			CreateImageContext(
-				outObject.MateData.TextureImages[i],
-				outObject.MateData.TextureImageMemorys[i],
-				outObject.MateData.TextureImageViews[i],
-				outObject.MateData.TextureSamplers[i],
-				pngfiles[i], sRGB);
-		}
-
-		CreateVertexBuffer(
-			outObject.MeshData.VertexBuffer,
-			outObject.MeshData.VertexBufferMemory,
-			outObject.MeshData.Vertices);
-		CreateIndexBuffer(
-			outObject.MeshData.IndexBuffer,
-			outObject.MeshData.IndexBufferMemory,
-			outObject.MeshData.Indices);
+			std::shared_ptr<FTextureAsset> texture = assets.Textures[i].get();
+			const FTextureCacheEntry& entry = AcquireTexture(outObject.MateData.TextureKeys[i], assets.TextureFiles[i], *texture, sRGB);
+			outObject.MateData.TextureImages[i] = entry.Image;
+			outObject.MateData.TextureImageMemorys[i] = entry.Memory;
+			outObject.MateData.TextureImageViews[i] = entry.ImageView;
+			outObject.MateData.TextureSamplers[i] = entry.Sampler;
+		}
+
+		std::shared_ptr<FMeshAsset> meshAsset = assets.Mesh.get();
+		CreateMesh(outObject.MeshData, *meshAsset);
+		outObject.DrawDataIndex = AllocateDrawData(outObject.MeshData);
+		if constexpr (std::is_base_of<FRenderIndirectObjectBase, T>::value) {
+			LoadMeshClusters(outObject.MeshData, meshAsset->CookedFile);
+		}
 		CreateDescriptorPool(
 			outObject.MateData.DescriptorPool,
-			static_cast<uint32_t>(pngfiles.size()));
+			static_cast<uint32_t>(textureCount));
 		CreateDescriptorSets(
 			outObject.MateData.DescriptorSets,
 			outObject.MateData.DescriptorPool,
@@ -5159,65 +8497,213 @@ protected:
 			outObject.MateData.TextureSamplers);
 	};
 
+	/** 模型和贴图是否已经解码完成*/
+	static bool IsRenderObjectAssetsReady(const FRenderObjectAssets& assets)
+	{
+		if (assets.Mesh.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return false;
+		}
+		for (const auto& texture : assets.Textures) {
+			if (texture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** 创建RenderObject并加入渲染列表
+	 * 开启流式上传时只加入任务队列，解码完成后通过传输队列上传，上传完成后才加入渲染列表*/
 	template <typename T>
-	void CreateInstancedBuffer(T& outObject, const std::vector<FInstanceData>& inInstanceData)
+	void AddRenderObject(uint32_t inPassFlags, FRenderObjectAssets& assets, const VkDescriptorSetLayout& inDescriptorSetLayout, const std::vector<FInstanceData>& inInstanceData = {})
 	{
-		outObject.InstanceCount = static_cast<uint32_t>(inInstanceData.size());
-		VkDeviceSize bufferSize = inInstanceData.size() * sizeof(FInstanceData);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		CreateBuffer(
-			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer,
-			stagingBufferMemory);
+#if ENABLE_STREAMING_UPLOAD
+		auto sharedAssets = std::make_shared<FRenderObjectAssets>(std::move(assets));
+		auto queuedTime = std::chrono::high_resolution_clock::now();
+		StreamingTasks.push_back([this, inPassFlags, sharedAssets, &inDescriptorSetLayout, inInstanceData, queuedTime]() {
+			if (!IsRenderObjectAssetsReady(*sharedAssets)) {
+				return false;
+			}
+			auto object = std::make_shared<T>();
+			// 几何缓存池需要扩容时，必须在开始录制之前完成
+			ReserveMeshGeometry(*sharedAssets->Mesh.get());
+			BeginStreamingUpload();
+			CreateRenderObject<T>(*object, *sharedAssets, inDescriptorSetLayout);
+			if constexpr (std::is_same<T, FRenderInstancedObject>::value) {
+				CreateInstancedBuffer<T>(*object, inInstanceData);
+			}
+			SubmitStreamingUpload([this, inPassFlags, object, queuedTime]() {
+				SceneRegistry.GetPool<T>().Add(std::move(*object), inPassFlags);
+				auto streamedTime = std::chrono::high_resolution_clock::now();
+				std::cout << "[LOG]: Streamed render object in "
+					<< std::chrono::duration<float, std::chrono::milliseconds::period>(streamedTime - queuedTime).count() << " ms" << std::endl;
+			});
+			return true;
+		});
+#else
+		T object;
+		CreateRenderObject<T>(object, assets, inDescriptorSetLayout);
+		if constexpr (std::is_same<T, FRenderInstancedObject>::value) {
+			CreateInstancedBuffer<T>(object, inInstanceData);
+		}
+		SceneRegistry.GetPool<T>().Add(std::move(object), inPassFlags);
+#endif
+	}
+
+	/** 每帧最多开始一个解码完成的流式上传任务，避免一帧内录制过多的上传*/
+	void TickStreamingTasks()
+	{
+		for (auto it = StreamingTasks.begin(); it != StreamingTasks.end(); ++it)
+		{
+			if ((*it)()) {
+				StreamingTasks.erase(it);
+				return;
+			}
+		}
+	}
+
+	/** 贴图缓存的Key：路径 + 内容哈希 + sRGB*/
+	static std::string MakeTextureCacheKey(const std::string& filename, uint64_t contentHash, bool sRGB)
+	{
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(contentHash));
+		return filename + "#" + hash + (sRGB ? "#srgb" : "#linear");
+	}
+
+	bool IsTextureCached(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(TextureCacheMutex);
+		return TextureCache.count(key) > 0;
+	}
+
+	/** 从贴图缓存中取得贴图，不存在时创建，引用计数加一*/
+	const FTextureCacheEntry& AcquireTexture(std::string& outKey, const std::string& filename, FTextureAsset& texture, bool sRGB)
+	{
+		outKey = MakeTextureCacheKey(filename, texture.ContentHash, sRGB);
+		{
+			std::lock_guard<std::mutex> lock(TextureCacheMutex);
+			auto cached = TextureCache.find(outKey);
+			if (cached != TextureCache.end()) {
+				cached->second.RefCount++;
+				return cached->second;
+			}
+		}
+
+		FTextureCacheEntry entry{};
+		if (texture.Pixels == nullptr)
+		{
+			// 解码时贴图还在缓存中（或者像素已经上传过），之后被释放了，重新解码
+			FTextureAsset decoded;
+			LoadTextureAsset(filename, decoded, DeviceCaps.CookedTextureFormatSupport, &StagingRing);
+			CreateImageContext(entry.Image, entry.Memory, entry.ImageView, entry.Sampler, decoded, sRGB);
+		}
+		else
+		{
+			CreateImageContext(entry.Image, entry.Memory, entry.ImageView, entry.Sampler, texture, sRGB);
+		}
+		entry.RefCount = 1;
+
+		std::lock_guard<std::mutex> lock(TextureCacheMutex);
+		return TextureCache.emplace(outKey, entry).first->second;
+	}
+
+	/** 引用计数减一，为0时销毁贴图资源*/
+	void ReleaseTexture(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(TextureCacheMutex);
+		auto cached = TextureCache.find(key);
+		if (cached == TextureCache.end() || --cached->second.RefCount > 0) {
+			return;
+		}
+		vkDestroyImageView(Device, cached->second.ImageView, nullptr);
+		vkDestroySampler(Device, cached->second.Sampler, nullptr);
+		vkDestroyImage(Device, cached->second.Image, nullptr);
+		MemoryAllocator.Free(cached->second.Memory);
+		TextureCache.erase(cached);
+	}
 
-		void* data;
-		vkMapMemory(Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, inInstanceData.data(), (size_t)bufferSize);
-		vkUnmapMemory(Device, stagingBufferMemory);
+	/** 释放材质引用的所有贴图*/
+	void ReleaseMaterialTextures(FMaterial& material)
+	{
+		for (const std::string& key : material.TextureKeys) {
+			ReleaseTexture(key);
+		}
+		material.TextureKeys.clear();
+		material.TextureImages.clear();
+		material.TextureImageMemorys.clear();
+		material.TextureImageViews.clear();
+		material.TextureSamplers.clear();
+	}
 
+	template <typename T>
+	void CreateInstancedBuffer(T& outObject, const std::vector<FInstanceData>& inInstanceData)
+	{
+		// 每个Instance都记录所属物体的 DrawData 序号，Instanced 物体的 firstInstance 用来定位LOD桶
+		std::vector<FInstanceData> instanceData(inInstanceData);
+		for (FInstanceData& instance : instanceData) {
+			instance.InstanceDrawIndex = static_cast<glm::uint16>(outObject.DrawDataIndex);
+		}
+		outObject.InstanceCount = static_cast<uint32_t>(instanceData.size());
+		VkDeviceSize bufferSize = instanceData.size() * sizeof(FInstanceData);
+		if constexpr (std::is_same<T, FRenderInstancedObject>::value)
+		{
+			// 所有Instance先放在 LOD0，开启LOD时每帧重新分桶
+			outObject.LodInstanceCount[0] = outObject.InstanceCount;
+			if (ENABLE_INSTANCE_LOD && outObject.MeshData.LodCount > 1 && bufferSize > 0)
+			{
+				// 每帧按LOD重排Instance，每个同时渲染的帧使用缓存中独立的一段，CPU直接写入持久映射的内存
+				outObject.Instances = instanceData;
+				outObject.InstanceLods.resize(instanceData.size());
+				CreateBuffer(
+					bufferSize * MAX_FRAMES_IN_FLIGHT,
+					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					outObject.MeshData.InstancedBuffer,
+					outObject.MeshData.InstancedBufferMemory,
+					EMemoryAllocationStrategy::Linear);
+				for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+					memcpy(outObject.MeshData.InstancedBufferMemory.Mapped + bufferSize * i, instanceData.data(), bufferSize);
+				}
+				return;
+			}
+		}
+		// 物体可以在运行时添加和删除，Instance 缓存放在 FreeList 内存块中，碎片整理时可以拷贝到别的内存块
 		CreateBuffer(
 			bufferSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			outObject.MeshData.InstancedBuffer,
-			outObject.MeshData.InstancedBufferMemory);
-		CopyBuffer(stagingBuffer, outObject.MeshData.InstancedBuffer, bufferSize);
-
-		vkDestroyBuffer(Device, stagingBuffer, nullptr);
-		vkFreeMemory(Device, stagingBufferMemory, nullptr);
+			outObject.MeshData.InstancedBufferMemory,
+			EMemoryAllocationStrategy::FreeList);
+		UploadBufferData(outObject.MeshData.InstancedBuffer, instanceData.data(), bufferSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 	};
 
 	template <typename T>
 	void CreateRenderIndirectBuffer(T& outObject)
 	{
 		VkDeviceSize bufferSize = outObject.IndirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		CreateBuffer(
-			bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer,
-			stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, outObject.IndirectCommands.data(), (size_t)bufferSize);
-		vkUnmapMemory(Device, stagingBufferMemory);
-
 		CreateBuffer(
 			bufferSize,
 			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			outObject.IndirectCommandsBuffer,
-			outObject.IndirectCommandsBufferMemory);
-		CopyBuffer(stagingBuffer, outObject.IndirectCommandsBuffer, bufferSize);
-
-		vkDestroyBuffer(Device, stagingBuffer, nullptr);
-		vkFreeMemory(Device, stagingBufferMemory, nullptr);
+			outObject.IndirectCommandsBufferMemory,
+			EMemoryAllocationStrategy::Linear);
+		UploadBufferData(outObject.IndirectCommandsBuffer, outObject.IndirectCommands.data(), bufferSize, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+		if constexpr (std::is_same<T, FRenderIndirectObject>::value)
+		{
+			// 每帧剔除后可见簇的命令，每个同时渲染的帧使用缓存中独立的一段，剔除之前所有簇都可见
+			CreateBuffer(
+				bufferSize * MAX_FRAMES_IN_FLIGHT,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				outObject.VisibleCommandsBuffer,
+				outObject.VisibleCommandsBufferMemory,
+				EMemoryAllocationStrategy::Linear);
+			for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+				memcpy(outObject.VisibleCommandsBufferMemory.Mapped + bufferSize * i, outObject.IndirectCommands.data(), bufferSize);
+			}
+			outObject.VisibleCommandCount = static_cast<uint32_t>(outObject.IndirectCommands.size());
+		}
 	};
 
 private:
@@ -5243,28 +8729,193 @@ private:
 		return buffer;
 	}
     
-	/** 从图片文件中读取贴像素信息*/
-	static void LoadTextureAsset(const std::string& filename, std::vector<uint8_t>& outPixels, int& outWidth, int& outHeight, int& outChannels, int& outMipLevels)
+	/** 从图片文件中解码RGBA8像素，返回 stb_image 分配的内存，使用后调用 stbi_image_free 释放*/
+	static stbi_uc* DecodeTextureFile(const std::string& filename, int& outWidth, int& outHeight, int& outChannels, int& outMipLevels)
 	{
-        stbi_hdr_to_ldr_scale(2.2f);
-        stbi_uc* pixels = stbi_load(filename.c_str(), &outWidth, &outHeight, &outChannels, STBI_rgb_alpha);
-        stbi_hdr_to_ldr_scale(1.0f);
-        outMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(outWidth, outHeight)))) + 1;
+        stbi_uc* pixels = nullptr;
+        if (stbi_is_hdr(filename.c_str())) {
+            // stb_image 的 HDR 转 LDR 参数是全局状态，多线程解码时需要加锁
+            static std::mutex hdrToLdrMutex;
+            std::lock_guard<std::mutex> lock(hdrToLdrMutex);
+            stbi_hdr_to_ldr_scale(2.2f);
+            pixels = stbi_load(filename.c_str(), &outWidth, &outHeight, &outChannels, STBI_rgb_alpha);
+            stbi_hdr_to_ldr_scale(1.0f);
+        }
+        else {
+            pixels = stbi_load(filename.c_str(), &outWidth, &outHeight, &outChannels, STBI_rgb_alpha);
+        }
         if (!pixels) {
             throw std::runtime_error("failed to load texture image!");
             assert(true);
         }
-        outPixels.resize(outWidth * outHeight * 4);
-        std::memcpy(outPixels.data(), pixels, static_cast<size_t>(outWidth * outHeight * 4));
-        // clear pixels data.
-        stbi_image_free(pixels);
+        outMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(outWidth, outHeight)))) + 1;
+        return pixels;
     }
 
-	/** 从模型文件中读取贴顶点信息*/
-	static void LoadModelAsset(const std::string& filename, std::vector<FVertex>& Vertices, std::vector<uint32_t>& Indices)
+	/** 从图片文件中读取贴像素信息，解码结果直接拷贝进环形StagingBuffer（stagingRing为空或者放不下时拷贝进堆内存）*/
+	static void LoadSourceTextureAsset(const std::string& filename, FTextureAsset& outTexture, FStagingRing* stagingRing)
+	{
+		stbi_uc* pixels = DecodeTextureFile(filename, outTexture.Width, outTexture.Height, outTexture.Channels, outTexture.MipLevels);
+		size_t pixelSize = static_cast<size_t>(outTexture.Width) * outTexture.Height * 4;
+		std::memcpy(outTexture.AllocatePixels(pixelSize, stagingRing), pixels, pixelSize);
+		// clear pixels data.
+		stbi_image_free(pixels);
+	}
+
+	/** 读取贴图，优先使用烘焙工具生成的 .tex 文件（带有完整的Mip链），不存在或者过期时读取源文件
+	 * 传入stagingRing时像素直接写入环形StagingBuffer，上传时作为拷贝源，不需要再拷贝一次*/
+	static void LoadTextureAsset(const std::string& filename, FTextureAsset& outTexture, uint32_t supportedFormats, FStagingRing* stagingRing = nullptr)
+	{
+		outTexture.Mips.clear();
+		outTexture.Format = ECookedTextureFormat::RGBA8;
+		if (LoadCookedTextureAsset(filename, outTexture, supportedFormats, stagingRing)) {
+			return;
+		}
+		std::array<std::string, ORM_CHANNEL_COUNT> channelFiles;
+		if (GetPackedTextureSources(filename, channelFiles)) {
+			LoadPackedTextureAsset(channelFiles, outTexture, stagingRing);
+		}
+		else {
+			LoadSourceTextureAsset(filename, outTexture, stagingRing);
+		}
+	}
+
+	/** 没有源 PNG 的 *_orm 贴图由各个通道的源贴图打包而成，和烘焙工具的规则一致：<name>_orm.png -> <name>_ao.png, <name>_r.png ...
+	 * 不存在的通道文件名为空，使用默认值*/
+	static bool GetPackedTextureSources(const std::string& filename, std::array<std::string, ORM_CHANNEL_COUNT>& outChannelFiles)
+	{
+		std::filesystem::path path(filename);
+		std::string name = path.stem().string();
+		std::string suffix = ORM_TEXTURE_SUFFIX;
+		if (std::filesystem::exists(path) || name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+			return false;
+		}
+		std::string materialName = name.substr(0, name.size() - suffix.size());
+		for (uint32_t c = 0; c < ORM_CHANNEL_COUNT; c++)
+		{
+			std::filesystem::path channelPath = path.parent_path() / (materialName + ORM_TEXTURE_CHANNELS[c].Suffix + path.extension().string());
+			outChannelFiles[c] = std::filesystem::exists(channelPath) ? channelPath.string() : std::string();
+		}
+		return true;
+	}
+
+	/** 把各个通道源贴图的 R 通道打包成一张 RGBA8 贴图，Mip 在运行时生成*/
+	static void LoadPackedTextureAsset(const std::array<std::string, ORM_CHANNEL_COUNT>& channelFiles, FTextureAsset& outTexture, FStagingRing* stagingRing)
+	{
+		outTexture.ReleasePixels();
+		for (uint32_t c = 0; c < ORM_CHANNEL_COUNT; c++)
+		{
+			if (channelFiles[c].empty()) {
+				continue;
+			}
+			int width, height, channels, mipLevels;
+			stbi_uc* pixels = DecodeTextureFile(channelFiles[c], width, height, channels, mipLevels);
+			size_t pixelSize = static_cast<size_t>(width) * height * 4;
+			if (outTexture.Pixels == nullptr) {
+				outTexture.Width = width;
+				outTexture.Height = height;
+				outTexture.Channels = 4;
+				outTexture.MipLevels = mipLevels;
+				// 打包结果直接写入StagingBuffer
+				uint8_t* packed = outTexture.AllocatePixels(pixelSize, stagingRing);
+				for (size_t p = 0; p < pixelSize; p += 4) {
+					for (uint32_t i = 0; i < ORM_CHANNEL_COUNT; i++) {
+						packed[p + i] = ORM_TEXTURE_CHANNELS[i].DefaultValue;
+					}
+				}
+			}
+			else if (width != outTexture.Width || height != outTexture.Height) {
+				stbi_image_free(pixels);
+				throw std::runtime_error("failed to pack texture channels of different sizes!");
+			}
+			for (size_t p = 0; p < pixelSize; p += 4) {
+				outTexture.Pixels[p + c] = pixels[p];
+			}
+			stbi_image_free(pixels);
+		}
+		if (outTexture.Pixels == nullptr) {
+			throw std::runtime_error("failed to load texture image!");
+		}
+	}
+
+	/** 贴图源文件的内容哈希，打包贴图合并所有通道源文件的哈希*/
+	static uint64_t HashTextureContent(const std::string& filename)
+	{
+		std::array<std::string, ORM_CHANNEL_COUNT> channelFiles;
+		if (!GetPackedTextureSources(filename, channelFiles)) {
+			return HashFileContent(filename);
+		}
+		uint64_t hash = 14695981039346656037ull;
+		for (const std::string& channelFile : channelFiles) {
+			hash = (hash ^ (channelFile.empty() ? 0 : HashFileContent(channelFile))) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	/** 读取烘焙贴图，所有Mip级别连续存放在Pixels中，设备不支持贴图的压缩格式时返回false
+	 * 源文件（打包贴图的所有通道源文件）和烘焙时不一致时返回false，规则和烘焙工具相同，见 CheckCookedTextureSources*/
+	static bool LoadCookedTextureAsset(const std::string& filename, FTextureAsset& outTexture, uint32_t supportedFormats, FStagingRing* stagingRing)
+	{
+		std::string cookedfile = std::filesystem::path(filename).replace_extension(".tex").string();
+		FMappedFile cookedFile;
+		if (!cookedFile.Open(cookedfile) || cookedFile.Size < sizeof(FCookedTextureHeader)) {
+			return false;
+		}
+		const FCookedTextureHeader* header = reinterpret_cast<const FCookedTextureHeader*>(cookedFile.Data);
+		if (header->Magic != FCookedTextureHeader::MAGIC || header->Version != FCookedTextureHeader::VERSION ||
+			header->Format >= static_cast<uint32_t>(ECookedTextureFormat::Count) || !(supportedFormats & (1u << header->Format)) || header->MipCount == 0 ||
+			sizeof(FCookedTextureHeader) + sizeof(FCookedTextureMip) * header->MipCount > cookedFile.Size) {
+			return false;
+		}
+
+		std::array<std::string, ORM_CHANNEL_COUNT> channelFiles;
+		std::vector<std::filesystem::path> sourceFiles = { filename };
+		if (GetPackedTextureSources(filename, channelFiles)) {
+			sourceFiles.assign(channelFiles.begin(), channelFiles.end());
+		}
+		FCookedTextureSourceStamp sourceStamp;
+		ECookedTextureSourceStatus sourceStatus = CheckCookedTextureSources(*header, sourceFiles, sourceStamp);
+		if (sourceStatus == ECookedTextureSourceStatus::Stale) {
+			return false;
+		}
+		if (sourceStatus == ECookedTextureSourceStatus::NeedRestamp)
+		{
+			// 映射是只读的，先关闭再写文件头
+			cookedFile.Close();
+			if (!RestampCookedTexture(cookedfile, sourceStamp.Stamp)) {
+				std::cout << "[LOG]: Failed to restamp cooked texture " << cookedfile << std::endl;
+			}
+			if (!cookedFile.Open(cookedfile) || cookedFile.Size < sizeof(FCookedTextureHeader)) {
+				return false;
+			}
+			header = reinterpret_cast<const FCookedTextureHeader*>(cookedFile.Data);
+		}
+
+		const FCookedTextureMip* mips = reinterpret_cast<const FCookedTextureMip*>(cookedFile.Data + sizeof(FCookedTextureHeader));
+		const FCookedTextureMip& lastMip = mips[header->MipCount - 1];
+		if (lastMip.Offset + lastMip.Size > cookedFile.Size) {
+			return false;
+		}
+
+		// Mip数据在文件中是连续的，从映射的文件整体拷贝进StagingBuffer，Offset改为相对于Pixels
+		uint64_t dataOffset = mips[0].Offset;
+		size_t dataSize = static_cast<size_t>(lastMip.Offset + lastMip.Size - dataOffset);
+		std::memcpy(outTexture.AllocatePixels(dataSize, stagingRing), cookedFile.Data + dataOffset, dataSize);
+		outTexture.Mips.assign(mips, mips + header->MipCount);
+		for (FCookedTextureMip& mip : outTexture.Mips) {
+			mip.Offset -= dataOffset;
+		}
+		outTexture.Width = static_cast<int>(header->Width);
+		outTexture.Height = static_cast<int>(header->Height);
+		outTexture.Channels = 4;
+		outTexture.MipLevels = static_cast<int>(header->MipCount);
+		outTexture.Format = static_cast<ECookedTextureFormat>(header->Format);
+		return true;
+	}
+
+	/** 读取并解析OBJ文件*/
+	static void ParseObjFile(const std::string& filename, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes)
 	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
 		std::string warn, err;
 
@@ -5272,31 +8923,74 @@ private:
 			throw std::runtime_error(warn + err);
 			assert(true);
 		}
+	}
 
-		std::unordered_map<FVertex, uint32_t> uniqueVertices{};
+	/** 根据OBJ的索引三元组生成顶点，缺少法线或者UV时使用0*/
+	static FVertex MakeObjVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
+	{
+		FVertex vertex{};
+
+		vertex.Position = {
+			attrib.vertices[3 * index.vertex_index + 0],
+			attrib.vertices[3 * index.vertex_index + 1],
+			attrib.vertices[3 * index.vertex_index + 2]
+		};
+
+		if (index.normal_index >= 0) {
+			vertex.Normal = {
+				attrib.normals[3 * index.normal_index + 0],
+				attrib.normals[3 * index.normal_index + 1],
+				attrib.normals[3 * index.normal_index + 2]
+			};
+		}
+
+		vertex.Color = { 1.0f, 1.0f, 1.0f };
+
+		if (index.texcoord_index >= 0) {
+			vertex.TexCoord = {
+				attrib.texcoords[2 * index.texcoord_index + 0],
+				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+			};
+		}
+
+		return vertex;
+	}
 
+	/** 统计OBJ所有形状的索引总数，用于预留容量*/
+	static size_t GetObjIndexCount(const std::vector<tinyobj::shape_t>& shapes)
+	{
+		size_t indexCount = 0;
 		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				FVertex vertex{};
+			indexCount += shape.mesh.indices.size();
+		}
+		return indexCount;
+	}
 
-				vertex.Position = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
+	/** 按索引三元组去重，生成顶点和点序*/
+	static void BuildUniqueVertices(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, std::vector<FVertex>& Vertices, std::vector<uint32_t>& Indices)
+	{
+		size_t indexCount = GetObjIndexCount(shapes);
+		Vertices.reserve(attrib.vertices.size() / 3);
+		Indices.reserve(indexCount);
+
+		FObjVertexIndexMap uniqueVertices;
+		uniqueVertices.Reserve(indexCount);
 
-				vertex.Normal = {
-					attrib.normals[3 * index.vertex_index + 0],
-					attrib.normals[3 * index.vertex_index + 1],
-					attrib.normals[3 * index.vertex_index + 2]
-				};
+		for (const auto& shape : shapes) {
+			uniqueVertices.AppendUnique(shape.mesh.indices, Vertices, Indices, [&attrib](const tinyobj::index_t& index) {
+				return MakeObjVertex(attrib, index);
+			});
+		}
+	}
 
-				vertex.Color = { 1.0f, 1.0f, 1.0f };
+	/** 按顶点数据去重，是原来的实现，只用来和 BuildUniqueVertices 对比性能*/
+	static void BuildUniqueVerticesByValue(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, std::vector<FVertex>& Vertices, std::vector<uint32_t>& Indices)
+	{
+		std::unordered_map<FVertex, uint32_t> uniqueVertices{};
 
-				vertex.TexCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
+		for (const auto& shape : shapes) {
+			for (const auto& index : shape.mesh.indices) {
+				FVertex vertex = MakeObjVertex(attrib, index);
 
 				if (uniqueVertices.count(vertex) == 0) {
 					uniqueVertices[vertex] = static_cast<uint32_t>(Vertices.size());
@@ -5308,6 +9002,295 @@ private:
 		}
 	}
 
+	/** 从模型文件中读取贴顶点信息*/
+	static void LoadModelAsset(const std::string& filename, std::vector<FVertex>& Vertices, std::vector<uint32_t>& Indices)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		ParseObjFile(filename, attrib, shapes);
+		BuildUniqueVertices(attrib, shapes, Vertices, Indices);
+		FTangentGenerator::Generate(Vertices, Indices);
+	}
+
+	/** 对比两种顶点去重的耗时，OBJ只解析一次，每种方法重复执行取平均*/
+	static void BenchmarkModelImport(const std::string& filename, uint32_t iterations = 5)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		auto parseStartTime = std::chrono::high_resolution_clock::now();
+		ParseObjFile(filename, attrib, shapes);
+		auto parseEndTime = std::chrono::high_resolution_clock::now();
+		float parseTime = std::chrono::duration<float, std::chrono::milliseconds::period>(parseEndTime - parseStartTime).count();
+
+		auto measure = [&](auto buildFunc, size_t& outVertexCount) {
+			float totalTime = 0.0f;
+			for (uint32_t i = 0; i < iterations; i++) {
+				std::vector<FVertex> vertices;
+				std::vector<uint32_t> indices;
+				auto startTime = std::chrono::high_resolution_clock::now();
+				buildFunc(attrib, shapes, vertices, indices);
+				auto endTime = std::chrono::high_resolution_clock::now();
+				totalTime += std::chrono::duration<float, std::chrono::milliseconds::period>(endTime - startTime).count();
+				outVertexCount = vertices.size();
+			}
+			return totalTime / iterations;
+		};
+
+		size_t byValueVertexCount = 0;
+		size_t byIndexVertexCount = 0;
+		float byValueTime = measure(BuildUniqueVerticesByValue, byValueVertexCount);
+		float byIndexTime = measure(BuildUniqueVertices, byIndexVertexCount);
+		std::cout << "[LOG]: Import " << filename << ": parse " << parseTime << " ms, "
+			<< GetObjIndexCount(shapes) << " indices, "
+			<< "dedup by value " << byValueTime << " ms (" << byValueVertexCount << " vertices), "
+			<< "dedup by index " << byIndexTime << " ms (" << byIndexVertexCount << " vertices), "
+			<< (byIndexTime > 0.0f ? byValueTime / byIndexTime : 0.0f) << "x faster" << std::endl;
+	}
+
+	/** 烘焙模型的路径，和源OBJ文件放在一起，后缀为 .mesh*/
+	static std::string GetCookedModelPath(const std::string& filename)
+	{
+		return std::filesystem::path(filename).replace_extension(".mesh").string();
+	}
+
+	/** 读取源文件的大小和修改时间，用来快速判断烘焙模型是否过期*/
+	static bool GetSourceFileStamp(const std::string& filename, uint64_t& outSize, int64_t& outTime)
+	{
+		std::error_code ec;
+		outSize = static_cast<uint64_t>(std::filesystem::file_size(filename, ec));
+		if (ec) {
+			return false;
+		}
+		outTime = static_cast<int64_t>(std::filesystem::last_write_time(filename, ec).time_since_epoch().count());
+		return !ec;
+	}
+
+	/** 计算文件内容的FNV-1a哈希*/
+	static uint64_t HashFileContent(const std::string& filename)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		FMappedFile file;
+		if (file.Open(filename)) {
+			for (size_t i = 0; i < file.Size; i++) {
+				hash = (hash ^ file.Data[i]) * 1099511628211ull;
+			}
+		}
+		return hash;
+	}
+
+	/** 检查烘焙模型的格式是否合法，并且和源OBJ文件一致
+	 * 先比较文件大小和修改时间，时间不一致时（比如重新checkout）再比较内容哈希
+	 * 哈希一致但时间不一致时 bOutNeedRestamp 为 true，调用者需要更新文件头里的时间，避免每次启动都计算哈希*/
+	static bool IsCookedModelValid(const FMappedFile& cookedFile, const std::string& filename, bool bHasSource, uint64_t sourceSize, int64_t sourceTime, bool& bOutNeedRestamp)
+	{
+		bOutNeedRestamp = false;
+		if (cookedFile.Size < sizeof(FCookedMeshHeader)) {
+			return false;
+		}
+		const FCookedMeshHeader* header = reinterpret_cast<const FCookedMeshHeader*>(cookedFile.Data);
+		if (header->Magic != FCookedMeshHeader::MAGIC || header->Version != FCookedMeshHeader::VERSION || header->VertexStride != sizeof(FVertex) ||
+			(header->IndexStride != sizeof(uint16_t) && header->IndexStride != sizeof(uint32_t))) {
+			return false;
+		}
+		if (header->VertexOffset + uint64_t(header->VertexCount) * sizeof(FVertex) > cookedFile.Size ||
+			header->IndexOffset + uint64_t(header->IndexCount) * header->IndexStride > cookedFile.Size) {
+			return false;
+		}
+		if (header->LodCount == 0 || header->LodCount > MAX_MESH_LODS) {
+			return false;
+		}
+		for (uint32_t i = 0; i < header->LodCount; i++) {
+			if (uint64_t(header->Lods[i].FirstIndex) + header->Lods[i].IndexCount > header->IndexCount) {
+				return false;
+			}
+		}
+		if (header->ClusterOffset % alignof(FCluster) != 0 || header->ClusterOffset + uint64_t(header->ClusterCount) * sizeof(FCluster) > cookedFile.Size) {
+			return false;
+		}
+		// 只发布了烘焙模型，没有源文件
+		if (!bHasSource) {
+			return true;
+		}
+		if (header->SourceSize != sourceSize) {
+			return false;
+		}
+		if (header->SourceTime == sourceTime) {
+			return true;
+		}
+		if (header->SourceHash != HashFileContent(filename)) {
+			return false;
+		}
+		bOutNeedRestamp = true;
+		return true;
+	}
+
+	/** 源文件内容没有变化，只更新烘焙模型文件头里记录的修改时间*/
+	static bool RestampCookedModel(const std::string& cookedfile, int64_t sourceTime)
+	{
+		std::fstream file(cookedfile, std::ios::in | std::ios::out | std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		file.seekp(offsetof(FCookedMeshHeader, SourceTime));
+		file.write(reinterpret_cast<const char*>(&sourceTime), sizeof(sourceTime));
+		return file.good();
+	}
+
+	/** 生成 LOD1 以后的LOD，点序追加到 indices 后面
+	 * 误差超过包围球半径的 MAX_LOD_RELATIVE_ERROR 倍，或者三角形减少不到10%时停止*/
+	static void BuildMeshLods(const std::vector<FVertex>& vertices, std::vector<uint32_t>& indices, std::vector<FMeshLod>& lods)
+	{
+		const float MAX_LOD_RELATIVE_ERROR = 0.05f;
+		if (vertices.empty()) {
+			return;
+		}
+		glm::vec3 boundsMin = vertices[0].Position;
+		glm::vec3 boundsMax = boundsMin;
+		for (const FVertex& vertex : vertices) {
+			boundsMin = glm::min(boundsMin, vertex.Position);
+			boundsMax = glm::max(boundsMax, vertex.Position);
+		}
+		float maxError = glm::length(boundsMax - boundsMin) * 0.5f * MAX_LOD_RELATIVE_ERROR;
+
+		const std::vector<uint32_t> sourceIndices(indices.begin(), indices.begin() + lods[0].IndexCount);
+		std::vector<uint32_t> lodClusterStarts;				// LOD不做按簇排序，只需要顶点缓存优化
+		while (lods.size() < MAX_MESH_LODS) {
+			size_t targetIndexCount = (sourceIndices.size() >> lods.size()) / 3 * 3;
+			float error = 0.0f;
+			std::vector<uint32_t> lodIndices = FMeshSimplifier::Simplify(vertices, sourceIndices, targetIndexCount, maxError, error);
+			if (lodIndices.empty() || lodIndices.size() > lods.back().IndexCount * 9 / 10) {
+				break;
+			}
+			FMeshOptimizer::OptimizeVertexCache(lodIndices, vertices.size(), lodClusterStarts);
+			lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), error });
+			indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+		}
+	}
+
+	/** 解析OBJ文件，并写入烘焙模型文件*/
+	static void CookModelAsset(const std::string& filename, const std::string& cookedfile, uint64_t sourceSize, int64_t sourceTime)
+	{
+		std::vector<FVertex> vertices;
+		std::vector<uint32_t> indices;
+		LoadModelAsset(filename, vertices, indices);
+
+		// 烘焙时优化点序和顶点顺序，运行时直接使用
+		FVertexCacheStats sourceStats = FMeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+		FMeshOptimizer::Optimize(vertices, indices);
+
+		// LOD0 划分为簇，簇内保持顶点缓存优化后的顺序，重排点序后重新优化顶点读取顺序
+		std::vector<FCluster> clusters;
+		FMeshClusterizer::Build(vertices, indices, clusters);
+		FMeshOptimizer::OptimizeVertexFetch(vertices, indices);
+		FVertexCacheStats optimizedStats = FMeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+
+		// 从原始模型简化出其余的LOD，每级三角形减半，点序追加在 LOD0 之后
+		std::vector<FMeshLod> lods;
+		lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+		BuildMeshLods(vertices, indices, lods);
+		std::cout << "[LOG]: Cooked " << filename << ", ACMR " << sourceStats.ACMR << " -> " << optimizedStats.ACMR
+			<< ", ATVR " << sourceStats.ATVR << " -> " << optimizedStats.ATVR
+			<< ", " << (vertices.size() <= 65536 ? 16 : 32) << "-bit indices, LOD triangles";
+		for (const FMeshLod& lod : lods) {
+			std::cout << " " << lod.IndexCount / 3;
+		}
+		std::cout << ", " << clusters.size() << " clusters" << std::endl;
+
+		// 顶点不超过65536个时点序用16位保存，点序内存和读取带宽减半
+		bool bShortIndices = vertices.size() <= 65536;
+		std::vector<uint16_t> shortIndices;
+		if (bShortIndices) {
+			shortIndices.assign(indices.begin(), indices.end());
+		}
+
+		FCookedMeshHeader header{};
+		header.Magic = FCookedMeshHeader::MAGIC;
+		header.Version = FCookedMeshHeader::VERSION;
+		header.VertexStride = sizeof(FVertex);
+		header.VertexCount = static_cast<uint32_t>(vertices.size());
+		header.IndexCount = static_cast<uint32_t>(indices.size());
+		header.IndexStride = bShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+		header.VertexOffset = sizeof(FCookedMeshHeader);
+		header.IndexOffset = header.VertexOffset + vertices.size() * sizeof(FVertex);
+		header.SourceSize = sourceSize;
+		header.SourceTime = sourceTime;
+		header.SourceHash = HashFileContent(filename);
+		header.BoundsMin = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position;
+		header.BoundsMax = header.BoundsMin;
+		for (const FVertex& vertex : vertices) {
+			header.BoundsMin = glm::min(header.BoundsMin, vertex.Position);
+			header.BoundsMax = glm::max(header.BoundsMax, vertex.Position);
+		}
+		header.ACMR = optimizedStats.ACMR;
+		header.ATVR = optimizedStats.ATVR;
+		header.LodCount = static_cast<uint32_t>(lods.size());
+		std::copy(lods.begin(), lods.end(), header.Lods);
+		// 16位点序的总字节数可能不是4的倍数，簇数据对齐后才能直接映射读取
+		uint64_t indexEnd = header.IndexOffset + uint64_t(header.IndexCount) * header.IndexStride;
+		header.ClusterCount = static_cast<uint32_t>(clusters.size());
+		header.ClusterOffset = (indexEnd + alignof(FCluster) - 1) / alignof(FCluster) * alignof(FCluster);
+
+		// 先写入临时文件再重命名，避免中断时留下不完整的烘焙文件，文件名带上线程ID，避免多个加载线程同时烘焙时互相覆盖
+		std::string tempfile = cookedfile + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+		{
+			std::ofstream file(tempfile, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to write cooked mesh file!");
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(FVertex));
+			if (bShortIndices) {
+				file.write(reinterpret_cast<const char*>(shortIndices.data()), shortIndices.size() * sizeof(uint16_t));
+			}
+			else {
+				file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+			}
+			const char padding[alignof(FCluster)] = {};
+			file.write(padding, header.ClusterOffset - indexEnd);
+			file.write(reinterpret_cast<const char*>(clusters.data()), clusters.size() * sizeof(FCluster));
+			if (!file.good()) {
+				throw std::runtime_error("failed to write cooked mesh file!");
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempfile, cookedfile, ec);
+		if (ec) {
+			std::filesystem::remove(cookedfile, ec);
+			std::filesystem::rename(tempfile, cookedfile);
+		}
+	}
+
+	/** 映射烘焙模型文件，不存在或者过期时，重新烘焙*/
+	static const FCookedMeshHeader* LoadCookedModelAsset(const std::string& filename, FMappedFile& outCookedFile)
+	{
+		std::string cookedfile = GetCookedModelPath(filename);
+		uint64_t sourceSize = 0;
+		int64_t sourceTime = 0;
+		bool bHasSource = GetSourceFileStamp(filename, sourceSize, sourceTime);
+
+		bool bNeedRestamp = false;
+		if (!outCookedFile.Open(cookedfile) || !IsCookedModelValid(outCookedFile, filename, bHasSource, sourceSize, sourceTime, bNeedRestamp))
+		{
+			outCookedFile.Close();
+			CookModelAsset(filename, cookedfile, sourceSize, sourceTime);
+			if (!outCookedFile.Open(cookedfile) || !IsCookedModelValid(outCookedFile, filename, bHasSource, sourceSize, sourceTime, bNeedRestamp)) {
+				throw std::runtime_error("failed to load cooked mesh file!");
+			}
+		}
+		else if (bNeedRestamp)
+		{
+			// 映射是只读的，先关闭再写文件头，写失败时下次启动仍然会走哈希比较
+			outCookedFile.Close();
+			if (!RestampCookedModel(cookedfile, sourceTime)) {
+				std::cout << "[LOG]: Failed to restamp cooked mesh " << cookedfile << std::endl;
+			}
+			if (!outCookedFile.Open(cookedfile)) {
+				throw std::runtime_error("failed to load cooked mesh file!");
+			}
+		}
+		return reinterpret_cast<const FCookedMeshHeader*>(outCookedFile.Data);
+	}
+
 	/* 随机数引擎*/
 	int RandRange(int min, int max)
 	{
@@ -5356,6 +9339,25 @@ private:
 		return true;
 	}
 
+	/** 验证层是否提供 VK_EXT_validation_features，用来开启同步验证*/
+	bool CheckValidationFeaturesSupport()
+	{
+		uint32_t extensionCount = 0;
+		vkEnumerateInstanceExtensionProperties(ValidationLayers[0], &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateInstanceExtensionProperties(ValidationLayers[0], &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+		{
+			if (strcmp(extension.extensionName, VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
 	/** 打印调试信息时的回调函数，可以用来处理调试信息*/
 	static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
 	{
@@ -0,0 +1,913 @@
+// Copyright LearnVulkan-09: Draw with Deferred, @xukai. All Rights Reserved.
+// 导入和烘焙模型时的网格处理，不依赖 Vulkan，单元测试直接测试这里的逻辑
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+
+/** OBJ顶点去重表：以 tinyobj 的（位置，法线，UV）索引三元组为键的开放寻址哈希表
+ * 相同三元组一定生成相同的顶点，所以不需要哈希浮点数，容量在构建时一次分配，线性探测不会再扩容*/
+class FObjVertexIndexMap
+{
+public:
+	/** 预留容量，inMaxCount 是最多可能插入的键的数量（即OBJ的索引数），负载因子不超过 2/3*/
+	void Reserve(size_t inMaxCount)
+	{
+		size_t capacity = 16;
+		while (capacity < inMaxCount + inMaxCount / 2) {
+			capacity <<= 1;
+		}
+		Slots.assign(capacity, FSlot{});
+		Mask = capacity - 1;
+	}
+
+	/** 查找三元组对应的顶点序号，不存在时插入 inNewValue，通过 bOutInserted 返回是否为新顶点
+	 * FIndex 是 tinyobj::index_t，或者有相同成员的结构*/
+	template<typename FIndex>
+	uint32_t FindOrAdd(const FIndex& index, uint32_t inNewValue, bool& bOutInserted)
+	{
+		size_t slot = Hash(index) & Mask;
+		while (true) {
+			FSlot& entry = Slots[slot];
+			if (entry.Value == EMPTY) {
+				entry.Position = index.vertex_index;
+				entry.Normal = index.normal_index;
+				entry.TexCoord = index.texcoord_index;
+				entry.Value = inNewValue;
+				bOutInserted = true;
+				return inNewValue;
+			}
+			if (entry.Position == index.vertex_index && entry.Normal == index.normal_index && entry.TexCoord == index.texcoord_index) {
+				bOutInserted = false;
+				return entry.Value;
+			}
+			slot = (slot + 1) & Mask;
+		}
+	}
+
+	/** 把一组索引三元组去重后追加到 vertices 和 indices，新的三元组调用 makeVertex(index) 生成顶点*/
+	template<typename FIndex, typename FVertexType, typename FMakeVertex>
+	void AppendUnique(const std::vector<FIndex>& objIndices, std::vector<FVertexType>& vertices, std::vector<uint32_t>& indices, FMakeVertex&& makeVertex)
+	{
+		for (const FIndex& index : objIndices) {
+			bool bInserted;
+			uint32_t vertexIndex = FindOrAdd(index, static_cast<uint32_t>(vertices.size()), bInserted);
+			if (bInserted) {
+				vertices.push_back(makeVertex(index));
+			}
+			indices.push_back(vertexIndex);
+		}
+	}
+
+private:
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+
+	struct FSlot {
+		int32_t Position = -1;
+		int32_t Normal = -1;
+		int32_t TexCoord = -1;
+		uint32_t Value = EMPTY;
+	};
+
+	/** 三个索引打包后用 splitmix64 的混合函数打散，低位也能均匀分布*/
+	template<typename FIndex>
+	static size_t Hash(const FIndex& index)
+	{
+		uint64_t key = (uint64_t(uint32_t(index.vertex_index)) << 32) ^ (uint64_t(uint32_t(index.normal_index)) << 16) ^ uint64_t(uint32_t(index.texcoord_index));
+		key ^= key >> 30;
+		key *= 0xbf58476d1ce4e5b9ull;
+		key ^= key >> 27;
+		key *= 0x94d049bb133111ebull;
+		key ^= key >> 31;
+		return static_cast<size_t>(key);
+	}
+
+	std::vector<FSlot> Slots;
+	size_t Mask = 0;
+};
+
+
+/** 顶点缓存的统计，ACMR = 每个三角形平均变换的顶点数（0.5 ~ 3），ATVR = 每个顶点平均变换的次数（>= 1）*/
+struct FVertexCacheStats {
+	float ACMR = 0.0f;
+	float ATVR = 0.0f;
+};
+
+/** 模型导入时的优化：顶点缓存排序（Tipsify）、按簇排序减少Overdraw、按访问顺序重排顶点
+ * 参考 Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007*/
+class FMeshOptimizer
+{
+public:
+	static const uint32_t CACHE_SIZE = 16;					// 模拟的变换后顶点缓存（FIFO）大小
+	static constexpr float OVERDRAW_THRESHOLD = 1.05f;		// 簇排序后ACMR最多允许变差的比例
+
+	/** 模拟 FIFO 顶点缓存，计算 ACMR 和 ATVR*/
+	static FVertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE)
+	{
+		FVertexCacheStats stats;
+		if (indices.empty() || vertexCount == 0) {
+			return stats;
+		}
+
+		// 记录顶点进入缓存的时间，和当前时间相差不超过缓存大小时仍在缓存中
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		std::vector<bool> bReferenced(vertexCount, false);
+		uint32_t timestamp = cacheSize + 1;
+		size_t misses = 0;
+		size_t uniqueCount = 0;
+		for (uint32_t index : indices) {
+			if (timestamp - cacheTimestamps[index] > cacheSize) {
+				cacheTimestamps[index] = timestamp++;
+				misses++;
+			}
+			if (!bReferenced[index]) {
+				bReferenced[index] = true;
+				uniqueCount++;
+			}
+		}
+
+		stats.ACMR = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		stats.ATVR = static_cast<float>(misses) / static_cast<float>(uniqueCount);
+		return stats;
+	}
+
+	/** 依次执行三个优化，点序和顶点都会被改写，FVertexType 需要有 glm::vec3 Position*/
+	template<typename FVertexType>
+	static void Optimize(std::vector<FVertexType>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> clusterStarts;
+		OptimizeVertexCache(indices, vertices.size(), clusterStarts);
+		OptimizeOverdraw(indices, vertices, clusterStarts);
+		OptimizeVertexFetch(vertices, indices);
+	}
+
+	/** Tipsify：围绕一个顶点扇形输出它所有未输出的三角形，再从刚输出的顶点中选择下一个扇形中心
+	 * 找不到合适的顶点时（死胡同）跳到别处，同时在这里断开一个簇，输出每个簇的起始三角形*/
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& outClusterStarts, uint32_t cacheSize = CACHE_SIZE)
+	{
+		outClusterStarts.clear();
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+
+		// 顶点到三角形的邻接表，CSR格式
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (uint32_t index : indices) {
+			liveTriangles[index]++;
+		}
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) {
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		{
+			std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) {
+				adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		std::vector<bool> bEmitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+
+		uint32_t timestamp = cacheSize + 1;
+		size_t deadEndCursor = 0;
+		int64_t fanning = 0;
+		outClusterStarts.push_back(0);
+		while (fanning >= 0) {
+			candidates.clear();
+			uint32_t vertex = static_cast<uint32_t>(fanning);
+			for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+				uint32_t triangle = adjacency[a];
+				if (bEmitted[triangle]) {
+					continue;
+				}
+				for (uint32_t k = 0; k < 3; k++) {
+					uint32_t v = indices[triangle * 3 + k];
+					output.push_back(v);
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+					if (timestamp - cacheTimestamps[v] > cacheSize) {
+						cacheTimestamps[v] = timestamp++;
+					}
+				}
+				bEmitted[triangle] = true;
+			}
+
+			// 优先选择还在缓存中、并且剩余三角形能在它离开缓存前输出完的顶点
+			int64_t best = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t v : candidates) {
+				if (liveTriangles[v] == 0) {
+					continue;
+				}
+				int64_t priority = 0;
+				if (timestamp - cacheTimestamps[v] + 2 * liveTriangles[v] <= cacheSize) {
+					priority = timestamp - cacheTimestamps[v];
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					best = v;
+				}
+			}
+
+			if (best < 0) {
+				best = SkipDeadEnd(liveTriangles, deadEnds, deadEndCursor);
+				if (best >= 0 && output.size() / 3 != outClusterStarts.back()) {
+					outClusterStarts.push_back(static_cast<uint32_t>(output.size() / 3));
+				}
+			}
+			fanning = best;
+		}
+
+		indices.swap(output);
+	}
+
+	/** 按簇排序：朝外的簇先画，能遮挡更多后画的簇，和视角无关
+	 * 排序键为 dot(簇中心 - 模型中心, 簇法线)，簇边界会打断顶点缓存，ACMR变差太多时保持原顺序*/
+	template<typename FVertexType>
+	static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<FVertexType>& vertices, const std::vector<uint32_t>& clusterStarts, float threshold = OVERDRAW_THRESHOLD)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (clusterStarts.size() < 2) {
+			return;
+		}
+
+		// 按面积加权的模型中心
+		glm::dvec3 meshCenter(0.0);
+		double meshArea = 0.0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			glm::dvec3 p0 = vertices[indices[t * 3 + 0]].Position;
+			glm::dvec3 p1 = vertices[indices[t * 3 + 1]].Position;
+			glm::dvec3 p2 = vertices[indices[t * 3 + 2]].Position;
+			double area = glm::length(glm::cross(p1 - p0, p2 - p0));
+			meshCenter += (p0 + p1 + p2) * (area / 3.0);
+			meshArea += area;
+		}
+		meshCenter = meshArea > 0.0 ? meshCenter / meshArea : glm::dvec3(0.0);
+
+		struct FClusterSortKey {
+			uint32_t Cluster;
+			double Key;
+		};
+		std::vector<FClusterSortKey> sortKeys(clusterStarts.size());
+		for (size_t c = 0; c < clusterStarts.size(); c++) {
+			size_t begin = clusterStarts[c];
+			size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+			glm::dvec3 center(0.0);
+			glm::dvec3 normal(0.0);
+			double area = 0.0;
+			for (size_t t = begin; t < end; t++) {
+				glm::dvec3 p0 = vertices[indices[t * 3 + 0]].Position;
+				glm::dvec3 p1 = vertices[indices[t * 3 + 1]].Position;
+				glm::dvec3 p2 = vertices[indices[t * 3 + 2]].Position;
+				glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+				double triangleArea = glm::length(n);
+				center += (p0 + p1 + p2) * (triangleArea / 3.0);
+				normal += n;
+				area += triangleArea;
+			}
+			center = area > 0.0 ? center / area : center;
+			double normalLength = glm::length(normal);
+			normal = normalLength > 0.0 ? normal / normalLength : normal;
+			sortKeys[c] = { static_cast<uint32_t>(c), glm::dot(center - meshCenter, normal) };
+		}
+		std::stable_sort(sortKeys.begin(), sortKeys.end(), [](const FClusterSortKey& a, const FClusterSortKey& b) {
+			return a.Key > b.Key;
+		});
+
+		std::vector<uint32_t> sorted;
+		sorted.reserve(indices.size());
+		for (const FClusterSortKey& sortKey : sortKeys) {
+			size_t begin = clusterStarts[sortKey.Cluster];
+			size_t end = sortKey.Cluster + 1 < clusterStarts.size() ? clusterStarts[sortKey.Cluster + 1] : triangleCount;
+			sorted.insert(sorted.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+		}
+
+		float cacheACMR = AnalyzeVertexCache(indices, vertices.size()).ACMR;
+		float sortedACMR = AnalyzeVertexCache(sorted, vertices.size()).ACMR;
+		if (sortedACMR <= cacheACMR * threshold) {
+			indices.swap(sorted);
+		}
+	}
+
+	/** 按点序中第一次出现的顺序重排顶点，顶点读取尽量连续，未被引用的顶点被丢弃*/
+	template<typename FVertexType>
+	static void OptimizeVertexFetch(std::vector<FVertexType>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+		std::vector<FVertexType> reordered;
+		reordered.reserve(vertices.size());
+		for (uint32_t& index : indices) {
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = static_cast<uint32_t>(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(reordered);
+	}
+
+private:
+	/** 死胡同时先回溯最近输出的顶点，再按顺序扫描剩余的顶点，都没有时返回-1*/
+	static int64_t SkipDeadEnd(const std::vector<uint32_t>& liveTriangles, std::vector<uint32_t>& deadEnds, size_t& cursor)
+	{
+		while (!deadEnds.empty()) {
+			uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0) {
+				return v;
+			}
+		}
+		while (cursor < liveTriangles.size()) {
+			if (liveTriangles[cursor] > 0) {
+				return static_cast<int64_t>(cursor);
+			}
+			cursor++;
+		}
+		return -1;
+	}
+};
+
+
+/** 基于二次误差（QEM）的模型简化，用来离线生成LOD
+ * 边坍缩到已有的顶点上，只生成新的点序，所有LOD共用一份顶点缓存
+ * 开放边界上的顶点只能沿边界坍缩；位置相同但法线或者UV不同的顶点（接缝）只能沿接缝坍缩，
+ * 接缝两侧的顶点分别坍缩到目标位置同一侧的顶点上，接缝边加上约束平面避免接缝偏移
+ * 只处理一个位置上有两个顶点、接缝穿过的简单情况，接缝交汇处、接缝的端点、边界上的接缝和非流形顶点被锁定
+ * 参考 Garland, Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997*/
+class FMeshSimplifier
+{
+public:
+	static constexpr float BORDER_WEIGHT = 10.0f;		// 边界约束平面的权重，避免开放边界（比如草叶的轮廓）向内收缩
+	static constexpr float SEAM_WEIGHT = 1.0f;			// 接缝约束平面的权重，接缝两侧的三角形各加一次
+
+	/** 把点序简化到不超过 targetIndexCount 个，误差（模型空间的距离）超过 maxError 时提前停止
+	 * 返回简化后的点序，outError 为实际的最大误差，FVertexType 需要有 glm::vec3 Position*/
+	template<typename FVertexType>
+	static std::vector<uint32_t> Simplify(const std::vector<FVertexType>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, float& outError)
+	{
+		outError = 0.0f;
+		std::vector<uint32_t> result(indices);
+		if (indices.size() <= targetIndexCount || vertices.empty()) {
+			return result;
+		}
+
+		// 按位置焊接顶点，拓扑和误差都在位置上计算
+		std::vector<uint32_t> positionIds(vertices.size());
+		std::vector<uint32_t> wedgeCounts;
+		{
+			std::unordered_map<glm::vec3, uint32_t, FPositionHash> uniquePositions;
+			uniquePositions.reserve(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++) {
+				auto it = uniquePositions.emplace(vertices[i].Position, static_cast<uint32_t>(wedgeCounts.size())).first;
+				if (it->second == wedgeCounts.size()) {
+					wedgeCounts.push_back(0);
+				}
+				positionIds[i] = it->second;
+				wedgeCounts[it->second]++;
+			}
+		}
+		const size_t positionCount = wedgeCounts.size();
+		std::vector<glm::vec3> positions(positionCount);
+		for (size_t i = 0; i < vertices.size(); i++) {
+			positions[positionIds[i]] = vertices[i].Position;
+		}
+
+		std::unordered_map<uint64_t, uint32_t> edges;
+		CountDirectedEdges(result, positionIds, edges);
+
+		// 同一条位置边两侧的三角形使用不同的顶点时，这条边是接缝
+		std::unordered_set<uint64_t> vertexEdges;
+		vertexEdges.reserve(result.size());
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			for (uint32_t k = 0; k < 3; k++) {
+				vertexEdges.insert(MakeEdgeKey(result[i + k], result[i + (k + 1) % 3]));
+			}
+		}
+		std::vector<uint32_t> seamEdgeCounts(positionCount, 0);	// 经过这个位置的接缝半边数量，简单接缝穿过时为4
+
+		// 每个位置的误差二次型：相邻三角形平面按面积加权，开放边界和接缝额外加上垂直于三角形的约束平面
+		std::vector<FQuadric> quadrics(positionCount);
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			uint32_t p[3] = { positionIds[result[i + 0]], positionIds[result[i + 1]], positionIds[result[i + 2]] };
+			glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+			float area = glm::length(normal);
+			if (area <= 0.0f) {
+				continue;
+			}
+			normal /= area;
+			FQuadric face = FQuadric::FromPlane(normal, -glm::dot(normal, positions[p[0]]), area * 0.5f);
+			for (uint32_t k = 0; k < 3; k++) {
+				quadrics[p[k]].Add(face);
+				uint32_t a = p[k];
+				uint32_t b = p[(k + 1) % 3];
+				bool bBorder = edges.count(MakeEdgeKey(b, a)) == 0;
+				bool bSeam = !bBorder && vertexEdges.count(MakeEdgeKey(result[i + (k + 1) % 3], result[i + k])) == 0;
+				if (bSeam) {
+					seamEdgeCounts[a]++;
+					seamEdgeCounts[b]++;
+				}
+				glm::vec3 edge = positions[b] - positions[a];
+				float length = glm::length(edge);
+				if ((bBorder || bSeam) && length > 0.0f) {
+					glm::vec3 constraintNormal = glm::normalize(glm::cross(edge, normal));
+					FQuadric constraint = FQuadric::FromPlane(constraintNormal, -glm::dot(constraintNormal, positions[a]), length * length * (bBorder ? BORDER_WEIGHT : SEAM_WEIGHT));
+					constraint.Weight = 0.0;
+					quadrics[a].Add(constraint);
+					quadrics[b].Add(constraint);
+				}
+			}
+		}
+
+		std::vector<EVertexKind> kinds(positionCount, EVertexKind::Manifold);
+		for (size_t p = 0; p < positionCount; p++) {
+			if (wedgeCounts[p] == 2 && seamEdgeCounts[p] == 4) {
+				kinds[p] = EVertexKind::Seam;
+			}
+			else if (wedgeCounts[p] > 1) {
+				kinds[p] = EVertexKind::Locked;
+			}
+		}
+		for (const auto& edge : edges) {
+			uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+			uint32_t b = static_cast<uint32_t>(edge.first & 0xffffffffu);
+			if (edge.second > 1) {
+				kinds[a] = kinds[b] = EVertexKind::Locked;
+			}
+			else if (edges.count(MakeEdgeKey(b, a)) == 0) {
+				for (uint32_t p : { a, b }) {
+					kinds[p] = kinds[p] == EVertexKind::Manifold ? EVertexKind::Border : (kinds[p] == EVertexKind::Seam ? EVertexKind::Locked : kinds[p]);
+				}
+			}
+		}
+
+		const double maxErrorSquared = double(maxError) * double(maxError);
+		double resultError = 0.0;
+		std::vector<FCollapse> collapses;
+		std::vector<uint32_t> adjacencyOffsets;
+		std::vector<uint32_t> adjacency;
+		std::vector<uint32_t> vertexRemap(vertices.size());
+		std::vector<std::pair<uint32_t, uint32_t>> wedgeRemap;
+		std::vector<bool> bTouched(positionCount);
+		while (result.size() > targetIndexCount) {
+			CountDirectedEdges(result, positionIds, edges);
+
+			// 收集候选的边，按坍缩误差从小到大排序
+			collapses.clear();
+			for (size_t i = 0; i + 2 < result.size(); i += 3) {
+				for (uint32_t k = 0; k < 3; k++) {
+					for (uint32_t direction = 0; direction < 2; direction++) {
+						uint32_t from = result[i + (direction == 0 ? k : (k + 1) % 3)];
+						uint32_t to = result[i + (direction == 0 ? (k + 1) % 3 : k)];
+						uint32_t pf = positionIds[from];
+						uint32_t pt = positionIds[to];
+						if (kinds[pf] == EVertexKind::Locked) {
+							continue;
+						}
+						if (kinds[pf] == EVertexKind::Border && !IsBorderEdge(edges, pf, pt)) {
+							continue;
+						}
+						FQuadric quadric = quadrics[pf];
+						quadric.Add(quadrics[pt]);
+						collapses.push_back({ from, to, quadric.Evaluate(positions[pt]) });
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const FCollapse& a, const FCollapse& b) { return a.Error < b.Error; });
+
+			BuildAdjacency(result, positionIds, positionCount, adjacencyOffsets, adjacency);
+
+			// 每一轮中一个顶点的一环邻域只坍缩一次，剩余的留到下一轮
+			for (size_t i = 0; i < vertexRemap.size(); i++) {
+				vertexRemap[i] = static_cast<uint32_t>(i);
+			}
+			std::fill(bTouched.begin(), bTouched.end(), false);
+			size_t triangleCount = result.size() / 3;
+			size_t targetTriangleCount = targetIndexCount / 3;
+			size_t collapseCount = 0;
+			for (const FCollapse& collapse : collapses) {
+				if (collapse.Error > maxErrorSquared || triangleCount <= targetTriangleCount) {
+					break;
+				}
+				uint32_t pf = positionIds[collapse.From];
+				uint32_t pt = positionIds[collapse.To];
+				if (bTouched[pf] || bTouched[pt] || !GetWedgeRemap(result, positionIds, adjacencyOffsets, adjacency, pf, pt, wedgeRemap) ||
+					HasFlippedTriangle(result, positionIds, positions, adjacencyOffsets, adjacency, pf, pt)) {
+					continue;
+				}
+
+				for (const auto& wedge : wedgeRemap) {
+					vertexRemap[wedge.first] = wedge.second;
+				}
+				quadrics[pt].Add(quadrics[pf]);
+				for (uint32_t a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1]; a++) {
+					uint32_t triangle = adjacency[a];
+					for (uint32_t k = 0; k < 3; k++) {
+						bTouched[positionIds[result[triangle * 3 + k]]] = true;
+					}
+				}
+				triangleCount -= kinds[pf] == EVertexKind::Border ? 1 : 2;
+				resultError = std::max(resultError, collapse.Error);
+				collapseCount++;
+			}
+			if (collapseCount == 0) {
+				break;
+			}
+
+			// 重映射点序，去掉退化的三角形
+			size_t writeIndex = 0;
+			for (size_t i = 0; i + 2 < result.size(); i += 3) {
+				uint32_t i0 = vertexRemap[result[i + 0]];
+				uint32_t i1 = vertexRemap[result[i + 1]];
+				uint32_t i2 = vertexRemap[result[i + 2]];
+				if (positionIds[i0] == positionIds[i1] || positionIds[i1] == positionIds[i2] || positionIds[i0] == positionIds[i2]) {
+					continue;
+				}
+				result[writeIndex++] = i0;
+				result[writeIndex++] = i1;
+				result[writeIndex++] = i2;
+			}
+			result.resize(writeIndex);
+		}
+
+		outError = static_cast<float>(std::sqrt(resultError));
+		return result;
+	}
+
+private:
+	enum class EVertexKind : uint8_t
+	{
+		Manifold,	// 可以坍缩到任意相邻顶点
+		Border,		// 开放边界，只能沿边界坍缩
+		Seam,		// 简单接缝上的两个顶点，只能沿接缝坍缩
+		Locked,		// 接缝交汇处或者非流形，不能被坍缩
+	};
+
+	/** 和 glm 的 std::hash 特化一样按分量组合，-0.0 和 0.0 的哈希值相同*/
+	struct FPositionHash {
+		size_t operator()(const glm::vec3& p) const
+		{
+			std::hash<float> hasher;
+			size_t seed = 0;
+			for (float v : { p.x, p.y, p.z }) {
+				seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			}
+			return seed;
+		}
+	};
+
+	/** 对称4x4矩阵，Weight 为累加的面积，误差按面积归一化为平均的距离平方*/
+	struct FQuadric {
+		double A2 = 0, AB = 0, AC = 0, AD = 0, B2 = 0, BC = 0, BD = 0, C2 = 0, CD = 0, D2 = 0;
+		double Weight = 0;
+
+		static FQuadric FromPlane(const glm::vec3& n, float d, float weight)
+		{
+			FQuadric q;
+			q.A2 = weight * n.x * n.x; q.AB = weight * n.x * n.y; q.AC = weight * n.x * n.z; q.AD = weight * n.x * d;
+			q.B2 = weight * n.y * n.y; q.BC = weight * n.y * n.z; q.BD = weight * n.y * d;
+			q.C2 = weight * n.z * n.z; q.CD = weight * n.z * d;
+			q.D2 = weight * double(d) * d;
+			q.Weight = weight;
+			return q;
+		}
+
+		void Add(const FQuadric& q)
+		{
+			A2 += q.A2; AB += q.AB; AC += q.AC; AD += q.AD; B2 += q.B2; BC += q.BC; BD += q.BD; C2 += q.C2; CD += q.CD; D2 += q.D2;
+			Weight += q.Weight;
+		}
+
+		double Evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double error = A2 * x * x + B2 * y * y + C2 * z * z + D2
+				+ 2.0 * (AB * x * y + AC * x * z + BC * y * z + AD * x + BD * y + CD * z);
+			return Weight > 0.0 ? std::abs(error) / Weight : 0.0;
+		}
+	};
+
+	struct FCollapse {
+		uint32_t From;
+		uint32_t To;
+		double Error;
+	};
+
+	static uint64_t MakeEdgeKey(uint32_t a, uint32_t b)
+	{
+		return (uint64_t(a) << 32) | b;
+	}
+
+	/** 统计位置之间的有向边，只出现一个方向的边是开放边界，出现多次的是非流形边*/
+	static void CountDirectedEdges(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds, std::unordered_map<uint64_t, uint32_t>& outEdges)
+	{
+		outEdges.clear();
+		outEdges.reserve(indices.size());
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			for (uint32_t k = 0; k < 3; k++) {
+				outEdges[MakeEdgeKey(positionIds[indices[i + k]], positionIds[indices[i + (k + 1) % 3]])]++;
+			}
+		}
+	}
+
+	static bool IsBorderEdge(const std::unordered_map<uint64_t, uint32_t>& edges, uint32_t a, uint32_t b)
+	{
+		bool bForward = edges.count(MakeEdgeKey(a, b)) > 0;
+		bool bBackward = edges.count(MakeEdgeKey(b, a)) > 0;
+		return bForward != bBackward;
+	}
+
+	/** 位置到三角形的邻接表，CSR格式*/
+	static void BuildAdjacency(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds, size_t positionCount,
+		std::vector<uint32_t>& outOffsets, std::vector<uint32_t>& outAdjacency)
+	{
+		outOffsets.assign(positionCount + 1, 0);
+		for (uint32_t index : indices) {
+			outOffsets[positionIds[index] + 1]++;
+		}
+		for (size_t p = 0; p < positionCount; p++) {
+			outOffsets[p + 1] += outOffsets[p];
+		}
+		outAdjacency.resize(indices.size());
+		std::vector<uint32_t> cursor(outOffsets.begin(), outOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) {
+			outAdjacency[cursor[positionIds[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	/** from 位置上的每个顶点坍缩到 to 位置上和它共享三角形的顶点，返回 (from顶点, to顶点)
+	 * 同一个顶点对应 to 的多个顶点（边不是接缝，但是 from 这一侧跨过了接缝），或者有顶点不和 to 相邻（沿着接缝以外的边坍缩）时返回false*/
+	static bool GetWedgeRemap(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds,
+		const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency, uint32_t from, uint32_t to, std::vector<std::pair<uint32_t, uint32_t>>& outRemap)
+	{
+		outRemap.clear();
+		for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+			uint32_t triangle = adjacency[a];
+			uint32_t fromVertex = UINT32_MAX;
+			uint32_t toVertex = UINT32_MAX;
+			for (uint32_t k = 0; k < 3; k++) {
+				uint32_t v = indices[triangle * 3 + k];
+				fromVertex = positionIds[v] == from ? v : fromVertex;
+				toVertex = positionIds[v] == to ? v : toVertex;
+			}
+			auto it = std::find_if(outRemap.begin(), outRemap.end(), [fromVertex](const std::pair<uint32_t, uint32_t>& wedge) { return wedge.first == fromVertex; });
+			if (it == outRemap.end()) {
+				outRemap.push_back({ fromVertex, toVertex });
+			}
+			else if (it->second == UINT32_MAX) {
+				it->second = toVertex;
+			}
+			else if (toVertex != UINT32_MAX && toVertex != it->second) {
+				return false;
+			}
+		}
+		for (const auto& wedge : outRemap) {
+			if (wedge.second == UINT32_MAX) {
+				return false;
+			}
+		}
+		return !outRemap.empty();
+	}
+
+	/** 把 from 移到 to 的位置后，是否有剩下的三角形翻转或者退化*/
+	static bool HasFlippedTriangle(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds, const std::vector<glm::vec3>& positions,
+		const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency, uint32_t from, uint32_t to)
+	{
+		for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+			uint32_t triangle = adjacency[a];
+			uint32_t p[3] = { positionIds[indices[triangle * 3 + 0]], positionIds[indices[triangle * 3 + 1]], positionIds[indices[triangle * 3 + 2]] };
+			if (p[0] == to || p[1] == to || p[2] == to) {
+				continue;
+			}
+			glm::vec3 before = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+			for (uint32_t k = 0; k < 3; k++) {
+				if (p[k] == from) {
+					p[k] = to;
+				}
+			}
+			glm::vec3 after = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+			if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+
+/** 模型簇（Meshlet）：LOD0 点序中连续的一段三角形，可以用一条 VkDrawIndexedIndirectCommand 单独绘制
+ * 包围球用来做视锥剔除，法线锥用来剔除整簇背对相机的三角形*/
+struct FCluster {
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	uint32_t VertexCount;        // 簇引用的不同顶点数量
+	glm::vec3 BoundsCenter;      // 包围球，模型空间
+	float BoundsRadius;
+	glm::vec3 ConeAxis;          // 法线锥的轴，模型空间
+	float ConeCutoff;            // 法线锥张角的正弦，为1时法线锥无效，簇不会被背面剔除
+
+	static const uint32_t MAX_VERTICES = 64;
+	static const uint32_t MAX_TRIANGLES = 124;
+};
+
+
+/** 把模型的三角形划分为簇，重排点序使每个簇的三角形连续
+ * 从一个三角形开始贪心生长，优先选择新增顶点最少、离簇中心最近的相邻三角形，顶点数或者三角形数达到上限时开始新的簇
+ * FVertexType 需要有 glm::vec3 Position*/
+class FMeshClusterizer
+{
+public:
+	template<typename FVertexType>
+	static void Build(const std::vector<FVertexType>& vertices, std::vector<uint32_t>& indices, std::vector<FCluster>& outClusters)
+	{
+		outClusters.clear();
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+
+		// 顶点到三角形的邻接表，CSR格式
+		std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1, 0);
+		for (uint32_t index : indices) {
+			adjacencyOffsets[index + 1]++;
+		}
+		for (size_t v = 0; v < vertices.size(); v++) {
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		{
+			std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) {
+				adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<bool> bEmitted(triangleCount, false);
+		std::vector<uint32_t> vertexStamps(vertices.size(), UINT32_MAX);	// 顶点属于哪个簇
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> clusterTriangles;
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		size_t seedCursor = 0;
+
+		while (true) {
+			// 按原来的（顶点缓存优化后的）顺序选择种子三角形
+			while (seedCursor < triangleCount && bEmitted[seedCursor]) {
+				seedCursor++;
+			}
+			if (seedCursor == triangleCount) {
+				break;
+			}
+
+			uint32_t clusterId = static_cast<uint32_t>(outClusters.size());
+			uint32_t clusterVertexCount = 0;
+			glm::vec3 clusterCenter(0.0f);
+			clusterTriangles.clear();
+			candidates.clear();
+
+			uint32_t triangle = static_cast<uint32_t>(seedCursor);
+			while (true) {
+				// 加入三角形，新的相邻三角形成为候选
+				bEmitted[triangle] = true;
+				clusterTriangles.push_back(triangle);
+				for (uint32_t k = 0; k < 3; k++) {
+					uint32_t v = indices[triangle * 3 + k];
+					if (vertexStamps[v] != clusterId) {
+						vertexStamps[v] = clusterId;
+						clusterVertexCount++;
+					}
+					for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+						if (!bEmitted[adjacency[a]]) {
+							candidates.push_back(adjacency[a]);
+						}
+					}
+				}
+				clusterCenter += (GetTriangleCenter(vertices, indices, triangle) - clusterCenter) / static_cast<float>(clusterTriangles.size());
+				if (clusterTriangles.size() >= FCluster::MAX_TRIANGLES) {
+					break;
+				}
+
+				int64_t best = -1;
+				uint32_t bestNewVertices = UINT32_MAX;
+				float bestDistance = std::numeric_limits<float>::max();
+				size_t writeIndex = 0;
+				for (uint32_t candidate : candidates) {
+					if (bEmitted[candidate]) {
+						continue;
+					}
+					candidates[writeIndex++] = candidate;
+					uint32_t newVertices = 0;
+					for (uint32_t k = 0; k < 3; k++) {
+						newVertices += vertexStamps[indices[candidate * 3 + k]] != clusterId ? 1 : 0;
+					}
+					if (clusterVertexCount + newVertices > FCluster::MAX_VERTICES) {
+						continue;
+					}
+					float distance = glm::length(GetTriangleCenter(vertices, indices, candidate) - clusterCenter);
+					if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance)) {
+						best = candidate;
+						bestNewVertices = newVertices;
+						bestDistance = distance;
+					}
+				}
+				candidates.resize(writeIndex);
+
+				// 没有相邻的三角形时（比如草叶这样不连通的小块），按原来的顺序接着填充
+				if (best < 0) {
+					while (seedCursor < triangleCount && bEmitted[seedCursor]) {
+						seedCursor++;
+					}
+					if (seedCursor == triangleCount || !candidates.empty() || clusterVertexCount + 3 > FCluster::MAX_VERTICES) {
+						break;
+					}
+					best = static_cast<int64_t>(seedCursor);
+				}
+				triangle = static_cast<uint32_t>(best);
+			}
+
+			FCluster cluster{};
+			cluster.FirstIndex = static_cast<uint32_t>(output.size());
+			cluster.IndexCount = static_cast<uint32_t>(clusterTriangles.size() * 3);
+			cluster.VertexCount = clusterVertexCount;
+			for (uint32_t t : clusterTriangles) {
+				output.insert(output.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+			}
+			ComputeClusterBounds(vertices, output, cluster);
+			outClusters.push_back(cluster);
+		}
+
+		indices.swap(output);
+	}
+
+private:
+	template<typename FVertexType>
+	static glm::vec3 GetTriangleCenter(const std::vector<FVertexType>& vertices, const std::vector<uint32_t>& indices, uint32_t triangle)
+	{
+		return (vertices[indices[triangle * 3 + 0]].Position + vertices[indices[triangle * 3 + 1]].Position + vertices[indices[triangle * 3 + 2]].Position) / 3.0f;
+	}
+
+	/** 包围球取包围盒中心，法线锥的轴为三角形法线的平均方向，张角由和轴夹角最大的法线决定*/
+	template<typename FVertexType>
+	static void ComputeClusterBounds(const std::vector<FVertexType>& vertices, const std::vector<uint32_t>& indices, FCluster& cluster)
+	{
+		glm::vec3 boundsMin(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+		glm::vec3 normalSum(0.0f);
+		for (uint32_t i = cluster.FirstIndex; i < cluster.FirstIndex + cluster.IndexCount; i += 3) {
+			glm::vec3 p0 = vertices[indices[i + 0]].Position;
+			glm::vec3 p1 = vertices[indices[i + 1]].Position;
+			glm::vec3 p2 = vertices[indices[i + 2]].Position;
+			boundsMin = glm::min(boundsMin, glm::min(p0, glm::min(p1, p2)));
+			boundsMax = glm::max(boundsMax, glm::max(p0, glm::max(p1, p2)));
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				normalSum += normal / length;
+			}
+		}
+
+		cluster.BoundsCenter = (boundsMin + boundsMax) * 0.5f;
+		cluster.BoundsRadius = 0.0f;
+		for (uint32_t i = cluster.FirstIndex; i < cluster.FirstIndex + cluster.IndexCount; i++) {
+			cluster.BoundsRadius = std::max(cluster.BoundsRadius, glm::length(vertices[indices[i]].Position - cluster.BoundsCenter));
+		}
+
+		float axisLength = glm::length(normalSum);
+		cluster.ConeAxis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+		cluster.ConeCutoff = 1.0f;
+		if (axisLength <= 0.0f) {
+			return;
+		}
+		float minDot = 1.0f;
+		for (uint32_t i = cluster.FirstIndex; i < cluster.FirstIndex + cluster.IndexCount; i += 3) {
+			glm::vec3 p0 = vertices[indices[i + 0]].Position;
+			glm::vec3 normal = glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				minDot = std::min(minDot, glm::dot(normal / length, cluster.ConeAxis));
+			}
+		}
+		// 张角接近或者超过90度时法线锥没有剔除意义
+		if (minDot > 0.1f) {
+			cluster.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+	}
+};
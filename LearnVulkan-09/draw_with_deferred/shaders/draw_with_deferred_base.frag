@@ -7,7 +7,6 @@ layout (constant_id = 0) const int SPEC_CONSTANTS = 0;
 // push constants block
 layout( push_constant ) uniform constants
 {
-	float time;
 	float roughness;
 	float metallic;
 	uint specConstants;
@@ -27,14 +26,17 @@ layout(set = 0, binding = 1) uniform uniformbuffer
 	mat4 shadowmapSpace;
 	mat4 localToWorld;
 	vec4 cameraInfo;
-	light directionalLights[16];
-	light pointLights[512];
-	light spotLights[16];
 	ivec4 lightsCount; // [0] for directionalLights, [1] for pointLights, [2] for spotLights
 	float zNear;
 	float zFar;
 } view;
 
+// 所有灯光按 方向光、点光源、聚光灯 的顺序排列，数量见 view.lightsCount
+layout(std430, set = 1, binding = 1) readonly buffer lightbuffer
+{
+	light lights[];
+} lightData;
+
 uint DIRECTIONAL_LIGHTS = view.lightsCount[0];
 uint POINT_LIGHTS = view.lightsCount[1];
 uint SPOT_LIGHTS = view.lightsCount[2];
@@ -43,17 +45,15 @@ uint SKY_MAXMIPS = view.lightsCount[3];
 layout(set = 0, binding = 2)  uniform samplerCube cubemap;  // sky cubemap
 layout(set = 0, binding = 3)  uniform sampler2D shadowmap;  // sky cubemap
 layout(set = 0, binding = 4)  uniform sampler2D sampler1; // basecolor
-layout(set = 0, binding = 5)  uniform sampler2D sampler2; // metalic
-layout(set = 0, binding = 6)  uniform sampler2D sampler3; // roughness
-layout(set = 0, binding = 7)  uniform sampler2D sampler4; // normalmap
-layout(set = 0, binding = 8)  uniform sampler2D sampler5; // ambient occlution
-layout(set = 0, binding = 9)  uniform sampler2D sampler6; // emissive
-layout(set = 0, binding = 10) uniform sampler2D sampler7; // mask
+layout(set = 0, binding = 5)  uniform sampler2D sampler2; // ambient occlution + roughness + metalic + mask
+layout(set = 0, binding = 6)  uniform sampler2D sampler3; // normalmap
+layout(set = 0, binding = 7)  uniform sampler2D sampler4; // emissive
 
 layout(location = 0) in vec3 fragPosition;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec3 fragColor;
 layout(location = 3) in vec2 fragTexCoord;
+layout(location = 4) in vec4 fragTangent;
 
 layout(location = 0) out vec4 outColor;
 
@@ -92,51 +92,40 @@ float remap(float value, float inputMin, float inputMax, float outputMin, float
 }
 
 
-vec3 ComputeNormal()
+// 切线在导入时生成（MikkTSpace），顶点着色器插值后传入，副切线由法线和切线的手性重建
+vec3 ComputeNormal(vec3 n)
 {
-	vec3 pos_dx = dFdx(fragPosition);
-	vec3 pos_dy = dFdy(fragPosition);
-	vec3 st1    = dFdx(vec3(fragTexCoord, 0.0));
-	vec3 st2    = dFdy(vec3(fragTexCoord, 0.0));
-	vec3 T      = (st2.t * pos_dx - st1.t * pos_dy) / (st1.s * st2.t - st2.s * st1.t);
 	vec3 N      = normalize(fragNormal);
-	T           = normalize(T - N * dot(N, T));
-	vec3 B      = normalize(cross(N, T));
+	vec3 T      = normalize(fragTangent.xyz - N * dot(N, fragTangent.xyz));
+	vec3 B      = cross(N, T) * fragTangent.w;
 	mat3 TBN    = mat3(T, B, N);
-	
-	return normalize(TBN[2].xyz);
+
+	return normalize(TBN * normalize(2.0 * n - 1.0));
 }
 
 
-vec3 ComputeNormal(vec3 n)
+// 法线贴图可能是 BC5 压缩的双通道格式，只使用 XY，Z 由单位长度重建
+vec3 UnpackNormalMap(vec2 rg)
 {
-	vec3 pos_dx = dFdx(fragPosition);
-	vec3 pos_dy = dFdy(fragPosition);
-	vec3 st1    = dFdx(vec3(fragTexCoord, 0.0));
-	vec3 st2    = dFdy(vec3(fragTexCoord, 0.0));
-	vec3 T      = (st2.t * pos_dx - st1.t * pos_dy) / (st1.s * st2.t - st2.s * st1.t);
-	vec3 N      = normalize(fragNormal);
-	T           = normalize(T - N * dot(N, T));
-	vec3 B      = normalize(cross(N, T));
-	mat3 TBN    = mat3(T, B, N);
-
-	return normalize(TBN * normalize(2.0 * n - 1.0));
+	vec2 xy = rg * 2.0 - 1.0;
+	float z = sqrt(max(0.0, 1.0 - dot(xy, xy)));
+	return vec3(xy, z) * 0.5 + 0.5;
 }
 
 
 vec3 GetDirectionalLightDirection(uint index)
 {
-	return normalize(view.directionalLights[index].direction.xyz);
+	return normalize(lightData.lights[index].direction.xyz);
 }
 
 vec3 GetDirectionalLightColor(uint index)
 {
-	return view.directionalLights[index].color.rgb;
+	return lightData.lights[index].color.rgb;
 }
 
 float GetDirectionalLightIntensity(uint index)
 {
-	return view.directionalLights[index].color.w;
+	return lightData.lights[index].color.w;
 }
 
 vec3 ApplyDirectionalLight(uint index, vec3 n)
@@ -151,27 +140,27 @@ vec3 ApplyDirectionalLight(uint index, vec3 n)
 
 vec3 GetPointLightPosition(uint index)
 {
-	return view.pointLights[index].position.xyz;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].position.xyz;
 }
 
 vec3 GetPointLightDirection(uint index, vec3 pos)
 {
-	return normalize(view.pointLights[index].position.xyz - pos);
+	return normalize(lightData.lights[DIRECTIONAL_LIGHTS + index].position.xyz - pos);
 }
 
 float GetPointLightFalloff(uint index)
 {
-	return view.pointLights[index].direction.w;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].direction.w;
 }
 
 vec3 GetPointLightColor(uint index)
 {
-	return view.pointLights[index].color.rgb;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].color.rgb;
 }
 
 float GetPointLightIntensity(uint index)
 {
-	return view.pointLights[index].color.w;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].color.w;
 }
 
 vec3 ApplyPointLight(uint index, vec3 pos, vec3 n)
@@ -401,13 +390,12 @@ void main()
 	vec3 VertexColor = fragColor;
 
 	vec3 BaseColor = texture(sampler1, fragTexCoord).rgb;
-	float Metallic = saturate(texture(sampler2, fragTexCoord).r);
-	float Roughness = saturate(texture(sampler3, fragTexCoord).r);
-	vec3 Normal = ComputeNormal(texture(sampler4, fragTexCoord).rgb);
-	vec3 AmbientOcclution = texture(sampler5, fragTexCoord).rgb;
+	vec4 ORM = texture(sampler2, fragTexCoord);
+	vec3 Normal = ComputeNormal(UnpackNormalMap(texture(sampler3, fragTexCoord).rg));
 
-	Roughness = max(0.01, Roughness);
-	float AO = AmbientOcclution.r;
+	float AO = ORM.r;
+	float Roughness = max(0.01, saturate(ORM.g));
+	float Metallic = saturate(ORM.b);
 	vec3 N = Normal;
 	vec3 P = fragPosition;
 	vec3 V = normalize(view.cameraInfo.xyz - P);
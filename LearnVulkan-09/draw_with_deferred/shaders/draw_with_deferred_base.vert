@@ -3,7 +3,6 @@
 // push constants block
 layout( push_constant ) uniform constants
 {
-	float time;
 	float roughness;
 	float metallic;
 	uint specConstants;
@@ -17,24 +16,80 @@ layout(set = 0, binding = 0) uniform uniformbuffer
 	mat4 proj;
 } ubo;
 
+#ifdef COMPACT_VERTEX
+// 每个物体的反量化参数：position = inPosition.xyz * positionScale.xyz + positionOffset.xyz
+// uv = inTexCoord * texCoordScaleOffset.xy + texCoordScaleOffset.zw
+struct DrawData
+{
+	vec4 positionScale;
+	vec4 positionOffset;
+	vec4 texCoordScaleOffset;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer drawdatabuffer
+{
+	DrawData draws[];
+} drawData;
+#endif
+
 // Vertex attributes
+#ifdef COMPACT_VERTEX
+layout(location = 0) in vec4 inPosition;		// snorm16，w为切线的手性
+layout(location = 1) in vec4 inNormalTangent;	// 八面体编码，xy为法线，zw为切线
+layout(location = 3) in vec2 inTexCoord;		// unorm16，物体的UV包围盒内量化
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec3 inColor;
 layout(location = 3) in vec2 inTexCoord;
+layout(location = 8) in vec4 inTangent;		// w为手性
+#endif
 
 layout(location = 0) out vec3 outPosition;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec3 outColor;
 layout(location = 3) out vec2 outTexCoord;
+layout(location = 4) out vec4 outTangent;		// 切线，w为手性
+
+#ifdef COMPACT_VERTEX
+// 八面体解码，和 FCompactVertex::OctEncode 对应
+vec3 OctDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+#endif
 
 void main()
 {
 	// Render object with MVP
+#ifdef COMPACT_VERTEX
+	DrawData draw = drawData.draws[gl_InstanceIndex];
+	vec3 position = inPosition.xyz * draw.positionScale.xyz + draw.positionOffset.xyz;
+#else
 	vec3 position = inPosition;
+#endif
 	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
 	outPosition = (ubo.model * vec4(position, 1.0)).rgb;
-	outNormal = (ubo.model * vec4(normalize(inNormal), 1.0)).rgb;
+#ifdef COMPACT_VERTEX
+	vec3 normal = OctDecode(inNormalTangent.xy);
+	vec3 tangent = OctDecode(inNormalTangent.zw);
+	float handedness = inPosition.w;
+	outColor = vec3(1.0);
+#else
+	vec3 normal = normalize(inNormal);
+	vec3 tangent = inTangent.xyz;
+	float handedness = inTangent.w;
 	outColor = inColor;
+#endif
+	outTangent = vec4((ubo.model * vec4(tangent, 0.0)).rgb, handedness);
+	outNormal = (ubo.model * vec4(normal, 1.0)).rgb;
+#ifdef COMPACT_VERTEX
+	outTexCoord = inTexCoord * draw.texCoordScaleOffset.xy + draw.texCoordScaleOffset.zw;
+#else
 	outTexCoord = inTexCoord;
+#endif
 }
\ No newline at end of file
@@ -8,7 +8,6 @@ layout (constant_id = 0) const int SPEC_CONSTANTS = 0;
 // push constants block
 layout( push_constant ) uniform constants
 {
-	float time;
 	float roughness;
 	float metallic;
 } global;
@@ -28,14 +27,17 @@ layout(set = 0, binding = 0) uniform uniformbuffer
 	mat4 shadowmapSpace;
 	mat4 localToWorld;
 	vec4 cameraInfo;
-	light directionalLights[16];
-	light pointLights[512];
-	light spotLights[16];
 	ivec4 lightsCount; // [0] for directionalLights, [1] for pointLights, [2] for spotLights
 	float zNear;
 	float zFar;
 } view;
 
+// 所有灯光按 方向光、点光源、聚光灯 的顺序排列，数量见 view.lightsCount
+layout(std430, set = 1, binding = 1) readonly buffer lightbuffer
+{
+	light lights[];
+} lightData;
+
 
 uint DIRECTIONAL_LIGHTS = view.lightsCount[0];
 uint POINT_LIGHTS = view.lightsCount[1];
@@ -95,17 +97,17 @@ float remap(float value, float inputMin, float inputMax, float outputMin, float
 
 vec3 GetDirectionalLightDirection(uint index)
 {
-	return normalize(view.directionalLights[index].direction.xyz);
+	return normalize(lightData.lights[index].direction.xyz);
 }
 
 vec3 GetDirectionalLightColor(uint index)
 {
-	return view.directionalLights[index].color.rgb;
+	return lightData.lights[index].color.rgb;
 }
 
 float GetDirectionalLightIntensity(uint index)
 {
-	return view.directionalLights[index].color.w;
+	return lightData.lights[index].color.w;
 }
 
 vec3 ApplyDirectionalLight(uint index, vec3 n)
@@ -120,27 +122,27 @@ vec3 ApplyDirectionalLight(uint index, vec3 n)
 
 vec3 GetPointLightPosition(uint index)
 {
-	return view.pointLights[index].position.xyz;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].position.xyz;
 }
 
 vec3 GetPointLightDirection(uint index, vec3 pos)
 {
-	return normalize(view.pointLights[index].position.xyz - pos);
+	return normalize(lightData.lights[DIRECTIONAL_LIGHTS + index].position.xyz - pos);
 }
 
 float GetPointLightFalloff(uint index)
 {
-	return view.pointLights[index].direction.w;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].direction.w;
 }
 
 vec3 GetPointLightColor(uint index)
 {
-	return view.pointLights[index].color.rgb;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].color.rgb;
 }
 
 float GetPointLightIntensity(uint index)
 {
-	return view.pointLights[index].color.w;
+	return lightData.lights[DIRECTIONAL_LIGHTS + index].color.w;
 }
 
 vec3 ApplyPointLight(uint index, vec3 pos, vec3 n)
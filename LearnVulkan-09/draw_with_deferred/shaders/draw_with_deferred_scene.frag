@@ -7,17 +7,15 @@ layout (constant_id = 0) const int SPEC_CONSTANTS = 0;
 layout(set = 0, binding = 2)  uniform samplerCube skycubemap;	// cubemap
 layout(set = 0, binding = 3)  uniform sampler2D shadowmap;		// shadowmap
 layout(set = 0, binding = 4)  uniform sampler2D sampler1;		// basecolor
-layout(set = 0, binding = 5)  uniform sampler2D sampler2;		// metalic
-layout(set = 0, binding = 6)  uniform sampler2D sampler3;		// roughness
-layout(set = 0, binding = 7)  uniform sampler2D sampler4;		// normal
-layout(set = 0, binding = 8)  uniform sampler2D sampler5;		// ambient occlution
-layout(set = 0, binding = 9)  uniform sampler2D sampler6;		// emissive
-layout(set = 0, binding = 10) uniform sampler2D sampler7;		// mask
+layout(set = 0, binding = 5)  uniform sampler2D sampler2;		// ambient occlution + roughness + metalic + mask
+layout(set = 0, binding = 6)  uniform sampler2D sampler3;		// normal
+layout(set = 0, binding = 7)  uniform sampler2D sampler4;		// emissive
 
 layout(location = 0) in vec3 fragPosition;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec3 fragColor;
 layout(location = 3) in vec2 fragTexCoord;
+layout(location = 4) in vec4 fragTangent;
 
 layout(location = 0) out vec4 outSceneColor;
 layout(location = 1) out vec4 outGBufferA;
@@ -26,35 +24,24 @@ layout(location = 3) out vec4 outGBufferC;
 layout(location = 4) out vec4 outGBufferD;
 
 
-vec3 ComputeNormal()
+// 切线在导入时生成（MikkTSpace），顶点着色器插值后传入，副切线由法线和切线的手性重建
+vec3 ComputeNormal(vec3 n)
 {
-	vec3 pos_dx = dFdx(fragPosition);
-	vec3 pos_dy = dFdy(fragPosition);
-	vec3 st1    = dFdx(vec3(fragTexCoord, 0.0));
-	vec3 st2    = dFdy(vec3(fragTexCoord, 0.0));
-	vec3 T      = (st2.t * pos_dx - st1.t * pos_dy) / (st1.s * st2.t - st2.s * st1.t);
 	vec3 N      = normalize(fragNormal);
-	T           = normalize(T - N * dot(N, T));
-	vec3 B      = normalize(cross(N, T));
+	vec3 T      = normalize(fragTangent.xyz - N * dot(N, fragTangent.xyz));
+	vec3 B      = cross(N, T) * fragTangent.w;
 	mat3 TBN    = mat3(T, B, N);
-	
-	return normalize(TBN[2].xyz);
+
+	return normalize(TBN * normalize(2.0 * n - 1.0));
 }
 
 
-vec3 ComputeNormal(vec3 n)
+// 法线贴图可能是 BC5 压缩的双通道格式，只使用 XY，Z 由单位长度重建
+vec3 UnpackNormalMap(vec2 rg)
 {
-	vec3 pos_dx = dFdx(fragPosition);
-	vec3 pos_dy = dFdy(fragPosition);
-	vec3 st1    = dFdx(vec3(fragTexCoord, 0.0));
-	vec3 st2    = dFdy(vec3(fragTexCoord, 0.0));
-	vec3 T      = (st2.t * pos_dx - st1.t * pos_dy) / (st1.s * st2.t - st2.s * st1.t);
-	vec3 N      = normalize(fragNormal);
-	T           = normalize(T - N * dot(N, T));
-	vec3 B      = normalize(cross(N, T));
-	mat3 TBN    = mat3(T, B, N);
-
-	return normalize(TBN * normalize(2.0 * n - 1.0));
+	vec2 xy = rg * 2.0 - 1.0;
+	float z = sqrt(max(0.0, 1.0 - dot(xy, xy)));
+	return vec3(xy, z) * 0.5 + 0.5;
 }
 
 
@@ -63,17 +50,15 @@ void main()
 	vec3 VertexColor = fragColor;
 
 	vec3 BaseColor = texture(sampler1, fragTexCoord).rgb;
-	float Metallic = texture(sampler2, fragTexCoord).r;
-	float Roughness = texture(sampler3, fragTexCoord).r;
-	vec3 Normal = ComputeNormal(texture(sampler4, fragTexCoord).rgb);
-	vec3 AmbientOcclution = texture(sampler5, fragTexCoord).rgb;
-	vec3 Emissive = texture(sampler6, fragTexCoord).rgb;
-	vec3 OpacityMask = texture(sampler7, fragTexCoord).rgb;
+	vec4 ORM = texture(sampler2, fragTexCoord);
+	vec3 Normal = ComputeNormal(UnpackNormalMap(texture(sampler3, fragTexCoord).rg));
+	vec3 Emissive = texture(sampler4, fragTexCoord).rgb;
 
-	Roughness = max(0.01, Roughness);
-	float AO = AmbientOcclution.r;
+	float AO = ORM.r;
+	float Roughness = max(0.01, ORM.g);
+	float Metallic = ORM.b;
 	vec3 NormalPacked = (normalize(Normal) + 1.0) / 2.0;
-	float Mask = OpacityMask.r;
+	float Mask = ORM.a;
 
 	outSceneColor = vec4(Emissive, Mask);;
 	outGBufferA = vec4(vec3(NormalPacked), 1.0);
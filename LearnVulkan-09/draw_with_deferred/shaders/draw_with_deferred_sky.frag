@@ -1,21 +1,10 @@
 #version 450
 
-struct light
-{
-	vec4 position;  // position.w represents type of light
-	vec4 color;     // color.w represents light intensity
-	vec4 direction; // direction.w represents range
-	vec4 info;      // (only used for spot lights) info.x represents light inner cone angle, info.y represents light outer cone angle
-};
-
 layout(set = 0, binding = 1) uniform uniformbuffer
 {
 	mat4 shadowmapSpace;
 	mat4 localToWorld;
 	vec4 cameraInfo;
-	light directionalLights[4];
-	light pointLights[4];
-	light spotLights[4];
 	ivec4 lightsCount; // [0] for directionalLights, [1] for pointLights, [2] for spotLights
 	float zNear;
 	float zFar;
@@ -3,7 +3,6 @@
 // push constants block
 layout( push_constant ) uniform constants
 {
-	float time;
 	float roughness;
 	float metallic;
 	uint specConstants;
@@ -17,13 +16,40 @@ layout(set = 0, binding = 0) uniform uniformbuffer
 	mat4 proj;
 } ubo;
 
+#ifdef COMPACT_VERTEX
+// 每个物体的反量化参数：position = inPosition.xyz * positionScale.xyz + positionOffset.xyz
+// uv = inTexCoord * texCoordScaleOffset.xy + texCoordScaleOffset.zw
+struct DrawData
+{
+	vec4 positionScale;
+	vec4 positionOffset;
+	vec4 texCoordScaleOffset;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer drawdatabuffer
+{
+	DrawData draws[];
+} drawData;
+#endif
+
+#ifdef COMPACT_VERTEX
+layout(location = 0) in vec4 inPosition;		// snorm16，w为切线的手性
+layout(location = 1) in vec4 inNormalTangent;	// 八面体编码，xy为法线，zw为切线
+layout(location = 3) in vec2 inTexCoord;		// unorm16，物体的UV包围盒内量化
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec3 inColor;
 layout(location = 3) in vec2 inTexCoord;
+#endif
 
 void main()
 {
+#ifdef COMPACT_VERTEX
+	DrawData draw = drawData.draws[gl_InstanceIndex];
+	vec3 position = inPosition.xyz * draw.positionScale.xyz + draw.positionOffset.xyz;
+#else
 	vec3 position = inPosition;
+#endif
 	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -3,7 +3,6 @@
 // push constants block
 layout( push_constant ) uniform constants
 {
-	float time;
 	float roughness;
 	float metallic;
 	uint specConstants;
@@ -17,16 +16,41 @@ layout(set = 0, binding = 0) uniform uniformbuffer
 	mat4 proj;
 } ubo;
 
+#ifdef COMPACT_VERTEX
+// 每个物体的反量化参数：position = inPosition.xyz * positionScale.xyz + positionOffset.xyz
+// uv = inTexCoord * texCoordScaleOffset.xy + texCoordScaleOffset.zw
+struct DrawData
+{
+	vec4 positionScale;
+	vec4 positionOffset;
+	vec4 texCoordScaleOffset;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer drawdatabuffer
+{
+	DrawData draws[];
+} drawData;
+#endif
+
+#ifdef COMPACT_VERTEX
+layout(location = 0) in vec4 inPosition;		// snorm16，w为切线的手性
+layout(location = 1) in vec4 inNormalTangent;	// 八面体编码，xy为法线，zw为切线
+layout(location = 3) in vec2 inTexCoord;		// unorm16，物体的UV包围盒内量化
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec3 inColor;
 layout(location = 3) in vec2 inTexCoord;
+#endif
 
 // Instanced attributes
 layout (location = 4) in vec3 inInstancePosition;
 layout (location = 5) in vec3 inInstanceRotation;
 layout (location = 6) in float inInstancePScale;
 layout (location = 7) in uint inInstanceTexIndex;
+#ifdef COMPACT_VERTEX
+layout (location = 9) in uint inInstanceDrawIndex;	// 所属物体在 DrawData 中的序号
+#endif
 
 mat4 MakeRotMatrix(vec3 R)
 {
@@ -60,6 +84,12 @@ mat4 MakeRotMatrix(vec3 R)
 void main()
 {
 	mat4 rotMat = MakeRotMatrix(inInstanceRotation);
-	vec3 position = (inPosition * inInstancePScale) * mat3(rotMat) + inInstancePosition;
+#ifdef COMPACT_VERTEX
+	DrawData draw = drawData.draws[inInstanceDrawIndex];
+	vec3 localPosition = inPosition.xyz * draw.positionScale.xyz + draw.positionOffset.xyz;
+#else
+	vec3 localPosition = inPosition;
+#endif
+	vec3 position = (localPosition * inInstancePScale) * mat3(rotMat) + inInstancePosition;
 	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,545 @@
+// Copyright LearnVulkan-09: Draw with Deferred, @xukai. All Rights Reserved.
+// 不依赖 Vulkan 的区间分配器，显存子分配器用它管理每个 VkDeviceMemory 块中的偏移，单元测试直接测试这里的逻辑
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+
+/** 显存子分配的策略*/
+enum class EMemoryAllocationStrategy : uint8_t
+{
+	Linear,		// 线性分配，只向后追加，块中的分配全部释放后整体重置，适合一起创建一起销毁的资源
+	FreeList,	// 空闲链表，用 TLSF 索引查找放得下的空闲区间，释放时合并相邻的空闲区间，适合生命周期各不相同的资源
+};
+
+
+/** 资源的内存布局，Buffer（以及Linear Image）和Optimal Image在同一块内存中相邻时，需要按 bufferImageGranularity 隔开*/
+enum class EMemoryResourceType : uint8_t
+{
+	Free,
+	Linear,
+	Optimal,
+};
+
+
+/** 一个内存块中的区间分配器，记录所有区间（包括空闲区间），偏移和大小以字节为单位
+ * FreeList 策略用 TLSF（Two-Level Segregated Fit）索引空闲区间：第一级按大小的最高位分组，第二级把每组再等分为 TLSF_SL_COUNT 份
+ * 每一份是一个空闲区间链表，两级位图记录哪些链表非空，分配时直接定位到第一个一定放得下的链表*/
+class FMemoryBlockAllocator
+{
+public:
+	static constexpr uint64_t INVALID_OFFSET = ~0ull;
+
+	void Init(uint64_t inSize, EMemoryAllocationStrategy inStrategy, uint64_t inGranularity)
+	{
+		Size = inSize;
+		Strategy = inStrategy;
+		Granularity = inGranularity > 0 ? inGranularity : 1;
+		uint32_t firstLevel, secondLevel;
+		MapSize(Size, firstLevel, secondLevel);
+		SecondLevelBitmaps.assign(firstLevel + 1, 0);
+		FreeHeads.assign(size_t(firstLevel + 1) * TLSF_SL_COUNT, INVALID_OFFSET);
+		Reset();
+	}
+
+	/** 分配成功时返回true，outOffset 按 alignment 对齐，并且和不同布局的相邻资源不在同一个 Granularity 页中*/
+	bool Allocate(uint64_t size, uint64_t alignment, EMemoryResourceType type, uint64_t& outOffset)
+	{
+		alignment = alignment > 0 ? alignment : 1;
+		if (size == 0 || size > Size) {
+			return false;
+		}
+		if (Strategy == EMemoryAllocationStrategy::Linear) {
+			return AllocateLinear(size, alignment, type, outOffset);
+		}
+
+		// 向上取整到链表的边界，找到的链表中每个区间都不小于 size，对齐之后放不下时继续查找更大的链表
+		uint32_t firstLevel, secondLevel;
+		MapSize(RoundUpToList(size), firstLevel, secondLevel);
+		while (FindFreeList(firstLevel, secondLevel))
+		{
+			for (uint64_t freeOffset = FreeHeads[GetListIndex(firstLevel, secondLevel)]; freeOffset != INVALID_OFFSET; )
+			{
+				auto current = Ranges.find(freeOffset);
+				if (TryAllocateFromRange(current, size, alignment, type, outOffset)) {
+					return true;
+				}
+				freeOffset = current->second.NextFree;
+			}
+			if (++secondLevel == TLSF_SL_COUNT) {
+				secondLevel = 0;
+				firstLevel++;
+			}
+		}
+		return false;
+	}
+
+	/** 释放 offset 处的分配，FreeList 和前后相邻的空闲区间合并，Linear 全部释放后整体重置*/
+	void Free(uint64_t offset)
+	{
+		auto current = Ranges.find(offset);
+		if (current == Ranges.end() || current->second.Type == EMemoryResourceType::Free) {
+			throw std::runtime_error("failed to free device memory, allocation not found!");
+		}
+		AllocationCount--;
+		UsedBytes -= current->second.Size;
+
+		if (Strategy == EMemoryAllocationStrategy::Linear)
+		{
+			current->second.Type = EMemoryResourceType::Free;
+			if (AllocationCount == 0) {
+				Reset();
+			}
+			return;
+		}
+
+		uint64_t freeOffset = current->first;
+		uint64_t freeSize = current->second.Size;
+		auto next = std::next(current);
+		if (next != Ranges.end() && next->second.Type == EMemoryResourceType::Free) {
+			freeSize += next->second.Size;
+			EraseFreeRange(next);
+		}
+		if (current != Ranges.begin()) {
+			auto prev = std::prev(current);
+			if (prev->second.Type == EMemoryResourceType::Free) {
+				freeOffset = prev->first;
+				freeSize += prev->second.Size;
+				EraseFreeRange(prev);
+			}
+		}
+		Ranges.erase(offset);
+		InsertFreeRange(freeOffset, freeSize);
+	}
+
+	/** 可以再分配的空间，Linear 只有末尾可以分配*/
+	uint64_t GetFreeBytes() const
+	{
+		return Strategy == EMemoryAllocationStrategy::Linear ? Size - LinearHead : Size - UsedBytes;
+	}
+
+	uint64_t GetLargestFreeRange() const
+	{
+		if (Strategy == EMemoryAllocationStrategy::Linear) {
+			return Size - LinearHead;
+		}
+		// 最大的空闲区间在最高的非空链表中
+		uint64_t largest = 0;
+		for (uint32_t firstLevel = uint32_t(SecondLevelBitmaps.size()); firstLevel-- > 0 && largest == 0; ) {
+			for (uint32_t secondLevel = TLSF_SL_COUNT; secondLevel-- > 0 && largest == 0; ) {
+				for (uint64_t offset = FreeHeads[GetListIndex(firstLevel, secondLevel)]; offset != INVALID_OFFSET; offset = Ranges.at(offset).NextFree) {
+					largest = std::max(largest, Ranges.at(offset).Size);
+				}
+			}
+		}
+		return largest;
+	}
+
+	/** 遍历所有分配，func(offset, size, alignment, type)*/
+	template<typename FFunc>
+	void ForEachAllocation(FFunc&& func) const
+	{
+		for (const auto& range : Ranges) {
+			if (range.second.Type != EMemoryResourceType::Free) {
+				func(range.first, range.second.Size, range.second.Alignment, range.second.Type);
+			}
+		}
+	}
+
+	/** 检查区间覆盖整个块、空闲区间已经合并，并且 TLSF 链表和位图一致，用于测试*/
+	bool IsConsistent() const
+	{
+		uint64_t expectedOffset = 0;
+		uint64_t usedBytes = 0;
+		uint32_t allocationCount = 0;
+		size_t freeRangeCount = 0;
+		bool bPrevFree = false;
+		for (const auto& range : Ranges)
+		{
+			bool bFree = range.second.Type == EMemoryResourceType::Free;
+			if (range.first != expectedOffset || range.second.Size == 0 ||
+				(bFree && bPrevFree && Strategy == EMemoryAllocationStrategy::FreeList)) {
+				return false;
+			}
+			if (bFree) {
+				freeRangeCount += IsIndexed(range.first) ? 1 : 0;
+			}
+			else {
+				usedBytes += range.second.Size;
+				allocationCount++;
+			}
+			expectedOffset += range.second.Size;
+			bPrevFree = bFree;
+		}
+		if (expectedOffset != Size || usedBytes != UsedBytes || allocationCount != AllocationCount) {
+			return false;
+		}
+
+		size_t listedCount = 0;
+		for (uint32_t firstLevel = 0; firstLevel < SecondLevelBitmaps.size(); firstLevel++)
+		{
+			bool bFirstLevelSet = (FirstLevelBitmap >> firstLevel) & 1;
+			if (bFirstLevelSet != (SecondLevelBitmaps[firstLevel] != 0)) {
+				return false;
+			}
+			for (uint32_t secondLevel = 0; secondLevel < TLSF_SL_COUNT; secondLevel++)
+			{
+				uint64_t head = FreeHeads[GetListIndex(firstLevel, secondLevel)];
+				if (((SecondLevelBitmaps[firstLevel] >> secondLevel) & 1) != (head != INVALID_OFFSET ? 1u : 0u)) {
+					return false;
+				}
+				for (uint64_t offset = head; offset != INVALID_OFFSET; offset = Ranges.at(offset).NextFree)
+				{
+					uint32_t rangeFirstLevel, rangeSecondLevel;
+					MapSize(Ranges.at(offset).Size, rangeFirstLevel, rangeSecondLevel);
+					if (rangeFirstLevel != firstLevel || rangeSecondLevel != secondLevel || Ranges.at(offset).Type != EMemoryResourceType::Free) {
+						return false;
+					}
+					listedCount++;
+				}
+			}
+		}
+		return listedCount == freeRangeCount;
+	}
+
+	uint64_t GetSize() const { return Size; }
+	uint64_t GetUsedBytes() const { return UsedBytes; }
+	uint32_t GetAllocationCount() const { return AllocationCount; }
+	EMemoryAllocationStrategy GetStrategy() const { return Strategy; }
+
+private:
+	static constexpr uint32_t TLSF_SL_BITS = 5;
+	static constexpr uint32_t TLSF_SL_COUNT = 1u << TLSF_SL_BITS;
+
+	struct FMemoryRange {
+		uint64_t Size = 0;
+		uint64_t Alignment = 1;
+		EMemoryResourceType Type = EMemoryResourceType::Free;
+		uint64_t PrevFree = INVALID_OFFSET;		// 同一个 TLSF 链表中前后的空闲区间
+		uint64_t NextFree = INVALID_OFFSET;
+	};
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static uint32_t FindLastSet(uint64_t value)
+	{
+		uint32_t bit = 0;
+		while (value >>= 1) {
+			bit++;
+		}
+		return bit;
+	}
+
+	static uint32_t FindFirstSet(uint64_t value)
+	{
+		uint32_t bit = 0;
+		while (!(value & 1)) {
+			value >>= 1;
+			bit++;
+		}
+		return bit;
+	}
+
+	/** 小于 TLSF_SL_COUNT 的大小每个值一个链表，其它大小按最高位分组，组内按接下来的 TLSF_SL_BITS 位分链表*/
+	static void MapSize(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel)
+	{
+		if (size < TLSF_SL_COUNT) {
+			outFirstLevel = 0;
+			outSecondLevel = uint32_t(size);
+			return;
+		}
+		uint32_t lastBit = FindLastSet(size);
+		outFirstLevel = lastBit - TLSF_SL_BITS + 1;
+		outSecondLevel = uint32_t(size >> (lastBit - TLSF_SL_BITS)) - TLSF_SL_COUNT;
+	}
+
+	/** 向上取整到下一个链表的起始大小，这样链表中的任意区间都放得下*/
+	static uint64_t RoundUpToList(uint64_t size)
+	{
+		if (size < TLSF_SL_COUNT) {
+			return size;
+		}
+		return size + (1ull << (FindLastSet(size) - TLSF_SL_BITS)) - 1;
+	}
+
+	static size_t GetListIndex(uint32_t firstLevel, uint32_t secondLevel)
+	{
+		return size_t(firstLevel) * TLSF_SL_COUNT + secondLevel;
+	}
+
+	/** 从 (firstLevel, secondLevel) 开始找到第一个非空的链表*/
+	bool FindFreeList(uint32_t& firstLevel, uint32_t& secondLevel) const
+	{
+		if (firstLevel >= SecondLevelBitmaps.size()) {
+			return false;
+		}
+		uint32_t secondLevelMap = SecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+		if (secondLevelMap == 0)
+		{
+			uint64_t firstLevelMap = firstLevel + 1 < 64 ? FirstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+			if (firstLevelMap == 0) {
+				return false;
+			}
+			firstLevel = FindFirstSet(firstLevelMap);
+			secondLevelMap = SecondLevelBitmaps[firstLevel];
+		}
+		secondLevel = FindFirstSet(secondLevelMap);
+		return true;
+	}
+
+	bool IsIndexed(uint64_t offset) const
+	{
+		const FMemoryRange& range = Ranges.at(offset);
+		uint32_t firstLevel, secondLevel;
+		MapSize(range.Size, firstLevel, secondLevel);
+		return range.PrevFree != INVALID_OFFSET || FreeHeads[GetListIndex(firstLevel, secondLevel)] == offset;
+	}
+
+	/** 两个不同布局的资源是否落在同一个 Granularity 页中*/
+	bool IsGranularityConflict(EMemoryResourceType a, uint64_t aLastByte, EMemoryResourceType b, uint64_t bFirstByte) const
+	{
+		if (a == EMemoryResourceType::Free || b == EMemoryResourceType::Free || a == b) {
+			return false;
+		}
+		return (aLastByte / Granularity) == (bFirstByte / Granularity);
+	}
+
+	bool TryAllocateFromRange(std::map<uint64_t, FMemoryRange>::iterator current, uint64_t size, uint64_t alignment, EMemoryResourceType type, uint64_t& outOffset)
+	{
+		uint64_t freeOffset = current->first;
+		uint64_t freeSize = current->second.Size;
+		uint64_t offset = AlignUp(freeOffset, alignment);
+		if (current != Ranges.begin()) {
+			auto prev = std::prev(current);
+			if (IsGranularityConflict(prev->second.Type, prev->first + prev->second.Size - 1, type, offset)) {
+				offset = AlignUp(offset, Granularity);
+			}
+		}
+		if (offset + size > freeOffset + freeSize) {
+			return false;
+		}
+		auto next = std::next(current);
+		if (next != Ranges.end() && IsGranularityConflict(type, offset + size - 1, next->second.Type, next->first)) {
+			return false;
+		}
+
+		// 拆分空闲区间：前面对齐留下的空隙和后面剩余的空间仍然是空闲的
+		EraseFreeRange(current);
+		if (offset > freeOffset) {
+			InsertFreeRange(freeOffset, offset - freeOffset);
+		}
+		FMemoryRange& range = Ranges[offset];
+		range.Size = size;
+		range.Alignment = alignment;
+		range.Type = type;
+		if (offset + size < freeOffset + freeSize) {
+			InsertFreeRange(offset + size, freeOffset + freeSize - offset - size);
+		}
+		AllocationCount++;
+		UsedBytes += size;
+		outOffset = offset;
+		return true;
+	}
+
+	bool AllocateLinear(uint64_t size, uint64_t alignment, EMemoryResourceType type, uint64_t& outOffset)
+	{
+		uint64_t offset = AlignUp(LinearHead, alignment);
+		if (LinearHead > 0 && IsGranularityConflict(LastType, LinearHead - 1, type, offset)) {
+			offset = AlignUp(offset, Granularity);
+		}
+		if (offset + size > Size) {
+			return false;
+		}
+
+		// 线性块中只有末尾是可以分配的空闲区间，对齐留下的空隙并入前一个区间之后的空闲区间
+		auto tail = Ranges.find(LinearHead);
+		if (tail != Ranges.end() && tail->second.Type == EMemoryResourceType::Free) {
+			EraseFreeRange(tail);
+		}
+		if (offset > LinearHead) {
+			InsertFreeRange(LinearHead, offset - LinearHead);
+		}
+		FMemoryRange& range = Ranges[offset];
+		range.Size = size;
+		range.Alignment = alignment;
+		range.Type = type;
+		LinearHead = offset + size;
+		LastType = type;
+		if (LinearHead < Size) {
+			InsertFreeRange(LinearHead, Size - LinearHead);
+		}
+		AllocationCount++;
+		UsedBytes += size;
+		outOffset = offset;
+		return true;
+	}
+
+	void Reset()
+	{
+		Ranges.clear();
+		FirstLevelBitmap = 0;
+		std::fill(SecondLevelBitmaps.begin(), SecondLevelBitmaps.end(), 0u);
+		std::fill(FreeHeads.begin(), FreeHeads.end(), INVALID_OFFSET);
+		LinearHead = 0;
+		LastType = EMemoryResourceType::Free;
+		InsertFreeRange(0, Size);
+	}
+
+	/** 加入空闲区间，并放到对应 TLSF 链表的头部*/
+	void InsertFreeRange(uint64_t offset, uint64_t size)
+	{
+		uint32_t firstLevel, secondLevel;
+		MapSize(size, firstLevel, secondLevel);
+		size_t list = GetListIndex(firstLevel, secondLevel);
+		FMemoryRange& range = Ranges[offset];
+		range.Size = size;
+		range.Alignment = 1;
+		range.Type = EMemoryResourceType::Free;
+		range.PrevFree = INVALID_OFFSET;
+		range.NextFree = FreeHeads[list];
+		if (FreeHeads[list] != INVALID_OFFSET) {
+			Ranges.at(FreeHeads[list]).PrevFree = offset;
+		}
+		FreeHeads[list] = offset;
+		FirstLevelBitmap |= 1ull << firstLevel;
+		SecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+	}
+
+	/** 从 TLSF 链表和区间表中移除空闲区间，链表为空时清除位图*/
+	void EraseFreeRange(std::map<uint64_t, FMemoryRange>::iterator range)
+	{
+		uint32_t firstLevel, secondLevel;
+		MapSize(range->second.Size, firstLevel, secondLevel);
+		size_t list = GetListIndex(firstLevel, secondLevel);
+		if (range->second.PrevFree != INVALID_OFFSET) {
+			Ranges.at(range->second.PrevFree).NextFree = range->second.NextFree;
+		}
+		else {
+			FreeHeads[list] = range->second.NextFree;
+		}
+		if (range->second.NextFree != INVALID_OFFSET) {
+			Ranges.at(range->second.NextFree).PrevFree = range->second.PrevFree;
+		}
+		if (FreeHeads[list] == INVALID_OFFSET)
+		{
+			SecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (SecondLevelBitmaps[firstLevel] == 0) {
+				FirstLevelBitmap &= ~(1ull << firstLevel);
+			}
+		}
+		Ranges.erase(range);
+	}
+
+	uint64_t Size = 0;
+	uint64_t Granularity = 1;
+	EMemoryAllocationStrategy Strategy = EMemoryAllocationStrategy::FreeList;
+	uint32_t AllocationCount = 0;
+	uint64_t UsedBytes = 0;
+	uint64_t LinearHead = 0;									// 线性块的分配位置
+	EMemoryResourceType LastType = EMemoryResourceType::Free;	// 线性块最后一个分配的布局
+	std::map<uint64_t, FMemoryRange> Ranges;					// 按偏移排序的所有区间，包括空闲区间
+	uint64_t FirstLevelBitmap = 0;								// 第 i 位表示第一级 i 中有非空的链表
+	std::vector<uint32_t> SecondLevelBitmaps;					// 第一级 i 中第 j 位表示链表 (i, j) 非空
+	std::vector<uint64_t> FreeHeads;							// 每个链表头部的空闲区间偏移
+};
+
+
+/** 按元素子分配的区间分配器，用于全局几何缓存池：空闲区间按偏移排序，首次适配，释放时和相邻的空闲区间合并
+ * 放不下时由使用者按 GetGrowCapacity 扩容，新增的空间通过 Grow 加入空闲区间*/
+struct FGeometryRangeAllocator
+{
+	uint32_t Capacity = 0;                          // 可以容纳的元素数量
+	uint32_t Used = 0;
+	std::map<uint32_t, uint32_t> FreeRanges;        // 空闲区间，起始元素 -> 元素数量
+
+	static const uint32_t INVALID_OFFSET = UINT32_MAX;
+
+	/** 分配count个连续的元素，返回起始元素，放不下时返回 INVALID_OFFSET*/
+	uint32_t Allocate(uint32_t count)
+	{
+		if (count == 0) {
+			return 0;
+		}
+		for (auto it = FreeRanges.begin(); it != FreeRanges.end(); ++it)
+		{
+			if (it->second < count) {
+				continue;
+			}
+			uint32_t offset = it->first;
+			uint32_t remaining = it->second - count;
+			FreeRanges.erase(it);
+			if (remaining > 0) {
+				FreeRanges[offset + count] = remaining;
+			}
+			Used += count;
+			return offset;
+		}
+		return INVALID_OFFSET;
+	}
+
+	void Free(uint32_t offset, uint32_t count)
+	{
+		if (count == 0) {
+			return;
+		}
+		Used -= count;
+		auto next = FreeRanges.lower_bound(offset);
+		if (next != FreeRanges.end() && offset + count == next->first) {
+			count += next->second;
+			next = FreeRanges.erase(next);
+		}
+		if (next != FreeRanges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				prev->second += count;
+				return;
+			}
+		}
+		FreeRanges[offset] = count;
+	}
+
+	/** 是否有足够大的连续空闲区间*/
+	bool CanAllocate(uint32_t count) const
+	{
+		if (count == 0) {
+			return true;
+		}
+		for (const auto& range : FreeRanges) {
+			if (range.second >= count) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** 放下count个连续元素需要的新容量：按两倍扩容，末尾的空闲区间和新增的空间合并，只需要补足差额*/
+	uint64_t GetGrowCapacity(uint32_t count) const
+	{
+		uint32_t tailFree = 0;
+		if (!FreeRanges.empty()) {
+			auto last = std::prev(FreeRanges.end());
+			tailFree = (last->first + last->second == Capacity) ? last->second : 0;
+		}
+		uint64_t newCapacity = std::max<uint64_t>(uint64_t(Capacity) * 2, 1);
+		while (newCapacity - Capacity + tailFree < count) {
+			newCapacity *= 2;
+		}
+		return newCapacity;
+	}
+
+	/** 扩容后新增的空间加入空闲区间，数据的拷贝由使用者完成*/
+	void Grow(uint32_t newCapacity)
+	{
+		Free(Capacity, newCapacity - Capacity);
+		Used += newCapacity - Capacity;
+		Capacity = newCapacity;
+	}
+};
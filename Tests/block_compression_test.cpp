@@ -0,0 +1,157 @@
+// Copyright LearnVulkan Tests, @xukai. All Rights Reserved.
+// BC1/BC4/BC5/BC7 编码后再解码，检查误差在允许的范围内
+#include "unit_test.h"
+
+#include "texture_cooker/block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/** 固定种子的随机数，保证每次运行结果一致*/
+static uint32_t NextRandom(uint32_t& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+/** 两个颜色之间的对角线渐变，所有像素在颜色空间中共线，端点插值可以很好地表示*/
+static std::vector<uint8_t> MakeGradientImage(uint32_t width, uint32_t height)
+{
+	const int from[4] = { 20, 240, 60, 255 };
+	const int to[4] = { 230, 30, 180, 64 };
+	std::vector<uint8_t> rgba(size_t(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			float t = float(x + y) / float(std::max(width + height - 2, 1u));
+			for (int c = 0; c < 4; c++) {
+				rgba[(size_t(y) * width + x) * 4 + c] = uint8_t(std::lround(from[c] + (to[c] - from[c]) * t));
+			}
+		}
+	}
+	return rgba;
+}
+
+static std::vector<uint8_t> MakeNoiseImage(uint32_t width, uint32_t height, uint32_t seed)
+{
+	std::vector<uint8_t> rgba(size_t(width) * height * 4);
+	for (uint8_t& value : rgba) {
+		value = uint8_t(NextRandom(seed));
+	}
+	return rgba;
+}
+
+static std::vector<uint8_t> MakeSolidImage(uint32_t width, uint32_t height, const uint8_t color[4])
+{
+	std::vector<uint8_t> rgba(size_t(width) * height * 4);
+	for (size_t i = 0; i < rgba.size(); i++) {
+		rgba[i] = color[i % 4];
+	}
+	return rgba;
+}
+
+/** 误差统计，只比较 channelCount 个通道*/
+struct FRoundTripError {
+	double RMSE = 0.0;
+	int MaxError = 0;
+};
+
+static FRoundTripError RoundTrip(ECookedTextureFormat format, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, int channelCount)
+{
+	std::vector<uint8_t> blocks;
+	CompressImage(format, rgba.data(), width, height, blocks);
+	CHECK(blocks.size() == size_t((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format));
+
+	std::vector<uint8_t> decoded;
+	DecompressImage(format, blocks.data(), width, height, decoded);
+	CHECK(decoded.size() == rgba.size());
+
+	FRoundTripError result;
+	double sum = 0.0;
+	for (size_t p = 0; p < rgba.size(); p += 4) {
+		for (int c = 0; c < channelCount; c++) {
+			int d = std::abs(int(rgba[p + c]) - int(decoded[p + c]));
+			sum += double(d) * d;
+			result.MaxError = std::max(result.MaxError, d);
+		}
+	}
+	result.RMSE = std::sqrt(sum / double(rgba.size() / 4 * channelCount));
+	return result;
+}
+
+static void TestSolidColor()
+{
+	const uint8_t color[4] = { 200, 117, 33, 180 };
+	std::vector<uint8_t> rgba = MakeSolidImage(8, 8, color);
+	// 565 量化：R/B 误差不超过 4，G 不超过 2
+	CHECK(RoundTrip(ECookedTextureFormat::BC1, rgba, 8, 8, 3).MaxError <= 4);
+	CHECK(RoundTrip(ECookedTextureFormat::BC4, rgba, 8, 8, 1).MaxError == 0);
+	CHECK(RoundTrip(ECookedTextureFormat::BC5, rgba, 8, 8, 2).MaxError == 0);
+	// 7位端点 + P 位可以精确表示任意 8 位颜色
+	CHECK(RoundTrip(ECookedTextureFormat::BC7, rgba, 8, 8, 4).MaxError <= 1);
+}
+
+static void TestGradient()
+{
+	std::vector<uint8_t> rgba = MakeGradientImage(32, 32);
+	FRoundTripError bc1 = RoundTrip(ECookedTextureFormat::BC1, rgba, 32, 32, 3);
+	CHECK(bc1.RMSE < 3.0 && bc1.MaxError <= 8);
+	CHECK(RoundTrip(ECookedTextureFormat::BC4, rgba, 32, 32, 1).MaxError <= 2);
+	CHECK(RoundTrip(ECookedTextureFormat::BC5, rgba, 32, 32, 2).MaxError <= 2);
+	CHECK(RoundTrip(ECookedTextureFormat::BC7, rgba, 32, 32, 4).MaxError <= 2);
+}
+
+/** 随机噪声不在一条直线上，只检查误差没有明显变差*/
+static void TestNoise()
+{
+	std::vector<uint8_t> rgba = MakeNoiseImage(32, 32, 1234u);
+	CHECK(RoundTrip(ECookedTextureFormat::BC1, rgba, 32, 32, 3).RMSE < 60.0);
+	CHECK(RoundTrip(ECookedTextureFormat::BC4, rgba, 32, 32, 1).RMSE < 12.0);
+	CHECK(RoundTrip(ECookedTextureFormat::BC5, rgba, 32, 32, 2).RMSE < 12.0);
+	CHECK(RoundTrip(ECookedTextureFormat::BC7, rgba, 32, 32, 4).RMSE < 50.0);
+}
+
+/** ORM 贴图的各个通道互不相关：颜色沿 x 变化，Alpha 沿 y 变化，Mode 6 的单条直线无法表示，应该选择 Mode 5*/
+static void TestUncorrelatedAlpha()
+{
+	const uint32_t size = 16;
+	std::vector<uint8_t> rgba(size * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint8_t* texel = &rgba[(y * size + x) * 4];
+			texel[0] = uint8_t(40 + x * 8);
+			texel[1] = uint8_t(200 - x * 8);
+			texel[2] = uint8_t(90 + x * 4);
+			texel[3] = uint8_t(y * 17);
+		}
+	}
+	std::vector<uint8_t> blocks;
+	CompressImage(ECookedTextureFormat::BC7, rgba.data(), size, size, blocks);
+	uint32_t mode5Blocks = 0;
+	for (size_t b = 0; b < blocks.size(); b += 16) {
+		mode5Blocks += (blocks[b] & 0x3F) == 0x20 ? 1 : 0;
+	}
+	CHECK(mode5Blocks == blocks.size() / 16);
+	CHECK(RoundTrip(ECookedTextureFormat::BC7, rgba, size, size, 4).MaxError <= 4);
+}
+
+/** 宽高不是4的倍数时，边缘块重复最后一行/列，解码结果裁剪回原尺寸
+ * 渐变很陡，BC4 每个块的误差不超过块内范围的 1/14*/
+static void TestPartialBlocks()
+{
+	std::vector<uint8_t> rgba = MakeGradientImage(6, 5);
+	CHECK(RoundTrip(ECookedTextureFormat::BC1, rgba, 6, 5, 3).RMSE < 10.0);
+	CHECK(RoundTrip(ECookedTextureFormat::BC4, rgba, 6, 5, 1).MaxError <= 12);
+	CHECK(RoundTrip(ECookedTextureFormat::BC7, rgba, 6, 5, 4).RMSE < 2.5);
+}
+
+int main()
+{
+	RUN_TEST(TestSolidColor);
+	RUN_TEST(TestGradient);
+	RUN_TEST(TestNoise);
+	RUN_TEST(TestUncorrelatedAlpha);
+	RUN_TEST(TestPartialBlocks);
+	return UNIT_TEST_RESULT();
+}
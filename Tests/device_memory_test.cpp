@@ -0,0 +1,159 @@
+// Copyright LearnVulkan Tests, @xukai. All Rights Reserved.
+// 显存块内的区间分配：分配、释放、合并空闲区间，以及 TLSF 索引的一致性
+#include "unit_test.h"
+
+#include "suballocators.h"
+
+#include <cstdint>
+#include <vector>
+
+static const uint64_t BLOCK_SIZE = 1024 * 1024;
+
+static void TestAllocateAndFree()
+{
+	FMemoryBlockAllocator allocator;
+	allocator.Init(BLOCK_SIZE, EMemoryAllocationStrategy::FreeList, 1);
+	CHECK(allocator.IsConsistent());
+	CHECK(allocator.GetLargestFreeRange() == BLOCK_SIZE);
+
+	uint64_t a, b, c;
+	CHECK(allocator.Allocate(1000, 256, EMemoryResourceType::Linear, a));
+	CHECK(allocator.Allocate(4096, 4096, EMemoryResourceType::Linear, b));
+	CHECK(allocator.Allocate(17, 1, EMemoryResourceType::Linear, c));
+	CHECK(a % 256 == 0 && b % 4096 == 0);
+	CHECK(a + 1000 <= b || b + 4096 <= a);
+	CHECK(allocator.GetAllocationCount() == 3);
+	CHECK(allocator.GetUsedBytes() == 1000 + 4096 + 17);
+	CHECK(allocator.IsConsistent());
+
+	allocator.Free(b);
+	CHECK(allocator.GetAllocationCount() == 2);
+	CHECK(allocator.IsConsistent());
+	allocator.Free(a);
+	allocator.Free(c);
+	CHECK(allocator.GetAllocationCount() == 0);
+	CHECK(allocator.GetUsedBytes() == 0);
+	// 全部释放后合并成一个覆盖整个块的空闲区间
+	CHECK(allocator.GetLargestFreeRange() == BLOCK_SIZE);
+	CHECK(allocator.IsConsistent());
+
+	// 放不下的分配失败，不改变状态
+	uint64_t offset;
+	CHECK(!allocator.Allocate(BLOCK_SIZE + 1, 1, EMemoryResourceType::Linear, offset));
+	CHECK(allocator.Allocate(BLOCK_SIZE, 1, EMemoryResourceType::Linear, offset) && offset == 0);
+	CHECK(!allocator.Allocate(1, 1, EMemoryResourceType::Linear, offset));
+	CHECK(allocator.IsConsistent());
+}
+
+/** 释放中间的分配后，和前后的空闲区间合并，合并后的空间可以被更大的分配使用*/
+static void TestCoalesce()
+{
+	FMemoryBlockAllocator allocator;
+	allocator.Init(BLOCK_SIZE, EMemoryAllocationStrategy::FreeList, 1);
+	const uint64_t size = BLOCK_SIZE / 4;
+	uint64_t offsets[4];
+	for (uint64_t& offset : offsets) {
+		CHECK(allocator.Allocate(size, 1, EMemoryResourceType::Linear, offset));
+	}
+	CHECK(allocator.GetLargestFreeRange() == 0);
+
+	allocator.Free(offsets[1]);
+	allocator.Free(offsets[3]);
+	CHECK(allocator.GetLargestFreeRange() == size);
+	uint64_t offset;
+	CHECK(!allocator.Allocate(size * 2, 1, EMemoryResourceType::Linear, offset));
+
+	// 释放 offsets[2] 后 1、2、3 合并成一个区间
+	allocator.Free(offsets[2]);
+	CHECK(allocator.IsConsistent());
+	CHECK(allocator.GetLargestFreeRange() == size * 3);
+	CHECK(allocator.Allocate(size * 3, 1, EMemoryResourceType::Linear, offset) && offset == offsets[1]);
+	CHECK(allocator.IsConsistent());
+}
+
+/** 不同布局的相邻资源不能落在同一个 Granularity 页中*/
+static void TestGranularity()
+{
+	const uint64_t granularity = 1024;
+	FMemoryBlockAllocator allocator;
+	allocator.Init(BLOCK_SIZE, EMemoryAllocationStrategy::FreeList, granularity);
+	uint64_t buffer, image;
+	CHECK(allocator.Allocate(100, 16, EMemoryResourceType::Linear, buffer));
+	CHECK(allocator.Allocate(100, 16, EMemoryResourceType::Optimal, image));
+	CHECK((buffer + 99) / granularity != image / granularity);
+	CHECK(allocator.IsConsistent());
+}
+
+/** 线性策略只向后追加，释放的空间在全部释放之前不会重用*/
+static void TestLinear()
+{
+	FMemoryBlockAllocator allocator;
+	allocator.Init(BLOCK_SIZE, EMemoryAllocationStrategy::Linear, 1);
+	uint64_t a, b, c;
+	CHECK(allocator.Allocate(100, 1, EMemoryResourceType::Linear, a));
+	CHECK(allocator.Allocate(100, 64, EMemoryResourceType::Linear, b));
+	CHECK(a == 0 && b == 128);
+	allocator.Free(a);
+	CHECK(allocator.Allocate(10, 1, EMemoryResourceType::Linear, c) && c == 228);
+	CHECK(allocator.IsConsistent());
+	allocator.Free(b);
+	allocator.Free(c);
+	CHECK(allocator.GetFreeBytes() == BLOCK_SIZE);
+	CHECK(allocator.Allocate(10, 1, EMemoryResourceType::Linear, a) && a == 0);
+	CHECK(allocator.IsConsistent());
+}
+
+/** 随机分配和释放，每一步都检查区间和 TLSF 索引一致，并且分配之间没有重叠*/
+static void TestRandomized()
+{
+	FMemoryBlockAllocator allocator;
+	allocator.Init(BLOCK_SIZE, EMemoryAllocationStrategy::FreeList, 256);
+	struct FLive { uint64_t Offset; uint64_t Size; };
+	std::vector<FLive> live;
+	uint32_t state = 42;
+	auto next = [&state]() { state = state * 1664525u + 1013904223u; return state >> 8; };
+	bool bConsistent = true;
+	for (int step = 0; step < 4000; step++)
+	{
+		if (live.empty() || next() % 3 != 0)
+		{
+			uint64_t size = 1 + next() % 20000;
+			uint64_t alignment = 1ull << (next() % 9);
+			EMemoryResourceType type = (next() & 1) ? EMemoryResourceType::Linear : EMemoryResourceType::Optimal;
+			uint64_t offset;
+			if (allocator.Allocate(size, alignment, type, offset)) {
+				CHECK(offset % alignment == 0 && offset + size <= BLOCK_SIZE);
+				live.push_back({ offset, size });
+			}
+		}
+		else
+		{
+			size_t index = next() % live.size();
+			allocator.Free(live[index].Offset);
+			live[index] = live.back();
+			live.pop_back();
+		}
+		bConsistent = bConsistent && allocator.IsConsistent();
+	}
+	CHECK(bConsistent);
+	for (size_t i = 0; i < live.size(); i++) {
+		for (size_t j = i + 1; j < live.size(); j++) {
+			CHECK(live[i].Offset + live[i].Size <= live[j].Offset || live[j].Offset + live[j].Size <= live[i].Offset);
+		}
+	}
+	for (const FLive& allocation : live) {
+		allocator.Free(allocation.Offset);
+	}
+	CHECK(allocator.GetLargestFreeRange() == BLOCK_SIZE);
+	CHECK(allocator.IsConsistent());
+}
+
+int main()
+{
+	RUN_TEST(TestAllocateAndFree);
+	RUN_TEST(TestCoalesce);
+	RUN_TEST(TestGranularity);
+	RUN_TEST(TestLinear);
+	RUN_TEST(TestRandomized);
+	return UNIT_TEST_RESULT();
+}
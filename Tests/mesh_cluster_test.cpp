@@ -0,0 +1,166 @@
+// Copyright LearnVulkan Tests, @xukai. All Rights Reserved.
+// 模型簇划分：顶点数和三角形数不超过上限，包围球包含簇的顶点，法线锥包含簇内所有三角形的法线
+#include "unit_test.h"
+
+#include "mesh_processing.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+struct FTestVertex {
+	glm::vec3 Position;
+};
+
+/** 经纬度球面，加上一些互不相连的小四边形（类似草叶），覆盖没有相邻三角形时按顺序填充的分支*/
+static void MakeTestMesh(std::vector<FTestVertex>& outVertices, std::vector<uint32_t>& outIndices)
+{
+	const uint32_t rings = 24;
+	const uint32_t segments = 48;
+	const float pi = 3.14159265f;
+	for (uint32_t r = 0; r <= rings; r++) {
+		float theta = pi * float(r) / float(rings);
+		for (uint32_t s = 0; s <= segments; s++) {
+			float phi = 2.0f * pi * float(s) / float(segments);
+			outVertices.push_back({ glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)) });
+		}
+	}
+	for (uint32_t r = 0; r < rings; r++) {
+		for (uint32_t s = 0; s < segments; s++) {
+			uint32_t v = r * (segments + 1) + s;
+			if (r > 0) {
+				outIndices.insert(outIndices.end(), { v, v + segments + 1, v + 1 });
+			}
+			if (r + 1 < rings) {
+				outIndices.insert(outIndices.end(), { v + 1, v + segments + 1, v + segments + 2 });
+			}
+		}
+	}
+
+	uint32_t state = 7u;
+	auto random = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return float(state >> 8) / float(1u << 24);
+	};
+	for (uint32_t blade = 0; blade < 100; blade++) {
+		glm::vec3 root(random() * 8.0f + 4.0f, random() * 8.0f, 0.0f);
+		uint32_t v = static_cast<uint32_t>(outVertices.size());
+		outVertices.push_back({ root });
+		outVertices.push_back({ root + glm::vec3(0.1f, 0.0f, 0.0f) });
+		outVertices.push_back({ root + glm::vec3(0.1f, 0.0f, 1.0f) });
+		outVertices.push_back({ root + glm::vec3(0.0f, 0.0f, 1.0f) });
+		outIndices.insert(outIndices.end(), { v, v + 1, v + 2, v, v + 2, v + 3 });
+	}
+}
+
+static std::vector<std::array<uint32_t, 3>> GetTriangleSet(const std::vector<uint32_t>& indices)
+{
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static glm::vec3 GetTriangleNormal(const std::vector<FTestVertex>& vertices, const std::vector<uint32_t>& indices, uint32_t i)
+{
+	glm::vec3 p0 = vertices[indices[i]].Position;
+	return glm::normalize(glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0));
+}
+
+static void TestClusterLimits()
+{
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	MakeTestMesh(vertices, indices);
+	std::vector<uint32_t> source = indices;
+
+	std::vector<FCluster> clusters;
+	FMeshClusterizer::Build(vertices, indices, clusters);
+
+	CHECK(GetTriangleSet(indices) == GetTriangleSet(source));
+	CHECK(!clusters.empty());
+
+	// 簇首尾相接覆盖全部点序，不超过上限，VertexCount 和实际引用的顶点数一致
+	uint32_t nextIndex = 0;
+	bool bWithinLimits = true;
+	bool bVertexCountMatches = true;
+	for (const FCluster& cluster : clusters) {
+		CHECK(cluster.FirstIndex == nextIndex);
+		nextIndex = cluster.FirstIndex + cluster.IndexCount;
+		std::set<uint32_t> clusterVertices(indices.begin() + cluster.FirstIndex, indices.begin() + nextIndex);
+		bWithinLimits = bWithinLimits && cluster.IndexCount > 0 && cluster.IndexCount % 3 == 0 &&
+			cluster.IndexCount / 3 <= FCluster::MAX_TRIANGLES && cluster.VertexCount <= FCluster::MAX_VERTICES;
+		bVertexCountMatches = bVertexCountMatches && cluster.VertexCount == clusterVertices.size();
+	}
+	CHECK(nextIndex == indices.size());
+	CHECK(bWithinLimits);
+	CHECK(bVertexCountMatches);
+	// 球面是连通的，贪心生长应该能把簇填到接近上限
+	CHECK(clusters.size() * FCluster::MAX_TRIANGLES < indices.size() / 3 * 2);
+}
+
+/** ConeCutoff 是张角的正弦，法线和轴的夹角余弦不小于 sqrt(1 - ConeCutoff^2)
+ * 渲染时的剔除条件成立的相机位置，簇内每个三角形都应该背对相机*/
+static void TestClusterBounds()
+{
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	MakeTestMesh(vertices, indices);
+	std::vector<FCluster> clusters;
+	FMeshClusterizer::Build(vertices, indices, clusters);
+
+	uint32_t state = 11u;
+	auto random = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return float(state >> 8) / float(1u << 24) * 2.0f - 1.0f;
+	};
+
+	bool bSpheresContain = true;
+	bool bConesContain = true;
+	bool bCullingConservative = true;
+	size_t coneCount = 0;
+	size_t culledCount = 0;
+	for (const FCluster& cluster : clusters) {
+		for (uint32_t i = cluster.FirstIndex; i < cluster.FirstIndex + cluster.IndexCount; i++) {
+			bSpheresContain = bSpheresContain && glm::length(vertices[indices[i]].Position - cluster.BoundsCenter) <= cluster.BoundsRadius + 1e-5f;
+		}
+		if (cluster.ConeCutoff >= 1.0f) {
+			continue;
+		}
+		coneCount++;
+		float minDot = std::sqrt(1.0f - cluster.ConeCutoff * cluster.ConeCutoff);
+		for (uint32_t i = cluster.FirstIndex; i < cluster.FirstIndex + cluster.IndexCount; i += 3) {
+			bConesContain = bConesContain && glm::dot(GetTriangleNormal(vertices, indices, i), cluster.ConeAxis) >= minDot - 1e-4f;
+		}
+
+		for (uint32_t sample = 0; sample < 64; sample++) {
+			glm::vec3 cameraPos = cluster.BoundsCenter + glm::vec3(random(), random(), random()) * 6.0f;
+			glm::vec3 toCluster = cluster.BoundsCenter - cameraPos;
+			if (glm::dot(toCluster, cluster.ConeAxis) < cluster.ConeCutoff * glm::length(toCluster) + cluster.BoundsRadius) {
+				continue;
+			}
+			culledCount++;
+			for (uint32_t i = cluster.FirstIndex; i < cluster.FirstIndex + cluster.IndexCount; i += 3) {
+				glm::vec3 toTriangle = vertices[indices[i]].Position - cameraPos;
+				bCullingConservative = bCullingConservative && glm::dot(GetTriangleNormal(vertices, indices, i), toTriangle) >= 0.0f;
+			}
+		}
+	}
+	CHECK(bSpheresContain);
+	CHECK(coneCount > 0);
+	CHECK(bConesContain);
+	CHECK(culledCount > 0);
+	CHECK(bCullingConservative);
+}
+
+int main()
+{
+	RUN_TEST(TestClusterLimits);
+	RUN_TEST(TestClusterBounds);
+	return UNIT_TEST_RESULT();
+}
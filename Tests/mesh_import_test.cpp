@@ -0,0 +1,153 @@
+// Copyright LearnVulkan Tests, @xukai. All Rights Reserved.
+// 模型导入：OBJ 索引三元组去重和点序重映射，以及几何缓存池的区间分配和两倍扩容
+#include "unit_test.h"
+
+#include "mesh_processing.h"
+#include "suballocators.h"
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+/** 和 tinyobj::index_t 相同的成员*/
+struct FTestObjIndex {
+	int vertex_index;
+	int normal_index;
+	int texcoord_index;
+};
+
+/** 顶点记录生成它的三元组，用来检查点序指向的顶点*/
+struct FTestVertex {
+	FTestObjIndex Source;
+};
+
+static std::tuple<int, int, int> MakeKey(const FTestObjIndex& index)
+{
+	return std::make_tuple(index.vertex_index, index.normal_index, index.texcoord_index);
+}
+
+static void BuildUnique(const std::vector<std::vector<FTestObjIndex>>& shapes, std::vector<FTestVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	size_t indexCount = 0;
+	for (const auto& shape : shapes) {
+		indexCount += shape.size();
+	}
+	FObjVertexIndexMap uniqueVertices;
+	uniqueVertices.Reserve(indexCount);
+	for (const auto& shape : shapes) {
+		uniqueVertices.AppendUnique(shape, vertices, indices, [](const FTestObjIndex& index) { return FTestVertex{ index }; });
+	}
+}
+
+/** 一个四边形的两个三角形共享两个角，法线或者UV不同的角是不同的顶点，缺少的法线和UV索引为 -1*/
+static void TestVertexDedup()
+{
+	std::vector<std::vector<FTestObjIndex>> shapes = {
+		{ { 0, 0, 0 }, { 1, 0, 1 }, { 2, 0, 2 }, { 0, 0, 0 }, { 2, 0, 2 }, { 3, 0, 3 } },
+		// 第二个形状引用相同的位置，但是法线不同，以及没有法线和UV的三元组
+		{ { 0, 1, 0 }, { 1, 1, 1 }, { 2, 1, 2 }, { 0, -1, -1 }, { 1, -1, -1 }, { 0, -1, -1 } },
+	};
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	BuildUnique(shapes, vertices, indices);
+
+	CHECK(indices.size() == 12);
+	CHECK(vertices.size() == 9);
+	CHECK(indices[0] == indices[3] && indices[2] == indices[4]);
+	CHECK(indices[0] != indices[6]);
+	CHECK(indices[9] == indices[11]);
+	// 顶点按首次出现的顺序生成
+	for (uint32_t i = 0; i < 4; i++) {
+		CHECK(indices[i < 3 ? i : i + 2] == i);
+	}
+}
+
+/** 大量随机三元组和 std::map 的结果对比：每个点序指向的顶点由同一个三元组生成，不同的三元组生成不同的顶点*/
+static void TestIndexRemapping()
+{
+	uint32_t state = 7;
+	auto next = [&state]() { state = state * 1664525u + 1013904223u; return state >> 8; };
+	std::vector<std::vector<FTestObjIndex>> shapes(3);
+	for (auto& shape : shapes) {
+		for (int i = 0; i < 30000; i++) {
+			shape.push_back({ int(next() % 2000), int(next() % 3) - 1, int(next() % 4) - 1 });
+		}
+	}
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	BuildUnique(shapes, vertices, indices);
+
+	std::map<std::tuple<int, int, int>, uint32_t> reference;
+	size_t i = 0;
+	bool bMatches = true;
+	for (const auto& shape : shapes) {
+		for (const FTestObjIndex& index : shape) {
+			auto inserted = reference.emplace(MakeKey(index), uint32_t(reference.size()));
+			bMatches = bMatches && indices[i] == inserted.first->second && MakeKey(vertices[indices[i]].Source) == MakeKey(index);
+			i++;
+		}
+	}
+	CHECK(indices.size() == i);
+	CHECK(bMatches);
+	CHECK(vertices.size() == reference.size());
+}
+
+static void TestPoolAllocate()
+{
+	FGeometryRangeAllocator pool;
+	pool.Grow(1000);
+	CHECK(pool.Capacity == 1000 && pool.Used == 0);
+	uint32_t a = pool.Allocate(300);
+	uint32_t b = pool.Allocate(300);
+	uint32_t c = pool.Allocate(300);
+	CHECK(a == 0 && b == 300 && c == 600);
+	CHECK(pool.Allocate(200) == FGeometryRangeAllocator::INVALID_OFFSET);
+	CHECK(!pool.CanAllocate(101) && pool.CanAllocate(100));
+
+	// 释放中间的区间后首次适配重用，和相邻的空闲区间合并
+	pool.Free(b, 300);
+	CHECK(pool.Allocate(100) == 300);
+	pool.Free(c, 300);
+	CHECK(pool.FreeRanges.size() == 1 && pool.FreeRanges.begin()->first == 400 && pool.FreeRanges.begin()->second == 600);
+	pool.Free(a, 300);
+	pool.Free(300, 100);
+	CHECK(pool.Used == 0);
+	CHECK(pool.FreeRanges.size() == 1 && pool.FreeRanges.begin()->second == 1000);
+}
+
+/** 放不下时按两倍扩容，末尾的空闲区间和新增的空间合并，扩容后分配从末尾空闲区间开始*/
+static void TestPoolGrow()
+{
+	FGeometryRangeAllocator pool;
+	pool.Grow(1000);
+	CHECK(pool.Allocate(900) == 0);
+	CHECK(!pool.CanAllocate(500));
+	// 末尾有100个空闲元素，两倍扩容后有1100个
+	CHECK(pool.GetGrowCapacity(500) == 2000);
+	CHECK(pool.GetGrowCapacity(1100) == 2000);
+	CHECK(pool.GetGrowCapacity(1101) == 4000);
+	pool.Grow(uint32_t(pool.GetGrowCapacity(500)));
+	CHECK(pool.Capacity == 2000 && pool.Used == 900);
+	CHECK(pool.FreeRanges.size() == 1);
+	CHECK(pool.Allocate(500) == 900);
+
+	// 末尾没有空闲区间时，新增的空间需要放下全部元素
+	FGeometryRangeAllocator full;
+	full.Grow(1000);
+	CHECK(full.Allocate(1000) == 0);
+	CHECK(full.GetGrowCapacity(1000) == 2000);
+	CHECK(full.GetGrowCapacity(1001) == 4000);
+	full.Grow(uint32_t(full.GetGrowCapacity(1001)));
+	CHECK(full.Allocate(1001) == 1000);
+	CHECK(full.Used == 2001);
+}
+
+int main()
+{
+	RUN_TEST(TestVertexDedup);
+	RUN_TEST(TestIndexRemapping);
+	RUN_TEST(TestPoolAllocate);
+	RUN_TEST(TestPoolGrow);
+	return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,140 @@
+// Copyright LearnVulkan Tests, @xukai. All Rights Reserved.
+// Tipsify 保留所有三角形并降低 ACMR，顶点重排后几何不变
+#include "unit_test.h"
+
+#include "mesh_processing.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct FTestVertex {
+	glm::vec3 Position;
+};
+
+/** size x size 个四边形的网格*/
+static void MakeGrid(uint32_t size, std::vector<FTestVertex>& outVertices, std::vector<uint32_t>& outIndices)
+{
+	for (uint32_t y = 0; y <= size; y++) {
+		for (uint32_t x = 0; x <= size; x++) {
+			outVertices.push_back({ glm::vec3(float(x), float(y), 0.0f) });
+		}
+	}
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			uint32_t v = y * (size + 1) + x;
+			outIndices.insert(outIndices.end(), { v, v + 1, v + size + 2, v, v + size + 2, v + size + 1 });
+		}
+	}
+}
+
+/** 打乱三角形的顺序，模拟没有优化过的点序*/
+static void ShuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed)
+{
+	size_t triangleCount = indices.size() / 3;
+	for (size_t t = triangleCount - 1; t > 0; t--) {
+		seed = seed * 1664525u + 1013904223u;
+		size_t other = (seed >> 8) % (t + 1);
+		std::swap_ranges(indices.begin() + t * 3, indices.begin() + t * 3 + 3, indices.begin() + other * 3);
+	}
+}
+
+/** 三角形按旋转到最小顶点开头后排序，保留绕序，用来比较两组点序是否包含相同的三角形*/
+static std::vector<std::array<uint32_t, 3>> GetTriangleSet(const std::vector<uint32_t>& indices)
+{
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		std::array<uint32_t, 3> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static void TestVertexCacheOptimization()
+{
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	MakeGrid(48, vertices, indices);
+	ShuffleTriangles(indices, 99u);
+	std::vector<uint32_t> source = indices;
+
+	float sourceACMR = FMeshOptimizer::AnalyzeVertexCache(indices, vertices.size()).ACMR;
+	std::vector<uint32_t> clusterStarts;
+	FMeshOptimizer::OptimizeVertexCache(indices, vertices.size(), clusterStarts);
+	FVertexCacheStats optimized = FMeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+
+	CHECK(indices.size() == source.size());
+	CHECK(GetTriangleSet(indices) == GetTriangleSet(source));
+	// 打乱的网格 ACMR 接近 3，Tipsify 之后明显降低
+	CHECK(sourceACMR > 2.0f);
+	CHECK(optimized.ACMR < sourceACMR * 0.5f);
+	CHECK(optimized.ACMR < 1.0f);
+	CHECK(optimized.ATVR >= 1.0f);
+
+	CHECK(!clusterStarts.empty() && clusterStarts[0] == 0);
+	CHECK(std::is_sorted(clusterStarts.begin(), clusterStarts.end()));
+	CHECK(clusterStarts.back() < indices.size() / 3);
+}
+
+/** 完整的优化流程：三角形按位置比较保持不变，顶点按第一次使用的顺序排列*/
+static void TestOptimize()
+{
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	MakeGrid(32, vertices, indices);
+	ShuffleTriangles(indices, 5u);
+	std::vector<FTestVertex> sourceVertices = vertices;
+	std::vector<uint32_t> sourceIndices = indices;
+	float sourceACMR = FMeshOptimizer::AnalyzeVertexCache(indices, vertices.size()).ACMR;
+
+	FMeshOptimizer::Optimize(vertices, indices);
+
+	CHECK(vertices.size() == sourceVertices.size());
+	CHECK(indices.size() == sourceIndices.size());
+	CHECK(FMeshOptimizer::AnalyzeVertexCache(indices, vertices.size()).ACMR < sourceACMR);
+
+	// 网格顶点的位置唯一，用位置映射回原来的顶点序号
+	auto toSourceIndex = [&sourceVertices](const glm::vec3& position) {
+		for (uint32_t v = 0; v < sourceVertices.size(); v++) {
+			if (sourceVertices[v].Position == position) {
+				return v;
+			}
+		}
+		return UINT32_MAX;
+	};
+	std::vector<uint32_t> remapped;
+	for (uint32_t index : indices) {
+		remapped.push_back(toSourceIndex(vertices[index].Position));
+	}
+	CHECK(GetTriangleSet(remapped) == GetTriangleSet(sourceIndices));
+
+	uint32_t nextVertex = 0;
+	bool bFetchOrdered = true;
+	for (uint32_t index : indices) {
+		bFetchOrdered = bFetchOrdered && index <= nextVertex;
+		nextVertex = std::max(nextVertex, index + 1);
+	}
+	CHECK(bFetchOrdered);
+}
+
+/** 没有被引用的顶点在重排时被丢弃*/
+static void TestVertexFetchDropsUnused()
+{
+	std::vector<FTestVertex> vertices = { { glm::vec3(0.0f) }, { glm::vec3(1.0f) }, { glm::vec3(2.0f) }, { glm::vec3(3.0f) } };
+	std::vector<uint32_t> indices = { 3, 1, 0 };
+	FMeshOptimizer::OptimizeVertexFetch(vertices, indices);
+	CHECK(vertices.size() == 3);
+	CHECK(indices[0] == 0 && indices[1] == 1 && indices[2] == 2);
+	CHECK(vertices[0].Position == glm::vec3(3.0f) && vertices[2].Position == glm::vec3(0.0f));
+}
+
+int main()
+{
+	RUN_TEST(TestVertexCacheOptimization);
+	RUN_TEST(TestOptimize);
+	RUN_TEST(TestVertexFetchDropsUnused);
+	return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,171 @@
+// Copyright LearnVulkan Tests, @xukai. All Rights Reserved.
+// QEM 简化：达到目标三角形数量，开放边界保持不变，沿UV接缝坍缩时接缝两侧的顶点不混用
+#include "unit_test.h"
+
+#include "mesh_processing.h"
+
+#include <cmath>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+struct FTestVertex {
+	glm::vec3 Position;
+};
+
+static const uint32_t GRID_SIZE = 16;
+static const uint32_t SEAM_COLUMN = GRID_SIZE / 2;
+
+/** GRID_SIZE x GRID_SIZE 个四边形的平面网格，bSeam 时 SEAM_COLUMN 这一列的顶点拆成左右两个（比如UV不连续）*/
+static void MakeGrid(bool bSeam, std::vector<FTestVertex>& outVertices, std::vector<uint32_t>& outIndices, std::vector<uint32_t>& outRightSeamVertices)
+{
+	std::vector<uint32_t> left((GRID_SIZE + 1) * (GRID_SIZE + 1));
+	std::vector<uint32_t> right(left.size());
+	for (uint32_t y = 0; y <= GRID_SIZE; y++) {
+		for (uint32_t x = 0; x <= GRID_SIZE; x++) {
+			uint32_t v = y * (GRID_SIZE + 1) + x;
+			left[v] = right[v] = static_cast<uint32_t>(outVertices.size());
+			outVertices.push_back({ glm::vec3(float(x), float(y), 0.0f) });
+			if (bSeam && x == SEAM_COLUMN) {
+				right[v] = static_cast<uint32_t>(outVertices.size());
+				outRightSeamVertices.push_back(right[v]);
+				outVertices.push_back({ glm::vec3(float(x), float(y), 0.0f) });
+			}
+		}
+	}
+	for (uint32_t y = 0; y < GRID_SIZE; y++) {
+		for (uint32_t x = 0; x < GRID_SIZE; x++) {
+			const std::vector<uint32_t>& side = x < SEAM_COLUMN ? left : right;
+			uint32_t v = y * (GRID_SIZE + 1) + x;
+			outIndices.insert(outIndices.end(), { side[v], side[v + 1], side[v + GRID_SIZE + 2], side[v], side[v + GRID_SIZE + 2], side[v + GRID_SIZE + 1] });
+		}
+	}
+}
+
+/** 有向面积之和，三角形翻转或者边界收缩都会让它偏离网格面积*/
+static float GetSignedArea(const std::vector<FTestVertex>& vertices, const std::vector<uint32_t>& indices, bool& bOutAllPositive)
+{
+	float area = 0.0f;
+	bOutAllPositive = true;
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		glm::vec3 p0 = vertices[indices[i + 0]].Position;
+		glm::vec3 p1 = vertices[indices[i + 1]].Position;
+		glm::vec3 p2 = vertices[indices[i + 2]].Position;
+		float triangleArea = glm::cross(p1 - p0, p2 - p0).z * 0.5f;
+		bOutAllPositive = bOutAllPositive && triangleArea > 0.0f;
+		area += triangleArea;
+	}
+	return area;
+}
+
+static bool IsOnBoundary(const glm::vec3& p)
+{
+	return p.x == 0.0f || p.y == 0.0f || p.x == float(GRID_SIZE) || p.y == float(GRID_SIZE);
+}
+
+static void TestReachesTarget()
+{
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> rightSeamVertices;
+	MakeGrid(false, vertices, indices, rightSeamVertices);
+
+	size_t targetIndexCount = indices.size() / 4 / 3 * 3;
+	float error = -1.0f;
+	std::vector<uint32_t> result = FMeshSimplifier::Simplify(vertices, indices, targetIndexCount, 1e-3f, error);
+
+	CHECK(result.size() % 3 == 0);
+	CHECK(!result.empty() && result.size() <= targetIndexCount);
+	CHECK(error >= 0.0f && error <= 1e-3f);
+
+	// 目标不低于原始数量时原样返回
+	std::vector<uint32_t> unchanged = FMeshSimplifier::Simplify(vertices, indices, indices.size(), 1e-3f, error);
+	CHECK(unchanged == indices && error == 0.0f);
+}
+
+static void TestKeepsBorder()
+{
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> rightSeamVertices;
+	MakeGrid(false, vertices, indices, rightSeamVertices);
+
+	float error = 0.0f;
+	std::vector<uint32_t> result = FMeshSimplifier::Simplify(vertices, indices, indices.size() / 8 / 3 * 3, 1e-3f, error);
+
+	bool bAllPositive = false;
+	float area = GetSignedArea(vertices, result, bAllPositive);
+	CHECK(bAllPositive);
+	CHECK(std::abs(area - float(GRID_SIZE * GRID_SIZE)) < 1e-3f);
+
+	// 四个角不能被坍缩，剩下的开放边界的边都在原来的边界上
+	std::set<uint32_t> referenced(result.begin(), result.end());
+	for (uint32_t corner : { 0u, GRID_SIZE, GRID_SIZE * (GRID_SIZE + 1), (GRID_SIZE + 1) * (GRID_SIZE + 1) - 1 }) {
+		CHECK(referenced.count(corner) == 1);
+	}
+	std::set<std::pair<uint32_t, uint32_t>> edges;
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (uint32_t k = 0; k < 3; k++) {
+			edges.insert({ result[i + k], result[i + (k + 1) % 3] });
+		}
+	}
+	bool bBorderOnBoundary = true;
+	for (const auto& edge : edges) {
+		if (edges.count({ edge.second, edge.first }) == 0) {
+			glm::vec3 a = vertices[edge.first].Position;
+			glm::vec3 b = vertices[edge.second].Position;
+			bBorderOnBoundary = bBorderOnBoundary && IsOnBoundary(a) && IsOnBoundary(b) && (a.x == b.x || a.y == b.y);
+		}
+	}
+	CHECK(bBorderOnBoundary);
+}
+
+/** 接缝上的顶点可以沿接缝坍缩，左边的三角形只用左边的顶点，右边的只用右边的*/
+static void TestCollapsesAlongSeam()
+{
+	std::vector<FTestVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> rightSeamVertices;
+	MakeGrid(true, vertices, indices, rightSeamVertices);
+
+	size_t targetIndexCount = indices.size() / 8 / 3 * 3;
+	float error = 0.0f;
+	std::vector<uint32_t> result = FMeshSimplifier::Simplify(vertices, indices, targetIndexCount, 1e-3f, error);
+	CHECK(result.size() <= targetIndexCount);
+
+	bool bAllPositive = false;
+	float area = GetSignedArea(vertices, result, bAllPositive);
+	CHECK(bAllPositive);
+	CHECK(std::abs(area - float(GRID_SIZE * GRID_SIZE)) < 1e-3f);
+
+	std::set<uint32_t> rightSeam(rightSeamVertices.begin(), rightSeamVertices.end());
+	std::set<float> seamRows;
+	bool bSidesKept = true;
+	for (size_t i = 0; i < result.size(); i += 3) {
+		float centerX = 0.0f;
+		for (uint32_t k = 0; k < 3; k++) {
+			centerX += vertices[result[i + k]].Position.x / 3.0f;
+		}
+		bool bRightSide = centerX > float(SEAM_COLUMN);
+		for (uint32_t k = 0; k < 3; k++) {
+			const glm::vec3& p = vertices[result[i + k]].Position;
+			bSidesKept = bSidesKept && (bRightSide ? p.x >= float(SEAM_COLUMN) : p.x <= float(SEAM_COLUMN));
+			if (p.x == float(SEAM_COLUMN)) {
+				bSidesKept = bSidesKept && (rightSeam.count(result[i + k]) == 1) == bRightSide;
+				seamRows.insert(p.y);
+			}
+		}
+	}
+	CHECK(bSidesKept);
+	// 接缝的两个端点在边界上被锁定，中间的接缝顶点被坍缩掉了一部分
+	CHECK(seamRows.count(0.0f) == 1 && seamRows.count(float(GRID_SIZE)) == 1);
+	CHECK(seamRows.size() < GRID_SIZE + 1);
+}
+
+int main()
+{
+	RUN_TEST(TestReachesTarget);
+	RUN_TEST(TestKeepsBorder);
+	RUN_TEST(TestCollapsesAlongSeam);
+	return UNIT_TEST_RESULT();
+}
@@ -0,0 +1,30 @@
+// Copyright LearnVulkan Tests, @xukai. All Rights Reserved.
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+/** 失败的检查数量，main 根据它返回进程的退出码*/
+inline int& GetUnitTestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+/** 检查失败时输出位置和表达式，继续执行剩下的检查*/
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cerr << __FILE__ << "(" << __LINE__ << "): CHECK failed: " #condition << std::endl; \
+			GetUnitTestFailures()++; \
+		} \
+	} while (0)
+
+/** 运行一个测试函数*/
+#define RUN_TEST(test) \
+	do { \
+		std::cout << "[TEST]: " #test << std::endl; \
+		test(); \
+	} while (0)
+
+#define UNIT_TEST_RESULT() (GetUnitTestFailures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
@@ -0,0 +1,806 @@
+// Copyright LearnVulkan Tools: Texture Cooker, @xukai. All Rights Reserved.
+// CPU 端的 BC1/BC4/BC5/BC7 编码器，端点用主成分分析估计，再用最小二乘迭代优化
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+/** BC7 2位和4位索引的插值权重*/
+static const int BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+/** 按 LSB 优先的顺序写入128位的压缩块*/
+struct FBitWriter {
+	uint8_t* Data;
+	uint32_t Position = 0;
+
+	void Write(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; i++, Position++) {
+			if ((value >> i) & 1u) {
+				Data[Position >> 3] |= uint8_t(1u << (Position & 7));
+			}
+		}
+	}
+};
+
+/** 按 LSB 优先的顺序读取128位的压缩块*/
+struct FBitReader {
+	const uint8_t* Data;
+	uint32_t Position = 0;
+
+	uint32_t Read(uint32_t bits)
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < bits; i++, Position++) {
+			value |= uint32_t((Data[Position >> 3] >> (Position & 7)) & 1u) << i;
+		}
+		return value;
+	}
+};
+
+
+/** 用幂迭代求像素分布的主轴，channels 为参与计算的通道数*/
+static void ComputePrincipalAxis(const float pixels[16][4], int channels, float outMean[4], float outAxis[4])
+{
+	for (int c = 0; c < 4; c++) {
+		outMean[c] = 0.0f;
+		outAxis[c] = 0.0f;
+	}
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < channels; c++) {
+			outMean[c] += pixels[i][c] / 16.0f;
+		}
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++) {
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++) {
+				covariance[a][b] += (pixels[i][a] - outMean[a]) * (pixels[i][b] - outMean[b]);
+			}
+		}
+	}
+
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++) {
+				next[a] += covariance[a][b] * axis[b];
+			}
+		}
+		float length = 0.0f;
+		for (int c = 0; c < channels; c++) {
+			length = std::max(length, std::abs(next[c]));
+		}
+		if (length < 1e-8f) {
+			break;
+		}
+		for (int c = 0; c < channels; c++) {
+			axis[c] = next[c] / length;
+		}
+	}
+	for (int c = 0; c < channels; c++) {
+		outAxis[c] = axis[c];
+	}
+}
+
+/** 沿主轴投影，取得初始的两个端点*/
+static void ComputeEndpoints(const float pixels[16][4], int channels, float outA[4], float outB[4])
+{
+	float mean[4], axis[4];
+	ComputePrincipalAxis(pixels, channels, mean, axis);
+	float minT = 0.0f, maxT = 0.0f;
+	float axisLength = 0.0f;
+	for (int c = 0; c < channels; c++) {
+		axisLength += axis[c] * axis[c];
+	}
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++) {
+			t += (pixels[i][c] - mean[c]) * axis[c];
+		}
+		t = axisLength > 0.0f ? t / axisLength : 0.0f;
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	for (int c = 0; c < 4; c++) {
+		outA[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+		outB[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+	}
+}
+
+/** 已知每个像素的插值权重时，用最小二乘求解最优端点，x = A * (1 - w) + B * w*/
+static bool RefineEndpoints(const float pixels[16][4], int channels, const float weights[16], float outA[4], float outB[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float wa = 1.0f - weights[i];
+		float wb = weights[i];
+		aa += wa * wa;
+		ab += wa * wb;
+		bb += wb * wb;
+		for (int c = 0; c < channels; c++) {
+			ax[c] += wa * pixels[i][c];
+			bx[c] += wb * pixels[i][c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::abs(determinant) < 1e-6f) {
+		return false;
+	}
+	for (int c = 0; c < channels; c++) {
+		outA[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+		outB[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+
+static uint16_t Pack565(const float color[4])
+{
+	uint32_t r = uint32_t(std::lround(color[0] * 31.0f / 255.0f));
+	uint32_t g = uint32_t(std::lround(color[1] * 63.0f / 255.0f));
+	uint32_t b = uint32_t(std::lround(color[2] * 31.0f / 255.0f));
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t packed, int outColor[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	outColor[0] = (r << 3) | (r >> 2);
+	outColor[1] = (g << 2) | (g >> 4);
+	outColor[2] = (b << 3) | (b >> 2);
+}
+
+/** 用两个 565 端点编码BC1块，返回误差*/
+static uint32_t EncodeBC1Endpoints(const float pixels[16][4], uint16_t color0, uint16_t color1, uint8_t out[8], float outWeights[16])
+{
+	// color0 > color1 时为4色模式
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+	int palette[4][3];
+	Unpack565(color0, palette[0]);
+	Unpack565(color1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+	static const float PALETTE_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	uint32_t indices = 0;
+	uint32_t totalError = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		uint32_t bestIndex = 0;
+		uint32_t bestError = UINT32_MAX;
+		for (uint32_t p = 0; p < (color0 == color1 ? 1u : 4u); p++)
+		{
+			uint32_t error = 0;
+			for (int c = 0; c < 3; c++) {
+				int d = int(std::lround(pixels[i][c])) - palette[p][c];
+				error += uint32_t(d * d);
+			}
+			if (error < bestError) {
+				bestError = error;
+				bestIndex = p;
+			}
+		}
+		indices |= bestIndex << (2 * i);
+		totalError += bestError;
+		outWeights[i] = PALETTE_WEIGHTS[bestIndex];
+	}
+
+	out[0] = uint8_t(color0 & 0xFF);
+	out[1] = uint8_t(color0 >> 8);
+	out[2] = uint8_t(color1 & 0xFF);
+	out[3] = uint8_t(color1 >> 8);
+	std::memcpy(out + 4, &indices, 4);
+	return totalError;
+}
+
+static void EncodeBC1Block(const float pixels[16][4], uint8_t out[8])
+{
+	float a[4], b[4];
+	ComputeEndpoints(pixels, 3, a, b);
+	// 端点从 B 到 A，权重为 0 的像素取 color0
+	float weights[16];
+	uint32_t bestError = EncodeBC1Endpoints(pixels, Pack565(b), Pack565(a), out, weights);
+
+	for (int iteration = 0; iteration < 2 && bestError > 0; iteration++)
+	{
+		// 权重是相对 color0 的，反过来求解
+		uint16_t color0 = uint16_t(out[0] | (out[1] << 8));
+		uint16_t color1 = uint16_t(out[2] | (out[3] << 8));
+		if (color0 == color1) {
+			break;
+		}
+		float start[4], end[4];
+		if (!RefineEndpoints(pixels, 3, weights, start, end)) {
+			break;
+		}
+		uint8_t candidate[8];
+		float candidateWeights[16];
+		uint16_t packedStart = Pack565(start);
+		uint16_t packedEnd = Pack565(end);
+		uint32_t error = EncodeBC1Endpoints(pixels, packedStart, packedEnd, candidate, candidateWeights);
+		if (error >= bestError) {
+			break;
+		}
+		bestError = error;
+		std::memcpy(out, candidate, 8);
+		std::memcpy(weights, candidateWeights, sizeof(weights));
+	}
+}
+
+
+/** BC4 单通道块，red0 > red1 时为8值模式*/
+static void EncodeBC4Block(const float pixels[16][4], int channel, uint8_t out[8])
+{
+	float minValue = 255.0f, maxValue = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		minValue = std::min(minValue, pixels[i][channel]);
+		maxValue = std::max(maxValue, pixels[i][channel]);
+	}
+	int red0 = int(std::lround(maxValue));
+	int red1 = int(std::lround(minValue));
+
+	int palette[8] = { red0, red1 };
+	for (int i = 1; i <= 6; i++) {
+		palette[i + 1] = ((7 - i) * red0 + i * red1 + 3) / 7;
+	}
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int value = int(std::lround(pixels[i][channel]));
+		uint64_t bestIndex = 0;
+		int bestError = INT32_MAX;
+		for (int p = 0; p < (red0 == red1 ? 1 : 8); p++)
+		{
+			int error = std::abs(value - palette[p]);
+			if (error < bestError) {
+				bestError = error;
+				bestIndex = uint64_t(p);
+			}
+		}
+		indices |= bestIndex << (3 * i);
+	}
+
+	out[0] = uint8_t(red0);
+	out[1] = uint8_t(red1);
+	for (int i = 0; i < 6; i++) {
+		out[2 + i] = uint8_t((indices >> (8 * i)) & 0xFF);
+	}
+}
+
+
+/** 端点量化到 7 位 + 共享的 P 位，选择误差较小的 P 位*/
+static void QuantizeBC7Endpoint(const float endpoint[4], int outQuantized[4], int& outPBit)
+{
+	float bestError = -1.0f;
+	for (int p = 0; p < 2; p++)
+	{
+		int quantized[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; c++) {
+			quantized[c] = std::clamp(int(std::lround((endpoint[c] - p) / 2.0f)), 0, 127);
+			float d = float((quantized[c] << 1) | p) - endpoint[c];
+			error += d * d;
+		}
+		if (bestError < 0.0f || error < bestError) {
+			bestError = error;
+			outPBit = p;
+			std::memcpy(outQuantized, quantized, sizeof(quantized));
+		}
+	}
+}
+
+/** Mode 6：单个子集，RGBA 7777 端点 + P 位，4位索引*/
+static uint32_t EncodeBC7Endpoints(const float pixels[16][4], const float a[4], const float b[4], uint8_t out[16], float outWeights[16])
+{
+	int quantized[2][4];
+	int pbits[2];
+	QuantizeBC7Endpoint(a, quantized[0], pbits[0]);
+	QuantizeBC7Endpoint(b, quantized[1], pbits[1]);
+
+	int endpoints[2][4];
+	for (int e = 0; e < 2; e++) {
+		for (int c = 0; c < 4; c++) {
+			endpoints[e][c] = (quantized[e][c] << 1) | pbits[e];
+		}
+	}
+	int palette[16][4];
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 4; c++) {
+			palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * endpoints[0][c] + BC7_WEIGHTS4[i] * endpoints[1][c] + 32) >> 6;
+		}
+	}
+
+	int indices[16];
+	uint32_t totalError = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		uint32_t bestError = UINT32_MAX;
+		for (int p = 0; p < 16; p++)
+		{
+			uint32_t error = 0;
+			for (int c = 0; c < 4; c++) {
+				int d = int(std::lround(pixels[i][c])) - palette[p][c];
+				error += uint32_t(d * d);
+			}
+			if (error < bestError) {
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+		totalError += bestError;
+	}
+
+	// 第一个像素的索引最高位隐含为0，否则交换端点
+	if (indices[0] & 8)
+	{
+		std::swap(quantized[0], quantized[1]);
+		std::swap(pbits[0], pbits[1]);
+		for (int i = 0; i < 16; i++) {
+			indices[i] = 15 - indices[i];
+		}
+	}
+	for (int i = 0; i < 16; i++) {
+		outWeights[i] = BC7_WEIGHTS4[indices[i]] / 64.0f;
+	}
+
+	std::memset(out, 0, 16);
+	FBitWriter writer{ out };
+	writer.Write(1u << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		writer.Write(uint32_t(quantized[0][c]), 7);
+		writer.Write(uint32_t(quantized[1][c]), 7);
+	}
+	writer.Write(uint32_t(pbits[0]), 1);
+	writer.Write(uint32_t(pbits[1]), 1);
+	writer.Write(uint32_t(indices[0]), 3);
+	for (int i = 1; i < 16; i++) {
+		writer.Write(uint32_t(indices[i]), 4);
+	}
+	return totalError;
+}
+
+static uint32_t EncodeBC7Mode6Block(const float pixels[16][4], uint8_t out[16])
+{
+	float a[4], b[4];
+	ComputeEndpoints(pixels, 4, a, b);
+	float weights[16];
+	uint32_t bestError = EncodeBC7Endpoints(pixels, a, b, out, weights);
+
+	for (int iteration = 0; iteration < 2 && bestError > 0; iteration++)
+	{
+		float start[4], end[4];
+		if (!RefineEndpoints(pixels, 4, weights, start, end)) {
+			break;
+		}
+		uint8_t candidate[16];
+		float candidateWeights[16];
+		uint32_t error = EncodeBC7Endpoints(pixels, start, end, candidate, candidateWeights);
+		if (error >= bestError) {
+			break;
+		}
+		bestError = error;
+		std::memcpy(out, candidate, 16);
+		std::memcpy(weights, candidateWeights, sizeof(weights));
+	}
+	return bestError;
+}
+
+/** 为每个像素选择误差最小的2位索引，channels 为参与比较的通道 [first, first + count)*/
+static uint32_t SelectBC7Indices2(const float pixels[16][4], int first, int count, const int endpoints[2][4], int outIndices[16])
+{
+	int palette[4][4];
+	for (int i = 0; i < 4; i++) {
+		for (int c = first; c < first + count; c++) {
+			palette[i][c] = ((64 - BC7_WEIGHTS2[i]) * endpoints[0][c] + BC7_WEIGHTS2[i] * endpoints[1][c] + 32) >> 6;
+		}
+	}
+	uint32_t totalError = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		uint32_t bestError = UINT32_MAX;
+		for (int p = 0; p < 4; p++)
+		{
+			uint32_t error = 0;
+			for (int c = first; c < first + count; c++) {
+				int d = int(std::lround(pixels[i][c])) - palette[p][c];
+				error += uint32_t(d * d);
+			}
+			if (error < bestError) {
+				bestError = error;
+				outIndices[i] = p;
+			}
+		}
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+/** Mode 5：RGB 777 端点和 8 位 Alpha 端点分别用2位索引插值，pixels 已经按 rotation 交换过通道
+ * 返回误差，outColorWeights 和 outAlphaWeights 是相对第一个端点的插值权重*/
+static uint32_t EncodeBC7Mode5Endpoints(const float pixels[16][4], int rotation, const float colorA[4], const float colorB[4], float alphaA, float alphaB,
+	uint8_t out[16], float outColorWeights[16], float outAlphaWeights[16])
+{
+	int quantized[2][4];
+	int endpoints[2][4];
+	for (int c = 0; c < 3; c++) {
+		quantized[0][c] = std::clamp(int(std::lround(colorA[c] * 127.0f / 255.0f)), 0, 127);
+		quantized[1][c] = std::clamp(int(std::lround(colorB[c] * 127.0f / 255.0f)), 0, 127);
+	}
+	quantized[0][3] = std::clamp(int(std::lround(alphaA)), 0, 255);
+	quantized[1][3] = std::clamp(int(std::lround(alphaB)), 0, 255);
+	for (int e = 0; e < 2; e++) {
+		for (int c = 0; c < 3; c++) {
+			endpoints[e][c] = (quantized[e][c] << 1) | (quantized[e][c] >> 6);
+		}
+		endpoints[e][3] = quantized[e][3];
+	}
+
+	int colorIndices[16], alphaIndices[16];
+	uint32_t totalError = SelectBC7Indices2(pixels, 0, 3, endpoints, colorIndices) + SelectBC7Indices2(pixels, 3, 1, endpoints, alphaIndices);
+
+	// 颜色和 Alpha 第一个像素的索引最高位都隐含为0，否则分别交换端点
+	if (colorIndices[0] & 2)
+	{
+		for (int c = 0; c < 3; c++) {
+			std::swap(quantized[0][c], quantized[1][c]);
+		}
+		for (int i = 0; i < 16; i++) {
+			colorIndices[i] = 3 - colorIndices[i];
+		}
+	}
+	if (alphaIndices[0] & 2)
+	{
+		std::swap(quantized[0][3], quantized[1][3]);
+		for (int i = 0; i < 16; i++) {
+			alphaIndices[i] = 3 - alphaIndices[i];
+		}
+	}
+	for (int i = 0; i < 16; i++) {
+		outColorWeights[i] = BC7_WEIGHTS2[colorIndices[i]] / 64.0f;
+		outAlphaWeights[i] = BC7_WEIGHTS2[alphaIndices[i]] / 64.0f;
+	}
+
+	std::memset(out, 0, 16);
+	FBitWriter writer{ out };
+	writer.Write(1u << 5, 6);
+	writer.Write(uint32_t(rotation), 2);
+	for (int c = 0; c < 3; c++) {
+		writer.Write(uint32_t(quantized[0][c]), 7);
+		writer.Write(uint32_t(quantized[1][c]), 7);
+	}
+	writer.Write(uint32_t(quantized[0][3]), 8);
+	writer.Write(uint32_t(quantized[1][3]), 8);
+	for (int i = 0; i < 16; i++) {
+		writer.Write(uint32_t(colorIndices[i]), i == 0 ? 1 : 2);
+	}
+	for (int i = 0; i < 16; i++) {
+		writer.Write(uint32_t(alphaIndices[i]), i == 0 ? 1 : 2);
+	}
+	return totalError;
+}
+
+/** 依次尝试4种 rotation：把一个颜色通道和 Alpha 交换后单独插值，适合这个通道和其它通道不相关的块（比如 ORM 的各个通道）*/
+static uint32_t EncodeBC7Mode5Block(const float pixels[16][4], uint8_t out[16])
+{
+	uint32_t bestError = UINT32_MAX;
+	for (int rotation = 0; rotation < 4; rotation++)
+	{
+		float rotated[16][4];
+		float scalar[16][4] = {};
+		float colorA[4], colorB[4];
+		float alphaA = 255.0f, alphaB = 0.0f;
+		std::memcpy(rotated, pixels, sizeof(rotated));
+		for (int i = 0; i < 16; i++)
+		{
+			if (rotation > 0) {
+				std::swap(rotated[i][rotation - 1], rotated[i][3]);
+			}
+			scalar[i][0] = rotated[i][3];
+			alphaA = std::min(alphaA, rotated[i][3]);
+			alphaB = std::max(alphaB, rotated[i][3]);
+		}
+		ComputeEndpoints(rotated, 3, colorA, colorB);
+
+		uint8_t candidate[16];
+		float colorWeights[16], alphaWeights[16];
+		uint32_t error = EncodeBC7Mode5Endpoints(rotated, rotation, colorA, colorB, alphaA, alphaB, candidate, colorWeights, alphaWeights);
+		for (int iteration = 0; iteration < 2 && error > 0; iteration++)
+		{
+			// 颜色和 Alpha 分别求解，求解失败的部分（比如所有权重相同）保持原来的端点
+			float start[4], end[4];
+			float alphaStart[4] = { alphaA }, alphaEnd[4] = { alphaB };
+			std::memcpy(start, colorA, sizeof(start));
+			std::memcpy(end, colorB, sizeof(end));
+			bool bColorRefined = RefineEndpoints(rotated, 3, colorWeights, start, end);
+			bool bAlphaRefined = RefineEndpoints(scalar, 1, alphaWeights, alphaStart, alphaEnd);
+			if (!bColorRefined && !bAlphaRefined) {
+				break;
+			}
+			uint8_t refined[16];
+			float refinedColorWeights[16], refinedAlphaWeights[16];
+			uint32_t refinedError = EncodeBC7Mode5Endpoints(rotated, rotation, start, end, alphaStart[0], alphaEnd[0], refined, refinedColorWeights, refinedAlphaWeights);
+			if (refinedError >= error) {
+				break;
+			}
+			error = refinedError;
+			std::memcpy(candidate, refined, 16);
+			std::memcpy(colorWeights, refinedColorWeights, sizeof(colorWeights));
+			std::memcpy(alphaWeights, refinedAlphaWeights, sizeof(alphaWeights));
+			std::memcpy(colorA, start, sizeof(colorA));
+			std::memcpy(colorB, end, sizeof(colorB));
+			alphaA = alphaStart[0];
+			alphaB = alphaEnd[0];
+		}
+
+		if (error < bestError) {
+			bestError = error;
+			std::memcpy(out, candidate, 16);
+		}
+	}
+	return bestError;
+}
+
+/** 分别用 Mode 6 和 Mode 5 编码，选择误差较小的一个*/
+static void EncodeBC7Block(const float pixels[16][4], uint8_t out[16])
+{
+	uint32_t mode6Error = EncodeBC7Mode6Block(pixels, out);
+	if (mode6Error == 0) {
+		return;
+	}
+	uint8_t mode5[16] = {};
+	if (EncodeBC7Mode5Block(pixels, mode5) < mode6Error) {
+		std::memcpy(out, mode5, 16);
+	}
+}
+
+
+static void DecodeBC1Block(const uint8_t block[8], uint8_t out[16][4])
+{
+	uint16_t color0 = uint16_t(block[0] | (block[1] << 8));
+	uint16_t color1 = uint16_t(block[2] | (block[3] << 8));
+	int palette[4][4];
+	Unpack565(color0, palette[0]);
+	Unpack565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	palette[3][3] = color0 > color1 ? 255 : 0;
+	for (int c = 0; c < 3; c++)
+	{
+		if (color0 > color1) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else {
+			// 3色模式，第4个颜色为透明黑色
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	uint32_t indices;
+	std::memcpy(&indices, block + 4, 4);
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 4; c++) {
+			out[i][c] = uint8_t(palette[(indices >> (2 * i)) & 3][c]);
+		}
+	}
+}
+
+static void DecodeBC4Block(const uint8_t block[8], int channel, uint8_t out[16][4])
+{
+	int red0 = block[0];
+	int red1 = block[1];
+	int palette[8] = { red0, red1 };
+	if (red0 > red1) {
+		for (int i = 1; i <= 6; i++) {
+			palette[i + 1] = ((7 - i) * red0 + i * red1 + 3) / 7;
+		}
+	}
+	else {
+		// 6值模式，最后两个值为0和255
+		for (int i = 1; i <= 4; i++) {
+			palette[i + 1] = ((5 - i) * red0 + i * red1 + 2) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++) {
+		indices |= uint64_t(block[2 + i]) << (8 * i);
+	}
+	for (int i = 0; i < 16; i++) {
+		out[i][channel] = uint8_t(palette[(indices >> (3 * i)) & 7]);
+	}
+}
+
+static void DecodeBC7Block(const uint8_t block[16], uint8_t out[16][4])
+{
+	FBitReader reader{ block };
+	uint32_t mode = 0;
+	while (mode < 8 && reader.Read(1) == 0) {
+		mode++;
+	}
+
+	if (mode == 5)
+	{
+		uint32_t rotation = reader.Read(2);
+		int endpoints[2][4];
+		for (int c = 0; c < 3; c++) {
+			for (int e = 0; e < 2; e++) {
+				int value = int(reader.Read(7));
+				endpoints[e][c] = (value << 1) | (value >> 6);
+			}
+		}
+		endpoints[0][3] = int(reader.Read(8));
+		endpoints[1][3] = int(reader.Read(8));
+		int colorIndices[16], alphaIndices[16];
+		for (int i = 0; i < 16; i++) {
+			colorIndices[i] = int(reader.Read(i == 0 ? 1 : 2));
+		}
+		for (int i = 0; i < 16; i++) {
+			alphaIndices[i] = int(reader.Read(i == 0 ? 1 : 2));
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++) {
+				int weight = BC7_WEIGHTS2[c < 3 ? colorIndices[i] : alphaIndices[i]];
+				out[i][c] = uint8_t(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+			}
+			if (rotation > 0) {
+				std::swap(out[i][rotation - 1], out[i][3]);
+			}
+		}
+		return;
+	}
+	if (mode != 6) {
+		throw std::invalid_argument("unsupported BC7 block mode!");
+	}
+
+	int endpoints[2][4];
+	for (int c = 0; c < 4; c++) {
+		endpoints[0][c] = int(reader.Read(7)) << 1;
+		endpoints[1][c] = int(reader.Read(7)) << 1;
+	}
+	for (int e = 0; e < 2; e++) {
+		uint32_t pbit = reader.Read(1);
+		for (int c = 0; c < 4; c++) {
+			endpoints[e][c] |= int(pbit);
+		}
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		int weight = BC7_WEIGHTS4[reader.Read(i == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; c++) {
+			out[i][c] = uint8_t(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+		}
+	}
+}
+
+
+uint32_t GetBlockBytes(ECookedTextureFormat format)
+{
+	switch (format)
+	{
+	case ECookedTextureFormat::BC1:
+	case ECookedTextureFormat::BC4:
+		return 8;
+	case ECookedTextureFormat::BC5:
+	case ECookedTextureFormat::BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+void CompressImage(ECookedTextureFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& outBlocks)
+{
+	uint32_t blockBytes = GetBlockBytes(format);
+	if (blockBytes == 0) {
+		throw std::invalid_argument("unsupported block compression format!");
+	}
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	outBlocks.assign(size_t(blocksX) * blocksY * blockBytes, 0);
+
+	for (uint32_t by = 0; by < blocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			float pixels[16][4];
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = std::min(bx * 4 + (i % 4), width - 1);
+				uint32_t y = std::min(by * 4 + (i / 4), height - 1);
+				const uint8_t* texel = &rgba[(size_t(y) * width + x) * 4];
+				for (int c = 0; c < 4; c++) {
+					pixels[i][c] = float(texel[c]);
+				}
+			}
+
+			uint8_t* block = &outBlocks[(size_t(by) * blocksX + bx) * blockBytes];
+			switch (format)
+			{
+			case ECookedTextureFormat::BC1:
+				EncodeBC1Block(pixels, block);
+				break;
+			case ECookedTextureFormat::BC4:
+				EncodeBC4Block(pixels, 0, block);
+				break;
+			case ECookedTextureFormat::BC5:
+				EncodeBC4Block(pixels, 0, block);
+				EncodeBC4Block(pixels, 1, block + 8);
+				break;
+			case ECookedTextureFormat::BC7:
+				EncodeBC7Block(pixels, block);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void DecompressImage(ECookedTextureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, std::vector<uint8_t>& outRGBA)
+{
+	uint32_t blockBytes = GetBlockBytes(format);
+	if (blockBytes == 0) {
+		throw std::invalid_argument("unsupported block compression format!");
+	}
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	outRGBA.assign(size_t(width) * height * 4, 0);
+
+	for (uint32_t by = 0; by < blocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			const uint8_t* block = &blocks[(size_t(by) * blocksX + bx) * blockBytes];
+			uint8_t pixels[16][4] = {};
+			for (int i = 0; i < 16; i++) {
+				pixels[i][3] = 255;
+			}
+			switch (format)
+			{
+			case ECookedTextureFormat::BC1:
+				DecodeBC1Block(block, pixels);
+				break;
+			case ECookedTextureFormat::BC4:
+				DecodeBC4Block(block, 0, pixels);
+				break;
+			case ECookedTextureFormat::BC5:
+				DecodeBC4Block(block, 0, pixels);
+				DecodeBC4Block(block + 8, 1, pixels);
+				break;
+			case ECookedTextureFormat::BC7:
+				DecodeBC7Block(block, pixels);
+				break;
+			default:
+				break;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = bx * 4 + (i % 4);
+				uint32_t y = by * 4 + (i / 4);
+				if (x < width && y < height) {
+					std::memcpy(&outRGBA[(size_t(y) * width + x) * 4], pixels[i], 4);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,20 @@
+// Copyright LearnVulkan Tools: Texture Cooker, @xukai. All Rights Reserved.
+#pragma once
+
+#include "cooked_texture.h"
+
+#include <cstdint>
+#include <vector>
+
+/** 每个4x4压缩块的字节数，RGBA8 返回0*/
+uint32_t GetBlockBytes(ECookedTextureFormat format);
+
+/** 把 RGBA8 图像压缩成 BC 块，宽高不是4的倍数时，边缘块重复最后一行/列像素
+ * BC1 压缩RGB，BC4 压缩R通道，BC5 压缩RG通道，BC7 压缩RGBA
+ * BC7 只使用单个子集的 Mode 6（RGBA 一起插值）和 Mode 5（一个通道单独插值），每个块选择误差较小的一个
+ * 不使用多子集的 Mode 0-3/7，颜色在块内分成多簇的区域误差会偏大*/
+void CompressImage(ECookedTextureFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& outBlocks);
+
+/** 把 BC 块解码成 RGBA8 图像，用来检查编码误差，BC4/BC5 没有的通道填0，Alpha 填255
+ * BC7 只支持编码器使用的 Mode，其它 Mode 的块抛出异常*/
+void DecompressImage(ECookedTextureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, std::vector<uint8_t>& outRGBA);
@@ -0,0 +1,158 @@
+// Copyright LearnVulkan Tools: Texture Cooker, @xukai. All Rights Reserved.
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/** 烘焙贴图的像素格式，运行时映射到对应的 VkFormat，烘焙工具不依赖 Vulkan 头文件*/
+enum class ECookedTextureFormat : uint32_t {
+	RGBA8 = 0,      // VK_FORMAT_R8G8B8A8_UNORM / VK_FORMAT_R8G8B8A8_SRGB
+	BC1 = 1,        // VK_FORMAT_BC1_RGB_UNORM_BLOCK / VK_FORMAT_BC1_RGB_SRGB_BLOCK，RGB 颜色
+	BC4 = 2,        // VK_FORMAT_BC4_UNORM_BLOCK，单通道数据
+	BC5 = 3,        // VK_FORMAT_BC5_UNORM_BLOCK，双通道法线，Z 在着色器中重建
+	BC7 = 4,        // VK_FORMAT_BC7_UNORM_BLOCK / VK_FORMAT_BC7_SRGB_BLOCK，高质量颜色
+	Count
+};
+
+/** 烘焙贴图文件头，文件布局为：Header + FCookedTextureMip[MipCount] + 每一级Mip的像素数据*/
+struct FCookedTextureHeader {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Format;       // ECookedTextureFormat
+	uint32_t Flags;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t MipCount;
+	uint32_t SourceMask;   // 存在的源文件，每个源文件一位，打包贴图删除或者重命名某个通道时不一致
+	uint64_t SourceSize;   // 所有源文件的大小之和
+	uint64_t SourceStamp;  // 所有源文件大小和修改时间的哈希，一致时不需要计算内容哈希
+	uint64_t SourceHash;   // 所有源文件内容的FNV-1a哈希，不存在的源文件为0
+
+	static constexpr uint32_t MAGIC = 0x58455443; // 'CTEX'
+	static constexpr uint32_t VERSION = 3;
+	static constexpr uint32_t FLAG_SRGB = 1u << 0;      // Mip 在线性空间中滤波，存储为 sRGB
+	static constexpr uint32_t FLAG_NORMALMAP = 1u << 1; // Mip 滤波后重新归一化法线
+};
+
+/** 每一级 Mip 在文件中的位置*/
+struct FCookedTextureMip {
+	uint64_t Offset;       // 相对文件头的偏移
+	uint64_t Size;
+	uint32_t Width;
+	uint32_t Height;
+};
+
+/** 打包贴图中的一个通道，对应一张单通道源贴图 <name><Suffix>.png，源贴图不存在时使用默认值*/
+struct FPackedTextureChannel {
+	const char* Suffix;
+	uint8_t DefaultValue;
+};
+
+/** ORM 打包贴图 <name>_orm，一次采样得到所有标量材质参数
+ * R = AmbientOcclution, G = Roughness, B = Metallic, A = Mask*/
+#define ORM_TEXTURE_SUFFIX "_orm"
+static constexpr uint32_t ORM_CHANNEL_COUNT = 4;
+static constexpr FPackedTextureChannel ORM_TEXTURE_CHANNELS[ORM_CHANNEL_COUNT] = {
+	{ "_ao", 255 },
+	{ "_r", 255 },
+	{ "_m", 0 },
+	{ "_ms", 255 },
+};
+
+
+/** 源文件的大小和修改时间，sources 中为空或者不存在的路径（打包贴图缺少的通道）不计入*/
+struct FCookedTextureSourceStamp {
+	uint32_t Mask = 0;
+	uint64_t Size = 0;
+	uint64_t Stamp = 14695981039346656037ull;
+};
+
+inline uint64_t HashCookedTextureValue(uint64_t hash, uint64_t value)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		hash = (hash ^ ((value >> (i * 8)) & 0xFF)) * 1099511628211ull;
+	}
+	return hash;
+}
+
+inline FCookedTextureSourceStamp GetCookedTextureSourceStamp(const std::vector<std::filesystem::path>& sources)
+{
+	FCookedTextureSourceStamp result;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		uint64_t size = 0;
+		int64_t time = 0;
+		std::error_code ec;
+		if (!sources[i].empty() && std::filesystem::is_regular_file(sources[i], ec))
+		{
+			size = static_cast<uint64_t>(std::filesystem::file_size(sources[i], ec));
+			time = static_cast<int64_t>(std::filesystem::last_write_time(sources[i], ec).time_since_epoch().count());
+			result.Mask |= 1u << i;
+		}
+		result.Size += size;
+		result.Stamp = HashCookedTextureValue(HashCookedTextureValue(result.Stamp, size), static_cast<uint64_t>(time));
+	}
+	return result;
+}
+
+/** 所有源文件内容的FNV-1a哈希，每个源文件的哈希再按顺序合并，不存在的源文件为0*/
+inline uint64_t HashCookedTextureSources(const std::vector<std::filesystem::path>& sources)
+{
+	uint64_t hash = 14695981039346656037ull;
+	std::vector<char> buffer(1 << 16);
+	for (const std::filesystem::path& source : sources)
+	{
+		uint64_t sourceHash = 0;
+		std::ifstream file(source, std::ios::binary);
+		if (!source.empty() && file.is_open())
+		{
+			sourceHash = 14695981039346656037ull;
+			while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+				for (std::streamsize i = 0; i < file.gcount(); i++) {
+					sourceHash = (sourceHash ^ static_cast<uint8_t>(buffer[i])) * 1099511628211ull;
+				}
+			}
+		}
+		hash = HashCookedTextureValue(hash, sourceHash);
+	}
+	return hash;
+}
+
+/** 烘焙贴图和源文件的比较结果*/
+enum class ECookedTextureSourceStatus {
+	Stale,          // 源文件增加、删除或者内容改变，需要重新烘焙
+	UpToDate,
+	NeedRestamp,    // 只有修改时间改变（比如重新checkout），需要更新文件头里的 SourceStamp
+};
+
+/** 先比较存在的源文件和总大小，再比较修改时间，修改时间不一致时比较内容哈希
+ * 所有源文件都不存在时（只发布了烘焙贴图）认为是最新的*/
+inline ECookedTextureSourceStatus CheckCookedTextureSources(const FCookedTextureHeader& header, const std::vector<std::filesystem::path>& sources, FCookedTextureSourceStamp& outStamp)
+{
+	outStamp = GetCookedTextureSourceStamp(sources);
+	if (outStamp.Mask == 0) {
+		return ECookedTextureSourceStatus::UpToDate;
+	}
+	if (header.SourceMask != outStamp.Mask || header.SourceSize != outStamp.Size) {
+		return ECookedTextureSourceStatus::Stale;
+	}
+	if (header.SourceStamp == outStamp.Stamp) {
+		return ECookedTextureSourceStatus::UpToDate;
+	}
+	return header.SourceHash == HashCookedTextureSources(sources) ? ECookedTextureSourceStatus::NeedRestamp : ECookedTextureSourceStatus::Stale;
+}
+
+/** 源文件内容没有变化，只更新烘焙贴图文件头里的 SourceStamp，文件不能处于映射状态*/
+inline bool RestampCookedTexture(const std::filesystem::path& cookedfile, uint64_t stamp)
+{
+	std::fstream file(cookedfile, std::ios::in | std::ios::out | std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	file.seekp(offsetof(FCookedTextureHeader, SourceStamp));
+	file.write(reinterpret_cast<const char*>(&stamp), sizeof(stamp));
+	return file.good();
+}
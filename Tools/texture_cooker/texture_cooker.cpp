@@ -0,0 +1,456 @@
+// Copyright LearnVulkan Tools: Texture Cooker, @xukai. All Rights Reserved.
+// 离线贴图烘焙工具：读取 PNG，预先计算完整的 Mip 链，写入 .tex 文件，运行时一次拷贝所有 Mip，不需要再用 vkCmdBlitImage 生成
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "cooked_texture.h"
+#include "block_compression.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+#define KAISER_FILTER_WIDTH 3.0 // 滤波半径，以目标像素为单位
+#define KAISER_FILTER_ALPHA 4.0 // Kaiser 窗的形状参数，越大旁瓣越小，但是越模糊
+
+static const char* FORMAT_NAMES[] = { "RGBA8", "BC1", "BC4", "BC5", "BC7" };
+
+
+/** 浮点 RGBA 图像，Mip 滤波在这个空间中进行
+ * sRGB 贴图存储的是线性颜色，法线贴图存储的是 [-1, 1] 的向量*/
+struct FImage {
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	std::vector<float> Pixels;
+};
+
+/** 烘焙选项，由贴图的命名规则决定*/
+struct FCookSettings {
+	bool bSRGB = false;
+	bool bNormalMap = false;
+	ECookedTextureFormat Format = ECookedTextureFormat::RGBA8;
+};
+
+/** 滤波核中的一个采样点*/
+struct FFilterTap {
+	uint32_t Index;
+	float Weight;
+};
+
+
+static float SRGBToLinear(float c)
+{
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSRGB(float c)
+{
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+/** 第一类零阶修正贝塞尔函数，用于计算 Kaiser 窗*/
+static double BesselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	double halfX = x * 0.5;
+	for (int k = 1; k < 32; k++) {
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+/** Kaiser 窗的 sinc 滤波，t 以目标像素为单位*/
+static double KaiserSinc(double t)
+{
+	double x = t / KAISER_FILTER_WIDTH;
+	if (std::abs(x) >= 1.0) {
+		return 0.0;
+	}
+	double sinc = (std::abs(t) < 1e-6) ? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+	double window = BesselI0(KAISER_FILTER_ALPHA * std::sqrt(1.0 - x * x)) / BesselI0(KAISER_FILTER_ALPHA);
+	return sinc * window;
+}
+
+/** 预先计算一维降采样每个目标像素的采样点和权重，贴图使用 REPEAT 寻址，所以边界环绕*/
+static std::vector<std::vector<FFilterTap>> BuildFilterKernel(uint32_t srcSize, uint32_t dstSize)
+{
+	std::vector<std::vector<FFilterTap>> kernel(dstSize);
+	double scale = double(srcSize) / double(dstSize);
+	double radius = KAISER_FILTER_WIDTH * scale;
+	for (uint32_t x = 0; x < dstSize; x++)
+	{
+		double center = (x + 0.5) * scale;
+		int32_t start = int32_t(std::floor(center - radius));
+		int32_t end = int32_t(std::ceil(center + radius));
+		double totalWeight = 0.0;
+		for (int32_t i = start; i < end; i++)
+		{
+			double weight = KaiserSinc((i + 0.5 - center) / scale);
+			if (weight == 0.0) {
+				continue;
+			}
+			uint32_t index = uint32_t(((i % int32_t(srcSize)) + int32_t(srcSize)) % int32_t(srcSize));
+			kernel[x].push_back({ index, float(weight) });
+			totalWeight += weight;
+		}
+		for (FFilterTap& tap : kernel[x]) {
+			tap.Weight = float(tap.Weight / totalWeight);
+		}
+	}
+	return kernel;
+}
+
+/** 可分离的降采样，先水平再垂直*/
+static FImage Downsample(const FImage& src)
+{
+	uint32_t dstWidth = std::max(1u, src.Width / 2);
+	uint32_t dstHeight = std::max(1u, src.Height / 2);
+
+	std::vector<std::vector<FFilterTap>> kernelX = BuildFilterKernel(src.Width, dstWidth);
+	FImage temp;
+	temp.Width = dstWidth;
+	temp.Height = src.Height;
+	temp.Pixels.assign(size_t(temp.Width) * temp.Height * 4, 0.0f);
+	for (uint32_t y = 0; y < src.Height; y++) {
+		for (uint32_t x = 0; x < dstWidth; x++) {
+			float* out = &temp.Pixels[(size_t(y) * dstWidth + x) * 4];
+			for (const FFilterTap& tap : kernelX[x]) {
+				const float* in = &src.Pixels[(size_t(y) * src.Width + tap.Index) * 4];
+				for (int c = 0; c < 4; c++) {
+					out[c] += in[c] * tap.Weight;
+				}
+			}
+		}
+	}
+
+	std::vector<std::vector<FFilterTap>> kernelY = BuildFilterKernel(src.Height, dstHeight);
+	FImage dst;
+	dst.Width = dstWidth;
+	dst.Height = dstHeight;
+	dst.Pixels.assign(size_t(dst.Width) * dst.Height * 4, 0.0f);
+	for (uint32_t y = 0; y < dstHeight; y++) {
+		for (const FFilterTap& tap : kernelY[y]) {
+			const float* in = &temp.Pixels[size_t(tap.Index) * dstWidth * 4];
+			float* out = &dst.Pixels[size_t(y) * dstWidth * 4];
+			for (size_t i = 0; i < size_t(dstWidth) * 4; i++) {
+				out[i] += in[i] * tap.Weight;
+			}
+		}
+	}
+	return dst;
+}
+
+/** 8位像素转换到滤波空间*/
+static FImage DecodeImage(const uint8_t* pixels, uint32_t width, uint32_t height, const FCookSettings& settings)
+{
+	FImage image;
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.resize(size_t(width) * height * 4);
+	for (size_t i = 0; i < image.Pixels.size(); i++)
+	{
+		float value = pixels[i] / 255.0f;
+		bool bAlpha = (i % 4) == 3;
+		if (settings.bNormalMap && !bAlpha) {
+			value = value * 2.0f - 1.0f;
+		}
+		else if (settings.bSRGB && !bAlpha) {
+			value = SRGBToLinear(value);
+		}
+		image.Pixels[i] = value;
+	}
+	return image;
+}
+
+/** 滤波空间转换回8位像素*/
+static void EncodeImage(const FImage& image, const FCookSettings& settings, std::vector<uint8_t>& outPixels)
+{
+	outPixels.resize(image.Pixels.size());
+	for (size_t p = 0; p < image.Pixels.size(); p += 4)
+	{
+		float rgba[4] = { image.Pixels[p + 0], image.Pixels[p + 1], image.Pixels[p + 2], image.Pixels[p + 3] };
+		if (settings.bNormalMap) {
+			// 滤波后的法线长度小于1，重新归一化
+			float length = std::sqrt(rgba[0] * rgba[0] + rgba[1] * rgba[1] + rgba[2] * rgba[2]);
+			for (int c = 0; c < 3; c++) {
+				rgba[c] = (length > 1e-6f ? rgba[c] / length : (c == 2 ? 1.0f : 0.0f)) * 0.5f + 0.5f;
+			}
+		}
+		else if (settings.bSRGB) {
+			for (int c = 0; c < 3; c++) {
+				rgba[c] = LinearToSRGB(std::max(0.0f, rgba[c]));
+			}
+		}
+		for (int c = 0; c < 4; c++) {
+			outPixels[p + c] = uint8_t(std::clamp(rgba[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+/** 贴图命名规则：*_bc 和 background 为 sRGB 颜色贴图，*_n 为法线贴图，其他为线性数据
+ * 压缩格式：颜色 BC7，法线 BC5，自发光 BC1，ORM 打包贴图 BC7，其他单通道标量 BC4
+ * default_* 会被绑定到任意材质通道，保持 RGBA8 不压缩*/
+static FCookSettings GetCookSettings(const fs::path& input)
+{
+	std::string name = input.stem().string();
+	auto EndsWith = [&name](const std::string& suffix) {
+		return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+
+	FCookSettings settings;
+	settings.bSRGB = EndsWith("_bc") || name == "background";
+	settings.bNormalMap = EndsWith("_n");
+	if (name.rfind("default_", 0) == 0) {
+		settings.Format = ECookedTextureFormat::RGBA8;
+	}
+	else if (settings.bSRGB) {
+		settings.Format = ECookedTextureFormat::BC7;
+	}
+	else if (settings.bNormalMap) {
+		settings.Format = ECookedTextureFormat::BC5;
+	}
+	else if (EndsWith("_ev")) {
+		settings.Format = ECookedTextureFormat::BC1;
+	}
+	else if (EndsWith(ORM_TEXTURE_SUFFIX)) {
+		settings.Format = ECookedTextureFormat::BC7;
+	}
+	else {
+		settings.Format = ECookedTextureFormat::BC4;
+	}
+	return settings;
+}
+
+/** 源贴图是 ORM 打包贴图的一个通道时，返回通道序号和材质名，否则返回 -1*/
+static int32_t GetPackedChannel(const fs::path& input, std::string& outMaterialName)
+{
+	std::string name = input.stem().string();
+	if (name.rfind("default_", 0) == 0) {
+		return -1;
+	}
+	for (uint32_t c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		std::string suffix = ORM_TEXTURE_CHANNELS[c].Suffix;
+		if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+			outMaterialName = name.substr(0, name.size() - suffix.size());
+			return int32_t(c);
+		}
+	}
+	return -1;
+}
+
+/** 读取一张源贴图*/
+static FImage LoadSourceImage(const fs::path& input, const FCookSettings& settings)
+{
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(input.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) {
+		throw std::runtime_error("failed to load texture image: " + input.string());
+	}
+	FImage image = DecodeImage(pixels, uint32_t(width), uint32_t(height), settings);
+	stbi_image_free(pixels);
+	return image;
+}
+
+/** 把各个通道源贴图的 R 通道打包成一张 RGBA 贴图，缺少的通道填充默认值，所有源贴图的尺寸必须一致*/
+static FImage LoadPackedImage(const std::vector<fs::path>& channelInputs, const FCookSettings& settings)
+{
+	int width = 0, height = 0;
+	std::vector<uint8_t> packed;
+	for (uint32_t c = 0; c < ORM_CHANNEL_COUNT; c++)
+	{
+		if (channelInputs[c].empty()) {
+			continue;
+		}
+		int channelWidth, channelHeight, channels;
+		stbi_uc* pixels = stbi_load(channelInputs[c].string().c_str(), &channelWidth, &channelHeight, &channels, STBI_rgb_alpha);
+		if (!pixels) {
+			throw std::runtime_error("failed to load texture image: " + channelInputs[c].string());
+		}
+		if (packed.empty()) {
+			width = channelWidth;
+			height = channelHeight;
+			packed.resize(size_t(width) * height * 4);
+			for (size_t p = 0; p < packed.size(); p += 4) {
+				for (uint32_t i = 0; i < ORM_CHANNEL_COUNT; i++) {
+					packed[p + i] = ORM_TEXTURE_CHANNELS[i].DefaultValue;
+				}
+			}
+		}
+		else if (channelWidth != width || channelHeight != height) {
+			stbi_image_free(pixels);
+			throw std::runtime_error("packed texture channels have different sizes: " + channelInputs[c].string());
+		}
+		for (size_t p = 0; p < packed.size(); p += 4) {
+			packed[p + c] = pixels[p];
+		}
+		stbi_image_free(pixels);
+	}
+	return DecodeImage(packed.data(), uint32_t(width), uint32_t(height), settings);
+}
+
+/** 烘焙一张贴图，写入所有 Mip 级别，文件头记录源文件的状态，见 CheckCookedTextureSources*/
+static uint32_t CookTexture(FImage image, const fs::path& output, const FCookSettings& settings, const std::vector<fs::path>& inputs)
+{
+	uint32_t width = image.Width;
+	uint32_t height = image.Height;
+	uint32_t mipCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	std::vector<FCookedTextureMip> mips(mipCount);
+	std::vector<std::vector<uint8_t>> mipPixels(mipCount);
+	uint64_t offset = sizeof(FCookedTextureHeader) + sizeof(FCookedTextureMip) * mipCount;
+	for (uint32_t i = 0; i < mipCount; i++)
+	{
+		if (i > 0) {
+			image = Downsample(image);
+		}
+		EncodeImage(image, settings, mipPixels[i]);
+		if (settings.Format != ECookedTextureFormat::RGBA8) {
+			std::vector<uint8_t> blocks;
+			CompressImage(settings.Format, mipPixels[i].data(), image.Width, image.Height, blocks);
+			mipPixels[i].swap(blocks);
+		}
+		mips[i].Offset = offset;
+		mips[i].Size = mipPixels[i].size();
+		mips[i].Width = image.Width;
+		mips[i].Height = image.Height;
+		offset += mips[i].Size;
+	}
+
+	FCookedTextureHeader header{};
+	header.Magic = FCookedTextureHeader::MAGIC;
+	header.Version = FCookedTextureHeader::VERSION;
+	header.Format = static_cast<uint32_t>(settings.Format);
+	header.Flags = (settings.bSRGB ? FCookedTextureHeader::FLAG_SRGB : 0) | (settings.bNormalMap ? FCookedTextureHeader::FLAG_NORMALMAP : 0);
+	header.Width = width;
+	header.Height = height;
+	header.MipCount = mipCount;
+	FCookedTextureSourceStamp sourceStamp = GetCookedTextureSourceStamp(inputs);
+	header.SourceMask = sourceStamp.Mask;
+	header.SourceSize = sourceStamp.Size;
+	header.SourceStamp = sourceStamp.Stamp;
+	header.SourceHash = HashCookedTextureSources(inputs);
+
+	std::ofstream file(output, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open cooked texture file: " + output.string());
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(mips.data()), sizeof(FCookedTextureMip) * mipCount);
+	for (const std::vector<uint8_t>& level : mipPixels) {
+		file.write(reinterpret_cast<const char*>(level.data()), level.size());
+	}
+	if (!file.good()) {
+		throw std::runtime_error("failed to write cooked texture file: " + output.string());
+	}
+	return mipCount;
+}
+
+
+/** 烘焙文件是当前版本的格式，并且记录的源文件大小和内容与当前一致时跳过
+ * 只有修改时间改变时更新文件头，下次不需要再计算内容哈希*/
+static bool IsCookedTextureUpToDate(const std::vector<fs::path>& inputs, const fs::path& output)
+{
+	FCookedTextureHeader header{};
+	{
+		std::ifstream file(output, std::ios::binary);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file.good() || header.Magic != FCookedTextureHeader::MAGIC || header.Version != FCookedTextureHeader::VERSION) {
+			return false;
+		}
+	}
+	FCookedTextureSourceStamp sourceStamp;
+	switch (CheckCookedTextureSources(header, inputs, sourceStamp))
+	{
+	case ECookedTextureSourceStatus::UpToDate:
+		return true;
+	case ECookedTextureSourceStatus::NeedRestamp:
+		return RestampCookedTexture(output, sourceStamp.Stamp);
+	default:
+		return false;
+	}
+}
+
+
+/** 输出一条烘焙日志*/
+static void LogCookedTexture(const std::string& input, const fs::path& output, uint32_t mipCount, const FCookSettings& settings)
+{
+	std::cout << "[COOK]: " << input << " -> " << output.filename().string()
+		<< " (" << mipCount << " mips, " << FORMAT_NAMES[static_cast<uint32_t>(settings.Format)]
+		<< (settings.bSRGB ? ", sRGB" : "") << (settings.bNormalMap ? ", normal" : "") << ")" << std::endl;
+}
+
+
+/** 用法：texture_cooker <input_dir> <output_dir> [--force]
+ * 把 input_dir 中所有 PNG 烘焙成 output_dir 中同名的 .tex 文件，源文件没有更新时跳过
+ * *_ao, *_r, *_m, *_ms 不单独烘焙，按材质名打包成一张 *_orm.tex*/
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		std::cerr << "usage: texture_cooker <input_dir> <output_dir> [--force]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	fs::path inputDir = argv[1];
+	fs::path outputDir = argv[2];
+	bool bForce = (argc > 3 && std::strcmp(argv[3], "--force") == 0);
+
+	try {
+		fs::create_directories(outputDir);
+		uint32_t cookedCount = 0;
+		std::map<std::string, std::vector<fs::path>> packedInputs;
+		for (const fs::directory_entry& entry : fs::directory_iterator(inputDir))
+		{
+			if (!entry.is_regular_file() || entry.path().extension() != ".png") {
+				continue;
+			}
+			std::string materialName;
+			int32_t channel = GetPackedChannel(entry.path(), materialName);
+			if (channel >= 0) {
+				std::vector<fs::path>& channelInputs = packedInputs[materialName];
+				channelInputs.resize(ORM_CHANNEL_COUNT);
+				channelInputs[channel] = entry.path();
+				continue;
+			}
+			fs::path output = outputDir / entry.path().filename().replace_extension(".tex");
+			if (!bForce && IsCookedTextureUpToDate({ entry.path() }, output)) {
+				continue;
+			}
+			FCookSettings settings = GetCookSettings(entry.path());
+			uint32_t mipCount = CookTexture(LoadSourceImage(entry.path(), settings), output, settings, { entry.path() });
+			LogCookedTexture(entry.path().filename().string(), output, mipCount, settings);
+			cookedCount++;
+		}
+
+		for (const auto& [materialName, channelInputs] : packedInputs)
+		{
+			fs::path output = outputDir / (materialName + ORM_TEXTURE_SUFFIX ".tex");
+			if (!bForce && IsCookedTextureUpToDate(channelInputs, output)) {
+				continue;
+			}
+			FCookSettings settings = GetCookSettings(output);
+			uint32_t mipCount = CookTexture(LoadPackedImage(channelInputs, settings), output, settings, channelInputs);
+			LogCookedTexture(materialName + "_{ao,r,m,ms}", output, mipCount, settings);
+			cookedCount++;
+		}
+		std::cout << "[COOK]: " << cookedCount << " textures cooked" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}